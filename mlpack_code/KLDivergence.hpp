@@ -6,23 +6,171 @@
 #define KL_DIVERGENCE_HPP_
 
 #include "data.hpp"
+#include "divergence_matrix.hpp"
+#include "divergence_stats.hpp"
+#include "quantized_data.hpp"
+#include "sparse_data.hpp"
 
 namespace bmst {
 
-template<typename T>
+// D fixes the dimensionality of the points at compile time (see Dims in
+// data.hpp); the default handles any dimensionality.
+template<typename T, size_t D = kDynamicDims>
 class KLDivergence
 {
+private:
+  // The term of coordinate i in BDivergence (max() if it is infinite)
+  // and in JBDivergence
+  static inline double Term_(const T x_i, const T y_i);
+  static inline double JBTerm_(const T x_i, const T y_i);
+  static inline double SparseDenseJB_(
+      const SparsePointView<T>& x, const ConstPointView<T>& y);
+
 public:
-  static inline double BDivergence(const Point<T>& x, const Point<T>& y);
-  static inline Point<T> Gradient(const Point<T>& x);
-  static inline Point<T> GradientConjugate(const Point<T>& x);
+  static const size_t kDims = D;
+
+  static inline double BDivergence(
+      const ConstPointView<T>& x, const ConstPointView<T>& y);
+  static inline Point<T> Gradient(const ConstPointView<T>& x);
+  static inline Point<T> GradientConjugate(const ConstPointView<T>& x);
+
+  // Gradient and GradientConjugate written into result, reusing its 
+  // storage (it is only reallocated if its dimensionality differs, as in
+  // Axpby). result may alias x.
+  static inline void Gradient(const ConstPointView<T>& x, Point<T>& result);
+  static inline void GradientConjugate(
+      const ConstPointView<T>& x, Point<T>& result);
+
   static inline bool IsCPD() { return true; }
-  static inline double JBDivergence(const Point<T>& x, const Point<T>& y);
+  // d(x, y) is convex in (x, y) jointly, which the pruning of a ball by
+  // a ball needs (see BregmanBall::RightLowerBound)
+  static inline bool IsJointlyConvex() { return true; }
+  static inline double JBDivergence(
+      const ConstPointView<T>& x, const ConstPointView<T>& y);
   static inline double StrongConvexityCoefficient() { return 1.0; }
-  static size_t bdiv_counter;
-  static size_t grad_counter;
-  static size_t grad_con_counter;
-  static size_t jbdiv_counter;
+
+  // An upper bound on the absolute error of divergence = BDivergence(x,
+  // y) (the rounding of the sum and the error of the vectorized
+  // logarithms, see simd_kernels.hpp). The radii and the bounds of the
+  // searches are padded by it, so that the pruning holds for the exact
+  // divergence.
+  template <class TPoint>
+  static inline double BDivergenceError(
+      const TPoint& x, const ConstPointView<T>& y, const double divergence);
+
+  // out[i][j] = BDivergence(x[i], y[j]) for all the points of the two
+  // tables, or for the rows [x_begin, x_end) of x and [y_begin, y_end)
+  // of y, computed like a matrix product (see divergence_matrix.hpp) by
+  // n_threads threads
+  static inline void BDivergenceMatrix(
+      const Table<T>& x, 
+      const Table<T>& y, 
+      Table<double>& out,
+      const size_t n_threads = 1);
+  static inline void BDivergenceMatrix(
+      const Table<T>& x, 
+      const size_t x_begin,
+      const size_t x_end,
+      const Table<T>& y, 
+      const size_t y_begin,
+      const size_t y_end,
+      Table<double>& out,
+      const size_t n_threads = 1);
+
+  // BDivergence(x, y) if it is at most upper_bound. Otherwise the sum may
+  // stop as soon as it passes upper_bound (every coordinate adds a 
+  // non-negative term) and the result is some value above upper_bound. 
+  // The sparse and quantized points are summed in full.
+  static inline double BDivergence(
+      const ConstPointView<T>& x, 
+      const ConstPointView<T>& y, 
+      const double upper_bound);
+  static inline double BDivergence(
+      const SparsePointView<T>& x, 
+      const ConstPointView<T>& y, 
+      const double upper_bound);
+  template <typename Q>
+  static inline double BDivergence(
+      const QuantizedPointView<T, Q>& x, 
+      const ConstPointView<T>& y, 
+      const double upper_bound);
+
+  // Sparse points (see sparse_data.hpp): the logarithms are only taken 
+  // on the non-zeros of the sparse arguments, the zeros are handled in 
+  // closed form
+  static inline double BDivergence(
+      const SparsePointView<T>& x, const ConstPointView<T>& y);
+  static inline double BDivergence(
+      const ConstPointView<T>& x, const SparsePointView<T>& y);
+  static inline double BDivergence(
+      const SparsePointView<T>& x, const SparsePointView<T>& y);
+  static inline Point<T> Gradient(const SparsePointView<T>& x);
+  static inline void Gradient(const SparsePointView<T>& x, Point<T>& result);
+  static inline double JBDivergence(
+      const SparsePointView<T>& x, const ConstPointView<T>& y);
+  static inline double JBDivergence(
+      const ConstPointView<T>& x, const SparsePointView<T>& y);
+  static inline double JBDivergence(
+      const SparsePointView<T>& x, const SparsePointView<T>& y);
+
+  // The generator phi of the divergence, and the divergence from the 
+  // cached terms d(x, y) = phi(x) - <x, grad phi(y)> + offset(y) with 
+  // offset(y) = <y, grad phi(y)> - phi(y) (see divergence_cache.hpp). 
+  // The latter costs one dot product, but is only valid if grad phi(y) 
+  // is finite.
+  static inline double Phi(const ConstPointView<T>& x);
+  static inline double Phi(const SparsePointView<T>& x);
+  static inline double BDivergence(
+      const double phi_x, 
+      const ConstPointView<T>& x, 
+      const ConstPointView<T>& grad_y, 
+      const double offset_y);
+  static inline double BDivergence(
+      const double phi_x, 
+      const SparsePointView<T>& x, 
+      const ConstPointView<T>& grad_y, 
+      const double offset_y);
+
+  // The closed form loses more to cancellation than the divergence 
+  // itself. With |<x, grad_y>| <= ClosedFormNorm(x, phi(x)) * 
+  // ClosedFormDualNorm(grad_y) (the l1 norm of x, which is non-negative,
+  // and the max norm of grad_y), 
+  // ClosedFormError bounds its absolute error given 
+  // scale_x = |phi(x)| + ||x|| ||grad_y||_* and 
+  // scale_y = |phi(y)| + ||y|| ||grad_y||_* (see divergence_cache.hpp).
+  template <class TPoint>
+  static inline double ClosedFormNorm(const TPoint& x, const double phi_x);
+  static inline double ClosedFormDualNorm(const ConstPointView<T>& grad_y);
+  static inline double ClosedFormError(
+      const size_t n_dims, const double scale_x, const double scale_y);
+
+  // Quantized points (see quantized_data.hpp), dequantized on the fly
+  template <typename Q>
+  static inline double BDivergence(
+      const QuantizedPointView<T, Q>& x, const ConstPointView<T>& y);
+  template <typename Q>
+  static inline Point<T> Gradient(const QuantizedPointView<T, Q>& x);
+  template <typename Q>
+  static inline void Gradient(
+      const QuantizedPointView<T, Q>& x, Point<T>& result);
+  template <typename Q>
+  static inline double JBDivergence(
+      const QuantizedPointView<T, Q>& x, const ConstPointView<T>& y);
+  template <typename Q>
+  static inline double Phi(const QuantizedPointView<T, Q>& x);
+  template <typename Q>
+  static inline double BDivergence(
+      const double phi_x, 
+      const QuantizedPointView<T, Q>& x, 
+      const ConstPointView<T>& grad_y, 
+      const double offset_y);
+
+  // The evaluations counted in the calling thread (in builds with 
+  // BMST_STATS, see divergence_stats.hpp)
+  static inline DivergenceStats& Stats() 
+  { 
+    return ThreadStats<KLDivergence>(); 
+  }
 }; // class KLDivergence 
 
 } // namespace
@@ -1,133 +1,582 @@
 #ifndef KL_DIVERGENCE_IMPL_HPP_
 #define KL_DIVERGENCE_IMPL_HPP_
 
+#include <algorithm>
 #include <cmath>
 
 #include "KLDivergence.hpp"
+#include "simd_kernels.hpp"
 
 namespace bmst {
 
-template<typename T> 
-size_t KLDivergence<T>::bdiv_counter = 0;
+template<typename T, size_t D>
+double KLDivergence<T, D>::BDivergence(
+    const ConstPointView<T>& x, const ConstPointView<T>& y)
+{
+  BMST_COUNT(Stats().bdiv, 1);
+  const size_t n_dims = Dims<D>::Of(x);
+  assert(y.n_dims() == n_dims);
+  return simd::KLDivergence(x.values(), y.values(), n_dims);
+}
+
+template<typename T, size_t D>
+double KLDivergence<T, D>::BDivergence(
+    const ConstPointView<T>& x, 
+    const ConstPointView<T>& y, 
+    const double upper_bound)
+{
+  BMST_COUNT(Stats().bdiv, 1);
+  const size_t n_dims = Dims<D>::Of(x);
+  assert(y.n_dims() == n_dims);
+  return simd::KLDivergence(x.values(), y.values(), n_dims, upper_bound);
+}
+
+template<typename T, size_t D>
+double KLDivergence<T, D>::BDivergence(
+    const SparsePointView<T>& x, 
+    const ConstPointView<T>& y, 
+    const double upper_bound)
+{
+  return BDivergence(x, y);
+}
+
+template<typename T, size_t D>
+template<typename Q>
+double KLDivergence<T, D>::BDivergence(
+    const QuantizedPointView<T, Q>& x, 
+    const ConstPointView<T>& y, 
+    const double upper_bound)
+{
+  return BDivergence(x, y);
+}
 
-template<typename T> 
-size_t KLDivergence<T>::grad_counter = 0;
+template<typename T, size_t D>
+template<class TPoint>
+double KLDivergence<T, D>::BDivergenceError(
+    const TPoint& x, const ConstPointView<T>& y, const double divergence)
+{
+  if (divergence == std::numeric_limits<T>::max())
+    return 0;
+  // every term x_i log (x_i / y_i) + y_i - x_i is off by a few units of
+  // |x_i log (x_i / y_i)| + y_i + x_i <= term_i + 2 (x_i + y_i), and the
+  // sum of the n terms adds n units of the divergence
+  const double n_dims = Dims<D>::Of(y);
+  const double unit = (n_dims + simd::kLogUlps + 4) * 
+    std::numeric_limits<T>::epsilon();
+  return unit * (divergence + 2 * (Sum(x) + Sum(y)));
+}
+
+template<typename T, size_t D>
+void KLDivergence<T, D>::BDivergenceMatrix(
+    const Table<T>& x, 
+    const Table<T>& y, 
+    Table<double>& out,
+    const size_t n_threads)
+{
+  divergence_matrix::Compute<T, KLDivergence<T, D> >(
+      x, 0, x.n_points(), y, 0, y.n_points(), out, n_threads);
+}
+
+template<typename T, size_t D>
+void KLDivergence<T, D>::BDivergenceMatrix(
+    const Table<T>& x, 
+    const size_t x_begin,
+    const size_t x_end,
+    const Table<T>& y, 
+    const size_t y_begin,
+    const size_t y_end,
+    Table<double>& out,
+    const size_t n_threads)
+{
+  divergence_matrix::Compute<T, KLDivergence<T, D> >(
+      x, x_begin, x_end, y, y_begin, y_end, out, n_threads);
+}
+
+template<typename T, size_t D>
+Point<T> KLDivergence<T, D>::Gradient(const ConstPointView<T>& x)
+{
+  Point<T> result;
+  Gradient(x, result);
+  return result;
+}
 
-template<typename T> 
-size_t KLDivergence<T>::grad_con_counter = 0;
+template<typename T, size_t D>
+Point<T> KLDivergence<T, D>::GradientConjugate(const ConstPointView<T>& x)
+{
+  Point<T> result;
+  GradientConjugate(x, result);
+  return result;
+}
 
-template<typename T> 
-size_t KLDivergence<T>::jbdiv_counter = 0;
+template<typename T, size_t D>
+void KLDivergence<T, D>::Gradient(
+    const ConstPointView<T>& x, Point<T>& result)
+{
+  BMST_COUNT(Stats().grad, 1);
+  const size_t n_dims = Dims<D>::Of(x);
+  // x cannot alias result if the sizes differ
+  if (result.n_dims() != n_dims)
+    result.zeros(n_dims);
+  simd::KLGradient(x.values(), result.values(), n_dims);
+}
 
-template<typename T>
-double KLDivergence<T>::BDivergence(const Point<T>& x, const Point<T>& y)
+template<typename T, size_t D>
+void KLDivergence<T, D>::GradientConjugate(
+    const ConstPointView<T>& x, Point<T>& result)
 {
-  ++bdiv_counter;
-  assert(x.n_dims() == y.n_dims());
+  BMST_COUNT(Stats().grad_con, 1);
+  const size_t n_dims = Dims<D>::Of(x);
+  if (result.n_dims() != n_dims)
+    result.zeros(n_dims);
+  simd::KLGradientConjugate(x.values(), result.values(), n_dims);
+}
 
+template<typename T, size_t D>
+double KLDivergence<T, D>::JBDivergence(
+    const ConstPointView<T>& x, const ConstPointView<T>& y) {
+  // compute f(x) + f(x) - 2 f((x+y)/2)
+  // \sum_i x_i log x_i + y_i log y_i - (x_i + y_i) log 0.5 * (x_i + y_i)
+  BMST_COUNT(Stats().jbdiv, 1);
+  const size_t n_dims = Dims<D>::Of(x);
+  assert(y.n_dims() == n_dims);
+  const T* x_values = x.values();
+  const T* y_values = y.values();
   double result = 0.0;
+  for (size_t i = 0; i < n_dims; ++i) 
+  {
+    const double z = x_values[i] + y_values[i];
+    if (x_values[i] >= std::numeric_limits<double>::epsilon()) 
+      result += (x_values[i] * log(x_values[i]));
+
+    if (y_values[i] >= std::numeric_limits<double>::epsilon()) 
+      result += (y_values[i] * log(y_values[i]));
+  
+    if (z >= std::numeric_limits<double>::epsilon())
+      result -= (z * log(0.5 * z));
+  }
 
-  for (int i = 0; i < x.n_dims(); i++)
+  return result;
+}
+
+template<typename T, size_t D>
+double KLDivergence<T, D>::Term_(const T x_i, const T y_i)
+{
+  if (x_i < 0 or y_i < 0) 
   {
-    if (x[i] < 0 or y[i] < 0) 
+    std::cout << "[ERROR] KL divergence cannot be computed for negative "
+      "valued features." << std::endl;
+    exit(1);
+  }
+
+  bool x_zero = (x_i < std::numeric_limits<T>::epsilon());
+  bool y_zero = (y_i < std::numeric_limits<T>::epsilon());
+  if (not x_zero and y_zero)
+    return std::numeric_limits<T>::max();
+  else if (x_zero and not y_zero)
+    return y_i;
+  else if (not x_zero and not y_zero) 
+    return x_i * log(x_i / y_i) + y_i - x_i;
+  return 0.0;
+}
+
+template<typename T, size_t D>
+double KLDivergence<T, D>::BDivergence(
+    const SparsePointView<T>& x, const ConstPointView<T>& y)
+{
+  BMST_COUNT(Stats().bdiv, 1);
+  const size_t n_dims = Dims<D>::Of(x);
+  assert(y.n_dims() == n_dims);
+  const T* y_values = y.values();
+
+  // every zero of x contributes y_i
+  double result = 0.0;
+  for (size_t i = 0; i < n_dims; i++)
+  {
+    if (y_values[i] < 0) 
     {
       std::cout << "[ERROR] KL divergence cannot be computed for negative "
         "valued features." << std::endl;
       exit(1);
     }
+    if (y_values[i] >= std::numeric_limits<T>::epsilon())
+      result += y_values[i];
+  }
 
-    // can take out fabs() here because we already checked if they're negative
-    bool x_zero = (x[i] < std::numeric_limits<T>::epsilon());
-    bool y_zero = (y[i] < std::numeric_limits<T>::epsilon());
-    
-    if (not x_zero and y_zero) // y == 0 and x > 0,  handle specially
-    {
-      // x log x - x log y + y - x
-      // log 0 = - infty so result = infty
-      result = std::numeric_limits<T>::max();
-      break; // not need to loop over other features anymore, nothing will reduce infty
-    } 
-    else if (x_zero and not y_zero) // y > 0, x == 0 , x log (x/y) + y - x = y
-    {
-      // 0 log 0 is 0 for KL divergence
-      result += y[i];
-    } 
-    else if (not x_zero and not y_zero) 
-    {
-      result += x[i] * log(x[i]/y[i]) + y[i] - x[i];      
-    }
-  } // loop over features
-    
+  const uint32_t* x_indices = x.indices();
+  const T* x_values = x.values();
+  for (size_t k = 0; k < x.n_nonzeros(); k++)
+  {
+    const T y_i = y_values[x_indices[k]];
+    const double term = Term_(x_values[k], y_i);
+    if (term == std::numeric_limits<T>::max())
+      return term;
+    result += term;
+    if (y_i >= std::numeric_limits<T>::epsilon())
+      result -= y_i;
+  }
   return result;
 }
 
-template<typename T>
-Point<T> KLDivergence<T>::Gradient(const Point<T>& x)
+template<typename T, size_t D>
+double KLDivergence<T, D>::BDivergence(
+    const ConstPointView<T>& x, const SparsePointView<T>& y)
+{
+  BMST_COUNT(Stats().bdiv, 1);
+  const size_t n_dims = Dims<D>::Of(x);
+  assert(y.n_dims() == n_dims);
+  const T* x_values = x.values();
+  const uint32_t* y_indices = y.indices();
+  const T* y_values = y.values();
+
+  double result = 0.0;
+  size_t k = 0;
+  for (size_t i = 0; i < n_dims; i++)
+  {
+    T y_i = 0;
+    if (k < y.n_nonzeros() and y_indices[k] == i)
+      y_i = y_values[k++];
+    const double term = Term_(x_values[i], y_i);
+    if (term == std::numeric_limits<T>::max())
+      return term;
+    result += term;
+  }
+  return result;
+}
+
+template<typename T, size_t D>
+double KLDivergence<T, D>::BDivergence(
+    const SparsePointView<T>& x, const SparsePointView<T>& y)
+{
+  BMST_COUNT(Stats().bdiv, 1);
+  const size_t n_dims = Dims<D>::Of(x);
+  assert(y.n_dims() == n_dims);
+
+  // merge the non-zeros, the common zeros contribute nothing
+  double result = 0.0;
+  size_t k_x = 0;
+  size_t k_y = 0;
+  while (k_x < x.n_nonzeros() or k_y < y.n_nonzeros())
+  {
+    const size_t i_x = (k_x < x.n_nonzeros()) ? x.indices()[k_x] : n_dims;
+    const size_t i_y = (k_y < y.n_nonzeros()) ? y.indices()[k_y] : n_dims;
+    const size_t i = std::min(i_x, i_y);
+    const T x_i = (i_x == i) ? x.values()[k_x++] : 0;
+    const T y_i = (i_y == i) ? y.values()[k_y++] : 0;
+    const double term = Term_(x_i, y_i);
+    if (term == std::numeric_limits<T>::max())
+      return term;
+    result += term;
+  }
+  return result;
+}
+
+template<typename T, size_t D>
+Point<T> KLDivergence<T, D>::Gradient(const SparsePointView<T>& x)
 {
-  ++grad_counter;
   Point<T> result;
-  result.zeros(x.n_dims());
+  Gradient(x, result);
+  return result;
+}
+
+template<typename T, size_t D>
+void KLDivergence<T, D>::Gradient(
+    const SparsePointView<T>& x, Point<T>& result)
+{
+  BMST_COUNT(Stats().grad, 1);
+  const size_t n_dims = Dims<D>::Of(x);
+  if (result.n_dims() != n_dims)
+    result.zeros(n_dims);
+  T* result_values = result.values();
+  std::fill(result_values, result_values + n_dims, 
+      -std::numeric_limits<T>::max());
 
-  for (int  i = 0; i < x.n_dims(); i++)
+  const uint32_t* x_indices = x.indices();
+  const T* x_values = x.values();
+  for (size_t k = 0; k < x.n_nonzeros(); k++)
   {
-    if (x[i] < 0) 
+    if (x_values[k] < 0) 
     {
       std::cout << "[ERROR] Gradient corresponding to KL divergence cannot "
         "be computed for negative valued features." << std::endl;
       exit(1);
     }
+    if (x_values[k] >= std::numeric_limits<T>::epsilon())
+      result_values[x_indices[k]] = log(x_values[k]) + 1.0;
+  }
+}
 
-    // Changed to check for numerical zero, not exact zero
-    if (x[i] < std::numeric_limits<T>::epsilon())
-      result[i] = -std::numeric_limits<T>::max();
-    else
-      result[i] = log(x[i]) + 1.0;
+template<typename T, size_t D>
+double KLDivergence<T, D>::JBTerm_(const T x_i, const T y_i)
+{
+  const double z = x_i + y_i;
+  double result = 0.0;
+  if (x_i >= std::numeric_limits<double>::epsilon()) 
+    result += (x_i * log(x_i));
+
+  if (y_i >= std::numeric_limits<double>::epsilon()) 
+    result += (y_i * log(y_i));
+
+  if (z >= std::numeric_limits<double>::epsilon())
+    result -= (z * log(0.5 * z));
+  return result;
+}
+
+template<typename T, size_t D>
+double KLDivergence<T, D>::SparseDenseJB_(
+    const SparsePointView<T>& x, const ConstPointView<T>& y)
+{
+  const size_t n_dims = Dims<D>::Of(x);
+  assert(y.n_dims() == n_dims);
+  const T* y_values = y.values();
+
+  // every zero of x contributes y_i log y_i - y_i log (y_i / 2) 
+  // = y_i log 2
+  double sum_y = 0.0;
+  for (size_t i = 0; i < n_dims; i++)
+    if (y_values[i] >= std::numeric_limits<double>::epsilon())
+      sum_y += y_values[i];
+  double result = M_LN2 * sum_y;
+
+  const uint32_t* x_indices = x.indices();
+  const T* x_values = x.values();
+  for (size_t k = 0; k < x.n_nonzeros(); k++)
+  {
+    const T y_i = y_values[x_indices[k]];
+    result += JBTerm_(x_values[k], y_i);
+    if (y_i >= std::numeric_limits<double>::epsilon())
+      result -= M_LN2 * y_i;
   }
+  return result;
+}
+
+template<typename T, size_t D>
+double KLDivergence<T, D>::JBDivergence(
+    const SparsePointView<T>& x, const ConstPointView<T>& y)
+{
+  BMST_COUNT(Stats().jbdiv, 1);
+  return SparseDenseJB_(x, y);
+}
 
+template<typename T, size_t D>
+double KLDivergence<T, D>::JBDivergence(
+    const ConstPointView<T>& x, const SparsePointView<T>& y)
+{
+  // the JB divergence is symmetric
+  BMST_COUNT(Stats().jbdiv, 1);
+  return SparseDenseJB_(y, x);
+}
+
+template<typename T, size_t D>
+double KLDivergence<T, D>::JBDivergence(
+    const SparsePointView<T>& x, const SparsePointView<T>& y)
+{
+  BMST_COUNT(Stats().jbdiv, 1);
+  const size_t n_dims = Dims<D>::Of(x);
+  assert(y.n_dims() == n_dims);
+
+  double result = 0.0;
+  size_t k_x = 0;
+  size_t k_y = 0;
+  while (k_x < x.n_nonzeros() or k_y < y.n_nonzeros())
+  {
+    const size_t i_x = (k_x < x.n_nonzeros()) ? x.indices()[k_x] : n_dims;
+    const size_t i_y = (k_y < y.n_nonzeros()) ? y.indices()[k_y] : n_dims;
+    const size_t i = std::min(i_x, i_y);
+    const T x_i = (i_x == i) ? x.values()[k_x++] : 0;
+    const T y_i = (i_y == i) ? y.values()[k_y++] : 0;
+    result += JBTerm_(x_i, y_i);
+  }
   return result;
 }
 
-template<typename T>
-Point<T> KLDivergence<T>::GradientConjugate(const Point<T>& x)
+template<typename T, size_t D>
+double KLDivergence<T, D>::Phi(const ConstPointView<T>& x)
 {
-  ++grad_con_counter;
-  Point<T> result;
-  result.zeros(x.n_dims());
-  
-  for (int i = 0; i < x.n_dims(); i++)
+  // \sum_i x_i log x_i
+  const size_t n_dims = Dims<D>::Of(x);
+  const T* x_values = x.values();
+  double result = 0.0;
+  for (size_t i = 0; i < n_dims; i++)
   {
-    if (x[i] > -std::numeric_limits<T>::max())
-      result[i] = exp(x[i] - 1.0);
-    else
-      result[i] = 0;
+    if (x_values[i] < 0) 
+    {
+      std::cout << "[ERROR] KL divergence cannot be computed for negative "
+        "valued features." << std::endl;
+      exit(1);
+    }
+    if (x_values[i] >= std::numeric_limits<T>::epsilon())
+      result += x_values[i] * log(x_values[i]);
   }
-  
   return result;
 }
 
-template<typename T>
-double KLDivergence<T>::JBDivergence(const Point<T>& x, const Point<T>& y) {
-  // compute f(x) + f(x) - 2 f((x+y)/2)
-  // \sum_i x_i log x_i + y_i log y_i - (x_i + y_i) log 0.5 * (x_i + y_i)
-  ++jbdiv_counter;
-  assert(x.n_dims() == y.n_dims());
-  Point<T> z = x + y;
+template<typename T, size_t D>
+double KLDivergence<T, D>::Phi(const SparsePointView<T>& x)
+{
+  const T* x_values = x.values();
   double result = 0.0;
-  for (size_t i = 0; i < x.n_dims(); ++i) 
+  for (size_t k = 0; k < x.n_nonzeros(); k++)
   {
-    if (x[i] >= std::numeric_limits<double>::epsilon()) 
-      result += (x[i] * log(x[i]));
+    if (x_values[k] < 0) 
+    {
+      std::cout << "[ERROR] KL divergence cannot be computed for negative "
+        "valued features." << std::endl;
+      exit(1);
+    }
+    if (x_values[k] >= std::numeric_limits<T>::epsilon())
+      result += x_values[k] * log(x_values[k]);
+  }
+  return result;
+}
 
-    if (y[i] >= std::numeric_limits<double>::epsilon()) 
-      result += (y[i] * log(y[i]));
-  
-    if (z[i] >= std::numeric_limits<double>::epsilon())
-      result -= (z[i] * log(0.5 * z[i]));
+template<typename T, size_t D>
+double KLDivergence<T, D>::BDivergence(
+    const double phi_x, 
+    const ConstPointView<T>& x, 
+    const ConstPointView<T>& grad_y, 
+    const double offset_y)
+{
+  BMST_COUNT(Stats().bdiv, 1);
+  // the cancellation can leave a small negative value
+  return std::max(0.0, phi_x - Dot(x, grad_y) + offset_y);
+}
+
+template<typename T, size_t D>
+double KLDivergence<T, D>::BDivergence(
+    const double phi_x, 
+    const SparsePointView<T>& x, 
+    const ConstPointView<T>& grad_y, 
+    const double offset_y)
+{
+  BMST_COUNT(Stats().bdiv, 1);
+  return std::max(0.0, phi_x - Dot(x, grad_y) + offset_y);
+}
+
+template<typename T, size_t D>
+template<class TPoint>
+double KLDivergence<T, D>::ClosedFormNorm(
+    const TPoint& x, const double /* phi_x */)
+{
+  return Sum(x);
+}
+
+template<typename T, size_t D>
+double KLDivergence<T, D>::ClosedFormDualNorm(
+    const ConstPointView<T>& grad_y)
+{
+  double max_norm = 0;
+  for (size_t i = 0; i < grad_y.n_dims(); i++)
+    max_norm = std::max(max_norm, (double) fabs(grad_y[i]));
+  return max_norm;
+}
+
+template<typename T, size_t D>
+double KLDivergence<T, D>::ClosedFormError(
+    const size_t n_dims, const double scale_x, const double scale_y)
+{
+  // grad_y is off by the error of the logarithms in T, which moves 
+  // <x - y, grad_y> by a few units of the scales; the sums of phi() and
+  // of the dot products are accumulated in double (see simd_kernels.hpp)
+  const double unit = 
+    (simd::kLogUlps + 4) * std::numeric_limits<T>::epsilon() + 
+    (n_dims + 4) * std::numeric_limits<double>::epsilon();
+  return unit * (scale_x + scale_y);
+}
+
+template<typename T, size_t D>
+template<typename Q>
+double KLDivergence<T, D>::BDivergence(
+    const QuantizedPointView<T, Q>& x, const ConstPointView<T>& y)
+{
+  BMST_COUNT(Stats().bdiv, 1);
+  const size_t n_dims = Dims<D>::Of(x);
+  assert(y.n_dims() == n_dims);
+  const Q* x_codes = x.codes();
+  const T x_scale = x.scale();
+  const T* y_values = y.values();
+
+  double result = 0.0;
+  for (size_t i = 0; i < n_dims; i++)
+  {
+    const double term = Term_(x_codes[i] * x_scale, y_values[i]);
+    if (term == std::numeric_limits<T>::max())
+      return term;
+    result += term;
   }
+  return result;
+}
 
+template<typename T, size_t D>
+template<typename Q>
+Point<T> KLDivergence<T, D>::Gradient(const QuantizedPointView<T, Q>& x)
+{
+  Point<T> result;
+  Gradient(x, result);
+  return result;
+}
+
+template<typename T, size_t D>
+template<typename Q>
+void KLDivergence<T, D>::Gradient(
+    const QuantizedPointView<T, Q>& x, Point<T>& result)
+{
+  // dequantized into result, and then in place
+  const size_t n_dims = Dims<D>::Of(x);
+  if (result.n_dims() != n_dims)
+    result.zeros(n_dims);
+  for (size_t i = 0; i < n_dims; i++)
+    result[i] = x[i];
+  Gradient(ConstPointView<T>(result), result);
+}
+
+template<typename T, size_t D>
+template<typename Q>
+double KLDivergence<T, D>::JBDivergence(
+    const QuantizedPointView<T, Q>& x, const ConstPointView<T>& y)
+{
+  BMST_COUNT(Stats().jbdiv, 1);
+  const size_t n_dims = Dims<D>::Of(x);
+  assert(y.n_dims() == n_dims);
+  const Q* x_codes = x.codes();
+  const T x_scale = x.scale();
+  const T* y_values = y.values();
+
+  double result = 0.0;
+  for (size_t i = 0; i < n_dims; i++)
+    result += JBTerm_(x_codes[i] * x_scale, y_values[i]);
   return result;
 }
 
+template<typename T, size_t D>
+template<typename Q>
+double KLDivergence<T, D>::Phi(const QuantizedPointView<T, Q>& x)
+{
+  // the codes are non-negative by construction
+  const size_t n_dims = Dims<D>::Of(x);
+  const Q* x_codes = x.codes();
+  const T x_scale = x.scale();
+  double result = 0.0;
+  for (size_t i = 0; i < n_dims; i++)
+  {
+    const T x_i = x_codes[i] * x_scale;
+    if (x_i >= std::numeric_limits<T>::epsilon())
+      result += x_i * log(x_i);
+  }
+  return result;
+}
+
+template<typename T, size_t D>
+template<typename Q>
+double KLDivergence<T, D>::BDivergence(
+    const double phi_x, 
+    const QuantizedPointView<T, Q>& x, 
+    const ConstPointView<T>& grad_y, 
+    const double offset_y)
+{
+  BMST_COUNT(Stats().bdiv, 1);
+  return std::max(0.0, phi_x - Dot(x, grad_y) + offset_y);
+}
+
 } // namespace
 
 #endif
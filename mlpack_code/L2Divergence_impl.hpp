@@ -1,54 +1,470 @@
 #ifndef L2DIVERGENCE_IMPL_HPP_
 #define L2DIVERGENCE_IMPL_HPP_
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
 #include "L2Divergence.hpp"
 
 namespace bmst {
 
-template<typename T> 
-size_t L2Divergence<T>::bdiv_counter = 0;
+template<typename T, size_t D>
+double L2Divergence<T, D>::SquaredDistance_(
+    const ConstPointView<T>& x, const ConstPointView<T>& y)
+{
+  if (D == kDynamicDims)
+    return SquaredDistance(x, y);
+
+  const size_t n_dims = Dims<D>::Of(x);
+  assert(y.n_dims() == n_dims);
+  const T* x_values = x.values();
+  const T* y_values = y.values();
+  double sq_distance = 0;
+  for (size_t i = 0; i < n_dims; i++)
+  {
+    const double diff = (double) x_values[i] - (double) y_values[i];
+    sq_distance += diff * diff;
+  }
+  return sq_distance;
+}
 
-template<typename T> 
-size_t L2Divergence<T>::grad_counter = 0;
+template<typename T, size_t D>
+double L2Divergence<T, D>::BDivergence(
+    const ConstPointView<T>& x, const ConstPointView<T>& y)
+{
+  BMST_COUNT(Stats().bdiv, 1);
+  // \frac{1}{2} \| x - y \|^2_2
+  return 0.5 * SquaredDistance_(x, y);
+}
 
-template<typename T> 
-size_t L2Divergence<T>::grad_con_counter = 0;
+template<typename T, size_t D>
+double L2Divergence<T, D>::BDivergence(
+    const ConstPointView<T>& x, 
+    const ConstPointView<T>& y, 
+    const double upper_bound)
+{
+  BMST_COUNT(Stats().bdiv, 1);
+  const size_t n_dims = Dims<D>::Of(x);
+  assert(y.n_dims() == n_dims);
+  return 0.5 * simd::SquaredDistance(
+      x.values(), y.values(), n_dims, 2 * upper_bound);
+}
 
-template<typename T> 
-size_t L2Divergence<T>::jbdiv_counter = 0;
+template<typename T, size_t D>
+double L2Divergence<T, D>::BDivergence(
+    const SparsePointView<T>& x, 
+    const ConstPointView<T>& y, 
+    const double upper_bound)
+{
+  return BDivergence(x, y);
+}
 
-template<typename T>
-double L2Divergence<T>::BDivergence(const Point<T>& x, const Point<T>& y)
+template<typename T, size_t D>
+template<typename Q>
+double L2Divergence<T, D>::BDivergence(
+    const QuantizedPointView<T, Q>& x, 
+    const ConstPointView<T>& y, 
+    const double upper_bound)
 {
-  ++bdiv_counter;  
-  // \frac{1}{2} \| x - y \|^2_2
-  Point<T> x_minus_y = x - y;
-  return 0.5 * Dot(x_minus_y, x_minus_y);
+  return BDivergence(x, y);
+}
+
+template<typename T, size_t D>
+template<class TPoint>
+double L2Divergence<T, D>::BDivergenceError(
+    const TPoint& /* x */, const ConstPointView<T>& y, const double divergence)
+{
+  const double n_dims = Dims<D>::Of(y);
+  return (n_dims + 4) * std::numeric_limits<T>::epsilon() * divergence;
+}
+
+template<typename T, size_t D>
+void L2Divergence<T, D>::BDivergenceMatrix(
+    const Table<T>& x, 
+    const Table<T>& y, 
+    Table<double>& out,
+    const size_t n_threads)
+{
+  divergence_matrix::Compute<T, L2Divergence<T, D> >(
+      x, 0, x.n_points(), y, 0, y.n_points(), out, n_threads);
+}
+
+template<typename T, size_t D>
+void L2Divergence<T, D>::BDivergenceMatrix(
+    const Table<T>& x, 
+    const size_t x_begin,
+    const size_t x_end,
+    const Table<T>& y, 
+    const size_t y_begin,
+    const size_t y_end,
+    Table<double>& out,
+    const size_t n_threads)
+{
+  divergence_matrix::Compute<T, L2Divergence<T, D> >(
+      x, x_begin, x_end, y, y_begin, y_end, out, n_threads);
 }
 
-template<typename T>
-Point<T> L2Divergence<T>::Gradient(const Point<T>& x)
+template<typename T, size_t D>
+Point<T> L2Divergence<T, D>::Gradient(const ConstPointView<T>& x)
 {
-  ++grad_counter;
-  return x;
+  BMST_COUNT(Stats().grad, 1);
+  return Point<T>(x);
 }
 
-template<typename T>
-Point<T> L2Divergence<T>::GradientConjugate(const Point<T>& x)
+template<typename T, size_t D>
+Point<T> L2Divergence<T, D>::GradientConjugate(const ConstPointView<T>& x)
 {
-  ++grad_con_counter;
-  return x;
+  BMST_COUNT(Stats().grad_con, 1);
+  return Point<T>(x);
 }
 
-template<typename T>
-double L2Divergence<T>::JBDivergence(const Point<T>& x, const Point<T>& y)
+template<typename T, size_t D>
+void L2Divergence<T, D>::Gradient(
+    const ConstPointView<T>& x, Point<T>& result)
+{
+  BMST_COUNT(Stats().grad, 1);
+  const size_t n_dims = Dims<D>::Of(x);
+  // x cannot alias result if the sizes differ
+  if (result.n_dims() != n_dims)
+    result.zeros(n_dims);
+  if (result.values() != x.values())
+    std::copy(x.values(), x.values() + n_dims, result.values());
+}
+
+template<typename T, size_t D>
+void L2Divergence<T, D>::GradientConjugate(
+    const ConstPointView<T>& x, Point<T>& result)
+{
+  BMST_COUNT(Stats().grad_con, 1);
+  const size_t n_dims = Dims<D>::Of(x);
+  if (result.n_dims() != n_dims)
+    result.zeros(n_dims);
+  if (result.values() != x.values())
+    std::copy(x.values(), x.values() + n_dims, result.values());
+}
+
+template<typename T, size_t D>
+double L2Divergence<T, D>::JBDivergence(
+    const ConstPointView<T>& x, const ConstPointView<T>& y)
 {
   // compute f(x) + f(x) - 2 f((x+y)/2)
   // 0.5 ||x||^2 + 0.5 ||y||^2 - ||(x + y) / 2||^2
   //  = 0.25 * || x - y ||^2 
-  ++jbdiv_counter;
-  Point<T> x_minus_y = x - y;
-  return 0.25 * Dot(x_minus_y, x_minus_y);
+  BMST_COUNT(Stats().jbdiv, 1);
+  return 0.25 * SquaredDistance_(x, y);
+}
+
+template<typename T, size_t D>
+double L2Divergence<T, D>::SquaredDistance_(
+    const SparsePointView<T>& x, const ConstPointView<T>& y)
+{
+  const size_t n_dims = Dims<D>::Of(x);
+  assert(y.n_dims() == n_dims);
+  const T* y_values = y.values();
+
+  // || x - y ||^2 = || y ||^2 + \sum_{x_i != 0} (x_i - y_i)^2 - y_i^2
+  double sq_distance = 0;
+  for (size_t i = 0; i < n_dims; i++)
+    sq_distance += (double) y_values[i] * (double) y_values[i];
+
+  const uint32_t* x_indices = x.indices();
+  const T* x_values = x.values();
+  for (size_t k = 0; k < x.n_nonzeros(); k++)
+  {
+    const double y_i = y_values[x_indices[k]];
+    const double diff = (double) x_values[k] - y_i;
+    sq_distance += diff * diff - y_i * y_i;
+  }
+  return sq_distance;
+}
+
+template<typename T, size_t D>
+double L2Divergence<T, D>::SquaredDistance_(
+    const SparsePointView<T>& x, const SparsePointView<T>& y)
+{
+  const size_t n_dims = Dims<D>::Of(x);
+  assert(y.n_dims() == n_dims);
+
+  double sq_distance = 0;
+  size_t k_x = 0;
+  size_t k_y = 0;
+  while (k_x < x.n_nonzeros() or k_y < y.n_nonzeros())
+  {
+    const size_t i_x = (k_x < x.n_nonzeros()) ? x.indices()[k_x] : n_dims;
+    const size_t i_y = (k_y < y.n_nonzeros()) ? y.indices()[k_y] : n_dims;
+    const size_t i = std::min(i_x, i_y);
+    const double x_i = (i_x == i) ? x.values()[k_x++] : 0;
+    const double y_i = (i_y == i) ? y.values()[k_y++] : 0;
+    sq_distance += (x_i - y_i) * (x_i - y_i);
+  }
+  return sq_distance;
+}
+
+template<typename T, size_t D>
+double L2Divergence<T, D>::BDivergence(
+    const SparsePointView<T>& x, const ConstPointView<T>& y)
+{
+  BMST_COUNT(Stats().bdiv, 1);
+  return 0.5 * SquaredDistance_(x, y);
+}
+
+template<typename T, size_t D>
+double L2Divergence<T, D>::BDivergence(
+    const ConstPointView<T>& x, const SparsePointView<T>& y)
+{
+  BMST_COUNT(Stats().bdiv, 1);
+  return 0.5 * SquaredDistance_(y, x);
+}
+
+template<typename T, size_t D>
+double L2Divergence<T, D>::BDivergence(
+    const SparsePointView<T>& x, const SparsePointView<T>& y)
+{
+  BMST_COUNT(Stats().bdiv, 1);
+  return 0.5 * SquaredDistance_(x, y);
+}
+
+template<typename T, size_t D>
+Point<T> L2Divergence<T, D>::Gradient(const SparsePointView<T>& x)
+{
+  Point<T> result;
+  Gradient(x, result);
+  return result;
+}
+
+template<typename T, size_t D>
+void L2Divergence<T, D>::Gradient(
+    const SparsePointView<T>& x, Point<T>& result)
+{
+  BMST_COUNT(Stats().grad, 1);
+  result.zeros(Dims<D>::Of(x));
+  const uint32_t* x_indices = x.indices();
+  const T* x_values = x.values();
+  for (size_t k = 0; k < x.n_nonzeros(); k++)
+    result[x_indices[k]] = x_values[k];
+}
+
+template<typename T, size_t D>
+double L2Divergence<T, D>::JBDivergence(
+    const SparsePointView<T>& x, const ConstPointView<T>& y)
+{
+  BMST_COUNT(Stats().jbdiv, 1);
+  return 0.25 * SquaredDistance_(x, y);
+}
+
+template<typename T, size_t D>
+double L2Divergence<T, D>::JBDivergence(
+    const ConstPointView<T>& x, const SparsePointView<T>& y)
+{
+  BMST_COUNT(Stats().jbdiv, 1);
+  return 0.25 * SquaredDistance_(y, x);
+}
+
+template<typename T, size_t D>
+double L2Divergence<T, D>::JBDivergence(
+    const SparsePointView<T>& x, const SparsePointView<T>& y)
+{
+  BMST_COUNT(Stats().jbdiv, 1);
+  return 0.25 * SquaredDistance_(x, y);
+}
+
+template<typename T, size_t D>
+double L2Divergence<T, D>::Phi(const ConstPointView<T>& x)
+{
+  // \frac{1}{2} \| x \|^2_2
+  const size_t n_dims = Dims<D>::Of(x);
+  const T* x_values = x.values();
+  double sq_norm = 0;
+  for (size_t i = 0; i < n_dims; i++)
+    sq_norm += (double) x_values[i] * (double) x_values[i];
+  return 0.5 * sq_norm;
+}
+
+template<typename T, size_t D>
+double L2Divergence<T, D>::Phi(const SparsePointView<T>& x)
+{
+  const T* x_values = x.values();
+  double sq_norm = 0;
+  for (size_t k = 0; k < x.n_nonzeros(); k++)
+    sq_norm += (double) x_values[k] * (double) x_values[k];
+  return 0.5 * sq_norm;
+}
+
+template<typename T, size_t D>
+double L2Divergence<T, D>::BDivergence(
+    const double phi_x, 
+    const ConstPointView<T>& x, 
+    const ConstPointView<T>& grad_y, 
+    const double offset_y)
+{
+  BMST_COUNT(Stats().bdiv, 1);
+  // the cancellation can leave a small negative value
+  return std::max(0.0, phi_x - Dot(x, grad_y) + offset_y);
+}
+
+template<typename T, size_t D>
+double L2Divergence<T, D>::BDivergence(
+    const double phi_x, 
+    const SparsePointView<T>& x, 
+    const ConstPointView<T>& grad_y, 
+    const double offset_y)
+{
+  BMST_COUNT(Stats().bdiv, 1);
+  return std::max(0.0, phi_x - Dot(x, grad_y) + offset_y);
+}
+
+template<typename T, size_t D>
+template<class TPoint>
+double L2Divergence<T, D>::ClosedFormNorm(
+    const TPoint& /* x */, const double phi_x)
+{
+  return sqrt(2 * std::max(0.0, phi_x));
+}
+
+template<typename T, size_t D>
+double L2Divergence<T, D>::ClosedFormDualNorm(
+    const ConstPointView<T>& grad_y)
+{
+  return sqrt(Dot(grad_y, grad_y));
+}
+
+template<typename T, size_t D>
+double L2Divergence<T, D>::ClosedFormError(
+    const size_t n_dims, const double scale_x, const double scale_y)
+{
+  // grad_y = y is exact (up to the dequantization of the quantized 
+  // points), and the sums of phi() and of the dot products are 
+  // accumulated in double (see simd_kernels.hpp)
+  const double unit = 2 * std::numeric_limits<T>::epsilon() + 
+    (n_dims + 4) * std::numeric_limits<double>::epsilon();
+  return unit * (scale_x + scale_y);
+}
+
+template<typename T, size_t D>
+template<typename Q>
+double L2Divergence<T, D>::SquaredDistance_(
+    const QuantizedPointView<T, Q>& x, const ConstPointView<T>& y)
+{
+  const size_t n_dims = Dims<D>::Of(x);
+  assert(y.n_dims() == n_dims);
+  const Q* x_codes = x.codes();
+  const T x_scale = x.scale();
+  const T* y_values = y.values();
+  double sq_distance = 0;
+  for (size_t i = 0; i < n_dims; i++)
+  {
+    const double diff = (double) (T) (x_codes[i] * x_scale) - 
+      (double) y_values[i];
+    sq_distance += diff * diff;
+  }
+  return sq_distance;
+}
+
+template<typename T, size_t D>
+template<typename Q>
+double L2Divergence<T, D>::BDivergence(
+    const QuantizedPointView<T, Q>& x, const ConstPointView<T>& y)
+{
+  BMST_COUNT(Stats().bdiv, 1);
+  return 0.5 * SquaredDistance_(x, y);
+}
+
+template<typename T, size_t D>
+template<typename Q>
+Point<T> L2Divergence<T, D>::Gradient(const QuantizedPointView<T, Q>& x)
+{
+  Point<T> result;
+  Gradient(x, result);
+  return result;
+}
+
+template<typename T, size_t D>
+template<typename Q>
+void L2Divergence<T, D>::Gradient(
+    const QuantizedPointView<T, Q>& x, Point<T>& result)
+{
+  // dequantized into result, and then in place
+  const size_t n_dims = Dims<D>::Of(x);
+  if (result.n_dims() != n_dims)
+    result.zeros(n_dims);
+  for (size_t i = 0; i < n_dims; i++)
+    result[i] = x[i];
+  Gradient(ConstPointView<T>(result), result);
+}
+
+template<typename T, size_t D>
+template<typename Q>
+double L2Divergence<T, D>::JBDivergence(
+    const QuantizedPointView<T, Q>& x, const ConstPointView<T>& y)
+{
+  BMST_COUNT(Stats().jbdiv, 1);
+  return 0.25 * SquaredDistance_(x, y);
+}
+
+template<typename T, size_t D>
+template<typename Q>
+double L2Divergence<T, D>::Phi(const QuantizedPointView<T, Q>& x)
+{
+  const size_t n_dims = Dims<D>::Of(x);
+  const Q* x_codes = x.codes();
+  const T x_scale = x.scale();
+  double sq_norm = 0;
+  for (size_t i = 0; i < n_dims; i++)
+  {
+    const double x_i = (T) (x_codes[i] * x_scale);
+    sq_norm += x_i * x_i;
+  }
+  return 0.5 * sq_norm;
+}
+
+template<typename T, size_t D>
+template<typename Q>
+double L2Divergence<T, D>::BDivergence(
+    const double phi_x, 
+    const QuantizedPointView<T, Q>& x, 
+    const ConstPointView<T>& grad_y, 
+    const double offset_y)
+{
+  BMST_COUNT(Stats().bdiv, 1);
+  return std::max(0.0, phi_x - Dot(x, grad_y) + offset_y);
+}
+
+template<typename T, size_t D>
+double BallBound<L2Divergence<T, D> >::LowerBound(
+    const double d_q_mu, const double radius)
+{
+  // the square roots and the difference are rounded toward the smaller
+  // bound, so that it holds when the two norms are close
+  const double eps = std::numeric_limits<double>::epsilon();
+  const double q_mu = std::sqrt(2 * d_q_mu) * (1 - 2 * eps);
+  const double r = std::sqrt(2 * radius) * (1 + 2 * eps);
+  if (q_mu <= r)
+    return 0;
+  const double gap = q_mu - r;
+  return 0.5 * gap * gap * (1 - 4 * eps);
+}
+
+template<typename T, size_t D>
+double BallBound<L2Divergence<T, D> >::LeftLowerBound(
+    const double d_mu_q, const double radius)
+{
+  return LowerBound(d_mu_q, radius);
+}
+
+template<typename T, size_t D>
+double BallBound<L2Divergence<T, D> >::BallLowerBound(
+    const double d_nu_mu, const double radius, const double other_radius)
+{
+  // rounded toward the smaller bound as in LowerBound
+  const double eps = std::numeric_limits<double>::epsilon();
+  const double nu_mu = std::sqrt(2 * d_nu_mu) * (1 - 2 * eps);
+  const double r = (std::sqrt(2 * radius) + std::sqrt(2 * other_radius)) * 
+    (1 + 3 * eps);
+  if (nu_mu <= r)
+    return 0;
+  const double gap = nu_mu - r;
+  return 0.5 * gap * gap * (1 - 4 * eps);
 }
 
 }
@@ -0,0 +1,64 @@
+/**
+ * @file bregman_mst/mlpack_code/ball_bound.hpp
+ *
+ * The lower bound on the divergences d(x, q) from the points x of a
+ * Bregman ball {x : d(x, mu) <= R} to a query q outside of it, in closed
+ * form for the divergences which have one. BregmanBall::CanPruneRight
+ * uses it instead of searching for the projection of q on the ball by
+ * bisection, which costs a gradient, a conjugate gradient and two
+ * divergences per step.
+ *
+ * The primary template has no closed form. A divergence provides its own
+ * by specializing BallBound with kClosedForm = true (see L2Divergence.hpp).
+ * The same goes for the left balls {x : d(mu, x) <= R} of
+ * BregmanBall::CanPruneLeft, with kLeftClosedForm, and for the bound 
+ * between a right ball and a left ball of the dual-tree pruning, with
+ * kBallClosedForm.
+ */
+
+#ifndef BMST_BALL_BOUND_HPP_
+#define BMST_BALL_BOUND_HPP_
+
+namespace bmst {
+
+template <class TBDiv>
+struct BallBound
+{
+  static const bool kClosedForm = false;
+
+  // A lower bound on min_{d(x, mu) <= radius} d(x, q), for d(q, mu) =
+  // d_q_mu > radius. It must hold in spite of its own rounding; the
+  // caller takes d_q_mu and radius at the ends of their error ranges.
+  static inline double LowerBound(
+      const double /* d_q_mu */, const double /* radius */)
+  {
+    return 0;
+  }
+
+  static const bool kLeftClosedForm = false;
+
+  // A lower bound on min_{d(mu, x) <= radius} d(q, x), for d(mu, q) = 
+  // d_mu_q > radius, under the same conditions as LowerBound
+  static inline double LeftLowerBound(
+      const double /* d_mu_q */, const double /* radius */)
+  {
+    return 0;
+  }
+
+  static const bool kBallClosedForm = false;
+
+  // A lower bound on d(x, q) for d(x, mu) <= radius and d(nu, q) <= 
+  // other_radius, with d(nu, mu) = d_nu_mu, under the same conditions as
+  // LowerBound
+  static inline double BallLowerBound(
+      const double /* d_nu_mu */, 
+      const double /* radius */, 
+      const double /* other_radius */)
+  {
+    return 0;
+  }
+};
+
+} // namespace
+
+#endif
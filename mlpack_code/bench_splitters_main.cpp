@@ -0,0 +1,222 @@
+/**
+ * @file bmst/mlpack_code/bench_splitters_main.cpp
+ *
+ * Compares the splitters of the tree construction (KMeansSplitter,
+ * SampledKMeansSplitter, RandomProjectionSplitter and PCASplitter): the
+ * time and the divergence evaluations of the construction, and the
+ * divergence evaluations of the left nearest neighbor searches on the
+ * trees, relative to the brute force ones (D / naive, which counts the
+ * divergences to the bisection points of the KL balls as well, and so
+ * can exceed 1 where the tree does not prune).
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/program_options.hpp>
+
+#include "data.hpp"
+#include "table_io.hpp"
+#include "util.hpp"
+
+#include "L2Divergence.hpp"
+#include "KLDivergence.hpp"
+#include "bregman_ball.hpp"
+#include "bregman_ball_tree.hpp"
+#include "kmeans_splitter.hpp"
+#include "left_nn_search.hpp"
+#include "projection_splitter.hpp"
+#include "sampled_kmeans_splitter.hpp"
+
+using namespace std;
+
+// Builds the tree with the splitter, searches the queries on it and
+// prints a row of the comparison
+template <typename T, class TDivergence, class TSplitter>
+void BenchSplitter(
+    const string& name,
+    const bmst::Table<T>& rset,
+    const bmst::Table<T>& qset,
+    const size_t leaf_size,
+    const std::vector<size_t>& naive_neighbors);
+
+template <typename T, class TDivergence>
+void BenchSplitters(
+    const bmst::Table<T>& rset,
+    const bmst::Table<T>& qset,
+    const size_t leaf_size)
+{
+  // the brute force neighbors, to check the searches
+  std::vector<size_t> naive_neighbors;
+  {
+    typedef bmst::BregmanBall<T, TDivergence> TBBall;
+    bmst::LeftNNSearch<T, TDivergence, TBBall> searcher(rset, rset.n_points());
+    searcher.ComputeNeighborsNaive(qset, naive_neighbors);
+  }
+
+  cout << setw(10) << "splitter" << setw(12) << "build (s)" <<
+    setw(14) << "build D" << setw(14) << "build G" <<
+    setw(12) << "search (s)" << setw(14) << "D / query" <<
+    setw(12) << "D / naive" << setw(8) << "errors" << endl;
+  BenchSplitter<T, TDivergence, bmst::KMeansSplitter<T, TDivergence> >(
+      "kmeans", rset, qset, leaf_size, naive_neighbors);
+  BenchSplitter<T, TDivergence,
+    bmst::SampledKMeansSplitter<T, TDivergence> >(
+      "sampled", rset, qset, leaf_size, naive_neighbors);
+  BenchSplitter<T, TDivergence,
+    bmst::RandomProjectionSplitter<T, TDivergence> >(
+      "random", rset, qset, leaf_size, naive_neighbors);
+  BenchSplitter<T, TDivergence, bmst::PCASplitter<T, TDivergence> >(
+      "pca", rset, qset, leaf_size, naive_neighbors);
+}
+
+int main(int argc, char* argv[])
+{
+  namespace bpo = boost::program_options;
+
+  // input command line options
+  bpo::options_description opt_desc(
+    "Options for comparing the splitters of the tree construction");
+  opt_desc.add_options()
+    ("help", "Produce help message")
+    ("rfile", bpo::value<string>(),
+     "The file containing the set of points (required). Text files and "
+     "binary tables (see convert_table_main) are both accepted")
+    ("qfile", bpo::value<string>(),
+     "A file containing a separate set of queries (optional)")
+    ("divergence", bpo::value<string>(),
+     "The divergence to be used for the search (optional). Options are: \n"
+     " L2 (default)\n"
+     " KL\n")
+    ("leaf_size", bpo::value<string>(),
+     "The maximum number of points in any leaf of the tree "
+     "(optional, 'leaf_size' defaults to 10)")
+    ("split_ratio", bpo::value<string>(), "The ratio with which the dataset "
+     "is split into query and reference sets (optional, defaults to 0.1 "
+     "if the query set is not provided)");
+
+  // read command line arguments
+  bpo::variables_map vm;
+  bpo::store(bpo::parse_command_line(argc, argv, opt_desc), vm);
+  bpo::notify(vm);
+
+  if (vm.count("help"))
+  {
+    cout << opt_desc << endl;
+    exit(0);
+  }
+
+  if (vm.count("rfile") == 0)
+  {
+    cout << "[ERROR] The --rfile option is required for specifying the set "
+      "of points to index"  << endl;
+    exit(1);
+  }
+
+  string rfile = vm["rfile"].as<string>();
+  string qfile = vm.count("qfile") ? vm["qfile"].as<string>() : "";
+  string chosen_divergence =
+    vm.count("divergence") ? vm["divergence"].as<string>() : "L2";
+  double query_ref_split_ratio = vm.count("split_ratio") ?
+    atof(vm["split_ratio"].as<string>().c_str()) : 0.1;
+  size_t leaf_size = vm.count("leaf_size") ?
+    atoi(vm["leaf_size"].as<string>().c_str()) : 10;
+
+  if (chosen_divergence != "L2" and chosen_divergence != "KL")
+  {
+    cout << "[ERROR] " << chosen_divergence <<
+      "-divergence is currently not supported" << endl;
+    exit(1);
+  }
+
+  cout << "Reading in '" << rfile << "'" << endl;
+  bmst::Table<float> data = bmst::LoadTable<float>(rfile);
+  std::unique_ptr<bmst::Table<float> > qset;
+  std::unique_ptr<bmst::Table<float> > rset;
+  if (qfile != "")
+  {
+    cout << "Reading in '" << qfile << "'" << endl;
+    qset.reset(new bmst::Table<float>(bmst::LoadTable<float>(qfile)));
+    rset.reset(new bmst::Table<float>(data));
+  }
+  else if (query_ref_split_ratio > 0 and query_ref_split_ratio < 1.0)
+  {
+    cout << "[INFO] Splitting the dataset randomly in the ratio " <<
+      query_ref_split_ratio << " : " << 1.0 - query_ref_split_ratio << endl;
+    bmst::util::SplitSet(data, query_ref_split_ratio, qset, rset);
+  }
+  else
+  {
+    cout << "[ERROR] The --split_ratio should be in the range (0, 1)" << endl;
+    exit(1);
+  }
+
+  cout << "Indexing " << rset->n_points() << " points and searching " <<
+    qset->n_points() << " queries with respect to the " <<
+    chosen_divergence << "-divergence, with leaves of at most " <<
+    leaf_size << " points" << endl;
+  if (chosen_divergence == "KL")
+    BenchSplitters<float, bmst::KLDivergence<float> >(
+        *rset, *qset, leaf_size);
+  else
+    BenchSplitters<float, bmst::L2Divergence<float> >(
+        *rset, *qset, leaf_size);
+
+  return 0;
+} // main
+
+template <typename T, class TDivergence, class TSplitter>
+void BenchSplitter(
+    const string& name,
+    const bmst::Table<T>& rset,
+    const bmst::Table<T>& qset,
+    const size_t leaf_size,
+    const std::vector<size_t>& naive_neighbors)
+{
+  typedef bmst::BregmanBall<T, TDivergence> TBBall;
+  typedef bmst::BregmanBallTree<T, TDivergence, TBBall, TSplitter> TTree;
+  typedef bmst::LeftNNSearch<T, TDivergence, TBBall, bmst::Table<T>, TTree>
+    TSearcher;
+  // the counts of this thread (bench_splitters_main is built with
+  // BMST_STATS)
+  bmst::DivergenceStats& stats = TDivergence::Stats();
+
+  stats.Reset();
+  const auto build_start = std::chrono::steady_clock::now();
+  TSearcher searcher(rset, leaf_size);
+  const double build_time = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - build_start).count();
+  const bmst::DivergenceStats build_stats = stats;
+
+  stats.Reset();
+  size_t errors = 0;
+  const auto search_start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < qset.n_points(); i++)
+  {
+    const size_t neighbor = searcher.ComputeNeighbor(qset[i]);
+    if (neighbor == naive_neighbors[i])
+      continue;
+    // another neighbor at the same divergence is not an error
+    if (neighbor == -1 or naive_neighbors[i] == -1 or
+        TDivergence::BDivergence(rset[naive_neighbors[i]], qset[i]) <
+        TDivergence::BDivergence(rset[neighbor], qset[i]))
+      ++errors;
+  }
+  const double search_time = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - search_start).count();
+
+  const double divs_per_query =
+    (double) stats.bdiv / std::max(qset.n_points(), (size_t) 1);
+  cout << setw(10) << name << setw(12) << build_time <<
+    setw(14) << build_stats.bdiv << setw(14) << build_stats.grad <<
+    setw(12) << search_time << setw(14) << divs_per_query <<
+    setw(12) << divs_per_query / rset.n_points() <<
+    setw(8) << errors << endl;
+}
@@ -0,0 +1,78 @@
+/**
+ * @file bregman_mst/mlpack_code/bound_cache.hpp
+ *
+ * A cache of lower bounds on the divergences from the points of the
+ * nodes of a tree to the points of a data set, keyed by (point, node).
+ * The bounds which do not depend on the search (see
+ * BregmanBall::RightLowerBound) can be computed once and then checked
+ * against every later candidate with a single comparison, e.g. by the
+ * rounds of Boruvka's algorithm on a static tree (see
+ * minimum_spanning_tree.hpp). The cache holds at most a given number of
+ * bytes: beyond it, the least recently used bound is evicted.
+ */
+
+#ifndef BMST_BOUND_CACHE_HPP_
+#define BMST_BOUND_CACHE_HPP_
+
+#include <stddef.h>
+
+#include <list>
+#include <unordered_map>
+#include <utility>
+
+namespace bmst {
+
+class BoundCache
+{
+private:
+  typedef std::pair<size_t, const void*> Key_;
+
+  struct KeyHash_
+  {
+    size_t operator()(const Key_& key) const;
+  };
+
+  // most recently used first
+  typedef std::list<std::pair<Key_, double> > Entries_;
+  Entries_ entries_;
+  std::unordered_map<Key_, Entries_::iterator, KeyHash_> index_;
+
+  size_t max_entries_;
+
+  size_t hits_;
+  size_t misses_;
+
+public:
+  // About the number of bytes taken by every bound in the cache: a node
+  // of the list, a node of the hash table (key, iterator, link and 
+  // hash) and a bucket
+  static const size_t kEntryBytes = 
+    sizeof(Entries_::value_type) + 2 * sizeof(void*) +
+    sizeof(Key_) + 3 * sizeof(void*) + sizeof(void*);
+
+  // The cache holds about max_bytes bytes (at least one bound)
+  BoundCache(const size_t max_bytes);
+
+  // The bound of (point, node) if it is in the cache, which makes it the
+  // most recently used one
+  bool Find(const size_t point, const void* node, double& bound);
+
+  // Add or replace the bound of (point, node), evicting the least
+  // recently used one if the cache is full
+  void Insert(const size_t point, const void* node, const double bound);
+
+  void Clear();
+
+  size_t size() const { return index_.size(); }
+  size_t max_entries() const { return max_entries_; }
+  // the calls to Find which found a bound or not
+  size_t hits() const { return hits_; }
+  size_t misses() const { return misses_; }
+
+}; // class
+
+}; // namespace
+
+#include "bound_cache_impl.hpp"
+
+#endif
@@ -0,0 +1,79 @@
+/**
+ * @file bregman_mst/mlpack_code/bound_cache_impl.hpp
+ *
+ * Implementation of the functions defined in bound_cache.hpp
+ */
+
+#ifndef BMST_BOUND_CACHE_IMPL_HPP_
+#define BMST_BOUND_CACHE_IMPL_HPP_
+
+#include <algorithm>
+#include <functional>
+
+#include "bound_cache.hpp"
+
+namespace bmst {
+
+inline size_t BoundCache::KeyHash_::operator()(const Key_& key) const
+{
+  // boost::hash_combine
+  size_t seed = std::hash<size_t>()(key.first);
+  seed ^= std::hash<const void*>()(key.second) + 0x9e3779b9 + 
+    (seed << 6) + (seed >> 2);
+  return seed;
+}
+
+inline BoundCache::BoundCache(const size_t max_bytes) :
+  max_entries_(std::max((size_t) 1, max_bytes / kEntryBytes)),
+  hits_(0),
+  misses_(0)
+{}
+
+inline bool BoundCache::Find(
+    const size_t point, const void* node, double& bound)
+{
+  const auto found = index_.find(Key_(point, node));
+  if (found == index_.end())
+  {
+    ++misses_;
+    return false;
+  }
+  ++hits_;
+  // move the entry to the front
+  entries_.splice(entries_.begin(), entries_, found->second);
+  bound = found->second->second;
+  return true;
+}
+
+inline void BoundCache::Insert(
+    const size_t point, const void* node, const double bound)
+{
+  const Key_ key(point, node);
+  const auto found = index_.find(key);
+  if (found != index_.end())
+  {
+    found->second->second = bound;
+    entries_.splice(entries_.begin(), entries_, found->second);
+    return;
+  }
+  if (index_.size() >= max_entries_)
+  {
+    // evict the least recently used bound
+    index_.erase(entries_.back().first);
+    entries_.pop_back();
+  }
+  entries_.push_front(std::make_pair(key, bound));
+  index_[key] = entries_.begin();
+}
+
+inline void BoundCache::Clear()
+{
+  entries_.clear();
+  index_.clear();
+  hits_ = 0;
+  misses_ = 0;
+}
+
+}; // namespace
+
+#endif
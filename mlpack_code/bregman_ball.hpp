@@ -9,11 +9,33 @@
 #ifndef BMST_BREGMAN_BALL_HPP_
 #define BMST_BREGMAN_BALL_HPP_
 
+#include "ball_bound.hpp"
 #include "data.hpp"
+#include "divergence_stats.hpp"
 
 namespace bmst {
 
+// The defaults of BregmanBall::SetBisection
+const size_t kMaxBisectionIterations = 64;
+const double kBisectionTolerance = 1e-3;
+
+// The default number of alternating projections of 
+// BregmanBall::RightLowerBound between two balls
+const size_t kMaxBallAlternations = 16;
+
+// The settings of BregmanBall::SetBisection, shared by all the balls of
+// the divergence whatever holds their centroids
 template <typename T, class TBregmanDiv>
+struct BisectionSettings
+{
+  static size_t max_iterations;
+  static double tolerance;
+};
+
+// TPoint holds the centroids and their gradients: Point<T> for a ball 
+// of its own, or ConstPointView<T> for a view of centroids stored 
+// elsewhere (see FlatBregmanBallTree)
+template <typename T, class TBregmanDiv, class TPoint = Point<T> >
 class BregmanBall 
 {
 protected:
@@ -21,81 +43,230 @@ protected:
 
   // the right centroid is the point such that 
   // Div(x, right_centroid_) \leq right_radius_ for all x in the ball
-  Point<T> right_centroid_;
+  TPoint right_centroid_;
 
   // the left centroid is the point such that
   // Div(left_centroid_, x) \leq left_radius_ for all x in the ball
-  Point<T> left_centroid_;
+  TPoint left_centroid_;
 
   // the gradients of the centroids
-  Point<T> right_centroid_prime_;
-  Point<T> left_centroid_prime_;
+  TPoint right_centroid_prime_;
+  TPoint left_centroid_prime_;
   
   // max_x BDiv(x, right_centroid_)
   double right_radius_;
-  // max_x BDiv(left_centroid_, x)
+  // max_x BDiv(left_centroid_, x), infinite if the ball was built 
+  // without a left centroid
   double left_radius_;
   
   size_t component_;
 
-  // helper for pruning in single tree traversal
-  bool CanPruneRight(
-      const double theta_l, 
-      const double theta_r, 
-      const Point<T>& q, 
-      const Point<T>& q_prime,
+  // the points x_theta' and x_theta of the bisection in CanPruneRight
+  // (and x_theta in CanPruneLeft), one pair per thread, so that the 
+  // pruning only allocates them the first time a thread meets queries of
+  // this dimensionality
+  struct Scratch_
+  {
+    Point<T> x_theta_prime;
+    Point<T> x_theta;
+  };
+  static inline Scratch_& ThreadScratch_();
+
+  // the points of the bound between two balls, likewise
+  struct BallScratch_
+  {
+    Point<T> q;
+    Point<T> q_prime;
+    Point<T> x;
+    Point<T> x_prime;
+    Point<T> y;
+    Point<T> y_prime;
+    Point<T> g;
+    Point<T> x_lambda;
+  };
+  static inline BallScratch_& ThreadBallScratch_();
+
+  // helper for pruning in single tree traversal: the bisection of theta
+  // toward the projection of q on the ball (see SetBisection). It 
+  // returns the largest lower bound L_theta it met, and stops as soon as
+  // the pruning is decided for q_div_to_best_candidate (which can be
+  // infinity to get the best bound).
+  // On the left ball, the bisection is the one of the right ball of the
+  // conjugate divergence, for which d(q, x) = d*(grad x, grad q): its 
+  // x_theta is (1 - theta) q + theta mu, and q_prime is not used.
+  template <bool kLeft>
+  double ProjectionLowerBound_(
+      const ConstPointView<T>& q,
+      const ConstPointView<T>& q_prime,
       const double q_div_to_best_candidate) const;
     
-  bool CanPruneRight(
-      const double theta_l,
-      const double theta_r,
-      const BregmanBall<T, TBregmanDiv>& other, 
-      const double q_div_to_best_candidate, 
-      const double q_div_centroids) const;
+  // The point x_theta at which the bisection of ProjectionLowerBound_
+  // reaches the surface of the ball, written in x_theta (and its 
+  // gradient in x_theta_prime for the right ball); returns theta
+  template <bool kLeft>
+  double SurfacePoint_(
+      const ConstPointView<T>& q,
+      const ConstPointView<T>& q_prime,
+      Point<T>& x_theta,
+      Point<T>& x_theta_prime) const;
+
+  // The lower bound between this ball and the left ball of other at the 
+  // point x of this one, where y = (1 - rho) x + rho nu is the 
+  // projection of x on the other ball (see RightLowerBound)
+  double BallCertificate_(
+      const BregmanBall<T, TBregmanDiv, TPoint>& other, 
+      const double rho, 
+      BallScratch_& scratch) const;
+
+  // The alternating projections of RightLowerBound, which stop as soon as
+  // the bound passes q_div_to_best_candidate
+  double BallLowerBound_(
+      const BregmanBall<T, TBregmanDiv, TPoint>& other, 
+      const double q_div_centroids, 
+      const size_t max_alternations,
+      const double q_div_to_best_candidate) const;
 
 public:
   BregmanBall();
-  BregmanBall(const Point<T>& right_center, const double right_radius);
   BregmanBall(
-      const Point<T>& right_center, 
+      const ConstPointView<T>& right_center, const double right_radius);
+  BregmanBall(
+      const ConstPointView<T>& right_center,
       const double right_radius, 
-      const Point<T>& left_center, 
+      const ConstPointView<T>& left_center,
       const double left_radius);
+  // The ball of centroids whose gradients are already known (which the
+  // views keep without computing anything)
+  BregmanBall(
+      const ConstPointView<T>& right_center,
+      const ConstPointView<T>& right_center_prime,
+      const double right_radius, 
+      const ConstPointView<T>& left_center,
+      const ConstPointView<T>& left_center_prime,
+      const double left_radius,
+      const size_t component);
   
   ~BregmanBall();
 
+  // Without a closed form bound (see ball_bound.hpp), the single query
+  // pruning bisects toward the projection of the query on the ball. It
+  // stops without pruning after max_iterations steps, or once x_theta is
+  // within a relative tolerance of the surface of the ball
+  // (|d(x_theta, mu) - R| <= tolerance R), so every check costs at most
+  // max_iterations conjugate gradients. The settings are shared by all
+  // the balls of the divergence and must not change during a search.
+  static void SetBisection(const size_t max_iterations, const double tolerance);
+  static size_t max_bisection_iterations() 
+  { 
+    return BisectionSettings<T, TBregmanDiv>::max_iterations; 
+  }
+  static double bisection_tolerance() 
+  { 
+    return BisectionSettings<T, TBregmanDiv>::tolerance; 
+  }
+
   // Add extra stats from the data if wanted
   // In plain BregmanBall, nothing is done here
-  void AddExtraStats(const Table<T>& data, const size_t start, const size_t end) {}
-  
+  template <class TTable>
+  void AddExtraStats(const TTable& data, const size_t start, const size_t end) {}
+
+  // The extra stats as doubles, to save and load the ball (see
+  // tree_io.hpp); BregmanBall has none
+  static const size_t kNumExtraStats = 0;
+  void GetExtraStats(double* stats) const {}
+  void SetExtraStats(const double* stats) {}
+
   // Pruning rule for a single query
   bool CanPruneRight(
-      const Point<T>& q,
-      const Point<T>& q_prime,
+      const ConstPointView<T>& q,
+      const ConstPointView<T>& q_prime,
       const double q_div_to_best_candidate) const;
   
   // We'll precompute this divergence to prioritize the tree search, 
   // so this function allows us not to compute
   // the distance to the centroid again
   bool CanPruneRight(
-      const Point<T>& q,
-      const Point<T>& q_prime,
+      const ConstPointView<T>& q,
+      const ConstPointView<T>& q_prime,
       const double q_div_to_best_candidate, 
       const double q_div_to_centroid) const;
 
-  // pruning rule for two nodes, with the query on the left
+  // A lower bound on the divergences d(x, q) from the points x of the 
+  // ball to q, which does not depend on any candidate (so it can be kept
+  // from one search to the next): the closed form of BallBound, or the 
+  // largest bound of the bisection run up to the surface of the ball. It
+  // is 0 if q is in the ball.
+  double RightLowerBound(
+      const ConstPointView<T>& q,
+      const ConstPointView<T>& q_prime,
+      const double q_div_to_centroid) const;
+
+  // Pruning rule for a single query on the right, for the right nearest
+  // neighbor argmin_x d(q, x), with the left ball {x : d(mu, x) <= R}.
+  // The bisection needs no gradient.
+  bool CanPruneLeft(
+      const ConstPointView<T>& q,
+      const double q_div_to_best_candidate) const;
+
+  // The same with d(mu, q) precomputed
+  bool CanPruneLeft(
+      const ConstPointView<T>& q,
+      const double q_div_to_best_candidate,
+      const double centroid_div_to_q) const;
+
+  // A lower bound on the divergences d(x, q) from the points x of this
+  // (right) ball to the points q of the left ball of other, for the 
+  // dual-tree searches, with q_div_centroids = d(nu, mu) between the 
+  // left centroid nu of other and the right centroid mu of this ball. 
+  // It needs a jointly convex divergence (it is 0 otherwise).
+  // With the closed form of BallBound if there is one. Otherwise, every
+  // pair of a point x and y = (1 - rho) x + rho nu gives a bound from
+  // Lagrangian duality. The first pair is where the closest points would
+  // be for L2, from q_div_centroids and the radii, which costs O(d) (and
+  // is the bound with max_alternations = 0); then the point x of this 
+  // ball and y of the other one are projected on each other in turn (up
+  // to max_alternations times, by bisection). For a pair, 
+  // G(x') = d(x', y') + rho / (1 - rho) (d(nu, y') - R_nu), with 
+  // y' = (1 - rho) x' + rho nu, is a lower bound on the divergences from
+  // x' to the other ball and is convex in x', so that for 
+  // g = grad G(x) = grad phi(x) - grad phi(y), any lambda > 0 and 
+  // grad phi(x_lambda) = grad phi(mu) - g / lambda,
+  //   d(x', q) >= G(x) + <g, x_lambda - x> + lambda (d(x_lambda, mu) - R)
+  // for all x' in this ball. The bound holds for every pair, and is 
+  // exact at the closest pair of points of the two balls.
+  double RightLowerBound(
+      const BregmanBall<T, TBregmanDiv, TPoint>& other, 
+      const double q_div_centroids,
+      const size_t max_alternations = kMaxBallAlternations) const;
+
+  // Pruning rule for two nodes, with the queries in other: 
+  // RightLowerBound against the largest candidate divergence of the 
+  // queries, with the O(d) bound first and then a single alternation if
+  // it does not prune
   bool CanPruneRight(
-      const BregmanBall<T, TBregmanDiv>& other, 
+      const BregmanBall<T, TBregmanDiv, TPoint>& other, 
       const double q_div_to_best_candidate, 
       const double q_div_centroids) const;
 
-  const Point<T>& left_centroid() const { return left_centroid_; }
+  // The same for the divergences d(q, x) from the points q of the right
+  // ball of other to the points x of the left ball of this one, with 
+  // centroids_div = d(nu, mu) between the left centroid nu of this ball 
+  // and the right centroid mu of other
+  bool CanPruneLeft(
+      const BregmanBall<T, TBregmanDiv, TPoint>& other, 
+      const double q_div_to_best_candidate, 
+      const double centroids_div) const
+  {
+    return other.CanPruneRight(*this, q_div_to_best_candidate, centroids_div);
+  }
+
+  const TPoint& left_centroid() const { return left_centroid_; }
   
-  const Point<T>& left_centroid_prime() const { return left_centroid_prime_; }
+  const TPoint& left_centroid_prime() const { return left_centroid_prime_; }
 
-  const Point<T>& right_centroid() const { return right_centroid_; }
+  const TPoint& right_centroid() const { return right_centroid_; }
   
-  const Point<T>& right_centroid_prime() const { return right_centroid_prime_; }
+  const TPoint& right_centroid_prime() const { return right_centroid_prime_; }
   
   const double right_radius() const { return right_radius_; }
 
@@ -9,54 +9,101 @@
 #ifndef BMST_BREGMAN_BALL_IMPL_HPP_
 #define BMST_BREGMAN_BALL_IMPL_HPP_
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
 #include "bregman_ball.hpp"
 
 namespace bmst {
 
-template <typename T, class TBregmanDiv>
-BregmanBall<T, TBregmanDiv>::BregmanBall() :
-  right_centroid_(Point<T>()),
-  right_centroid_prime_(Point<T>()),
-  left_centroid_(Point<T>()),
-  left_centroid_prime_(Point<T>()),
+template <typename T, class TBregmanDiv, class TPoint>
+BregmanBall<T, TBregmanDiv, TPoint>::BregmanBall() :
+  right_centroid_(),
+  right_centroid_prime_(),
+  left_centroid_(),
+  left_centroid_prime_(),
   right_radius_(0),
   left_radius_(0),
   component_(-1)
 {}
 
-template <typename T, class TBregmanDiv>
-BregmanBall<T, TBregmanDiv>::BregmanBall(
-    const Point<T>& right_center, const double right_radius) :
+template <typename T, class TBregmanDiv, class TPoint>
+BregmanBall<T, TBregmanDiv, TPoint>::BregmanBall(
+    const ConstPointView<T>& right_center, const double right_radius) :
   right_centroid_(right_center),
-  right_radius_(right_radius)
+  right_radius_(right_radius),
+  left_radius_(std::numeric_limits<double>::infinity()),
+  component_(-1)
 {
-  right_centroid_prime_  = TBregmanDiv::Gradient(right_center);
+  TBregmanDiv::Gradient(right_center, right_centroid_prime_);
 }
 
-template <typename T, class TBregmanDiv>
-BregmanBall<T, TBregmanDiv>::BregmanBall(
-    const Point<T>& right_center, 
+template <typename T, class TBregmanDiv, class TPoint>
+BregmanBall<T, TBregmanDiv, TPoint>::BregmanBall(
+    const ConstPointView<T>& right_center,
     const double right_radius, 
-    const Point<T>& left_center, 
+    const ConstPointView<T>& left_center,
     const double left_radius) :
   right_centroid_(right_center),
   left_centroid_(left_center),
   right_radius_(right_radius),
-  left_radius_(left_radius)
+  left_radius_(left_radius),
+  component_(-1)
 {
-  right_centroid_prime_  = TBregmanDiv::Gradient(right_center);
-  left_centroid_prime_  = TBregmanDiv::Gradient(left_center);
+  TBregmanDiv::Gradient(right_center, right_centroid_prime_);
+  TBregmanDiv::Gradient(left_center, left_centroid_prime_);
 }
 
+template <typename T, class TBregmanDiv, class TPoint>
+BregmanBall<T, TBregmanDiv, TPoint>::BregmanBall(
+    const ConstPointView<T>& right_center,
+    const ConstPointView<T>& right_center_prime,
+    const double right_radius, 
+    const ConstPointView<T>& left_center,
+    const ConstPointView<T>& left_center_prime,
+    const double left_radius,
+    const size_t component) :
+  right_centroid_(right_center),
+  left_centroid_(left_center),
+  right_centroid_prime_(right_center_prime),
+  left_centroid_prime_(left_center_prime),
+  right_radius_(right_radius),
+  left_radius_(left_radius),
+  component_(component)
+{}
 
-template <typename T, class TBregmanDiv>
-BregmanBall<T, TBregmanDiv>::~BregmanBall()
+template <typename T, class TBregmanDiv, class TPoint>
+BregmanBall<T, TBregmanDiv, TPoint>::~BregmanBall()
 {}
 
-template<typename T, class TBregmanDiv>
-bool BregmanBall<T, TBregmanDiv>::CanPruneRight(
-    const Point<T>& q, 
-    const Point<T>& q_prime,
+template <typename T, class TBregmanDiv>
+size_t BisectionSettings<T, TBregmanDiv>::max_iterations = 
+  kMaxBisectionIterations;
+
+template <typename T, class TBregmanDiv>
+double BisectionSettings<T, TBregmanDiv>::tolerance = kBisectionTolerance;
+
+template <typename T, class TBregmanDiv, class TPoint>
+void BregmanBall<T, TBregmanDiv, TPoint>::SetBisection(
+    const size_t max_iterations, const double tolerance)
+{
+  BisectionSettings<T, TBregmanDiv>::max_iterations = max_iterations;
+  BisectionSettings<T, TBregmanDiv>::tolerance = tolerance;
+}
+
+template <typename T, class TBregmanDiv, class TPoint>
+typename BregmanBall<T, TBregmanDiv, TPoint>::Scratch_& 
+BregmanBall<T, TBregmanDiv, TPoint>::ThreadScratch_()
+{
+  static thread_local Scratch_ scratch;
+  return scratch;
+}
+
+template<typename T, class TBregmanDiv, class TPoint>
+bool BregmanBall<T, TBregmanDiv, TPoint>::CanPruneRight(
+    const ConstPointView<T>& q,
+    const ConstPointView<T>& q_prime,
     const double q_div_to_best_candidate) const
 {
   assert(q.n_dims() == q_prime.n_dims());
@@ -65,10 +112,10 @@ bool BregmanBall<T, TBregmanDiv>::CanPruneRight(
   return CanPruneRight(q, q_prime, q_div_to_best_candidate, d_q_mu);
 }
 
-template<typename T, class TBregmanDiv>
-bool BregmanBall<T, TBregmanDiv>::CanPruneRight(
-    const Point<T>& q,
-    const Point<T>& q_prime,
+template<typename T, class TBregmanDiv, class TPoint>
+bool BregmanBall<T, TBregmanDiv, TPoint>::CanPruneRight(
+    const ConstPointView<T>& q,
+    const ConstPointView<T>& q_prime,
     const double q_div_to_best_candidate, 
     const double q_div_to_centroid) const
 {
@@ -84,109 +131,413 @@ bool BregmanBall<T, TBregmanDiv>::CanPruneRight(
     return false;
   }  
 
-  // initialize at the extreme values of theta
-  return CanPruneRight(0.0, 1.0, q, q_prime, q_div_to_best_candidate);
+  if (BallBound<TBregmanDiv>::kClosedForm)
+  {
+    // the bound is taken on the smallest value the exact d(q, mu) can
+    // have (see BDivergenceError)
+    const double d_q_mu = q_div_to_centroid - TBregmanDiv::BDivergenceError(
+        q, right_centroid_, q_div_to_centroid);
+    return BallBound<TBregmanDiv>::LowerBound(d_q_mu, right_radius_) > 
+      q_div_to_best_candidate;
+  }
+
+  return ProjectionLowerBound_<false>(q, q_prime, q_div_to_best_candidate) > 
+    q_div_to_best_candidate;
 }
 
-template<typename T, class TBregmanDiv>
-bool BregmanBall<T, TBregmanDiv>::CanPruneRight(
-    const double theta_l,
-    const double theta_r,
-    const Point<T>& q,
-    const Point<T>& q_prime,
-    const double q_div_to_best_candidate) const 
+template<typename T, class TBregmanDiv, class TPoint>
+bool BregmanBall<T, TBregmanDiv, TPoint>::CanPruneLeft(
+    const ConstPointView<T>& q,
+    const double q_div_to_best_candidate) const
 {
-  if (1.0 - theta_l < std::numeric_limits<T>::epsilon()) 
-  {
-    // x_theta = mu, but still appears to be outside the ball
-    // Possible reasons:
-    // * ball radius very small (which we already check for)
-    // * d(x_theta, mu) = \infty, which means mu has zero
-    //   This is possible when:
-    //   ** mu is just a single point with zero (compute d(mu, x) and return),
-    //      so effectively no prune
-    //   ** all points have same zero (since right_radius_ != \infty), 
-    //      so cannot really prune since we dont know the actual d(p, q)
-    // NOTE: The above explanation is only valid of KL-divergence
-    // but we still cannot prune so that is that
+  // no left ball to prune with
+  if (left_radius_ == std::numeric_limits<double>::infinity())
     return false;
-  }
-  if (theta_r < std::numeric_limits<T>::epsilon()) 
+  const double d_mu_q = TBregmanDiv::BDivergence(left_centroid_, q);
+  return CanPruneLeft(q, q_div_to_best_candidate, d_mu_q);
+}
+
+template<typename T, class TBregmanDiv, class TPoint>
+bool BregmanBall<T, TBregmanDiv, TPoint>::CanPruneLeft(
+    const ConstPointView<T>& q,
+    const double q_div_to_best_candidate, 
+    const double centroid_div_to_q) const
+{
+  // the same shortcuts as CanPruneRight
+  if (left_radius_ < std::numeric_limits<T>::epsilon()
+      or centroid_div_to_q <= left_radius_ 
+      or centroid_div_to_q < q_div_to_best_candidate)
   {
-    // x_theta = q, and we are still in the ball
-    // * q is almost in the ball, so do not prune
     return false;
-  }
+  }  
 
-  double theta = 0.5 * (theta_l + theta_r);
- 
-  //std::cout << "Searching, theta = " << theta << "\n";
-  
-  //std::cout << "q: ";
-  //q.print();
-  
-  Point<T> x_theta_prime = theta * right_centroid_prime_ + (1.0 - theta) * q_prime;
-  Point<T> x_theta = TBregmanDiv::GradientConjugate(x_theta_prime);
-
-  //std::cout << "x_theta: ";
-  //x_theta.print(); 
-
-  double d_x_theta_mu = TBregmanDiv::BDivergence(x_theta, right_centroid_);
-  double d_x_theta_q = TBregmanDiv::BDivergence(x_theta, q);
-  
-  double L_theta 
-      = d_x_theta_q + theta / (1.0 - theta) * (d_x_theta_mu - right_radius_);
-  
-  //std::cout << "d_x_theta_mu: " << d_x_theta_mu << ", d_x_theta_q: " << d_x_theta_q << ", L_theta: " << L_theta << "\n";
-  //std::cout<< "radius: " << right_radius_ << ", q_div_to_best_candidate: " << q_div_to_best_candidate << "\n\n";
-      
-  if (L_theta > q_div_to_best_candidate)
+  if (BallBound<TBregmanDiv>::kLeftClosedForm)
   {
-    return true;
+    const double d_mu_q = centroid_div_to_q - TBregmanDiv::BDivergenceError(
+        left_centroid_, q, centroid_div_to_q);
+    return BallBound<TBregmanDiv>::LeftLowerBound(d_mu_q, left_radius_) > 
+      q_div_to_best_candidate;
   }
-  else if (d_x_theta_mu <= right_radius_ && d_x_theta_q < q_div_to_best_candidate)
+
+  return ProjectionLowerBound_<true>(q, q, q_div_to_best_candidate) > 
+    q_div_to_best_candidate;
+}
+
+template<typename T, class TBregmanDiv, class TPoint>
+double BregmanBall<T, TBregmanDiv, TPoint>::RightLowerBound(
+    const ConstPointView<T>& q,
+    const ConstPointView<T>& q_prime,
+    const double q_div_to_centroid) const
+{
+  if (q_div_to_centroid <= right_radius_)
+    return 0;
+
+  if (BallBound<TBregmanDiv>::kClosedForm)
   {
-    return false;
+    const double d_q_mu = q_div_to_centroid - TBregmanDiv::BDivergenceError(
+        q, right_centroid_, q_div_to_centroid);
+    return BallBound<TBregmanDiv>::LowerBound(d_q_mu, right_radius_);
   }
-  else if (d_x_theta_mu > right_radius_)
-  {
-    // we're outside the ball
-    // if (d_x_theta_q < q_div_to_best_candidate) // worth moving inward
-    return CanPruneRight(theta, theta_r, q, q_prime, q_div_to_best_candidate);
-    // else
 
-  }
-  else 
+  return ProjectionLowerBound_<false>(
+      q, q_prime, std::numeric_limits<double>::infinity());
+}
+
+template<typename T, class TBregmanDiv, class TPoint>
+template <bool kLeft>
+double BregmanBall<T, TBregmanDiv, TPoint>::ProjectionLowerBound_(
+    const ConstPointView<T>& q,
+    const ConstPointView<T>& q_prime,
+    const double q_div_to_best_candidate) const 
+{
+  BMST_COUNT(TBregmanDiv::Stats().bisections, 1);
+  // without a candidate, the bisection only stops at the surface of the
+  // ball or out of iterations
+  const bool has_candidate = 
+    q_div_to_best_candidate < std::numeric_limits<double>::infinity();
+  // every L_theta is a lower bound, the largest one is returned
+  double lower_bound = 0;
+  // x_theta' and x_theta are overwritten at every step
+  Scratch_& scratch = ThreadScratch_();
+  Point<T>& x_theta_prime = scratch.x_theta_prime;
+  Point<T>& x_theta = scratch.x_theta;
+  const double radius = kLeft ? left_radius_ : right_radius_;
+
+  double theta_l = 0.0;
+  double theta_r = 1.0;
+  for (size_t iteration = 0; iteration < max_bisection_iterations(); 
+      iteration++)
   {
-    // we're inside the ball, move outward
-    return CanPruneRight(theta_l, theta, q, q_prime, q_div_to_best_candidate);
+    if (1.0 - theta_l < std::numeric_limits<T>::epsilon()) 
+    {
+      // x_theta = mu, but still appears to be outside the ball
+      // Possible reasons:
+      // * ball radius very small (which we already check for)
+      // * d(x_theta, mu) = \infty, which means mu has zero
+      //   This is possible when:
+      //   ** mu is just a single point with zero (compute d(mu, x) and 
+      //      return), so effectively no prune
+      //   ** all points have same zero (since the radius != \infty), 
+      //      so cannot really prune since we dont know the actual d(p, q)
+      // NOTE: The above explanation is only valid of KL-divergence
+      // but we still cannot prune so that is that
+      return lower_bound;
+    }
+    if (theta_r < std::numeric_limits<T>::epsilon()) 
+    {
+      // x_theta = q, and we are still in the ball
+      // * q is almost in the ball, so do not prune
+      return lower_bound;
+    }
+
+    const double theta = 0.5 * (theta_l + theta_r);
+    if (theta <= theta_l or theta >= theta_r)
+    {
+      // the interval cannot be split anymore: x_theta is on the surface 
+      // of the ball, where the padded L_theta may stay just below
+      // q_div_to_best_candidate, so do not prune
+      return lower_bound;
+    }
+
+    BMST_COUNT(TBregmanDiv::Stats().bisection_steps, 1);
+    // d_x_theta_mu and d_x_theta_q are the divergences between x_theta
+    // and mu and q, taken in the order of the ball
+    double d_x_theta_mu;
+    double d_x_theta_q;
+    double e_x_theta_mu;
+    double e_x_theta_q;
+    if (kLeft)
+    {
+      Axpby<T>(1.0 - theta, q, theta, left_centroid_, x_theta);
+      d_x_theta_mu = TBregmanDiv::BDivergence(left_centroid_, x_theta);
+      d_x_theta_q = TBregmanDiv::BDivergence(q, x_theta);
+      // the lower bound is taken on the smallest values the exact 
+      // divergences can have (see BDivergenceError)
+      e_x_theta_mu = TBregmanDiv::BDivergenceError(
+          left_centroid_, x_theta, d_x_theta_mu);
+      e_x_theta_q = TBregmanDiv::BDivergenceError(q, x_theta, d_x_theta_q);
+    }
+    else
+    {
+      Axpby<T>(1.0 - theta, q_prime, theta, right_centroid_prime_, 
+          x_theta_prime);
+      TBregmanDiv::GradientConjugate(x_theta_prime, x_theta);
+      d_x_theta_mu = TBregmanDiv::BDivergence(x_theta, right_centroid_);
+      d_x_theta_q = TBregmanDiv::BDivergence(x_theta, q);
+      e_x_theta_mu = TBregmanDiv::BDivergenceError(
+          x_theta, right_centroid_, d_x_theta_mu);
+      e_x_theta_q = TBregmanDiv::BDivergenceError(x_theta, q, d_x_theta_q);
+    }
+    const double L_theta = (d_x_theta_q - e_x_theta_q) + 
+      theta / (1.0 - theta) * (d_x_theta_mu - e_x_theta_mu - radius);
+      
+    lower_bound = std::max(lower_bound, L_theta);
+    if (L_theta > q_div_to_best_candidate)
+      return lower_bound;
+    if (has_candidate and d_x_theta_mu <= radius 
+        and d_x_theta_q < q_div_to_best_candidate)
+      return lower_bound;
+    if (fabs(d_x_theta_mu - radius) <= 
+        bisection_tolerance() * radius)
+    {
+      // x_theta is close enough to the projection of q on the ball, 
+      // where L_theta is d(x_theta, q): the bound cannot get much larger
+      return lower_bound;
+    }
+
+    if (d_x_theta_mu > radius)
+    {
+      // we're outside the ball, move inward
+      theta_l = theta;
+    }
+    else 
+    {
+      // we're inside the ball, move outward
+      theta_r = theta;
+    }
   }
+
+  // out of iterations
+  return lower_bound;
 }
 
-template<typename T, class TBregmanDiv>
-bool BregmanBall<T, TBregmanDiv>::CanPruneRight(
-    const BregmanBall<T, TBregmanDiv>& other, 
+template<typename T, class TBregmanDiv, class TPoint>
+double BregmanBall<T, TBregmanDiv, TPoint>::RightLowerBound(
+    const BregmanBall<T, TBregmanDiv, TPoint>& other, 
+    const double q_div_centroids,
+    const size_t max_alternations) const
+{
+  return BallLowerBound_(other, q_div_centroids, max_alternations, 
+      std::numeric_limits<double>::infinity());
+}
+
+template<typename T, class TBregmanDiv, class TPoint>
+bool BregmanBall<T, TBregmanDiv, TPoint>::CanPruneRight(
+    const BregmanBall<T, TBregmanDiv, TPoint>& other, 
     const double q_div_to_best_candidate, 
     const double q_div_centroids) const
 {
-  // if the balls intersect, can't prune
-  if (q_div_centroids - right_radius_ - other.radius() < 0)
+  return BallLowerBound_(other, q_div_centroids, 1, q_div_to_best_candidate)
+    > q_div_to_best_candidate;
+}
+
+template <typename T, class TBregmanDiv, class TPoint>
+typename BregmanBall<T, TBregmanDiv, TPoint>::BallScratch_& 
+BregmanBall<T, TBregmanDiv, TPoint>::ThreadBallScratch_()
+{
+  static thread_local BallScratch_ scratch;
+  return scratch;
+}
+
+template<typename T, class TBregmanDiv, class TPoint>
+template <bool kLeft>
+double BregmanBall<T, TBregmanDiv, TPoint>::SurfacePoint_(
+    const ConstPointView<T>& q,
+    const ConstPointView<T>& q_prime,
+    Point<T>& x_theta,
+    Point<T>& x_theta_prime) const
+{
+  const double radius = kLeft ? left_radius_ : right_radius_;
+  double theta_l = 0.0;
+  double theta_r = 1.0;
+  double theta = 0.0;
+  // at least one step, so that x_theta is set
+  for (size_t iteration = 0; 
+      iteration == 0 or iteration < max_bisection_iterations(); iteration++)
   {
-    return false;    
+    theta = 0.5 * (theta_l + theta_r);
+    if (iteration > 0 and (theta <= theta_l or theta >= theta_r))
+      break;
+
+    BMST_COUNT(TBregmanDiv::Stats().bisection_steps, 1);
+    double d_x_theta_mu;
+    if (kLeft)
+    {
+      Axpby<T>(1.0 - theta, q, theta, left_centroid_, x_theta);
+      d_x_theta_mu = TBregmanDiv::BDivergence(left_centroid_, x_theta);
+    }
+    else
+    {
+      Axpby<T>(1.0 - theta, q_prime, theta, right_centroid_prime_, 
+          x_theta_prime);
+      TBregmanDiv::GradientConjugate(x_theta_prime, x_theta);
+      d_x_theta_mu = TBregmanDiv::BDivergence(x_theta, right_centroid_);
+    }
+    if (fabs(d_x_theta_mu - radius) <= bisection_tolerance() * radius)
+      break;
+    if (d_x_theta_mu > radius)
+      theta_l = theta;
+    else
+      theta_r = theta;
   }
-  
-  return CanPruneRight(0, 1.0, other, q_div_to_best_candidate, q_div_centroids);
+  return theta;
 }
 
-template<typename T, class TBregmanDiv>
-bool BregmanBall<T, TBregmanDiv>::CanPruneRight(
-    const double theta_l,
-    const double theta_r,
-    const BregmanBall<T, TBregmanDiv>& other, 
-    const double q_div_to_best_candidate, 
-    const double q_div_centroids) const
+template<typename T, class TBregmanDiv, class TPoint>
+double BregmanBall<T, TBregmanDiv, TPoint>::BallCertificate_(
+    const BregmanBall<T, TBregmanDiv, TPoint>& other, 
+    const double rho, 
+    BallScratch_& scratch) const
+{
+  if (not (rho < 1.0))
+    return 0;
+  const TPoint& nu = other.left_centroid_;
+  const Point<T>& x = scratch.x;
+  const Point<T>& y = scratch.y;
+
+  // G(x), on the smallest values the exact divergences can have
+  const double d_x_y = TBregmanDiv::BDivergence(x, y);
+  const double d_nu_y = TBregmanDiv::BDivergence(nu, y);
+  const double g_at_x = 
+    (d_x_y - TBregmanDiv::BDivergenceError(x, y, d_x_y)) + 
+    rho / (1.0 - rho) * (d_nu_y - TBregmanDiv::BDivergenceError(nu, y, d_nu_y)
+        - other.left_radius_);
+
+  // g = grad phi(x) - grad phi(y), and lambda from the optimality 
+  // condition g = lambda (grad phi(mu) - grad phi(x)) of the closest pair 
+  // (any lambda > 0 gives a bound)
+  TBregmanDiv::Gradient(y, scratch.y_prime);
+  Axpby<T>(1.0, scratch.x_prime, -1.0, scratch.y_prime, scratch.g);
+  const size_t n_dims = x.n_dims();
+  const T* g = scratch.g.values();
+  const T* x_prime = scratch.x_prime.values();
+  const T* mu_prime = right_centroid_prime_.values();
+  double g_dot_direction = 0;
+  double direction_norm = 0;
+  for (size_t i = 0; i < n_dims; i++)
+  {
+    const double direction_i = (double) mu_prime[i] - x_prime[i];
+    g_dot_direction += g[i] * direction_i;
+    direction_norm += direction_i * direction_i;
+  }
+  const double lambda = g_dot_direction / direction_norm;
+  if (not (lambda > 0) or not std::isfinite(lambda))
+    return 0;
+
+  // x_lambda minimizes <g, x'> + lambda d(x', mu)
+  Axpby<T>(1.0, right_centroid_prime_, -1.0 / lambda, scratch.g, 
+      scratch.x_lambda);
+  TBregmanDiv::GradientConjugate(scratch.x_lambda, scratch.x_lambda);
+  const double d_x_lambda_mu = 
+    TBregmanDiv::BDivergence(scratch.x_lambda, right_centroid_);
+
+  // <g, x_lambda - x>, less a bound on its rounding and on the one of g
+  const T* x_lambda = scratch.x_lambda.values();
+  const T* x_values = x.values();
+  double linear = 0;
+  double magnitude = 0;
+  for (size_t i = 0; i < n_dims; i++)
+  {
+    linear += g[i] * ((double) x_lambda[i] - x_values[i]);
+    magnitude += fabs(g[i]) * (fabs(x_lambda[i]) + fabs(x_values[i]));
+  }
+  linear -= (n_dims + 2) * std::numeric_limits<T>::epsilon() * magnitude;
+
+  const double bound = g_at_x + linear + lambda * (d_x_lambda_mu - 
+      TBregmanDiv::BDivergenceError(
+        scratch.x_lambda, right_centroid_, d_x_lambda_mu) - right_radius_);
+  // the gradients at the zeros of KL are not finite
+  if (not std::isfinite(bound))
+    return 0;
+  return std::max(bound, 0.0);
+}
+
+template<typename T, class TBregmanDiv, class TPoint>
+double BregmanBall<T, TBregmanDiv, TPoint>::BallLowerBound_(
+    const BregmanBall<T, TBregmanDiv, TPoint>& other, 
+    const double q_div_centroids, 
+    const size_t max_alternations,
+    const double q_div_to_best_candidate) const
 {
-  return false;
+  if (not TBregmanDiv::IsJointlyConvex() or 
+      other.left_radius_ == std::numeric_limits<double>::infinity())
+    return 0;
+  // the left centroid of other is in this ball, or the right centroid of
+  // this ball is in the other one
+  if (q_div_centroids <= right_radius_ or 
+      q_div_centroids <= other.left_radius_)
+    return 0;
+
+  if (BallBound<TBregmanDiv>::kBallClosedForm)
+  {
+    const double d_nu_mu = q_div_centroids - TBregmanDiv::BDivergenceError(
+        other.left_centroid_, right_centroid_, q_div_centroids);
+    return BallBound<TBregmanDiv>::BallLowerBound(
+        d_nu_mu, right_radius_, other.left_radius_);
+  }
+
+  BallScratch_& scratch = ThreadBallScratch_();
+  // first the bound at the pair where the projections would be for L2, 
+  // which takes no bisection: x on the dual segment from nu to mu, and y
+  // on the segment from x to nu
+  double lower_bound = 0;
+  const double theta = 1.0 - sqrt(right_radius_ / q_div_centroids);
+  Axpby<T>(1.0 - theta, other.left_centroid_prime_, theta, 
+      right_centroid_prime_, scratch.x_prime);
+  TBregmanDiv::GradientConjugate(scratch.x_prime, scratch.x);
+  const double d_nu_x = 
+    TBregmanDiv::BDivergence(other.left_centroid_, scratch.x);
+  if (d_nu_x > other.left_radius_ and std::isfinite(d_nu_x))
+  {
+    const double rho = 1.0 - sqrt(other.left_radius_ / d_nu_x);
+    Axpby<T>(1.0 - rho, scratch.x, rho, other.left_centroid_, scratch.y);
+    lower_bound = BallCertificate_(other, rho, scratch);
+  }
+  if (max_alternations == 0 or lower_bound > q_div_to_best_candidate)
+    return lower_bound;
+
+  BMST_COUNT(TBregmanDiv::Stats().bisections, 1);
+  // q starts at the left centroid of other
+  scratch.q = other.left_centroid_;
+  scratch.q_prime = other.left_centroid_prime_;
+  for (size_t alternation = 0; alternation < max_alternations; 
+      alternation++)
+  {
+    // x is the projection of q on this ball, and y the one of x on the
+    // other ball, unless the balls meet
+    if (alternation > 0 and 
+        TBregmanDiv::BDivergence(scratch.q, right_centroid_) <= right_radius_)
+      break;
+    SurfacePoint_<false>(scratch.q, scratch.q_prime, scratch.x, 
+        scratch.x_prime);
+    if (TBregmanDiv::BDivergence(other.left_centroid_, scratch.x) <= 
+        other.left_radius_)
+      break;
+    const double rho = other.template SurfacePoint_<true>(
+        scratch.x, scratch.x, scratch.y, scratch.y_prime);
+
+    const double bound = BallCertificate_(other, rho, scratch);
+    // the pairs have converged
+    const bool converged = 
+      (bound > 0 and bound <= lower_bound * (1 + bisection_tolerance()));
+    lower_bound = std::max(lower_bound, bound);
+    if (converged or lower_bound > q_div_to_best_candidate)
+      break;
+
+    scratch.q = scratch.y;
+    TBregmanDiv::Gradient(scratch.q, scratch.q_prime);
+  }
+  return lower_bound;
 }
 
 } // namespace
@@ -15,12 +15,43 @@
 
 #include <memory>
 #include <queue>
+#include <string>
 #include <vector>
 
 #include "data.hpp"
+#include "parallel.hpp"
+#include "table_io.hpp"
+#include "table_stream.hpp"
+#include "tree_io.hpp"
 
 namespace bmst {
 
+// The settings of the construction of a BregmanBallTree in memory
+struct TreeBuildOptions
+{
+  // The threads of the construction (1: the calling thread only)
+  size_t n_threads;
+  // The nodes of at least this many points are split one at a time by 
+  // all the threads (the data-parallel passes of the splitter, see 
+  // KMeansSplitter::SetThreads). The subtrees of the smaller ones are 
+  // independent tasks, which idle threads steal from the busy ones.
+  size_t min_data_parallel_points;
+  // The seed of the splits: the splitter of every node is seeded from it
+  // and the range of the node (see TSplitter::SetSeed), so that a seed 
+  // gives the same tree for any number of threads. 0 draws a seed from
+  // std::random_device.
+  unsigned seed;
+
+  TreeBuildOptions(
+      const size_t n_threads_in = 1,
+      const size_t min_data_parallel_points_in = 1 << 16,
+      const unsigned seed_in = 0) :
+    n_threads(n_threads_in),
+    min_data_parallel_points(min_data_parallel_points_in),
+    seed(seed_in)
+  {}
+};
+
 template <typename T, class TBDiv, class TBBall, class TSplitter>
 class BregmanBallTree
 {
@@ -46,42 +77,128 @@ private:
       const TBBall& bounding_ball);
 
   // Initializer
+  template <class TTable>
   BregmanBallTree(
-      const Table<T>& table,
+      const TTable& table,
       const size_t begin,
       const size_t count);
 
   // Helper functions
+  // Splits the nodes from the root down, the large ones first and then 
+  // the subtrees below them in parallel (see TreeBuildOptions)
+  template <class TTable>
   void BuildTree(
-      Table<T>& table,
+      TTable& table,
       const size_t leaf_size,
       const double min_ball_width,
-      std::queue<TBBTree*>& node_queue,
+      const TreeBuildOptions& options,
       std::vector<size_t>& old_from_new);
 
-  double ComputeNodeRadius(
-      const Table<T>& data,
+  // Splits the node with the splitter seeded with seed and run on 
+  // n_threads threads, and adds the children which have to be split 
+  // further to children_to_split. Nodes with disjoint ranges can be 
+  // split at the same time.
+  template <class TTable>
+  void SplitNode(
+      TTable& table,
+      const size_t leaf_size,
+      const double min_ball_width,
+      const unsigned seed,
+      const size_t n_threads,
+      std::vector<size_t>& old_from_new,
+      std::vector<TBBTree*>& children_to_split);
+
+  // The seed of the splitter of the node (never 0)
+  unsigned NodeSeed(const unsigned seed) const;
+
+  template <class TTable>
+  static double ComputeNodeRadius(
+      const TTable& data,
+      const size_t node_begin,
+      const size_t node_end,
+      const ConstPointView<T>& node_center);
+
+  // The left centroid of the points, grad phi*(mean_x grad phi(x)) 
+  // (the minimizer of the sum of the divergences from it to the points),
+  // and the left radius max_x d(left_center, x)
+  template <class TTable>
+  static void ComputeNodeLeftBall(
+      const TTable& data,
       const size_t node_begin,
       const size_t node_end,
-      const Point<T>& node_center);
+      Point<T>& left_center,
+      double& left_radius);
 
-  size_t MatrixSwap(
-      Table<T>& table,
+  template <class TTable>
+  static size_t MatrixSwap(
+      TTable& table,
       const size_t node_begin,
       const size_t node_end,
       std::vector<size_t>& membership,
       std::vector<size_t>& old_from_new);
 
+  // Out-of-core helper: builds the tree over the points of the stream
+  // and appends the points to the writer in their final order. The 
+  // original index of the i-th point of the stream is 
+  // (*original_indices)[i] (or just i if original_indices is NULL). 
+  // The nodes whose bounds still have to be computed from the final 
+  // data are added to unbounded_nodes.
+  static TBBTree* BuildOutOfCore(
+      TableStream<T>& stream,
+      const std::vector<size_t>* original_indices,
+      BinaryTableWriter<T>& writer,
+      std::vector<size_t>& old_from_new,
+      const size_t max_points_in_memory,
+      const size_t leaf_size,
+      const std::string& temp_dir,
+      std::vector<TBBTree*>& unbounded_nodes);
+
+  // Shift the indices of all the nodes in the subtree
+  void ShiftIndices(const size_t offset);
+
+  // The ball of the node-th node of the index
+  static TBBall IndexBall(const TreeIndex<T>& index, const size_t node);
+
 public:
-  // Initializer
+  // The type of the nodes of the traversals (the trees are their own 
+  // nodes, see FlatBregmanBallTree for another layout)
+  typedef TBBTree TNode;
+
+  // Initializer, for a Table<T> or a SparseTable<T>
+  template <class TTable>
   BregmanBallTree(
-      Table<T>& data, 
+      TTable& data, 
       std::vector<size_t>& old_from_new,
       const size_t leaf_size = 10, 
-      const double min_ball_width = 0);
+      const double min_ball_width = 0,
+      const TreeBuildOptions& options = TreeBuildOptions());
+
+  // Out-of-core initializer for data sets that do not fit in memory.
+  // The top of the tree is split on a sample of the stream, the points
+  // are spilled into one temporary file (in temp_dir) per top-level 
+  // partition, and the subtree of every partition is then built in 
+  // memory, one partition at a time, using roughly at most 
+  // memory_budget bytes. The reordered points are written to 
+  // output_file as a binary table (see table_io.hpp), which can be 
+  // memory-mapped to search the tree.
+  BregmanBallTree(
+      TableStream<T>& stream,
+      const std::string& output_file,
+      std::vector<size_t>& old_from_new,
+      const size_t memory_budget,
+      const size_t leaf_size = 10,
+      const std::string& temp_dir = "/tmp");
+
+  // Loads the subtree of the node-th node of a tree index (the root by
+  // default, see tree_io.hpp). The points are index.Data() and the 
+  // permutation index.OldFromNew(); the balls are copied, with their 
+  // extra stats.
+  BregmanBallTree(const TreeIndex<T>& index, const size_t node = 0);
     
   ~BregmanBallTree();
   // Tree info accessors
+  TBBTree* Root() { return this; }
+  const TBBTree* Root() const { return this; }
   bool IsLeaf() const { if (left_) return false; else return true; };
   TBBTree* Left() const { return left_.get(); }
   TBBTree* Right() const { return right_.get(); }
@@ -96,29 +213,50 @@ public:
   const double LRadius() const { return bounding_ball_.left_radius(); }
   const TBBall& Bound() const { return bounding_ball_; }
   TBBall& Bound() { return bounding_ball_; }
+  // the component of the points of the node in MinimumSpanningTree
+  const size_t Component() const { return bounding_ball_.Component(); }
+  void SetComponent(const size_t comp) { bounding_ball_.SetComponent(comp); }
+
+  // The accessors of a node of the tree, which the traversals go 
+  // through (FlatBregmanBallTree keeps the children and centroids of its
+  // nodes in the tree rather than in the nodes)
+  TBBTree* Left(const TBBTree* node) const { return node->Left(); }
+  TBBTree* Right(const TBBTree* node) const { return node->Right(); }
+  const Point<T>& RCenter(const TBBTree* node) const 
+  { 
+    return node->RCenter(); 
+  }
+  const Point<T>& LCenter(const TBBTree* node) const 
+  { 
+    return node->LCenter(); 
+  }
+  const TBBall& Bound(const TBBTree* node) const { return node->Bound(); }
 
   // Pruning functions
   // point-ball right-prune
   bool CanPruneRight(
-      const Point<T>& q, 
+      const ConstPointView<T>& q,
       const double q_div_to_best_candidate,
       const double div_to_center = std::numeric_limits<double>::max());
 
-  // TO-DO: if needed, implement point-ball left-prune
-  // API might change
+  // point-ball left-prune, for the right nearest neighbors of q
   bool CanPruneLeft(
-      const Point<T>& q, 
+      const ConstPointView<T>& q,
       const double q_div_to_best_candidate,
       const double div_to_center = std::numeric_limits<double>::max());
 
-  // TO-DO: ball-ball right prune
+  // ball-ball right-prune: the divergences d(x, q) from the points x of
+  // this node to the points q of other_node (see 
+  // BregmanBall::CanPruneRight), with node_div_to_center = 
+  // d(other_node.LCenter(), RCenter()) if it is known
   bool CanPruneRight(
       const TBBTree& other_node,
       const double node_max_div_to_best_candidate,
       const double node_div_to_center = std::numeric_limits<double>::max());
 
-  // TO-DO: if needed, ball-ball left prune
-  // API might change
+  // ball-ball left-prune: the divergences d(q, x) from the points q of 
+  // other_node to the points x of this node, with center_div_to_node = 
+  // d(LCenter(), other_node.RCenter()) if it is known
   bool CanPruneLeft(
       const TBBTree& other_node,
       const double node_max_div_to_best_candidate,
@@ -13,10 +13,20 @@
 #ifndef BMST_BREGMAN_BALL_TREE_IMPL_HPP_
 #define BMST_BREGMAN_BALL_TREE_IMPL_HPP_
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <functional>
+#include <random>
+
 #include "bregman_ball_tree.hpp"
 
 namespace bmst {
 
+// seed for the sample the out-of-core construction splits the top on
+const unsigned kOutOfCoreSampleSeed = 1234;
+
 template <typename T, class TBDiv, class TBBall, class TSplitter>
 BregmanBallTree<T, TBDiv, TBBall, TSplitter>::BregmanBallTree(
     const size_t begin,
@@ -29,8 +39,9 @@ BregmanBallTree<T, TBDiv, TBBall, TSplitter>::BregmanBallTree(
 {}
 
 template <typename T, class TBDiv, class TBBall, class TSplitter>
+template <class TTable>
 BregmanBallTree<T, TBDiv, TBBall, TSplitter>::BregmanBallTree(
-    const Table<T>& table,
+    const TTable& table,
     const size_t begin,
     const size_t count) : 
   begin_(begin),
@@ -45,119 +56,255 @@ BregmanBallTree<T, TBDiv, TBBall, TSplitter>::BregmanBallTree(
 
   center /= (T) count_;
   double radius = ComputeNodeRadius(table, begin_, end_, center);
-  TBBall node_bball(center, radius);
+  Point<T> left_center;
+  double left_radius;
+  ComputeNodeLeftBall(table, begin_, end_, left_center, left_radius);
+  TBBall node_bball(center, radius, left_center, left_radius);
   bounding_ball_ = node_bball;
 }
 
 template <typename T, class TBDiv, class TBBall, class TSplitter>
+BregmanBallTree<T, TBDiv, TBBall, TSplitter>::BregmanBallTree(
+    const TreeIndex<T>& index,
+    const size_t node) :
+  begin_(index.Node(node).begin),
+  count_(index.Node(node).count),
+  end_(index.Node(node).begin + index.Node(node).count),
+  bounding_ball_(IndexBall(index, node))
+{
+  if (index.Node(node).right != 0)
+  {
+    left_.reset(new TBBTree(index, node + 1));
+    right_.reset(new TBBTree(index, index.Node(node).right));
+  }
+}
+
+template <typename T, class TBDiv, class TBBall, class TSplitter>
+TBBall BregmanBallTree<T, TBDiv, TBBall, TSplitter>::IndexBall(
+    const TreeIndex<T>& index, 
+    const size_t node)
+{
+  if (index.n_extra_stats() != TBBall::kNumExtraStats)
+  {
+    std::cout << "[ERROR] The tree index has " << index.n_extra_stats() <<
+      " extra stats per node instead of the " << TBBall::kNumExtraStats <<
+      " of the balls." << std::endl;
+    exit(1);
+  }
+  const TreeFileNode& file_node = index.Node(node);
+  TBBall ball(
+      index.RightCentroids()[node],
+      index.RightCentroidPrimes()[node],
+      file_node.right_radius,
+      index.LeftCentroids()[node],
+      index.LeftCentroidPrimes()[node],
+      file_node.left_radius,
+      -1);
+  ball.SetExtraStats(index.ExtraStats(node));
+  return ball;
+}
+
+template <typename T, class TBDiv, class TBBall, class TSplitter>
+template <class TTable>
 void BregmanBallTree<T, TBDiv, TBBall, TSplitter>::BuildTree(
-    Table<T>& data,
+    TTable& data,
     const size_t leaf_size, 
     const double min_ball_width, 
-    std::queue<BregmanBallTree<T, TBDiv, TBBall, TSplitter>*>& node_queue,
+    const TreeBuildOptions& options,
     std::vector<size_t>& old_from_new)
 {
   typedef BregmanBallTree<T, TBDiv, TBBall, TSplitter> TNode;
+  unsigned seed = options.seed;
+  while (seed == 0)
+    seed = std::random_device()();
+
+  // the nodes too large to be tasks, split by all the threads
+  std::vector<TNode*> tasks;
+  std::vector<TNode*> children_to_split;
+  std::queue<TNode*> node_queue;
+  node_queue.push(this);
   while (not node_queue.empty()) 
   {
     TNode* current_node = node_queue.front();
     node_queue.pop();
+    if (options.n_threads > 1 and 
+        current_node->count_ < options.min_data_parallel_points)
+    {
+      tasks.push_back(current_node);
+      continue;
+    }
 
     // std::cout << "Current node count: " << current_node->count_ << 
     //   ", begin @ " << current_node->begin_ << ", end @ " << 
     //   current_node->end_ << std::endl;
+    children_to_split.clear();
+    current_node->SplitNode(data, leaf_size, min_ball_width, seed, 
+        options.n_threads, old_from_new, children_to_split);
+    for (size_t i = 0; i < children_to_split.size(); i++)
+      node_queue.push(children_to_split[i]);
+  } // node queue loop
 
-    // Try to partition the set:
-    // NOTE: Currently, to save one pass over the data, we will always
-    // attempt to split the root (and use the left and right stats to 
-    // compute the root center)
-    std::vector<size_t> membership;
-    std::vector<Point<T> > centers;
-    std::vector<double> radii;
-    TSplitter data_splitter;
-    data_splitter.PartitionData(
-        data, 
-        current_node->begin_,
-        current_node->end_, 
-        membership,
-        centers,
-        radii);
-
-    assert(centers.size() == radii.size());
-    assert(centers.size() == 2);
-    size_t left_count = MatrixSwap(
-        data, 
-        current_node->begin_, 
-        current_node->end_, 
-        membership, 
-        old_from_new);
-
-    // do something special for the root node
-    if (current_node->count_ == data.n_points()) 
+  if (tasks.empty())
+    return;
+
+  // the subtrees below, one task per node to split
+  WorkStealingPool pool(options.n_threads);
+  std::function<void (TNode*)> build_subtree = [&](TNode* node)
+  {
+    std::vector<TNode*> children;
+    node->SplitNode(
+        data, leaf_size, min_ball_width, seed, 1, old_from_new, children);
+    for (size_t i = 0; i < children.size(); i++)
     {
-      Point<T> root_center 
-        = ((double) left_count * centers[0] 
-           + (double) (current_node->count_ - left_count) * centers[1]) 
-        / (double) current_node->count_;
-      double root_radius = 
-        ComputeNodeRadius(data, 0, data.n_points(), root_center);
-      // initialize the root bounding ball
-      TBBall root_bball(root_center, root_radius);
-      root_bball.AddExtraStats(data, 0, data.n_points());
-      current_node->bounding_ball_ = root_bball;
+      TNode* child = children[i];
+      pool.Spawn([&build_subtree, child]() { build_subtree(child); });
     }
-    if (left_count > 0 and left_count < current_node->Count()) 
+  };
+  for (size_t i = 0; i < tasks.size(); i++)
+  {
+    TNode* node = tasks[i];
+    pool.Spawn([&build_subtree, node]() { build_subtree(node); });
+  }
+  pool.Wait();
+} // BuildTree
+
+template <typename T, class TBDiv, class TBBall, class TSplitter>
+unsigned BregmanBallTree<T, TBDiv, TBBall, TSplitter>::NodeSeed(
+    const unsigned seed) const
+{
+  // boost::hash_combine of the seed and the range of the node
+  size_t node_seed = std::hash<unsigned>()(seed);
+  node_seed ^= std::hash<size_t>()(begin_) + 0x9e3779b9 + 
+    (node_seed << 6) + (node_seed >> 2);
+  node_seed ^= std::hash<size_t>()(count_) + 0x9e3779b9 + 
+    (node_seed << 6) + (node_seed >> 2);
+  const unsigned folded = (unsigned) (node_seed ^ (node_seed >> 32));
+  return (folded == 0) ? 1 : folded;
+}
+
+template <typename T, class TBDiv, class TBBall, class TSplitter>
+template <class TTable>
+void BregmanBallTree<T, TBDiv, TBBall, TSplitter>::SplitNode(
+    TTable& data,
+    const size_t leaf_size, 
+    const double min_ball_width, 
+    const unsigned seed,
+    const size_t n_threads,
+    std::vector<size_t>& old_from_new,
+    std::vector<BregmanBallTree<T, TBDiv, TBBall, TSplitter>*>& 
+      children_to_split)
+{
+  typedef BregmanBallTree<T, TBDiv, TBBall, TSplitter> TNode;
+  TNode* current_node = this;
+
+  // Try to partition the set:
+  // NOTE: Currently, to save one pass over the data, we will always
+  // attempt to split the root (and use the left and right stats to 
+  // compute the root center)
+  std::vector<size_t> membership;
+  std::vector<Point<T> > centers;
+  std::vector<double> radii;
+  TSplitter data_splitter;
+  data_splitter.SetSeed(NodeSeed(seed));
+  data_splitter.SetThreads(n_threads);
+  data_splitter.PartitionData(
+      data, 
+      current_node->begin_,
+      current_node->end_, 
+      membership,
+      centers,
+      radii);
+
+  assert(centers.size() == radii.size());
+  assert(centers.size() == 2);
+  size_t left_count = MatrixSwap(
+      data, 
+      current_node->begin_, 
+      current_node->end_, 
+      membership, 
+      old_from_new);
+
+  // do something special for the root node
+  Point<T> left_center;
+  double left_radius;
+  if (current_node->count_ == data.n_points()) 
+  {
+    Point<T> root_center;
+    Axpby<T>(
+        (double) left_count / (double) current_node->count_, 
+        centers[0], 
+        (double) (current_node->count_ - left_count) / 
+        (double) current_node->count_, 
+        centers[1], 
+        root_center);
+    double root_radius = 
+      ComputeNodeRadius(data, 0, data.n_points(), root_center);
+    ComputeNodeLeftBall(
+        data, 0, data.n_points(), left_center, left_radius);
+    // initialize the root bounding ball
+    TBBall root_bball(root_center, root_radius, left_center, left_radius);
+    root_bball.AddExtraStats(data, 0, data.n_points());
+    current_node->bounding_ball_ = root_bball;
+  }
+  if (left_count > 0 and left_count < current_node->Count()) 
+  {
+    // did find a viable split
+    ComputeNodeLeftBall(data, current_node->Begin(), 
+        current_node->Begin() + left_count, left_center, left_radius);
+    TBBall left_bball(centers[0], radii[0], left_center, left_radius);
+    left_bball.AddExtraStats(
+        data, current_node->Begin(), current_node->Begin() + left_count);
+    current_node->left_.reset(
+        new TNode(current_node->Begin(), left_count, left_bball));
+    ComputeNodeLeftBall(data, current_node->Begin() + left_count, 
+        current_node->End(), left_center, left_radius);
+    TBBall right_bball(centers[1], radii[1], left_center, left_radius);
+    right_bball.AddExtraStats(
+        data, current_node->Begin() + left_count, current_node->End());
+    current_node->right_.reset(new TNode(
+        current_node->begin_ + left_count, 
+        current_node->count_ - left_count, 
+        right_bball));
+
+    // the children nodes for further tree construction
+    if (leaf_size > 0) 
     {
-      // did find a viable split
-      TBBall left_bball(centers[0], radii[0]);
-      left_bball.AddExtraStats(
-          data, current_node->Begin(), current_node->Begin() + left_count);
-      current_node->left_.reset(
-          new TNode(current_node->Begin(), left_count, left_bball));
-      TBBall right_bball(centers[1], radii[1]);
-      right_bball.AddExtraStats(
-          data, current_node->Begin() + left_count, current_node->End());
-      current_node->right_.reset(new TNode(
-          current_node->begin_ + left_count, 
-          current_node->count_ - left_count, 
-          right_bball));
-
-      // queueing up the children nodes for further tree construction
-      if (leaf_size > 0) 
-      {
-        assert(min_ball_width == 0);
-        if (left_count > leaf_size)
-          node_queue.push(current_node->left_.get());
+      assert(min_ball_width == 0);
+      if (left_count > leaf_size)
+        children_to_split.push_back(current_node->left_.get());
 
-        if (current_node->count_ - left_count > leaf_size)
-          node_queue.push(current_node->right_.get());
-      }
-      else 
-      {
-        assert(min_ball_width > 0);
-        assert(leaf_size == 0);
-        if (radii[0] > min_ball_width / 2.)
-          node_queue.push(current_node->left_.get());
+      if (current_node->count_ - left_count > leaf_size)
+        children_to_split.push_back(current_node->right_.get());
+    }
+    else 
+    {
+      assert(min_ball_width > 0);
+      assert(leaf_size == 0);
+      if (radii[0] > min_ball_width / 2.)
+        children_to_split.push_back(current_node->left_.get());
 
-        if (radii[1] > min_ball_width / 2.)
-          node_queue.push(current_node->right_.get());
-      }
-    } // if some split found
-  } // node queue loop
-} // BuildTree
+      if (radii[1] > min_ball_width / 2.)
+        children_to_split.push_back(current_node->right_.get());
+    }
+  } // if some split found
+} // SplitNode
 
 template <typename T, class TBDiv, class TBBall, class TSplitter>
+template <class TTable>
 double BregmanBallTree<T, TBDiv, TBBall, TSplitter>::ComputeNodeRadius(
-    const Table<T>& data,
+    const TTable& data,
     const size_t node_begin,
     const size_t node_end,
-    const Point<T>& node_center)
+    const ConstPointView<T>& node_center)
 {
   double node_radius = 0;
   double div_to_center;
   for (size_t i = node_begin; i < node_end; i++) 
   {
     div_to_center = TBDiv::BDivergence(data[i], node_center);
+    // the radius bounds the exact divergences
+    div_to_center += TBDiv::BDivergenceError(
+        data[i], node_center, div_to_center);
     if (div_to_center > node_radius)
       node_radius = div_to_center;
   }
@@ -165,8 +312,47 @@ double BregmanBallTree<T, TBDiv, TBBall, TSplitter>::ComputeNodeRadius(
 }
 
 template <typename T, class TBDiv, class TBBall, class TSplitter>
+template <class TTable>
+void BregmanBallTree<T, TBDiv, TBBall, TSplitter>::ComputeNodeLeftBall(
+    const TTable& data,
+    const size_t node_begin,
+    const size_t node_end,
+    Point<T>& left_center,
+    double& left_radius)
+{
+  // the mean of the gradients, summed divided by the count so that the 
+  // gradients at the zeros of KL (-max()) do not overflow
+  const double weight = 1.0 / (node_end - node_begin);
+  Point<T> point;
+  Point<T> point_prime;
+  Point<T> mean_prime;
+  mean_prime.zeros(data.n_dims());
+  for (size_t i = node_begin; i < node_end; i++)
+  {
+    TBDiv::Gradient(data[i], point_prime);
+    Axpby<T>(1.0, mean_prime, weight, point_prime, mean_prime);
+  }
+  TBDiv::GradientConjugate(mean_prime, left_center);
+
+  left_radius = 0;
+  for (size_t i = node_begin; i < node_end; i++)
+  {
+    // sparse and quantized points are made dense, in the same storage
+    point.zeros(data.n_dims());
+    point += data[i];
+    double div_from_center = TBDiv::BDivergence(left_center, point);
+    // the radius bounds the exact divergences
+    div_from_center += TBDiv::BDivergenceError(
+        left_center, point, div_from_center);
+    if (div_from_center > left_radius)
+      left_radius = div_from_center;
+  }
+}
+
+template <typename T, class TBDiv, class TBBall, class TSplitter>
+template <class TTable>
 size_t BregmanBallTree<T, TBDiv, TBBall, TSplitter>::MatrixSwap(
-    Table<T>& table,
+    TTable& table,
     const size_t node_begin,
     const size_t node_end,
     std::vector<size_t>& membership,
@@ -187,10 +373,7 @@ size_t BregmanBallTree<T, TBDiv, TBBall, TSplitter>::MatrixSwap(
     if (left_ind > right_ind) 
       break;
 
-    // FIXME: use std::swap here
-    Point<T> temp_point = table[node_begin + left_ind];
-    table[node_begin + left_ind] = table[node_begin + right_ind];
-    table[node_begin + right_ind] = temp_point;
+    table.Swap(node_begin + left_ind, node_begin + right_ind);
 
     size_t temp_ind = old_from_new[node_begin + left_ind];
     old_from_new[node_begin + left_ind] = old_from_new[node_begin + right_ind];
@@ -206,11 +389,13 @@ size_t BregmanBallTree<T, TBDiv, TBBall, TSplitter>::MatrixSwap(
 }
 
 template <typename T, class TBDiv, class TBBall, class TSplitter>
+template <class TTable>
 BregmanBallTree<T, TBDiv, TBBall, TSplitter>::BregmanBallTree(
-    Table<T>& data, 
+    TTable& data, 
     std::vector<size_t>& old_from_new,
     const size_t leaf_size, 
-    const double min_ball_width) :
+    const double min_ball_width,
+    const TreeBuildOptions& options) :
   begin_(0),
   count_(data.n_points()),
   end_(data.n_points())
@@ -221,14 +406,358 @@ BregmanBallTree<T, TBDiv, TBBall, TSplitter>::BregmanBallTree(
       "'minimum leaf diameter'" << std::endl;
     exit(1);
   }
+  if (TBDiv::kDims != kDynamicDims and data.n_dims() != TBDiv::kDims)
+  {
+    std::cout << "[ERROR] The divergence is fixed to " << TBDiv::kDims << 
+      " dimensions but the data has " << data.n_dims() << "." << std::endl;
+    exit(1);
+  }
 
   old_from_new.resize(data.n_points());
   for (size_t i = 0; i < count_; i++) 
     old_from_new[i] = i;
 
-  std::queue<BregmanBallTree<T, TBDiv, TBBall, TSplitter>*> node_queue;
-  node_queue.push(this);
-  BuildTree(data, leaf_size, min_ball_width, node_queue, old_from_new);
+  BuildTree(data, leaf_size, min_ball_width, options, old_from_new);
+}
+
+template <typename T, class TBDiv, class TBBall, class TSplitter>
+void BregmanBallTree<T, TBDiv, TBBall, TSplitter>::ShiftIndices(
+    const size_t offset)
+{
+  begin_ += offset;
+  end_ += offset;
+  if (left_)
+    left_->ShiftIndices(offset);
+  if (right_)
+    right_->ShiftIndices(offset);
+}
+
+template <typename T, class TBDiv, class TBBall, class TSplitter>
+BregmanBallTree<T, TBDiv, TBBall, TSplitter>* 
+BregmanBallTree<T, TBDiv, TBBall, TSplitter>::BuildOutOfCore(
+    TableStream<T>& stream,
+    const std::vector<size_t>* original_indices,
+    BinaryTableWriter<T>& writer,
+    std::vector<size_t>& old_from_new,
+    const size_t max_points_in_memory,
+    const size_t leaf_size,
+    const std::string& temp_dir,
+    std::vector<TBBTree*>& unbounded_nodes)
+{
+  typedef BregmanBallTree<T, TBDiv, TBBall, TSplitter> TNode;
+  const size_t n_dims = stream.n_dims();
+
+  // Pass 1: count the points and draw a uniform sample (reservoir 
+  // sampling) to compute the top-level splits from
+  const size_t sample_size = std::max((size_t) 2, max_points_in_memory / 2);
+  Table<T> sample(sample_size, n_dims);
+  std::default_random_engine gen(kOutOfCoreSampleSeed);
+  size_t n_points = 0;
+  Table<T> block;
+  stream.Rewind();
+  while (stream.NextBlock(block))
+  {
+    for (size_t i = 0; i < block.n_points(); i++, n_points++)
+    {
+      size_t slot = n_points;
+      if (n_points >= sample_size)
+        slot = std::uniform_int_distribution<size_t>(0, n_points)(gen);
+      if (slot < sample_size)
+        std::copy(block[i].values(), block[i].values() + n_dims, 
+            sample[slot].values());
+    }
+  }
+  if (n_points == 0)
+    return NULL;
+
+  // The top of the tree: split the sample until every part is expected
+  // to fit in memory
+  struct TopNode 
+  {
+    size_t begin;
+    size_t count;
+    std::vector<Point<T> > centers;
+    int left;
+    int right;
+  };
+  std::vector<TopNode> top;
+  if (n_points > max_points_in_memory)
+  {
+    std::vector<size_t> sample_old_from_new(sample_size);
+    top.push_back(TopNode());
+    top[0].begin = 0;
+    top[0].count = sample_size;
+    top[0].left = -1;
+    top[0].right = -1;
+    for (size_t i = 0; i < top.size(); i++)
+    {
+      const double expected_points = 
+        (double) top[i].count * n_points / sample_size;
+      if (expected_points <= max_points_in_memory or top[i].count < 2)
+        continue;
+
+      std::vector<size_t> membership;
+      std::vector<Point<T> > centers;
+      std::vector<double> radii;
+      TSplitter data_splitter;
+      data_splitter.PartitionData(
+          sample, 
+          top[i].begin, 
+          top[i].begin + top[i].count, 
+          membership, 
+          centers, 
+          radii);
+      size_t left_count = MatrixSwap(
+          sample, 
+          top[i].begin, 
+          top[i].begin + top[i].count, 
+          membership, 
+          sample_old_from_new);
+      if (left_count == 0 or left_count == top[i].count)
+        continue;
+
+      TopNode left = { top[i].begin, left_count, 
+        std::vector<Point<T> >(), -1, -1 };
+      TopNode right = { top[i].begin + left_count, top[i].count - left_count, 
+        std::vector<Point<T> >(), -1, -1 };
+      top[i].centers = centers;
+      top[i].left = top.size();
+      top[i].right = top.size() + 1;
+      top.push_back(left);
+      top.push_back(right);
+    }
+  }
+
+  if (top.size() <= 1)
+  {
+    // Everything fits in memory (or the sample could not be split): 
+    // build the subtree in memory
+    if (n_points > max_points_in_memory)
+      std::cout << "[WARNING] Could not split " << n_points << " points "
+        "to fit the memory budget; building them in memory." << std::endl;
+
+    Table<T> data(n_points, n_dims);
+    if (n_points <= sample_size)
+    {
+      // the sample holds all the points in order
+      std::copy(sample.values(), sample.values() + n_points * data.stride(),
+          data.values());
+    }
+    else
+    {
+      size_t i = 0;
+      stream.Rewind();
+      while (stream.NextBlock(block))
+      {
+        std::copy(block.values(), 
+            block.values() + block.n_points() * block.stride(), 
+            data[i].values());
+        i += block.n_points();
+      }
+    }
+    sample = Table<T>();
+
+    std::vector<size_t> local_old_from_new;
+    TNode* node;
+    if (n_points <= std::max(leaf_size, (size_t) 1))
+    {
+      local_old_from_new.resize(n_points);
+      for (size_t i = 0; i < n_points; i++)
+        local_old_from_new[i] = i;
+      node = new TNode(data, 0, n_points);
+      node->bounding_ball_.AddExtraStats(data, 0, n_points);
+    }
+    else
+      node = new TNode(data, local_old_from_new, leaf_size);
+
+    node->ShiftIndices(writer.n_points());
+    writer.Append(data);
+    for (size_t i = 0; i < n_points; i++)
+      old_from_new.push_back(original_indices ? 
+          (*original_indices)[local_old_from_new[i]] : local_old_from_new[i]);
+    return node;
+  }
+  sample = Table<T>();
+
+  // Pass 2: spill the points into one file per partition (the leaves 
+  // of the top), routing every point to the closer center at every 
+  // level as the splitter would have done
+  std::vector<std::string> file_names(top.size());
+  std::vector<std::unique_ptr<BinaryTableWriter<T> > > partitions(top.size());
+  std::vector<std::unique_ptr<std::ofstream> > index_files(top.size());
+  for (size_t i = 0; i < top.size(); i++)
+  {
+    if (top[i].left >= 0)
+      continue;
+    std::string file_name = temp_dir + "/bmst_partition_XXXXXX";
+    int fd = mkstemp(&file_name[0]);
+    if (fd < 0)
+    {
+      std::cout << "[ERROR] Could not create a temporary file in '" << 
+        temp_dir << "'." << std::endl;
+      exit(1);
+    }
+    close(fd);
+    file_names[i] = file_name;
+    partitions[i].reset(new BinaryTableWriter<T>(file_name, n_dims, false));
+    index_files[i].reset(new std::ofstream(
+        (file_name + ".idx").c_str(), std::ofstream::binary));
+  }
+
+  size_t point_index = 0;
+  stream.Rewind();
+  while (stream.NextBlock(block))
+  {
+    for (size_t i = 0; i < block.n_points(); i++, point_index++)
+    {
+      const ConstPointView<T> point = block[i];
+      size_t node = 0;
+      while (top[node].left >= 0)
+      {
+        const double div_left = 
+          TBDiv::BDivergence(point, top[node].centers[0]);
+        const double div_right = 
+          TBDiv::BDivergence(point, top[node].centers[1]);
+        node = (div_left <= div_right) ? top[node].left : top[node].right;
+      }
+      partitions[node]->Append(point);
+      const size_t original_index = original_indices ? 
+        (*original_indices)[point_index] : point_index;
+      index_files[node]->write(
+          (const char*) &original_index, sizeof(original_index));
+    }
+  }
+  for (size_t i = 0; i < top.size(); i++)
+  {
+    if (partitions[i])
+    {
+      partitions[i]->Close();
+      index_files[i]->close();
+    }
+  }
+  partitions.clear();
+  index_files.clear();
+
+  // Build the subtrees of the partitions one at a time (in order, so 
+  // that every node covers a contiguous range of the output) and 
+  // connect them with the nodes of the top
+  std::function<TNode* (const size_t)> build_node = 
+    [&](const size_t i) -> TNode*
+  {
+    if (top[i].left < 0)
+    {
+      const std::string index_file = file_names[i] + ".idx";
+      TNode* node;
+      {
+        TableStream<T> partition_stream(file_names[i], stream.block_size());
+        std::ifstream ifs(index_file.c_str(), std::ifstream::binary);
+        std::vector<size_t> indices;
+        size_t index;
+        while (ifs.read((char*) &index, sizeof(index)))
+          indices.push_back(index);
+        node = BuildOutOfCore(
+            partition_stream, 
+            &indices, 
+            writer, 
+            old_from_new, 
+            max_points_in_memory, 
+            leaf_size, 
+            temp_dir, 
+            unbounded_nodes);
+      }
+      remove(file_names[i].c_str());
+      remove(index_file.c_str());
+      return node;
+    }
+
+    TNode* left = build_node(top[i].left);
+    TNode* right = build_node(top[i].right);
+    if (left == NULL)
+      return right;
+    if (right == NULL)
+      return left;
+
+    TNode* node = new TNode(left->begin_, left->count_ + right->count_, TBBall());
+    node->left_.reset(left);
+    node->right_.reset(right);
+    unbounded_nodes.push_back(node);
+    return node;
+  };
+
+  return build_node(0);
+} // BuildOutOfCore
+
+template <typename T, class TBDiv, class TBBall, class TSplitter>
+BregmanBallTree<T, TBDiv, TBBall, TSplitter>::BregmanBallTree(
+    TableStream<T>& stream,
+    const std::string& output_file,
+    std::vector<size_t>& old_from_new,
+    const size_t memory_budget,
+    const size_t leaf_size,
+    const std::string& temp_dir)
+{
+  typedef BregmanBallTree<T, TBDiv, TBBall, TSplitter> TNode;
+
+  // the in-memory build needs the points plus a few indices per point
+  const size_t bytes_per_point = 
+    Table<T>::Stride(stream.n_dims()) * sizeof(T) + 4 * sizeof(size_t);
+  const size_t max_points_in_memory = memory_budget / bytes_per_point;
+  if (TBDiv::kDims != kDynamicDims and stream.n_dims() != TBDiv::kDims)
+  {
+    std::cout << "[ERROR] The divergence is fixed to " << TBDiv::kDims << 
+      " dimensions but the data has " << stream.n_dims() << "." << std::endl;
+    exit(1);
+  }
+  if (max_points_in_memory < std::max(leaf_size, (size_t) 2)) 
+  {
+    std::cout << "[ERROR] A memory budget of " << memory_budget << 
+      " bytes is too small to build a tree over points with " << 
+      stream.n_dims() << " dimensions." << std::endl;
+    exit(1);
+  }
+
+  BinaryTableWriter<T> writer(output_file, stream.n_dims());
+  old_from_new.clear();
+  std::vector<TNode*> unbounded_nodes;
+  TNode* root = BuildOutOfCore(
+      stream, 
+      NULL, 
+      writer, 
+      old_from_new, 
+      max_points_in_memory, 
+      leaf_size, 
+      temp_dir, 
+      unbounded_nodes);
+  writer.Close();
+  if (root == NULL)
+  {
+    std::cout << "[ERROR] Cannot build a tree over an empty set." << 
+      std::endl;
+    exit(1);
+  }
+
+  // take over the root
+  begin_ = root->begin_;
+  end_ = root->end_;
+  count_ = root->count_;
+  bounding_ball_ = root->bounding_ball_;
+  left_.swap(root->left_);
+  right_.swap(root->right_);
+  for (size_t i = 0; i < unbounded_nodes.size(); i++)
+    if (unbounded_nodes[i] == root)
+      unbounded_nodes[i] = this;
+  delete root;
+
+  // Compute the bounds of the nodes split on the sample from the 
+  // points that actually ended up in them
+  const Table<T> data = MapBinaryTable<T>(output_file);
+  for (size_t i = 0; i < unbounded_nodes.size(); i++)
+  {
+    TNode* node = unbounded_nodes[i];
+    TNode bounds(data, node->begin_, node->count_);
+    node->bounding_ball_ = bounds.bounding_ball_;
+    node->bounding_ball_.AddExtraStats(data, node->begin_, node->end_);
+  }
 }
 
 template <typename T, class TBDiv, class TBBall, class TSplitter>
@@ -240,7 +769,7 @@ BregmanBallTree<T, TBDiv, TBBall, TSplitter>::~BregmanBallTree()
 
 template <typename T, class TBDiv, class TBBall, class TSplitter>
 bool BregmanBallTree<T, TBDiv, TBBall, TSplitter>::CanPruneRight(
-    const Point<T>& q,
+    const ConstPointView<T>& q,
     const double q_div_to_best_candidate,
     const double q_div_to_center)
 {
@@ -252,12 +781,14 @@ bool BregmanBallTree<T, TBDiv, TBBall, TSplitter>::CanPruneRight(
 
 template <typename T, class TBDiv, class TBBall, class TSplitter>
 bool BregmanBallTree<T, TBDiv, TBBall, TSplitter>::CanPruneLeft(
-    const Point<T>& q,
+    const ConstPointView<T>& q,
     const double q_div_to_best_candidate,
     const double q_div_to_center)
 {
-  // TO BE FILLED IN (always return false for now)
-  return false;
+  if (q_div_to_center == std::numeric_limits<double>::max())
+    return bounding_ball_.CanPruneLeft(q, q_div_to_best_candidate);
+  return bounding_ball_.CanPruneLeft(
+      q, q_div_to_best_candidate, q_div_to_center);
 }
 
 template <typename T, class TBDiv, class TBBall, class TSplitter>
@@ -266,8 +797,12 @@ bool BregmanBallTree<T, TBDiv, TBBall, TSplitter>::CanPruneRight(
     const double node_max_div_to_best_candidate,
     const double node_div_to_center)
 {
-  // TO BE FILLED IN (always return false for now)
-  return false;
+  // node_div_to_center = d(LCenter of other_node, RCenter)
+  const double centers_div = 
+    (node_div_to_center == std::numeric_limits<double>::max()) ?
+    TBDiv::BDivergence(other_node.LCenter(), RCenter()) : node_div_to_center;
+  return bounding_ball_.CanPruneRight(
+      other_node.Bound(), node_max_div_to_best_candidate, centers_div);
 }
 
 template <typename T, class TBDiv, class TBBall, class TSplitter>
@@ -276,8 +811,12 @@ bool BregmanBallTree<T, TBDiv, TBBall, TSplitter>::CanPruneLeft(
     const double node_max_div_to_best_candidate,
     const double center_div_to_node)
 {
-  // TO BE FILLED IN (always return false for now)
-  return false;
+  // center_div_to_node = d(LCenter, RCenter of other_node)
+  const double centers_div = 
+    (center_div_to_node == std::numeric_limits<double>::max()) ?
+    TBDiv::BDivergence(LCenter(), other_node.RCenter()) : center_div_to_node;
+  return bounding_ball_.CanPruneLeft(
+      other_node.Bound(), node_max_div_to_best_candidate, centers_div);
 }
     
 } // namespace
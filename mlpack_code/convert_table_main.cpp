@@ -0,0 +1,81 @@
+/**
+ * @file bmst/mlpack_code/convert_table_main.cpp
+ *
+ * Converts a text (comma or space separated) data file into the binary
+ * table format that can be memory-mapped by the search programs.
+ */
+
+#include <iostream>
+#include <string>
+
+#include <boost/program_options.hpp>
+
+#include "data.hpp"
+#include "table_io.hpp"
+
+using namespace std;
+
+template <typename T>
+void Convert(const string& in_file, const string& out_file, const bool checksum);
+
+int main(int argc, char* argv[])
+{
+  namespace bpo = boost::program_options;
+
+  bpo::options_description opt_desc(
+    "Options for converting data files into the binary table format");
+  opt_desc.add_options()
+    ("help", "Produce help message")
+    ("input", bpo::value<string>(),
+     "The text file containing the set of points (required)")
+    ("output", bpo::value<string>(),
+     "The binary file to be written (required)")
+    ("type", bpo::value<string>(),
+     "The element type of the binary table (optional). Options are: \n"
+     " float (default)\n"
+     " double\n")
+    ("no_checksum", "Do not store a checksum of the data in the header");
+
+  bpo::variables_map vm;
+  bpo::store(bpo::parse_command_line(argc, argv, opt_desc), vm);
+  bpo::notify(vm);
+
+  if (vm.count("help"))
+  {
+    cout << opt_desc << endl;
+    exit(0);
+  }
+
+  if (vm.count("input") == 0 or vm.count("output") == 0)
+  {
+    cout << "[ERROR] The --input and --output options are required" << endl;
+    exit(1);
+  }
+
+  string in_file = vm["input"].as<string>();
+  string out_file = vm["output"].as<string>();
+  string type = vm.count("type") ? vm["type"].as<string>() : "float";
+  bool checksum = (vm.count("no_checksum") == 0);
+
+  if (type == "float")
+    Convert<float>(in_file, out_file, checksum);
+  else if (type == "double")
+    Convert<double>(in_file, out_file, checksum);
+  else
+  {
+    cout << "[ERROR] Unsupported element type '" << type << "'" << endl;
+    exit(1);
+  }
+
+  return 0;
+} // main
+
+template <typename T>
+void Convert(const string& in_file, const string& out_file, const bool checksum)
+{
+  cout << "Reading in '" << in_file << "'" << endl;
+  bmst::Table<T> data(in_file);
+  cout << "Writing '" << out_file << "'" << endl;
+  bmst::WriteBinaryTable(data, out_file, checksum);
+  return;
+}
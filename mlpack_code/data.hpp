@@ -9,12 +9,81 @@
 #ifndef BMST_DATA_HPP_
 #define BMST_DATA_HPP_
 
+#include <memory>
 #include <string>
 #include <vector>
 
 namespace bmst
 { 
 
+// Dimensionality used as a template argument when the number of 
+// dimensions is only known at run time.
+const size_t kDynamicDims = 0;
+
+// Loop bound over the dimensions of a point. With a fixed D > 0 the
+// bound is a compile-time constant, so the loops over the dimensions can
+// be unrolled and vectorized.
+template <size_t D>
+struct Dims
+{
+  template <class TPoint>
+  static size_t Of(const TPoint& x);
+};
+
+template <>
+struct Dims<kDynamicDims>
+{
+  template <class TPoint>
+  static size_t Of(const TPoint& x) { return x.n_dims(); }
+};
+
+// Non-owning read-only view of a point stored elsewhere (usually a row
+// of a Table). It is cheap to copy and is the type taken by the
+// divergences, balls, splitters and trees.
+template <typename T>
+class ConstPointView
+{
+private:
+  const T* values_;
+  size_t n_dims_;
+
+public:
+  ConstPointView();
+  ConstPointView(const T* values, const size_t n_dims);
+
+  const size_t n_dims() const { return n_dims_; }
+  const T* values() const { return values_; }
+
+  const T& operator[](const size_t i) const;
+
+  void print() const;
+
+};
+
+// Non-owning mutable view of a point stored elsewhere.
+template <typename T>
+class PointView
+{
+private:
+  T* values_;
+  size_t n_dims_;
+
+public:
+  PointView();
+  PointView(T* values, const size_t n_dims);
+
+  const size_t n_dims() const { return n_dims_; }
+  T* values() const { return values_; }
+
+  T& operator[](const size_t i) const;
+
+  operator ConstPointView<T>() const
+  { return ConstPointView<T>(values_, n_dims_); }
+
+  void print() const;
+
+};
+
 template <typename T>
 class Point
 {
@@ -26,14 +95,21 @@ public:
   Point();
   Point(const std::vector<T>& point);
   Point(const Point<T>& point);
+  Point(const ConstPointView<T>& point);
+  Point(const PointView<T>& point);
 
   const size_t n_dims() const { return n_dims_; }
+  const T* values() const { return values_.data(); }
+  T* values() { return values_.data(); }
+
+  operator ConstPointView<T>() const
+  { return ConstPointView<T>(values_.data(), n_dims_); }
 
   T& operator[](const size_t i);
   const T& operator[](const size_t i) const;
   Point<T>& operator=(const Point<T>& point);
-  Point<T>& operator+=(const Point<T>& point);
-  Point<T>& operator-=(const Point<T>& point);
+  Point<T>& operator+=(const ConstPointView<T>& point);
+  Point<T>& operator-=(const ConstPointView<T>& point);
   Point<T>& operator*=(const double scalar);
   Point<T>& operator/=(const double scalar);
   void zeros();
@@ -70,28 +146,100 @@ Point<T> operator/(const Point<T>& lhs, const double rhs);
 template<typename T>
 double Dot(const Point<T>& a, const Point<T>& b);
 
+template<typename T>
+double Dot(const ConstPointView<T>& a, const ConstPointView<T>& b);
+
+// \sum_i a_i
+template<typename T>
+double Sum(const Point<T>& a);
+
+template<typename T>
+double Sum(const ConstPointView<T>& a);
+
+template<typename T>
+double Sum(const PointView<T>& a);
+
+// Fused kernels, evaluated in a single pass without temporary points
+// (Dot, SquaredDistance and Axpby run on the vectorized kernels of
+// simd_kernels.hpp)
+
+// || a - b ||^2
+template<typename T>
+double SquaredDistance(const ConstPointView<T>& a, const ConstPointView<T>& b);
+
+template<typename T>
+double SquaredDistance(const Point<T>& a, const Point<T>& b);
+
+// result = alpha * x + beta * y, reusing the storage of result (it is
+// only reallocated if its dimensionality differs). result may alias x
+// or y.
+template<typename T>
+void Axpby(
+    const double alpha, 
+    const ConstPointView<T>& x, 
+    const double beta, 
+    const ConstPointView<T>& y, 
+    Point<T>& result);
+
+// The points are stored row-major in a single buffer aligned to
+// kAlignment bytes. Every row is padded (with zeros) to a multiple of
+// kAlignment bytes so that each point starts on an aligned address.
 template <typename T>
 class Table
 {
+public:
+  static const size_t kAlignment = 64;
+
 private:
-  std::vector<Point<T> > points_;
+  // The backing store; released through its deleter
+  std::shared_ptr<T> storage_;
+  T* values_;
   size_t n_points_;
+  size_t n_dims_;
+  // distance (in elements) between consecutive points
+  size_t stride_;
+
+  void Allocate_(const size_t n_points, const size_t n_dims);
 
 public:
   Table();
+  Table(const size_t n_points, const size_t n_dims);
   Table(const std::vector<std::vector<T> >& points);
   Table(const std::vector<Point<T> >& points);
   Table(const Table& table);
-  // Read table in from a file
-  Table(const std::string& file_name);
+  Table(Table&& table);
+  // Wrap an existing buffer laid out with Stride(n_dims) and aligned to
+  // kAlignment, without copying it. The buffer is released through the
+  // deleter of the storage.
+  Table(
+      const std::shared_ptr<T>& storage,
+      const size_t n_points,
+      const size_t n_dims);
+  // Read table in from a (comma or space separated) text file, parsing
+  // it with n_threads threads (0 means one per hardware thread). Throws
+  // a std::runtime_error with the offending line for malformed files.
+  Table(const std::string& file_name, const size_t n_threads = 0);
 
   const size_t n_points() const { return n_points_; }
+  const size_t n_dims() const { return n_dims_; }
+  const size_t stride() const { return stride_; }
 
-  Point<T>& operator[](const size_t i);
-  const Point<T>& operator[](const size_t i) const;
+  // The raw aligned row-major buffer
+  T* values() { return values_; }
+  const T* values() const { return values_; }
+
+  PointView<T> operator[](const size_t i);
+  ConstPointView<T> operator[](const size_t i) const;
   Table& operator=(const Table& table);
+  Table& operator=(Table&& table);
   
+  // Swap the i-th and the j-th points in place
+  void Swap(const size_t i, const size_t j);
+
   void print() const;
+
+  // The padded row length (in elements) for points of n_dims dimensions
+  static size_t Stride(const size_t n_dims);
   
 }; // class
 
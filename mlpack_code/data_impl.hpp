@@ -8,15 +8,92 @@
 #ifndef BMST_DATA_IMPL_HPP_
 #define BMST_DATA_IMPL_HPP_
 
+#include <assert.h>
+#include <stdlib.h>
+
+#include <algorithm>
 #include <fstream> 
-#include <boost/lexical_cast.hpp>
-#include <boost/tokenizer.hpp>
+#include <iostream>
+#include <utility>
 
 #include "data.hpp"
+#include "simd_kernels.hpp"
+#include "text_parser.hpp"
 
 namespace bmst
 { 
 
+template <size_t D>
+template <class TPoint>
+size_t Dims<D>::Of(const TPoint& x)
+{
+  assert(x.n_dims() == D);
+  return D;
+}
+
+template <typename T>
+ConstPointView<T>::ConstPointView() :
+  values_(NULL),
+  n_dims_(0)
+{}
+
+template <typename T>
+ConstPointView<T>::ConstPointView(const T* values, const size_t n_dims) :
+  values_(values),
+  n_dims_(n_dims)
+{}
+
+template<typename T>
+const T& ConstPointView<T>::operator[](const size_t i) const
+{
+  if (i >= n_dims_)
+  {
+    std::cout << "[ERROR] Point index out of range" << std::endl;
+    exit(1);
+  }
+  return values_[i];
+}
+
+template<typename T>
+void ConstPointView<T>::print() const
+{
+  std::cout << "(";
+  for (int i = 0; i < n_dims_ - 1; i++)
+  {
+    std::cout << values_[i] << ", ";
+  }
+  std::cout << values_[n_dims_ - 1] << ")\n";
+}
+
+template <typename T>
+PointView<T>::PointView() :
+  values_(NULL),
+  n_dims_(0)
+{}
+
+template <typename T>
+PointView<T>::PointView(T* values, const size_t n_dims) :
+  values_(values),
+  n_dims_(n_dims)
+{}
+
+template<typename T>
+T& PointView<T>::operator[](const size_t i) const
+{
+  if (i >= n_dims_)
+  {
+    std::cout << "[ERROR] Point index out of range" << std::endl;
+    exit(1);
+  }
+  return values_[i];
+}
+
+template<typename T>
+void PointView<T>::print() const
+{
+  ConstPointView<T>(values_, n_dims_).print();
+}
+
 template <typename T>
 Point<T>::Point() :
   values_(std::vector<T>(0)),
@@ -35,6 +112,18 @@ Point<T>::Point(const Point<T>& point)
   *this = point;
 }
 
+template<typename T>
+Point<T>::Point(const ConstPointView<T>& point) :
+  values_(point.values(), point.values() + point.n_dims()),
+  n_dims_(point.n_dims())
+{}
+
+template<typename T>
+Point<T>::Point(const PointView<T>& point) :
+  values_(point.values(), point.values() + point.n_dims()),
+  n_dims_(point.n_dims())
+{}
+
 template<typename T>
 T& Point<T>::operator[](const size_t i)
 {
@@ -70,12 +159,13 @@ Point<T>& Point<T>::operator=(const Point<T>& point)
 }
 
 template<typename T>
-Point<T>& Point<T>::operator+=(const Point<T>& point)
+Point<T>& Point<T>::operator+=(const ConstPointView<T>& point)
 {
-  if (n_dims_ == point.n_dims_) 
+  if (n_dims_ == point.n_dims())
   {
+    const T* point_values = point.values();
     for (size_t i = 0; i < n_dims_; i++)
-      values_[i] += point.values_[i];
+      values_[i] += point_values[i];
   }
   else
   {
@@ -87,12 +177,13 @@ Point<T>& Point<T>::operator+=(const Point<T>& point)
 }
 
 template<typename T>
-Point<T>& Point<T>::operator-=(const Point<T>& point)
+Point<T>& Point<T>::operator-=(const ConstPointView<T>& point)
 {
-  if (n_dims_ == point.n_dims_) 
+  if (n_dims_ == point.n_dims())
   {
+    const T* point_values = point.values();
     for (size_t i = 0; i < n_dims_; i++)
-      values_[i] -= point.values_[i];
+      values_[i] -= point_values[i];
   }
   else
   {
@@ -197,6 +288,12 @@ Point<T> operator/(const Point<T>& lhs, const double rhs)
 // Binary dot product
 template<typename T>
 double Dot(const Point<T>& a, const Point<T>& b)
+{
+  return Dot(ConstPointView<T>(a), ConstPointView<T>(b));
+}
+
+template<typename T>
+double Dot(const ConstPointView<T>& a, const ConstPointView<T>& b)
 {
   if (a.n_dims() != b.n_dims())
   {
@@ -205,114 +302,272 @@ double Dot(const Point<T>& a, const Point<T>& b)
       std::endl;
     exit(1);
   }
-  double dot_product = 0;
-  // FIXME: Improve efficiency of this loop
+  return simd::Dot(a.values(), b.values(), a.n_dims());
+}
+
+template<typename T>
+double Sum(const Point<T>& a)
+{
+  return Sum(ConstPointView<T>(a));
+}
+
+template<typename T>
+double Sum(const ConstPointView<T>& a)
+{
+  const T* a_values = a.values();
+  double sum = 0;
   for (size_t i = 0; i < a.n_dims(); i++)
-    dot_product += (a[i] * b[i]);
-  return dot_product;
+    sum += a_values[i];
+  return sum;
+}
+
+template<typename T>
+double Sum(const PointView<T>& a)
+{
+  return Sum(ConstPointView<T>(a));
+}
+
+template<typename T>
+double SquaredDistance(const ConstPointView<T>& a, const ConstPointView<T>& b)
+{
+  if (a.n_dims() != b.n_dims())
+  {
+    std::cout << "[ERROR] Dimension mismatch in distance computation" <<
+      std::endl;
+    exit(1);
+  }
+  return simd::SquaredDistance(a.values(), b.values(), a.n_dims());
+}
+
+template<typename T>
+double SquaredDistance(const Point<T>& a, const Point<T>& b)
+{
+  return SquaredDistance(ConstPointView<T>(a), ConstPointView<T>(b));
+}
+
+template<typename T>
+void Axpby(
+    const double alpha, 
+    const ConstPointView<T>& x, 
+    const double beta, 
+    const ConstPointView<T>& y, 
+    Point<T>& result)
+{
+  if (x.n_dims() != y.n_dims())
+  {
+    std::cout << "[ERROR] Dimensions mismatch in point addition" <<
+      std::endl;
+    exit(1);
+  }
+  // x and y cannot alias result if the sizes differ, so resizing 
+  // result does not invalidate them
+  if (result.n_dims() != x.n_dims())
+    result.zeros(x.n_dims());
+  simd::Axpby(
+      alpha, x.values(), beta, y.values(), result.values(), x.n_dims());
+}
+
+template<typename T>
+size_t Table<T>::Stride(const size_t n_dims)
+{
+  const size_t block = kAlignment / sizeof(T);
+  return ((n_dims + block - 1) / block) * block;
+}
+
+template<typename T>
+void Table<T>::Allocate_(const size_t n_points, const size_t n_dims)
+{
+  n_points_ = n_points;
+  n_dims_ = n_dims;
+  stride_ = Stride(n_dims);
+  const size_t n_values = n_points_ * stride_;
+  if (n_values == 0)
+  {
+    storage_.reset();
+    values_ = NULL;
+    return;
+  }
+
+  void* buffer = NULL;
+  if (posix_memalign(&buffer, kAlignment, n_values * sizeof(T)) != 0)
+  {
+    std::cout << "[ERROR] Could not allocate " << n_points_ << " x " <<
+      n_dims_ << " table." << std::endl;
+    exit(1);
+  }
+  values_ = static_cast<T*>(buffer);
+  storage_.reset(values_, free);
+  // zero out the padding as well
+  std::fill(values_, values_ + n_values, T(0));
 }
 
 template<typename T>
 Table<T>::Table() :
-  points_(std::vector<Point<T> >(0)),
-  n_points_(0)
+  values_(NULL),
+  n_points_(0),
+  n_dims_(0),
+  stride_(0)
 {}
 
+template<typename T>
+Table<T>::Table(const size_t n_points, const size_t n_dims)
+{
+  Allocate_(n_points, n_dims);
+}
+
 template<typename T>
 Table<T>::Table(const std::vector<std::vector<T> >& points)
 {
-  for (size_t i = 0; i < points.size(); i++)
-    points_.push_back(Point<T>(points[i]));
-  n_points_ = points.size();
+  Allocate_(points.size(), points.size() > 0 ? points[0].size() : 0);
+  for (size_t i = 0; i < n_points_; i++)
+  {
+    if (points[i].size() != n_dims_)
+    {
+      std::cout << "[ERROR] Dimensionality of the points do not match." <<
+        std::endl;
+      exit(1);
+    }
+    std::copy(points[i].begin(), points[i].end(), values_ + i * stride_);
+  }
 }
 
 template<typename T>
-Table<T>::Table(const std::vector<Point<T> >& points) :
-  points_(points),
-  n_points_(points.size())
-{}
+Table<T>::Table(const std::vector<Point<T> >& points)
+{
+  Allocate_(points.size(), points.size() > 0 ? points[0].n_dims() : 0);
+  for (size_t i = 0; i < n_points_; i++)
+  {
+    if (points[i].n_dims() != n_dims_)
+    {
+      std::cout << "[ERROR] Dimensionality of the points do not match." <<
+        std::endl;
+      exit(1);
+    }
+    std::copy(
+        points[i].values(), points[i].values() + n_dims_,
+        values_ + i * stride_);
+  }
+}
 
 template<typename T>
-Table<T>::Table(const Table<T>& table)
+Table<T>::Table(const Table<T>& table) :
+  values_(NULL),
+  n_points_(0),
+  n_dims_(0),
+  stride_(0)
 {
   *this = table;
 }
 
 template<typename T>
-Table<T>::Table(const std::string& file_name) 
-{
-  points_.resize(0);
-  n_points_ = 0;
-  std::ifstream ifs;
-  ifs.open(file_name.c_str(), std::ifstream::in);
-  std::string line;
-  boost::char_separator<char> sep(" ,");
-  boost::tokenizer<boost::char_separator<char> > tok(line, sep);
-  std::vector<std::string> line_pieces;
-  std::vector<T> dims;
-  size_t n_dims = 0;
-  while (ifs.good()) {
-    std::getline(ifs, line);
-    tok.assign(line.begin(), line.end());
-    line_pieces.assign(tok.begin(), tok.end());
-    if (line_pieces.size() > 0) 
-    {
-      if (n_dims == 0) 
-        n_dims = line_pieces.size();
-      else 
-      {
-        if (n_dims != line_pieces.size()) 
-        {
-          std::cout << "[ERROR] Dimensionality of the points do not match." << 
-            std::endl;
-          exit(0);
-        }
-      }
-
-      if (dims.size() == 0)
-        dims.resize(n_dims);
-
-      for (size_t i = 0; i < n_dims; i++)
-        dims[i] = boost::lexical_cast<double>(line_pieces[i]);
-
-      Point<T> point(dims);
-      points_.push_back(dims);
-      ++n_points_;
-    }
+Table<T>::Table(Table<T>&& table) :
+  values_(NULL),
+  n_points_(0),
+  n_dims_(0),
+  stride_(0)
+{
+  *this = std::move(table);
+}
+
+template<typename T>
+Table<T>::Table(
+    const std::shared_ptr<T>& storage,
+    const size_t n_points,
+    const size_t n_dims) :
+  storage_(storage),
+  values_(storage.get()),
+  n_points_(n_points),
+  n_dims_(n_dims),
+  stride_(Stride(n_dims))
+{
+  if ((size_t) values_ % kAlignment != 0)
+  {
+    std::cout << "[ERROR] The table buffer is not aligned to " <<
+      kAlignment << " bytes." << std::endl;
+    exit(1);
   }
+}
 
-  ifs.close();
-  std::cout << "[INFO] " << n_points_ << " points loaded with " << n_dims <<
+template<typename T>
+Table<T>::Table(const std::string& file_name, const size_t n_threads) :
+  values_(NULL),
+  n_points_(0),
+  n_dims_(0),
+  stride_(0)
+{
+  text_parser::ReadTable(file_name, n_threads, *this);
+  std::cout << "[INFO] " << n_points_ << " points loaded with " << n_dims_ <<
     " dimensions each." << std::endl;
 }
 
 template<typename T>
-Point<T>& Table<T>::operator[](const size_t i)
+PointView<T> Table<T>::operator[](const size_t i)
 {
   if (i >= n_points_) 
   {
     std::cout << "[ERROR] Table index out of range" << std::endl;
     exit(1);
   }
-  return points_[i];
+  return PointView<T>(values_ + i * stride_, n_dims_);
 }
 
 template<typename T>
-const Point<T>& Table<T>::operator[](const size_t i) const
+ConstPointView<T> Table<T>::operator[](const size_t i) const
 {
   if (i >= n_points_) 
   {
     std::cout << "[ERROR] Table index out of range" << std::endl;
     exit(1);
   }
-  return points_[i];
+  return ConstPointView<T>(values_ + i * stride_, n_dims_);
 }
 
 template<typename T>
 Table<T>& Table<T>::operator=(const Table<T>& table) 
 {
+  if (this == &table)
+    return *this;
+
+  Allocate_(table.n_points_, table.n_dims_);
+  if (n_points_ > 0)
+    std::copy(
+        table.values_, table.values_ + n_points_ * stride_, values_);
+
+  return *this;
+}
+
+template<typename T>
+Table<T>& Table<T>::operator=(Table<T>&& table)
+{
+  if (this == &table)
+    return *this;
+
+  storage_ = std::move(table.storage_);
+  values_ = table.values_;
   n_points_ = table.n_points_;
-  points_ = table.points_;
+  n_dims_ = table.n_dims_;
+  stride_ = table.stride_;
+
+  table.values_ = NULL;
+  table.n_points_ = 0;
+  table.n_dims_ = 0;
+  table.stride_ = 0;
+
+  return *this;
+}
+
+template<typename T>
+void Table<T>::Swap(const size_t i, const size_t j)
+{
+  if (i >= n_points_ or j >= n_points_)
+  {
+    std::cout << "[ERROR] Table index out of range" << std::endl;
+    exit(1);
+  }
+  if (i != j)
+    std::swap_ranges(
+        values_ + i * stride_, values_ + i * stride_ + n_dims_,
+        values_ + j * stride_);
 }
 
 template<typename T>
@@ -321,7 +576,7 @@ void Table<T>::print() const
   
   for (int i = 0; i < n_points_; i++)
   {
-    points_[i].print();
+    (*this)[i].print();
   }
   
 }
@@ -0,0 +1,97 @@
+/**
+ * @file bregman_mst/mlpack_code/divergence_cache.hpp
+ *
+ * Per-point terms of a Bregman divergence, computed once for a table.
+ * Writing d(x, y) = phi(x) - <x, grad phi(y)> + offset(y), with
+ * offset(y) = <y, grad phi(y)> - phi(y), the divergence between cached
+ * points costs one dot product instead of a pass of logarithms (for KL).
+ */
+
+#ifndef BMST_DIVERGENCE_CACHE_HPP_
+#define BMST_DIVERGENCE_CACHE_HPP_
+
+#include <math.h>
+
+#include <vector>
+
+#include "data.hpp"
+
+namespace bmst {
+
+template <typename T, class TBDiv>
+class DivergenceCache
+{
+private:
+  size_t n_dims_;
+  // phi(x) and TBDiv::ClosedFormNorm(x) of every point
+  std::vector<double> phi_;
+  std::vector<double> norms_;
+  // grad phi(x) and offset(x) of every point, if requested, and the 
+  // terms of the error of the divergences to x: ||grad phi(x)||_* and 
+  // |phi(x)| + ||x|| ||grad phi(x)||_* (see TBDiv::ClosedFormError)
+  Table<T> gradients_;
+  std::vector<double> offsets_;
+  std::vector<double> dual_norms_;
+  std::vector<double> scales_;
+  // whether grad phi(x) is finite, so that the divergences to x have 
+  // the closed form (a KL histogram with a zero does not)
+  std::vector<char> closed_form_;
+
+public:
+  DivergenceCache();
+  // The cache of the points of data (a Table<T> or a SparseTable<T>).
+  // The gradients are only needed for the divergences to the points 
+  // (d(., x)), and are dense even for sparse tables.
+  template <class TTable>
+  DivergenceCache(const TTable& data, const bool with_gradients = true);
+
+  const size_t n_points() const { return phi_.size(); }
+  const bool with_gradients() const { return gradients_.n_points() > 0; }
+
+  const double phi(const size_t i) const { return phi_[i]; }
+  ConstPointView<T> gradient(const size_t i) const { return gradients_[i]; }
+  const double offset(const size_t i) const { return offsets_[i]; }
+  const bool closed_form(const size_t i) const { return closed_form_[i]; }
+
+  // Upper bounds on the absolute error of the closed form d(x_i, y), 
+  // given dual_norm_y and scale_y of y (see ErrorScale), and of the 
+  // closed form d(x, x_i) given phi(x) and ClosedFormNorm(x)
+  double ErrorFrom(
+      const size_t i, const double dual_norm_y, const double scale_y) const
+  {
+    return TBDiv::ClosedFormError(
+        n_dims_, fabs(phi_[i]) + norms_[i] * dual_norm_y, scale_y);
+  }
+  double ErrorTo(
+      const size_t i, const double phi_x, const double norm_x) const
+  {
+    return TBDiv::ClosedFormError(
+        n_dims_, fabs(phi_x) + norm_x * dual_norms_[i], scales_[i]);
+  }
+
+  // Keep the cache in step with a reordering of the table
+  void Swap(const size_t i, const size_t j);
+
+  // offset(y) of a point y with gradient grad_y; returns false if 
+  // grad_y is not finite
+  template <class TPoint>
+  static bool Offset(
+      const TPoint& y, const ConstPointView<T>& grad_y, double& offset);
+
+  // ||grad_y||_* and |phi(y)| + ||y|| ||grad_y||_* of a point y, the 
+  // terms of the error of the closed form divergences to it
+  template <class TPoint>
+  static void ErrorScale(
+      const TPoint& y, 
+      const double phi_y, 
+      const ConstPointView<T>& grad_y, 
+      double& dual_norm, 
+      double& scale);
+
+}; // class
+
+} // namespace
+
+#include "divergence_cache_impl.hpp"
+
+#endif
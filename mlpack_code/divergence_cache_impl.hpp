@@ -0,0 +1,105 @@
+/**
+ * @file bregman_mst/mlpack_code/divergence_cache_impl.hpp
+ *
+ * Implementation of the functions defined in divergence_cache.hpp
+ */
+
+#ifndef BMST_DIVERGENCE_CACHE_IMPL_HPP_
+#define BMST_DIVERGENCE_CACHE_IMPL_HPP_
+
+#include <algorithm>
+#include <limits>
+
+#include "divergence_cache.hpp"
+
+namespace bmst {
+
+template <typename T, class TBDiv>
+DivergenceCache<T, TBDiv>::DivergenceCache() :
+  n_dims_(0)
+{}
+
+template <typename T, class TBDiv>
+template <class TTable>
+DivergenceCache<T, TBDiv>::DivergenceCache(
+    const TTable& data, const bool with_gradients) :
+  n_dims_(data.n_dims()),
+  phi_(data.n_points()),
+  norms_(data.n_points())
+{
+  for (size_t i = 0; i < data.n_points(); i++)
+  {
+    phi_[i] = TBDiv::Phi(data[i]);
+    norms_[i] = TBDiv::ClosedFormNorm(data[i], phi_[i]);
+  }
+
+  if (not with_gradients)
+    return;
+
+  gradients_ = Table<T>(data.n_points(), data.n_dims());
+  offsets_.resize(data.n_points());
+  closed_form_.resize(data.n_points());
+  dual_norms_.resize(data.n_points());
+  scales_.resize(data.n_points());
+  for (size_t i = 0; i < data.n_points(); i++)
+  {
+    const Point<T> gradient = TBDiv::Gradient(data[i]);
+    std::copy(gradient.values(), gradient.values() + data.n_dims(), 
+        gradients_[i].values());
+    double offset;
+    closed_form_[i] = Offset(data[i], gradients_[i], offset);
+    offsets_[i] = offset;
+    ErrorScale(data[i], phi_[i], gradients_[i], dual_norms_[i], scales_[i]);
+  }
+}
+
+template <typename T, class TBDiv>
+void DivergenceCache<T, TBDiv>::Swap(const size_t i, const size_t j)
+{
+  std::swap(phi_[i], phi_[j]);
+  std::swap(norms_[i], norms_[j]);
+  if (with_gradients())
+  {
+    gradients_.Swap(i, j);
+    std::swap(offsets_[i], offsets_[j]);
+    std::swap(closed_form_[i], closed_form_[j]);
+    std::swap(dual_norms_[i], dual_norms_[j]);
+    std::swap(scales_[i], scales_[j]);
+  }
+}
+
+template <typename T, class TBDiv>
+template <class TPoint>
+bool DivergenceCache<T, TBDiv>::Offset(
+    const TPoint& y, const ConstPointView<T>& grad_y, double& offset)
+{
+  const T* grad_values = grad_y.values();
+  for (size_t i = 0; i < grad_y.n_dims(); i++)
+  {
+    if (grad_values[i] <= -std::numeric_limits<T>::max()
+        or grad_values[i] >= std::numeric_limits<T>::max())
+    {
+      offset = 0;
+      return false;
+    }
+  }
+  offset = Dot(y, grad_y) - TBDiv::Phi(y);
+  return true;
+}
+
+template <typename T, class TBDiv>
+template <class TPoint>
+void DivergenceCache<T, TBDiv>::ErrorScale(
+    const TPoint& y, 
+    const double phi_y, 
+    const ConstPointView<T>& grad_y, 
+    double& dual_norm, 
+    double& scale)
+{
+  dual_norm = TBDiv::ClosedFormDualNorm(grad_y);
+  scale = fabs(phi_y) + TBDiv::ClosedFormNorm(y, phi_y) * dual_norm;
+}
+
+} // namespace
+
+#endif
@@ -0,0 +1,45 @@
+/**
+ * @file bregman_mst/mlpack_code/divergence_matrix.hpp
+ *
+ * All the divergences d(x_i, y_j) between a block of points x and a
+ * block of points y. Writing d(x, y) = phi(x) - <x, grad phi(y)> +
+ * offset(y) (see divergence_cache.hpp), the matrix is the product of
+ * the block x with the gradients of the block y, plus the phi(x) and
+ * offset(y) terms. It is computed like a matrix product: both blocks are
+ * packed in double, the gradients are swept in tiles that stay in cache
+ * and every row of x meets four gradients at a time in the Dot4
+ * micro-kernel (see simd_kernels.hpp). The points y without a finite
+ * gradient (a KL histogram with a zero) fall back to the divergence.
+ */
+
+#ifndef BMST_DIVERGENCE_MATRIX_HPP_
+#define BMST_DIVERGENCE_MATRIX_HPP_
+
+#include "data.hpp"
+
+namespace bmst {
+namespace divergence_matrix {
+
+// The tiles of gradients take about this many bytes
+const size_t kTileBytes = 1 << 17;
+
+// out[i][j] = TBDiv::BDivergence(x[x_begin + i], y[y_begin + j]), where
+// out is reallocated if its shape differs. The rows are split among
+// n_threads threads (0 means one per hardware thread).
+template <typename T, class TBDiv>
+void Compute(
+    const Table<T>& x,
+    const size_t x_begin,
+    const size_t x_end,
+    const Table<T>& y,
+    const size_t y_begin,
+    const size_t y_end,
+    Table<double>& out,
+    const size_t n_threads = 1);
+
+}; // namespace
+}; // namespace
+
+#include "divergence_matrix_impl.hpp"
+
+#endif
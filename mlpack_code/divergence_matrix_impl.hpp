@@ -0,0 +1,179 @@
+/**
+ * @file bregman_mst/mlpack_code/divergence_matrix_impl.hpp
+ *
+ * Implementation of the functions defined in divergence_matrix.hpp
+ */
+
+#ifndef BMST_DIVERGENCE_MATRIX_IMPL_HPP_
+#define BMST_DIVERGENCE_MATRIX_IMPL_HPP_
+
+#include <stdlib.h>
+
+#include <algorithm>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "divergence_cache.hpp"
+#include "divergence_matrix.hpp"
+#include "divergence_stats.hpp"
+#include "simd_kernels.hpp"
+
+namespace bmst {
+namespace divergence_matrix {
+
+// The packed terms of the block y
+struct Columns_
+{
+  // grad phi(y_j) in double, zero if it is not finite
+  Table<double> gradients;
+  std::vector<double> offsets;
+  std::vector<char> closed_form;
+};
+
+template <typename T, class TBDiv>
+void ComputeRows_(
+    const Table<T>& x,
+    const size_t x_begin,
+    const size_t row_begin,
+    const size_t row_end,
+    const Table<T>& y,
+    const size_t y_begin,
+    const Columns_& columns,
+    Table<double>& out,
+    DivergenceStats& stats)
+{
+  const DivergenceStats stats_before = TBDiv::Stats();
+  const size_t n_dims = x.n_dims();
+  const size_t n_rows = row_end - row_begin;
+  const size_t n_columns = columns.gradients.n_points();
+
+  // pack the rows
+  Table<double> rows(n_rows, n_dims);
+  std::vector<double> phi(n_rows);
+  for (size_t r = 0; r < n_rows; r++)
+  {
+    const ConstPointView<T> x_r = x[x_begin + row_begin + r];
+    std::copy(x_r.values(), x_r.values() + n_dims, rows[r].values());
+    phi[r] = TBDiv::Phi(x_r);
+  }
+
+  // a multiple of four gradients per tile
+  const size_t tile = std::max((size_t) 4,
+      kTileBytes / (sizeof(double) * std::max(n_dims, (size_t) 1)) / 4 * 4);
+  for (size_t tile_begin = 0; tile_begin < n_columns; tile_begin += tile)
+  {
+    const size_t tile_end = std::min(n_columns, tile_begin + tile);
+    for (size_t r = 0; r < n_rows; r++)
+    {
+      const double* row = rows[r].values();
+      double* out_r = out[row_begin + r].values();
+      size_t j = tile_begin;
+      for (; j + 4 <= tile_end; j += 4)
+      {
+        const double* gradients[4] = {
+          columns.gradients[j].values(),
+          columns.gradients[j + 1].values(),
+          columns.gradients[j + 2].values(),
+          columns.gradients[j + 3].values() };
+        double dots[4];
+        simd::Dot4(row, gradients, n_dims, dots);
+        // the cancellation can leave a small negative value
+        for (size_t k = 0; k < 4; k++)
+          out_r[j + k] =
+            std::max(0.0, phi[r] - dots[k] + columns.offsets[j + k]);
+      }
+      for (; j < tile_end; j++)
+        out_r[j] = std::max(0.0, phi[r] -
+            simd::Dot(row, columns.gradients[j].values(), n_dims) +
+            columns.offsets[j]);
+    }
+  }
+
+  for (size_t j = 0; j < n_columns; j++)
+  {
+    if (columns.closed_form[j])
+      continue;
+    for (size_t r = 0; r < n_rows; r++)
+      out[row_begin + r][j] = TBDiv::BDivergence(
+          x[x_begin + row_begin + r], y[y_begin + j]);
+  }
+  // the counts of this thread for the caller's thread
+  stats = TBDiv::Stats() - stats_before;
+}
+
+template <typename T, class TBDiv>
+void Compute(
+    const Table<T>& x,
+    const size_t x_begin,
+    const size_t x_end,
+    const Table<T>& y,
+    const size_t y_begin,
+    const size_t y_end,
+    Table<double>& out,
+    const size_t n_threads)
+{
+  if (x.n_dims() != y.n_dims())
+  {
+    std::cout << "[ERROR] Dimension mismatch in divergence matrix "
+      "computation" << std::endl;
+    exit(1);
+  }
+  const size_t n_dims = x.n_dims();
+  const size_t n_x = x_end - x_begin;
+  const size_t n_y = y_end - y_begin;
+  if (out.n_points() != n_x or out.n_dims() != n_y)
+    out = Table<double>(n_x, n_y);
+  if (n_x == 0 or n_y == 0)
+    return;
+
+  // pack the columns
+  Columns_ columns;
+  columns.gradients = Table<double>(n_y, n_dims);
+  columns.offsets.resize(n_y);
+  columns.closed_form.resize(n_y);
+  size_t n_closed_form = 0;
+  Point<T> gradient;
+  for (size_t j = 0; j < n_y; j++)
+  {
+    const ConstPointView<T> y_j = y[y_begin + j];
+    TBDiv::Gradient(y_j, gradient);
+    double offset;
+    columns.closed_form[j] =
+      DivergenceCache<T, TBDiv>::Offset(y_j, gradient, offset);
+    columns.offsets[j] = offset;
+    if (columns.closed_form[j])
+    {
+      std::copy(gradient.values(), gradient.values() + n_dims,
+          columns.gradients[j].values());
+      ++n_closed_form;
+    }
+  }
+  // the other columns count their divergences themselves
+  BMST_COUNT(TBDiv::Stats().bdiv, n_x * n_closed_form);
+
+  size_t n_chunks = n_threads;
+  if (n_chunks == 0)
+    n_chunks = std::thread::hardware_concurrency();
+  n_chunks = std::max((size_t) 1, std::min(n_chunks, n_x));
+
+  std::vector<std::thread> threads;
+  std::vector<DivergenceStats> stats(n_chunks);
+  for (size_t c = 1; c < n_chunks; c++)
+    threads.push_back(std::thread(ComputeRows_<T, TBDiv>,
+          std::cref(x), x_begin, c * n_x / n_chunks, (c + 1) * n_x / n_chunks,
+          std::cref(y), y_begin, std::cref(columns), std::ref(out),
+          std::ref(stats[c])));
+  ComputeRows_<T, TBDiv>(
+      x, x_begin, 0, n_x / n_chunks, y, y_begin, columns, out, stats[0]);
+  for (size_t c = 0; c < threads.size(); c++)
+  {
+    threads[c].join();
+    TBDiv::Stats() += stats[c + 1];
+  }
+}
+
+}; // namespace
+}; // namespace
+
+#endif
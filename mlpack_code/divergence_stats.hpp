@@ -0,0 +1,66 @@
+/**
+ * @file bregman_mst/mlpack_code/divergence_stats.hpp
+ *
+ * Counts of the divergence evaluations. Every thread keeps its own
+ * counts for every divergence (see KLDivergence::Stats), so parallel
+ * searches share nothing, and the counts of several threads or searches
+ * are added up with operator+=. They are only kept in builds with
+ * BMST_STATS defined: otherwise BMST_COUNT expands to nothing and the
+ * divergences pay nothing for them.
+ */
+
+#ifndef BMST_DIVERGENCE_STATS_HPP_
+#define BMST_DIVERGENCE_STATS_HPP_
+
+#include <stddef.h>
+
+// counter += n, in builds with BMST_STATS only
+#ifdef BMST_STATS
+#define BMST_COUNT(counter, n) ((counter) += (n))
+#else
+#define BMST_COUNT(counter, n) ((void) 0)
+#endif
+
+namespace bmst {
+
+#ifdef BMST_STATS
+const bool kStatsEnabled = true;
+#else
+const bool kStatsEnabled = false;
+#endif
+
+class DivergenceStats
+{
+public:
+  // The calls to BDivergence, Gradient, GradientConjugate and 
+  // JBDivergence
+  size_t bdiv;
+  size_t grad;
+  size_t grad_con;
+  size_t jbdiv;
+  // The bisections of BregmanBall::CanPruneRight and their steps (each 
+  // one a conjugate gradient and two divergences)
+  size_t bisections;
+  size_t bisection_steps;
+
+  DivergenceStats();
+
+  void Reset();
+
+  DivergenceStats& operator+=(const DivergenceStats& other);
+  DivergenceStats& operator-=(const DivergenceStats& other);
+
+}; // class
+
+DivergenceStats operator-(
+    const DivergenceStats& lhs, const DivergenceStats& rhs);
+
+// The counts of the calling thread for the divergence TBDiv
+template <class TBDiv>
+DivergenceStats& ThreadStats();
+
+}; // namespace
+
+#include "divergence_stats_impl.hpp"
+
+#endif
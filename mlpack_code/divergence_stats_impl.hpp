@@ -0,0 +1,70 @@
+/**
+ * @file bregman_mst/mlpack_code/divergence_stats_impl.hpp
+ *
+ * Implementation of the functions defined in divergence_stats.hpp
+ */
+
+#ifndef BMST_DIVERGENCE_STATS_IMPL_HPP_
+#define BMST_DIVERGENCE_STATS_IMPL_HPP_
+
+#include "divergence_stats.hpp"
+
+namespace bmst {
+
+inline DivergenceStats::DivergenceStats()
+{
+  Reset();
+}
+
+inline void DivergenceStats::Reset()
+{
+  bdiv = 0;
+  grad = 0;
+  grad_con = 0;
+  jbdiv = 0;
+  bisections = 0;
+  bisection_steps = 0;
+}
+
+inline DivergenceStats& DivergenceStats::operator+=(
+    const DivergenceStats& other)
+{
+  bdiv += other.bdiv;
+  grad += other.grad;
+  grad_con += other.grad_con;
+  jbdiv += other.jbdiv;
+  bisections += other.bisections;
+  bisection_steps += other.bisection_steps;
+  return *this;
+}
+
+inline DivergenceStats& DivergenceStats::operator-=(
+    const DivergenceStats& other)
+{
+  bdiv -= other.bdiv;
+  grad -= other.grad;
+  grad_con -= other.grad_con;
+  jbdiv -= other.jbdiv;
+  bisections -= other.bisections;
+  bisection_steps -= other.bisection_steps;
+  return *this;
+}
+
+inline DivergenceStats operator-(
+    const DivergenceStats& lhs, const DivergenceStats& rhs)
+{
+  DivergenceStats difference(lhs);
+  difference -= rhs;
+  return difference;
+}
+
+template <class TBDiv>
+DivergenceStats& ThreadStats()
+{
+  static thread_local DivergenceStats stats;
+  return stats;
+}
+
+}; // namespace
+
+#endif
@@ -29,23 +29,39 @@ private:
 
 public:
   EnhancedBregmanBall();
-  EnhancedBregmanBall(const Point<T>& right_center, const double right_radius);
   EnhancedBregmanBall(
-      const Point<T>& right_center, 
+      const ConstPointView<T>& right_center, const double right_radius);
+  EnhancedBregmanBall(
+      const ConstPointView<T>& right_center,
       const double right_radius, 
-      const Point<T>& left_center, 
+      const ConstPointView<T>& left_center,
       const double left_radius);
+  // The ball of centroids whose gradients are already known
+  EnhancedBregmanBall(
+      const ConstPointView<T>& right_center,
+      const ConstPointView<T>& right_center_prime,
+      const double right_radius, 
+      const ConstPointView<T>& left_center,
+      const ConstPointView<T>& left_center_prime,
+      const double left_radius,
+      const size_t component);
   
   ~EnhancedBregmanBall();
   
   // Add extra stats from the data if wanted
   // In EnhancedBregmanBall, we compute l2_radius_ and nothing is done here
-  void AddExtraStats(const Table<T>& data, const size_t start, const size_t end);
+  template <class TTable>
+  void AddExtraStats(const TTable& data, const size_t start, const size_t end);
+
+  // l2_radius_ and jbdiv_radius_
+  static const size_t kNumExtraStats = 2;
+  void GetExtraStats(double* stats) const;
+  void SetExtraStats(const double* stats);
 
   // Pruning rule for a single query
   bool CanPruneRight(
-      const Point<T>& q, 
-      const Point<T>& q_prime,
+      const ConstPointView<T>& q,
+      const ConstPointView<T>& q_prime,
       const double q_div_to_best_candidate) const;
   
 }; // class
@@ -21,32 +21,62 @@ EnhancedBregmanBall<T, TBDiv>::EnhancedBregmanBall() :
 
 template <typename T, class TBDiv>
 EnhancedBregmanBall<T, TBDiv>::EnhancedBregmanBall(
-    const Point<T>& right_center, const double right_radius) :
+    const ConstPointView<T>& right_center, const double right_radius) :
   TBase(right_center, right_radius)
 {}
 
 template <typename T, class TBDiv>
 EnhancedBregmanBall<T, TBDiv>::EnhancedBregmanBall(
-    const Point<T>& right_center, 
+    const ConstPointView<T>& right_center,
     const double right_radius, 
-    const Point<T>& left_center, 
+    const ConstPointView<T>& left_center,
     const double left_radius) :
   TBase(right_center, right_radius, left_center, left_radius)
 {}
 
+template <typename T, class TBDiv>
+EnhancedBregmanBall<T, TBDiv>::EnhancedBregmanBall(
+    const ConstPointView<T>& right_center,
+    const ConstPointView<T>& right_center_prime,
+    const double right_radius, 
+    const ConstPointView<T>& left_center,
+    const ConstPointView<T>& left_center_prime,
+    const double left_radius,
+    const size_t component) :
+  TBase(right_center, right_center_prime, right_radius, 
+      left_center, left_center_prime, left_radius, component),
+  l2_radius_(0),
+  jbdiv_radius_(0)
+{}
+
 template <typename T, class TBDiv>
 EnhancedBregmanBall<T, TBDiv>::~EnhancedBregmanBall()
 {}
 
 template <typename T, class TBDiv>
+void EnhancedBregmanBall<T, TBDiv>::GetExtraStats(double* stats) const
+{
+  stats[0] = l2_radius_;
+  stats[1] = jbdiv_radius_;
+}
+
+template <typename T, class TBDiv>
+void EnhancedBregmanBall<T, TBDiv>::SetExtraStats(const double* stats)
+{
+  l2_radius_ = stats[0];
+  jbdiv_radius_ = stats[1];
+}
+
+template <typename T, class TBDiv>
+template <class TTable>
 void EnhancedBregmanBall<T, TBDiv>::AddExtraStats(
-    const Table<T>& data, const size_t start, const size_t end)
+    const TTable& data, const size_t start, const size_t end)
 {
   double max_sq_l2_dist = 0;
   double max_sq_jbdiv = 0;
   for (size_t i = 0; i < data.n_points(); ++i) {
     assert(TBase::right_centroid_.n_dims() == data[i].n_dims());
-    double sq_l2_dist = L2Divergence<T>::BDivergence(data[i], TBase::right_centroid_);
+    double sq_l2_dist = L2Divergence<T, TBDiv::kDims>::BDivergence(data[i], TBase::right_centroid_);
     if (sq_l2_dist > max_sq_l2_dist)
       max_sq_l2_dist = sq_l2_dist;
     double sq_jbdiv = TBDiv::JBDivergence(data[i], TBase::right_centroid_);
@@ -62,12 +92,14 @@ void EnhancedBregmanBall<T, TBDiv>::AddExtraStats(
 
 template<typename T, class TBDiv>
 bool EnhancedBregmanBall<T, TBDiv>::CanPruneRight(
-    const Point<T>& q, const Point<T>& q_prime, const double q_div_to_best_candidate) const
+    const ConstPointView<T>& q,
+    const ConstPointView<T>& q_prime,
+    const double q_div_to_best_candidate) const
 {
   // try pruning using strong convexity
   if (TBDiv::StrongConvexityCoefficient() > 0) 
   {
-    const double l2_q_mu = std::sqrt(L2Divergence<T>::BDivergence(q, TBase::right_centroid_));
+    const double l2_q_mu = std::sqrt(L2Divergence<T, TBDiv::kDims>::BDivergence(q, TBase::right_centroid_));
     if (l2_q_mu > l2_radius_) 
     {
       const double diff = l2_q_mu - l2_radius_;
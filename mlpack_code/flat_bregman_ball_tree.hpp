@@ -0,0 +1,192 @@
+/**
+ * @file bregman_mst/mlpack_code/flat_bregman_ball_tree.hpp
+ *
+ * A compact layout of a BregmanBallTree: the nodes sit in one array in
+ * depth-first (pre-)order, so that the left child of a node is the next
+ * node and the right child is addressed by its index, and the centroids
+ * and their gradients of all the nodes sit in aligned tables (one row
+ * per node) next to the array. A traversal walks down the array instead
+ * of following a pointer to every node and to the four points of its
+ * ball, and the whole index takes a handful of allocations.
+ *
+ * The nodes hold no pointers: the tree gives their children, centroids
+ * and bounds (Left(node), RCenter(node), Bound(node), ...), as
+ * BregmanBallTree does, so the searches run on either layout (see
+ * LeftNNSearch and MinimumSpanningTree). Their bounds are BregmanBall
+ * views of the rows: the extra stats of other balls (e.g.
+ * EnhancedBregmanBall) are not kept. A tree index file has the same
+ * layout, so that the tables of a loaded tree are the mapped file.
+ */
+
+#ifndef BMST_FLAT_BREGMAN_BALL_TREE_HPP_
+#define BMST_FLAT_BREGMAN_BALL_TREE_HPP_
+
+#include <limits>
+#include <vector>
+
+#include "bregman_ball.hpp"
+#include "bregman_ball_tree.hpp"
+#include "data.hpp"
+#include "tree_io.hpp"
+
+namespace bmst {
+
+template <typename T, class TBDiv, class TSplitter>
+class FlatBregmanBallTree
+{
+public:
+  typedef FlatBregmanBallTree<T, TBDiv, TSplitter> TFlatTree;
+  // the bound of a node, on the rows of the tables
+  typedef BregmanBall<T, TBDiv, ConstPointView<T> > TBBall;
+
+  // A node holds its range, the index of its right child and its radii;
+  // its children and centroids are reached through the tree (Left(node),
+  // RCenter(node), ...), so that the array holds no pointers
+  class Node
+  {
+  private:
+    friend class FlatBregmanBallTree<T, TBDiv, TSplitter>;
+
+    // Indices into the data set
+    int begin_;
+    int count_;
+    // the index of the right child (the left one is the next node), 0
+    // for a leaf
+    int right_;
+    double right_radius_;
+    double left_radius_;
+    size_t component_;
+
+  public:
+    // Tree info accessors
+    bool IsLeaf() const { return right_ == 0; }
+    const int Begin() const { return begin_; }
+    const int End() const { return begin_ + count_; }
+    const int Count() const { return count_; }
+
+    // node statistic accessors
+    const double RRadius() const { return right_radius_; }
+    const double LRadius() const { return left_radius_; }
+
+    // the component of the points of the node in MinimumSpanningTree
+    const size_t Component() const { return component_; }
+    void SetComponent(const size_t comp) { component_ = comp; }
+  }; // class Node
+
+  typedef Node TNode;
+
+private:
+  // the nodes in depth-first order, the root first
+  std::vector<Node> nodes_;
+
+  // the centroids of the balls of the nodes and their gradients, one row
+  // per node
+  Table<T> right_centroids_;
+  Table<T> right_centroid_primes_;
+  Table<T> left_centroids_;
+  Table<T> left_centroid_primes_;
+
+  template <class TBBTree>
+  void Flatten(const TBBTree& tree);
+
+public:
+  // Builds a BregmanBallTree over the data (see its initializer) and
+  // flattens it
+  template <class TTable>
+  FlatBregmanBallTree(
+      TTable& data,
+      std::vector<size_t>& old_from_new,
+      const size_t leaf_size = 10,
+      const double min_ball_width = 0,
+      const TreeBuildOptions& options = TreeBuildOptions());
+
+  // Loads a tree index (see tree_io.hpp): the nodes are copied, and the
+  // centroids are the rows of the mapped file. The points are 
+  // index.Data() and the permutation index.OldFromNew().
+  FlatBregmanBallTree(const TreeIndex<T>& index);
+
+  // Flattens a tree (of any ball)
+  template <class TBall>
+  FlatBregmanBallTree(
+      const BregmanBallTree<T, TBDiv, TBall, TSplitter>& tree);
+
+  Node* Root() { return &nodes_[0]; }
+  const Node* Root() const { return &nodes_[0]; }
+
+  size_t n_nodes() const { return nodes_.size(); }
+
+  // The bytes taken by the nodes and their centroids
+  size_t Bytes() const;
+
+  // The accessors of the nodes, as the ones of BregmanBallTree (see 
+  // BregmanBallTree::Left(node))
+  Node* Left(const Node* node) const
+  {
+    return node->IsLeaf() ? NULL : const_cast<Node*>(node + 1);
+  }
+  Node* Right(const Node* node) const
+  {
+    return node->IsLeaf() ? NULL : 
+      const_cast<Node*>(nodes_.data() + node->right_);
+  }
+  ConstPointView<T> RCenter(const Node* node) const
+  {
+    return right_centroids_[node - nodes_.data()];
+  }
+  ConstPointView<T> LCenter(const Node* node) const
+  {
+    return left_centroids_[node - nodes_.data()];
+  }
+  TBBall Bound(const Node* node) const;
+
+  // Pruning functions, as the ones of BregmanBallTree, with the gradient
+  // q_prime of q
+  bool CanPruneRight(
+      const Node* node,
+      const ConstPointView<T>& q,
+      const ConstPointView<T>& q_prime,
+      const double q_div_to_best_candidate,
+      const double div_to_center = std::numeric_limits<double>::max())
+    const;
+
+  bool CanPruneLeft(
+      const Node* node,
+      const ConstPointView<T>& q,
+      const double q_div_to_best_candidate,
+      const double div_to_center = std::numeric_limits<double>::max())
+    const;
+
+  bool CanPruneRight(
+      const Node* node,
+      const Node* other_node,
+      const double node_max_div_to_best_candidate,
+      const double node_div_to_center =
+        std::numeric_limits<double>::max()) const;
+
+  bool CanPruneLeft(
+      const Node* node,
+      const Node* other_node,
+      const double node_max_div_to_best_candidate,
+      const double center_div_to_node =
+        std::numeric_limits<double>::max()) const;
+
+  // The root's accessors, as for BregmanBallTree
+  bool IsLeaf() const { return Root()->IsLeaf(); }
+  Node* Left() const { return Left(Root()); }
+  Node* Right() const { return Right(Root()); }
+  const int Begin() const { return Root()->Begin(); }
+  const int End() const { return Root()->End(); }
+  const int Count() const { return Root()->Count(); }
+  ConstPointView<T> RCenter() const { return RCenter(Root()); }
+  const double RRadius() const { return Root()->RRadius(); }
+  ConstPointView<T> LCenter() const { return LCenter(Root()); }
+  const double LRadius() const { return Root()->LRadius(); }
+  TBBall Bound() const { return Bound(Root()); }
+
+}; // class
+
+} // namespace
+
+#endif
+
+#include "flat_bregman_ball_tree_impl.hpp"
@@ -0,0 +1,212 @@
+/**
+ * @file bregman_mst/mlpack_code/flat_bregman_ball_tree_impl.hpp
+ *
+ * Implementation of the functions defined in flat_bregman_ball_tree.hpp
+ */
+
+#ifndef BMST_FLAT_BREGMAN_BALL_TREE_IMPL_HPP_
+#define BMST_FLAT_BREGMAN_BALL_TREE_IMPL_HPP_
+
+#include <algorithm>
+#include <utility>
+
+#include "flat_bregman_ball_tree.hpp"
+
+namespace bmst {
+
+template <typename T, class TBDiv, class TSplitter>
+template <class TTable>
+FlatBregmanBallTree<T, TBDiv, TSplitter>::FlatBregmanBallTree(
+    TTable& data,
+    std::vector<size_t>& old_from_new,
+    const size_t leaf_size,
+    const double min_ball_width,
+    const TreeBuildOptions& options)
+{
+  const BregmanBallTree<T, TBDiv, BregmanBall<T, TBDiv>, TSplitter> tree(
+      data, old_from_new, leaf_size, min_ball_width, options);
+  Flatten(tree);
+}
+
+template <typename T, class TBDiv, class TSplitter>
+FlatBregmanBallTree<T, TBDiv, TSplitter>::FlatBregmanBallTree(
+    const TreeIndex<T>& index) :
+  nodes_(index.n_nodes()),
+  right_centroids_(index.RightCentroids()),
+  right_centroid_primes_(index.RightCentroidPrimes()),
+  left_centroids_(index.LeftCentroids()),
+  left_centroid_primes_(index.LeftCentroidPrimes())
+{
+  for (size_t index_node = 0; index_node < nodes_.size(); index_node++)
+  {
+    const TreeFileNode& file_node = index.Node(index_node);
+    Node& node = nodes_[index_node];
+    node.begin_ = file_node.begin;
+    node.count_ = file_node.count;
+    node.right_ = file_node.right;
+    node.right_radius_ = file_node.right_radius;
+    node.left_radius_ = file_node.left_radius;
+    node.component_ = -1;
+  }
+}
+
+template <typename T, class TBDiv, class TSplitter>
+template <class TBall>
+FlatBregmanBallTree<T, TBDiv, TSplitter>::FlatBregmanBallTree(
+    const BregmanBallTree<T, TBDiv, TBall, TSplitter>& tree)
+{
+  Flatten(tree);
+}
+
+template <typename T, class TBDiv, class TSplitter>
+template <class TBBTree>
+void FlatBregmanBallTree<T, TBDiv, TSplitter>::Flatten(const TBBTree& tree)
+{
+  // count the nodes first, to allocate the tables once
+  size_t n_nodes = 0;
+  std::vector<const TBBTree*> node_stack(1, &tree);
+  while (not node_stack.empty())
+  {
+    const TBBTree* node = node_stack.back();
+    node_stack.pop_back();
+    n_nodes++;
+    if (not node->IsLeaf())
+    {
+      node_stack.push_back(node->Right());
+      node_stack.push_back(node->Left());
+    }
+  }
+
+  const size_t n_dims = tree.RCenter().n_dims();
+  nodes_.resize(n_nodes);
+  right_centroids_ = Table<T>(n_nodes, n_dims);
+  right_centroid_primes_ = Table<T>(n_nodes, n_dims);
+  left_centroids_ = Table<T>(n_nodes, n_dims);
+  left_centroid_primes_ = Table<T>(n_nodes, n_dims);
+
+  // the nodes in depth-first order, with the index of the parent of the
+  // right children to set its right_
+  std::vector<std::pair<const TBBTree*, size_t> > stack(
+      1, std::make_pair(&tree, (size_t) 0));
+  for (size_t index = 0; index < n_nodes; index++)
+  {
+    const TBBTree* node = stack.back().first;
+    const size_t parent = stack.back().second;
+    stack.pop_back();
+    // every right child comes after the subtree of its left sibling
+    if (index > 0 and parent != index - 1)
+      nodes_[parent].right_ = index;
+
+    Node& flat_node = nodes_[index];
+    flat_node.begin_ = node->Begin();
+    flat_node.count_ = node->Count();
+    flat_node.right_ = 0;
+    flat_node.right_radius_ = node->RRadius();
+    flat_node.left_radius_ = node->LRadius();
+    flat_node.component_ = node->Bound().Component();
+    const auto& ball = node->Bound();
+    std::copy(ball.right_centroid().values(),
+        ball.right_centroid().values() + n_dims,
+        right_centroids_[index].values());
+    std::copy(ball.right_centroid_prime().values(),
+        ball.right_centroid_prime().values() + n_dims,
+        right_centroid_primes_[index].values());
+    std::copy(ball.left_centroid().values(),
+        ball.left_centroid().values() + n_dims,
+        left_centroids_[index].values());
+    std::copy(ball.left_centroid_prime().values(),
+        ball.left_centroid_prime().values() + n_dims,
+        left_centroid_primes_[index].values());
+
+    if (not node->IsLeaf())
+    {
+      stack.push_back(std::make_pair(node->Right(), index));
+      stack.push_back(std::make_pair(node->Left(), index));
+    }
+  }
+}
+
+template <typename T, class TBDiv, class TSplitter>
+size_t FlatBregmanBallTree<T, TBDiv, TSplitter>::Bytes() const
+{
+  return nodes_.size() * sizeof(Node) + 4 * right_centroids_.n_points() *
+    Table<T>::Stride(right_centroids_.n_dims()) * sizeof(T);
+}
+
+template <typename T, class TBDiv, class TSplitter>
+typename FlatBregmanBallTree<T, TBDiv, TSplitter>::TBBall
+FlatBregmanBallTree<T, TBDiv, TSplitter>::Bound(const Node* node) const
+{
+  const size_t index = node - nodes_.data();
+  return TBBall(
+      right_centroids_[index],
+      right_centroid_primes_[index],
+      node->right_radius_,
+      left_centroids_[index],
+      left_centroid_primes_[index],
+      node->left_radius_,
+      node->component_);
+}
+
+template <typename T, class TBDiv, class TSplitter>
+bool FlatBregmanBallTree<T, TBDiv, TSplitter>::CanPruneRight(
+    const Node* node,
+    const ConstPointView<T>& q,
+    const ConstPointView<T>& q_prime,
+    const double q_div_to_best_candidate,
+    const double q_div_to_center) const
+{
+  if (q_div_to_center == std::numeric_limits<double>::max())
+    return Bound(node).CanPruneRight(q, q_prime, q_div_to_best_candidate);
+  return Bound(node).CanPruneRight(
+      q, q_prime, q_div_to_best_candidate, q_div_to_center);
+}
+
+template <typename T, class TBDiv, class TSplitter>
+bool FlatBregmanBallTree<T, TBDiv, TSplitter>::CanPruneLeft(
+    const Node* node,
+    const ConstPointView<T>& q,
+    const double q_div_to_best_candidate,
+    const double q_div_to_center) const
+{
+  if (q_div_to_center == std::numeric_limits<double>::max())
+    return Bound(node).CanPruneLeft(q, q_div_to_best_candidate);
+  return Bound(node).CanPruneLeft(
+      q, q_div_to_best_candidate, q_div_to_center);
+}
+
+template <typename T, class TBDiv, class TSplitter>
+bool FlatBregmanBallTree<T, TBDiv, TSplitter>::CanPruneRight(
+    const Node* node,
+    const Node* other_node,
+    const double node_max_div_to_best_candidate,
+    const double node_div_to_center) const
+{
+  // node_div_to_center = d(LCenter of other_node, RCenter of node)
+  const double centers_div =
+    (node_div_to_center == std::numeric_limits<double>::max()) ?
+    TBDiv::BDivergence(LCenter(other_node), RCenter(node)) : 
+    node_div_to_center;
+  return Bound(node).CanPruneRight(
+      Bound(other_node), node_max_div_to_best_candidate, centers_div);
+}
+
+template <typename T, class TBDiv, class TSplitter>
+bool FlatBregmanBallTree<T, TBDiv, TSplitter>::CanPruneLeft(
+    const Node* node,
+    const Node* other_node,
+    const double node_max_div_to_best_candidate,
+    const double center_div_to_node) const
+{
+  // center_div_to_node = d(LCenter of node, RCenter of other_node)
+  const double centers_div =
+    (center_div_to_node == std::numeric_limits<double>::max()) ?
+    TBDiv::BDivergence(LCenter(node), RCenter(other_node)) : 
+    center_div_to_node;
+  return Bound(node).CanPruneLeft(
+      Bound(other_node), node_max_div_to_best_candidate, centers_div);
+}
+
+} // namespace
+
+#endif
@@ -6,24 +6,85 @@
 #ifndef BMST_KMEANS_SPLITTER_HPP_
 #define BMST_KMEANS_SPLITTER_HPP_
 
+#include <algorithm>
+#include <random>
 #include <vector>
 
 #include "data.hpp"
 
 namespace bmst {
 
+// The passes over the points of KMeansSplitter go through blocks of 
+// this many points
+const size_t kKMeansBlockPoints = 4096;
+
+// The passes of the splitters (KMeansSplitter, SampledKMeansSplitter and
+// the projection splitters) over the points of a node, and their
+// sampling
+
+// Draws sample_size of the indices in [begin_index, end_index) without
+// replacement (Floyd's algorithm), in increasing order; all of them if
+// there are at most sample_size
+inline void SampleRange(
+    const size_t begin_index,
+    const size_t end_index,
+    const size_t sample_size,
+    std::default_random_engine& gen,
+    std::vector<size_t>& sample);
+
+// Moves every center to the mean of its points (the ones of 
+// [begin_index, end_index), membership[i - begin_index] being the center
+// of point i); the centers without points stay where they are. The 
+// points are summed block by block (see KMeansSplitter::SetThreads).
+template <typename T, class TTable>
+void MeanCenters(
+    const TTable& data,
+    const size_t begin_index,
+    const size_t end_index,
+    const std::vector<size_t>& membership,
+    const size_t n_threads,
+    std::vector<Point<T> >& centers);
+
+// The radius of every center: the largest divergence (plus its error
+// bound) of its points to it
+template <class TBregmanDiv, typename T, class TTable>
+void CenterRadii(
+    const TTable& data,
+    const size_t begin_index,
+    const size_t end_index,
+    const std::vector<size_t>& membership,
+    const std::vector<Point<T> >& centers,
+    const size_t n_threads,
+    std::vector<double>& radii);
+
 template <typename T, class TBregmanDiv>
 class KMeansSplitter
 {
 private:
   size_t k_;
   size_t max_iterations_;
+  unsigned seed_;
+  size_t n_threads_;
 
 public:
   KMeansSplitter(const size_t k = 2, const size_t max_iters = 10000);
 
+  // The seed of the first center, so that the same seed gives the same
+  // split; 0 (the default) draws it from std::random_device
+  void SetSeed(const unsigned seed) { seed_ = seed; }
+
+  // The threads of the passes over the points (1 by default). The sums
+  // over the points are added up block by block in order, so that any 
+  // number of threads gives the same split.
+  void SetThreads(const size_t n_threads) 
+  { 
+    n_threads_ = std::max((size_t) 1, n_threads); 
+  }
+
+  // TTable is Table<T> or SparseTable<T>
+  template <class TTable>
   void PartitionData(
-      const Table<T>& data,
+      const TTable& data,
       const size_t begin_index,
       const size_t end_index,
       std::vector<size_t>& membership,
@@ -9,19 +9,138 @@
 
 #include <random>
 #include <set>
+#include <unordered_set>
+
+#include "parallel.hpp"
 
 namespace bmst {
 
+inline void SampleRange(
+    const size_t begin_index,
+    const size_t end_index,
+    const size_t sample_size,
+    std::default_random_engine& gen,
+    std::vector<size_t>& sample)
+{
+  const size_t n_points = end_index - begin_index;
+  sample.resize(0);
+  if (n_points <= sample_size)
+  {
+    for (size_t i = begin_index; i < end_index; i++)
+      sample.push_back(i);
+    return;
+  }
+  std::unordered_set<size_t> picked;
+  for (size_t j = n_points - sample_size; j < n_points; j++)
+  {
+    const size_t t = std::uniform_int_distribution<size_t>(0, j)(gen);
+    if (not picked.insert(t).second)
+      picked.insert(j);
+  }
+  for (const size_t i : picked)
+    sample.push_back(begin_index + i);
+  std::sort(sample.begin(), sample.end());
+}
+
+template <typename T, class TTable>
+void MeanCenters(
+    const TTable& data,
+    const size_t begin_index,
+    const size_t end_index,
+    const std::vector<size_t>& membership,
+    const size_t n_threads,
+    std::vector<Point<T> >& centers)
+{
+  const size_t k = centers.size();
+  const size_t n_dims = data[begin_index].n_dims();
+  const size_t n_blocks =
+    (end_index - begin_index + kKMeansBlockPoints - 1) / kKMeansBlockPoints;
+  std::vector<std::vector<Point<T> > > block_sums(n_blocks);
+  std::vector<std::vector<double> > block_counts(n_blocks);
+  ParallelFor(n_blocks, n_threads, [&](const size_t block)
+  {
+    const size_t block_begin = begin_index + block * kKMeansBlockPoints;
+    const size_t block_end = 
+      std::min(end_index, block_begin + kKMeansBlockPoints);
+    std::vector<Point<T> >& sums = block_sums[block];
+    sums.resize(k);
+    for (size_t j = 0; j < k; j++)
+      sums[j].zeros(n_dims);
+    block_counts[block].assign(k, 0);
+    for (size_t i = block_begin; i < block_end; i++)
+    {
+      sums[membership[i - begin_index]] += data[i];
+      block_counts[block][membership[i - begin_index]]++;
+    }
+  });
+  // added up in the order of the blocks, for any number of threads
+  Point<T> sum;
+  for (size_t j = 0; j < k; j++)
+  {
+    double count = 0;
+    sum.zeros(n_dims);
+    for (size_t block = 0; block < n_blocks; block++)
+    {
+      sum += block_sums[block][j];
+      count += block_counts[block][j];
+    }
+    if (count > 0)
+    {
+      centers[j] = sum;
+      centers[j] /= count;
+    }
+  }
+}
+
+template <class TBregmanDiv, typename T, class TTable>
+void CenterRadii(
+    const TTable& data,
+    const size_t begin_index,
+    const size_t end_index,
+    const std::vector<size_t>& membership,
+    const std::vector<Point<T> >& centers,
+    const size_t n_threads,
+    std::vector<double>& radii)
+{
+  const size_t k = centers.size();
+  const size_t n_blocks =
+    (end_index - begin_index + kKMeansBlockPoints - 1) / kKMeansBlockPoints;
+  std::vector<std::vector<double> > block_radii(n_blocks);
+  ParallelFor(n_blocks, n_threads, [&](const size_t block)
+  {
+    const size_t block_begin = begin_index + block * kKMeansBlockPoints;
+    const size_t block_end = 
+      std::min(end_index, block_begin + kKMeansBlockPoints);
+    block_radii[block].assign(k, 0);
+    for (size_t i = block_begin; i < block_end; i++)
+    {
+      size_t j = membership[i - begin_index];
+      double div_to_center = TBregmanDiv::BDivergence(data[i], centers[j]);
+      div_to_center += TBregmanDiv::BDivergenceError(
+          data[i], centers[j], div_to_center);
+      if (div_to_center > block_radii[block][j])
+        block_radii[block][j] = div_to_center;
+    }
+  });
+  radii.assign(k, 0);
+  for (size_t block = 0; block < n_blocks; block++)
+    for (size_t j = 0; j < k; j++)
+      radii[j] = std::max(radii[j], block_radii[block][j]);
+}
+
 template<typename T, class TBregmanDiv>
 KMeansSplitter<T, TBregmanDiv>::KMeansSplitter(
     const size_t k, const size_t max_iters) :
   k_(k),
-  max_iterations_(max_iters)
+  max_iterations_(max_iters),
+  seed_(0),
+  n_threads_(1)
 {}
 
 template<typename T, class TBregmanDiv>
+template<class TTable>
 void KMeansSplitter<T, TBregmanDiv>::PartitionData(
-    const Table<T>& data,
+    const TTable& data,
     const size_t begin_index,
     const size_t end_index,
     std::vector<size_t>& membership,
@@ -37,12 +156,22 @@ void KMeansSplitter<T, TBregmanDiv>::PartitionData(
   }
   // initialize the centers and such
   membership.resize(end_index - begin_index);
-  size_t n_dims = data[begin_index].n_dims();
   // pick k_ random points and make them centers
   centers.resize(0);
+  // the passes over the points go block by block (see SetThreads)
+  const size_t n_blocks = 
+    (end_index - begin_index + kKMeansBlockPoints - 1) / kKMeansBlockPoints;
+  auto block_begin = [&](const size_t block) 
+  { 
+    return begin_index + block * kKMeansBlockPoints; 
+  };
+  auto block_end = [&](const size_t block) 
+  { 
+    return std::min(end_index, block_begin(block) + kKMeansBlockPoints);
+  };
   // first a random point to be the first center
-  std::random_device rd;
-  std::default_random_engine gen(rd());
+  std::default_random_engine gen(
+      seed_ != 0 ? seed_ : std::random_device()());
   std::uniform_int_distribution<size_t> urand(begin_index, end_index - 1);
   std::set<size_t> points_already_picked;
   size_t first_point = urand(gen);
@@ -51,23 +180,42 @@ void KMeansSplitter<T, TBregmanDiv>::PartitionData(
   std::vector<double> div_to_closest_mean(
       end_index - begin_index, std::numeric_limits<double>::max());
   div_to_closest_mean[first_point - begin_index] = 0;
+  std::vector<double> block_max_divs(n_blocks);
+  std::vector<size_t> block_max_indices(n_blocks);
   for (size_t j = 1; j < k_; j++) 
   {
     // compute distances to the previous center
     // and also keep track of the point with the largest div
-    double max_div_to_closest_center = 0;
-    size_t max_index = end_index;
-    for (size_t i = begin_index; i < end_index; i++) 
+    ParallelFor(n_blocks, n_threads_, [&](const size_t block)
     {
-      double div_to_center = TBregmanDiv::BDivergence(data[i], centers[j - 1]);
-      if (div_to_center < div_to_closest_mean[i - begin_index])
+      double max_div_to_closest_center = 0;
+      size_t max_index = end_index;
+      for (size_t i = block_begin(block); i < block_end(block); i++) 
       {
-        div_to_closest_mean[i - begin_index] = div_to_center;
+        double div_to_center = 
+          TBregmanDiv::BDivergence(data[i], centers[j - 1]);
+        if (div_to_center < div_to_closest_mean[i - begin_index])
+        {
+          div_to_closest_mean[i - begin_index] = div_to_center;
+        }
+        if (div_to_closest_mean[i - begin_index] > max_div_to_closest_center)
+        {
+          max_div_to_closest_center = div_to_closest_mean[i - begin_index];
+          max_index = i;
+        }
       }
-      if (div_to_closest_mean[i - begin_index] > max_div_to_closest_center)
+      block_max_divs[block] = max_div_to_closest_center;
+      block_max_indices[block] = max_index;
+    });
+    // the first of the farthest points, as a single pass would find
+    double max_div_to_closest_center = 0;
+    size_t max_index = end_index;
+    for (size_t block = 0; block < n_blocks; block++)
+    {
+      if (block_max_divs[block] > max_div_to_closest_center)
       {
-        max_div_to_closest_center = div_to_closest_mean[i - begin_index];
-        max_index = i;
+        max_div_to_closest_center = block_max_divs[block];
+        max_index = block_max_indices[block];
       }
     }
     assert(max_index >= begin_index);
@@ -99,7 +247,8 @@ void KMeansSplitter<T, TBregmanDiv>::PartitionData(
   // the re-assignment loop
   std::vector<size_t> old_membership;
   bool converged = false;
-  std::vector<double> cluster_counts(k_);
+  // the objective of every block
+  std::vector<double> block_objs(n_blocks);
   size_t num_iters = 0;
   double kmeans_obj;
   do
@@ -108,24 +257,35 @@ void KMeansSplitter<T, TBregmanDiv>::PartitionData(
     if (membership.size() == 0)
       membership.resize(end_index - begin_index);
 
-    kmeans_obj = 0;
-    for (size_t i = begin_index; i < end_index; i++)
+    ParallelFor(n_blocks, n_threads_, [&](const size_t block)
     {
-      double min_div = std::numeric_limits<double>::max();
-      size_t min_index = k_;
-      for (size_t j = 0; j < k_; j++)
+      double block_obj = 0;
+      for (size_t i = block_begin(block); i < block_end(block); i++)
       {
-        double div_to_center = TBregmanDiv::BDivergence(data[i], centers[j]);
-        if (div_to_center < min_div) 
+        // a point can be infinitely far from all the centers (e.g. with 
+        // the KL divergence, a sparse histogram and centers that are 
+        // still single points); such points go to the first center
+        double min_div = std::numeric_limits<double>::max();
+        size_t min_index = 0;
+        for (size_t j = 0; j < k_; j++)
         {
-          min_div = div_to_center;
-          min_index = j;
+          double div_to_center = 
+            TBregmanDiv::BDivergence(data[i], centers[j]);
+          if (div_to_center < min_div) 
+          {
+            min_div = div_to_center;
+            min_index = j;
+          }
         }
+        assert(min_index < k_);
+        membership[i - begin_index] = min_index;
+        block_obj += min_div;
       }
-      assert(min_index < k_);
-      membership[i - begin_index] = min_index;
-      kmeans_obj += min_div;
-    }
+      block_objs[block] = block_obj;
+    });
+    kmeans_obj = 0;
+    for (size_t block = 0; block < n_blocks; block++)
+      kmeans_obj += block_objs[block];
     // std::cout << "Obj: " << kmeans_obj << " @ iter " << 
     //   num_iters << std::endl;
 
@@ -152,20 +312,10 @@ void KMeansSplitter<T, TBregmanDiv>::PartitionData(
       }
     }
 
-    // compute the new means for the assignment
-    for (size_t j = 0; j < k_; j++)
-      centers[j].zeros();
-    cluster_counts.assign(k_, 0);
-
-    for (size_t i = begin_index; i < end_index; i++)
-    {
-      centers[membership[i - begin_index]] += data[i];
-      cluster_counts[membership[i - begin_index]]++;
-    }
-
-    for (size_t j = 0; j < k_; j++)
-      if (cluster_counts[j] > 0)
-        centers[j] /= cluster_counts[j];
+    // compute the new means for the assignment (the centers without
+    // points stay where they are)
+    MeanCenters(data, begin_index, end_index, membership, n_threads_, 
+        centers);
 
     old_membership.swap(membership);     
 
@@ -188,14 +338,8 @@ void KMeansSplitter<T, TBregmanDiv>::PartitionData(
       membership.swap(old_membership);
   }
   // compute the radii for each of the centers
-  radii.assign(k_, 0);
-  for (size_t i = begin_index; i < end_index; i++)
-  {
-    size_t j = membership[i - begin_index];
-    double div_to_center = TBregmanDiv::BDivergence(data[i], centers[j]);
-    if (div_to_center > radii[j])
-      radii[j] = div_to_center;
-  }
+  CenterRadii<TBregmanDiv>(data, begin_index, end_index, membership, 
+      centers, n_threads_, radii);
      
   return;
 } // PartitionData
@@ -1,30 +1,68 @@
 #ifndef BMST_LEFT_NN_SEARCH_HPP_
 #define BMST_LEFT_NN_SEARCH_HPP_
 
+#include <queue>
+#include <string>
+#include <utility>
+
 #include "bregman_ball_tree.hpp"
+#include "divergence_cache.hpp"
 #include "kmeans_splitter.hpp"
+#include "quantized_data.hpp"
+#include "sparse_data.hpp"
+#include "tree_io.hpp"
 
 namespace bmst {
 
-template<typename T, class TBDiv, class TBBall>
+// TTable is Table<T>, SparseTable<T> or QuantizedTable<T, Q>; the 
+// queries are dense. TTreeType is a BregmanBallTree over the balls 
+// TBBall, or its flat layout (see FlatBregmanBallTree, whose nodes only
+// keep BregmanBall bounds)
+template<typename T, class TBDiv, class TBBall, class TTable = Table<T>,
+  class TTreeType = 
+    BregmanBallTree<T, TBDiv, TBBall, KMeansSplitter<T, TBDiv> > >
 class LeftNNSearch {
 public:
   
-  LeftNNSearch(const Table<T>& data, const size_t leaf_size);
+  LeftNNSearch(const TTable& data, const size_t leaf_size);
+
+  // Starts from a prebuilt tree index (see tree_io.hpp) instead of 
+  // building the tree: the references are the mapped data of the index
+  // (dense tables only)
+  LeftNNSearch(const TreeIndex<T>& index);
   
   ~LeftNNSearch();
   
-  size_t ComputeNeighbor(const Point<T>& query);
+  size_t ComputeNeighbor(const ConstPointView<T>& query);
+
+  // Search the n_candidates nearest neighbors of the query in the 
+  // (quantized) table, and return the one nearest in full_data, the same 
+  // points at full precision in their original order (e.g. mapped with 
+  // MapBinaryTable, so that only the candidates are read from disk)
+  size_t ComputeNeighbor(
+      const ConstPointView<T>& query, 
+      const size_t n_candidates, 
+      const Table<T>& full_data);
   
-  size_t ComputeNeighborNaive(const Point<T>& query);
+  size_t ComputeNeighborNaive(const ConstPointView<T>& query);
+
+  // Write the tree, the references and their permutation as a tree 
+  // index (dense tables only)
+  void SaveIndex(const std::string& file_name) const;
+
+  // ComputeNeighborNaive for all the queries, from the divergence 
+  // matrices of the references to blocks of queries computed by n_threads
+  // threads (dense tables only)
+  void ComputeNeighborsNaive(
+      const Table<T>& queries, 
+      std::vector<size_t>& neighbors,
+      const size_t n_threads = 1);
   
 private:
   
-  typedef KMeansSplitter<T, TBDiv> TSplitter;
-  
-  typedef BregmanBallTree<T, TBDiv, TBBall, TSplitter> TTreeType;
+  typedef typename TTreeType::TNode TNode;
 
-  Table<T> data_;
+  TTable data_;
   
   TTreeType* tree_;
 
@@ -33,13 +71,38 @@ private:
   size_t neighbor_index_;
   double neighbor_distance_;
 
+  // the best n_candidates_ (divergence, index) pairs found so far, the 
+  // worst one on top; once there are n_candidates_ of them, 
+  // neighbor_distance_ is an upper bound on the exact divergence of the
+  // worst one (its computed divergence plus TBDiv::BDivergenceError, or
+  // plus the error of the closed form)
+  size_t n_candidates_;
+  std::priority_queue<std::pair<double, size_t> > candidates_;
+  // the number of candidates the storage of candidates_ was reserved for
+  size_t candidates_capacity_;
+
   std::vector<size_t> old_from_new_indices_;
+
+  // phi() and the norms of the (reordered) references
+  DivergenceCache<T, TBDiv> cache_;
+
+  // the gradient, offset() and error terms (see 
+  // DivergenceCache::ErrorScale) of the current query, if it has the 
+  // closed form; query_prime_ keeps its storage from one query to the 
+  // next, like candidates_, so that a search does not allocate
+  Point<T> query_prime_;
+  double query_offset_;
+  double query_dual_norm_;
+  double query_scale_;
+  bool query_closed_form_;
   
   // functions
+  void Search_(const ConstPointView<T>& query, const size_t n_candidates);
+
   void SearchNode_(
-      const TTreeType* node,
-      const Point<T>& query,
-      const Point<T>& query_prime,
+      const TNode* node,
+      const ConstPointView<T>& query,
+      const ConstPointView<T>& query_prime,
       const T d_q_to_centroid);
 }; // class
 
@@ -5,34 +5,93 @@
 
 namespace bmst {
 
-template<typename T, class TBDiv, class TBBall>
-LeftNNSearch<T, TBDiv, TBBall>::LeftNNSearch(
-    const Table<T>& data, const size_t leaf_size) :
+template<typename T, class TBDiv, class TBBall, class TTable, 
+  class TTreeType>
+LeftNNSearch<T, TBDiv, TBBall, TTable, TTreeType>::LeftNNSearch(
+    const TTable& data, const size_t leaf_size) :
   data_(data),
   leaf_size_(leaf_size),
   neighbor_index_(-1),
-  neighbor_distance_(std::numeric_limits<T>::max())
+  neighbor_distance_(std::numeric_limits<T>::max()),
+  n_candidates_(1),
+  candidates_capacity_(0)
 {
   tree_ = new TTreeType(data_, old_from_new_indices_, leaf_size_);
+  cache_ = DivergenceCache<T, TBDiv>(data_, false);
 }
 
-template<typename T, class TBDiv, class TBBall>
-LeftNNSearch<T, TBDiv, TBBall>::~LeftNNSearch()
+template<typename T, class TBDiv, class TBBall, class TTable, 
+  class TTreeType>
+LeftNNSearch<T, TBDiv, TBBall, TTable, TTreeType>::LeftNNSearch(
+    const TreeIndex<T>& index) :
+  data_(index.Data()),
+  leaf_size_(index.leaf_size()),
+  neighbor_index_(-1),
+  neighbor_distance_(std::numeric_limits<T>::max()),
+  n_candidates_(1),
+  candidates_capacity_(0)
+{
+  tree_ = new TTreeType(index);
+  index.OldFromNew(old_from_new_indices_);
+  cache_ = DivergenceCache<T, TBDiv>(data_, false);
+}
+
+template<typename T, class TBDiv, class TBBall, class TTable, 
+  class TTreeType>
+void LeftNNSearch<T, TBDiv, TBBall, TTable, TTreeType>::SaveIndex(
+    const std::string& file_name) const
+{
+  WriteTreeIndex(*tree_, data_, old_from_new_indices_, file_name, leaf_size_);
+}
+
+template<typename T, class TBDiv, class TBBall, class TTable, 
+  class TTreeType>
+LeftNNSearch<T, TBDiv, TBBall, TTable, TTreeType>::~LeftNNSearch()
 {
   if (tree_)
     delete tree_;
 }
 
-template<typename T, class TBDiv, class TBBall>
-size_t LeftNNSearch<T, TBDiv, TBBall>::ComputeNeighbor(const Point<T>& query) 
+template<typename T, class TBDiv, class TBBall, class TTable, 
+  class TTreeType>
+void LeftNNSearch<T, TBDiv, TBBall, TTable, TTreeType>::Search_(
+    const ConstPointView<T>& query, const size_t n_candidates)
 {
   neighbor_index_ = -1;
   neighbor_distance_ = std::numeric_limits<T>::max();
+  n_candidates_ = n_candidates;
+  // popping keeps the storage of the queue, which holds at most 
+  // n_candidates + 1 pairs
+  while (not candidates_.empty())
+    candidates_.pop();
+  if (n_candidates > candidates_capacity_)
+  {
+    std::vector<std::pair<double, size_t> > storage;
+    storage.reserve(n_candidates + 1);
+    candidates_ = std::priority_queue<std::pair<double, size_t> >(
+        std::less<std::pair<double, size_t> >(), std::move(storage));
+    candidates_capacity_ = n_candidates;
+  }
   
   const T dist_to_centroid = TBDiv::BDivergence(query, tree_->RCenter());
-  const Point<T> query_prime = TBDiv::Gradient(query);
+  TBDiv::Gradient(query, query_prime_);
+  query_closed_form_ = DivergenceCache<T, TBDiv>::Offset(
+      query, query_prime_, query_offset_);
+  if (query_closed_form_)
+    DivergenceCache<T, TBDiv>::ErrorScale(query, TBDiv::Phi(query), 
+        query_prime_, query_dual_norm_, query_scale_);
   
-  SearchNode_(tree_, query, query_prime, dist_to_centroid);
+  SearchNode_(tree_->Root(), query, query_prime_, dist_to_centroid);
+}
+
+template<typename T, class TBDiv, class TBBall, class TTable, 
+  class TTreeType>
+size_t LeftNNSearch<T, TBDiv, TBBall, TTable, TTreeType>::ComputeNeighbor(
+    const ConstPointView<T>& query)
+{
+  Search_(query, 1);
+  if (not candidates_.empty())
+    neighbor_index_ = candidates_.top().second;
   
   if (neighbor_index_ == -1) {
     assert(neighbor_distance_ == std::numeric_limits<T>::max());
@@ -44,8 +103,43 @@ size_t LeftNNSearch<T, TBDiv, TBBall>::ComputeNeighbor(const Point<T>& query)
   }
 }
 
-template<typename T, class TBDiv, class TBBall>
-size_t LeftNNSearch<T, TBDiv, TBBall>::ComputeNeighborNaive(const Point<T>& query)
+template<typename T, class TBDiv, class TBBall, class TTable, 
+  class TTreeType>
+size_t LeftNNSearch<T, TBDiv, TBBall, TTable, TTreeType>::ComputeNeighbor(
+    const ConstPointView<T>& query, 
+    const size_t n_candidates, 
+    const Table<T>& full_data)
+{
+  if (full_data.n_points() != data_.n_points() 
+      or full_data.n_dims() != data_.n_dims())
+  {
+    std::cout << "[ERROR] The full precision table does not match the "
+      "searched table." << std::endl;
+    exit(1);
+  }
+  Search_(query, std::max(n_candidates, (size_t) 1));
+
+  // re-rank the candidates with the full precision points
+  size_t neighbor = -1;
+  double neighbor_distance = std::numeric_limits<T>::max();
+  for (; not candidates_.empty(); candidates_.pop())
+  {
+    const size_t index = old_from_new_indices_[candidates_.top().second];
+    const double dist = TBDiv::BDivergence(full_data[index], query);
+    // ties go to the candidate nearest in the searched table
+    if (dist <= neighbor_distance)
+    {
+      neighbor = index;
+      neighbor_distance = dist;
+    }
+  }
+  return neighbor;
+}
+
+template<typename T, class TBDiv, class TBBall, class TTable, 
+  class TTreeType>
+size_t LeftNNSearch<T, TBDiv, TBBall, TTable, TTreeType>::ComputeNeighborNaive(
+    const ConstPointView<T>& query)
 {
   neighbor_index_ = -1;
   neighbor_distance_ = std::numeric_limits<T>::max();
@@ -71,11 +165,47 @@ size_t LeftNNSearch<T, TBDiv, TBBall>::ComputeNeighborNaive(const Point<T>& quer
   }
 }
 
-template<typename T, class TBDiv, class TBBall>
-void LeftNNSearch<T, TBDiv, TBBall>::SearchNode_(
-    const TTreeType* node, 
-    const Point<T>& query, 
-    const Point<T>& query_prime, 
+template<typename T, class TBDiv, class TBBall, class TTable, 
+  class TTreeType>
+void LeftNNSearch<T, TBDiv, TBBall, TTable, TTreeType>::ComputeNeighborsNaive(
+    const Table<T>& queries, 
+    std::vector<size_t>& neighbors,
+    const size_t n_threads)
+{
+  // the matrices of a block of queries take at most 
+  // 8 * data_.n_points() * kBlock bytes
+  const size_t kBlock = 256;
+  neighbors.assign(queries.n_points(), -1);
+  Table<double> divergences;
+  for (size_t begin = 0; begin < queries.n_points(); begin += kBlock)
+  {
+    const size_t end = std::min(queries.n_points(), begin + kBlock);
+    TBDiv::BDivergenceMatrix(data_, 0, data_.n_points(), 
+        queries, begin, end, divergences, n_threads);
+    // sweep the rows of the matrix in order
+    std::vector<double> neighbor_distances(
+        end - begin, std::numeric_limits<T>::max());
+    for (size_t r = 0; r < data_.n_points(); r++)
+    {
+      const double* divergences_r = divergences[r].values();
+      for (size_t q = begin; q < end; q++)
+      {
+        if (divergences_r[q - begin] < neighbor_distances[q - begin])
+        {
+          neighbors[q] = old_from_new_indices_[r];
+          neighbor_distances[q - begin] = divergences_r[q - begin];
+        }
+      }
+    }
+  }
+}
+
+template<typename T, class TBDiv, class TBBall, class TTable, 
+  class TTreeType>
+void LeftNNSearch<T, TBDiv, TBBall, TTable, TTreeType>::SearchNode_(
+    const TNode* node, 
+    const ConstPointView<T>& query,
+    const ConstPointView<T>& query_prime,
     const T dist_to_centroid) 
 {
   // at leaf, do exhaustive search
@@ -83,18 +213,41 @@ void LeftNNSearch<T, TBDiv, TBBall>::SearchNode_(
   {
     for (int i = node->Begin(); i < node->End(); i++)
     {
-      double dist = TBDiv::BDivergence(data_[i], query);
-      if (dist < neighbor_distance_) 
+      // the closed form is compared by its lower bound, so that a 
+      // reference whose exact divergence is below the bound is kept
+      double dist, error = 0;
+      if (query_closed_form_)
+      {
+        dist = TBDiv::BDivergence(cache_.phi(i), data_[i], query_prime, 
+            query_offset_);
+        error = cache_.ErrorFrom(i, query_dual_norm_, query_scale_);
+      }
+      else
+      {
+        dist = TBDiv::BDivergence(data_[i], query, neighbor_distance_);
+      }
+      if (dist - error < neighbor_distance_) 
       {
-        neighbor_distance_ = dist;
-        neighbor_index_ = i;
+        candidates_.push(std::make_pair(dist, (size_t) i));
+        if (candidates_.size() > n_candidates_)
+          candidates_.pop();
+        if (candidates_.size() == n_candidates_)
+        {
+          const size_t worst = candidates_.top().second;
+          const double worst_dist = candidates_.top().first;
+          neighbor_distance_ = worst_dist + (query_closed_form_
+              ? cache_.ErrorFrom(worst, query_dual_norm_, query_scale_)
+              : TBDiv::BDivergenceError(data_[worst], query, worst_dist));
+        }
       }
     } // for references
     return;
   } // base case
 
-  double d_left = TBDiv::BDivergence(tree_->Left()->RCenter(), query);
-  double d_right = TBDiv::BDivergence(tree_->Right()->RCenter(), query);
+  double d_left = 
+    TBDiv::BDivergence(tree_->RCenter(tree_->Left(node)), query);
+  double d_right = 
+    TBDiv::BDivergence(tree_->RCenter(tree_->Right(node)), query);
   // Prioritize search by distance to centroid
   // NOTE: This current scheme always goes to atleast one leaf of any subtree 
   // that is not pruned -- this is useful if you are not pruning a lot anyways
@@ -103,24 +256,24 @@ void LeftNNSearch<T, TBDiv, TBBall>::SearchNode_(
   if (d_left < d_right)
   {
     // search left
-    // if (not node->Left()->Bound().CanPruneRight(
+    // if (not tree_->Bound(tree_->Left(node)).CanPruneRight(
     //     query, query_prime, neighbor_distance_))
-    SearchNode_(node->Left(), query, query_prime, d_left);
+    SearchNode_(tree_->Left(node), query, query_prime, d_left);
     // try to prune right
-    if (not node->Right()->Bound().CanPruneRight(
+    if (not tree_->Bound(tree_->Right(node)).CanPruneRight(
         query, query_prime, neighbor_distance_))
-      SearchNode_(node->Right(), query, query_prime, d_right);
+      SearchNode_(tree_->Right(node), query, query_prime, d_right);
   }
   else 
   {
     // search right
-    // if (not node->Right()->Bound().CanPruneRight(
+    // if (not tree_->Bound(tree_->Right(node)).CanPruneRight(
     //     query, query_prime, neighbor_distance_))
-    SearchNode_(node->Right(), query, query_prime, d_right);
+    SearchNode_(tree_->Right(node), query, query_prime, d_right);
     // try to prune left
-    if (not node->Left()->Bound().CanPruneRight(
+    if (not tree_->Bound(tree_->Left(node)).CanPruneRight(
         query, query_prime, neighbor_distance_))
-      SearchNode_(node->Left(), query, query_prime, d_left);
+      SearchNode_(tree_->Left(node), query, query_prime, d_left);
   } 
 
   return;
@@ -1,7 +1,13 @@
 #ifndef MINIMUM_SPANNING_TREE_HPP_
 #define MINIMUM_SPANNING_TREE_HPP_
 
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "bound_cache.hpp"
 #include "data.hpp"
+#include "tree_io.hpp"
 #include "union_find.hpp"
 
 namespace bmst {
@@ -41,10 +47,15 @@ namespace bmst {
 
   private:
 
+    // the nodes of the tree (see BregmanBallTree::TNode)
+    typedef typename TTreeType::TNode TNode;
+
     Table<T> data_;
 
     TTreeType* tree_;
     
+    int leaf_size_;
+    
     std::vector<size_t> old_from_new_;
     
     std::vector<Edge> edge_list_;
@@ -54,25 +65,50 @@ namespace bmst {
     std::vector<Edge> nearest_neighbors_;
     std::vector<double> candidate_dists_;
     
+    // the gradient of the current query in ComputeSTB
+    Point<T> query_prime_;
+    
+    // the lower bounds from the nodes to the queries, kept across the 
+    // rounds of ComputeSTB for the nodes up to bound_cache_depth_ (the 
+    // root has depth 0), if bound_cache_ is set
+    std::unique_ptr<BoundCache> bound_cache_;
+    size_t bound_cache_depth_;
+    
+    // the largest candidate of the queries of the nodes in ComputeDTB, 
+    // which only decrease during a round (DBL_MAX for the nodes not 
+    // searched yet)
+    std::unordered_map<const TNode*, double> node_candidate_dists_;
+    
     // functions //
     
-    void SearchTree_(TTreeType* query_node, TTreeType* reference_node);
+    void SearchTree_(TNode* query_node, TNode* reference_node);
+    
+    double NodeCandidateDist_(const TNode* node) const;
     
     void NaiveBoruvka_(std::vector<std::vector<double> >& edge_weights);
 
     void AddEdges_();
     
-    void SearchTree_(const Point<T>& q, size_t q_index, size_t root_q, TTreeType* node);
+    void SearchTree_(const ConstPointView<T>& q, const ConstPointView<T>& q_prime, 
+                     size_t q_index, size_t root_q, TNode* node, size_t depth);
+    
+    // through the bound cache for the nodes down to bound_cache_depth_
+    bool CanPrune_(const ConstPointView<T>& q, const ConstPointView<T>& q_prime, 
+                   size_t q_index, size_t root_q, TNode* node, size_t depth);
     
-    void ResetTree_(TTreeType* node);
+    void ResetTree_(TNode* node);
 
-    void UpdateTree_(TTreeType* node);
+    void UpdateTree_(TNode* node);
     
     void ResetAll_();
     
   public:
     
     MinimumSpanningTree(Table<T>& data, int leaf_size = 1);
+    
+    // Starts from a prebuilt tree index (see tree_io.hpp) instead of 
+    // building the tree, on the mapped data of the index
+    MinimumSpanningTree(const TreeIndex<T>& index);
   
     ~MinimumSpanningTree();
   
@@ -86,9 +122,23 @@ namespace bmst {
     
     // Single-tree Boruvka, loop over all queries
     void ComputeSTB();
+    
+    // Keep the lower bounds from the nodes to the queries of ComputeSTB
+    // (which do not depend on the candidates) from one round to the next,
+    // in at most about max_bytes bytes (see bound_cache.hpp), for the 
+    // nodes down to max_depth. The bounds are then computed in full the
+    // first time, instead of stopping as soon as a node is pruned, and 
+    // every later round prunes the node with a single comparison.
+    void EnableBoundCache(size_t max_bytes, size_t max_depth);
+    
+    // NULL if the bound cache is disabled
+    const BoundCache* GetBoundCache() const { return bound_cache_.get(); }
   
     // This will put things back in terms of the original indexing  
     std::vector<Edge>& EdgeList();
+    
+    // Write the tree, the data and their permutation as a tree index
+    void SaveIndex(const std::string& file_name) const;
   
   }; // class MST
 
@@ -8,15 +8,39 @@ namespace bmst {
   MinimumSpanningTree<T, EdgePolicy, TTreeType>::MinimumSpanningTree(Table<T>& data, int leaf_size)
   :
   data_(data),
+  leaf_size_(leaf_size),
   components_(data.n_points()),
   nearest_neighbors_(data.n_points()),
-  candidate_dists_(data.n_points(), DBL_MAX)
+  candidate_dists_(data.n_points(), DBL_MAX),
+  bound_cache_depth_(0)
   {
     
     tree_ = new TTreeType(data_, old_from_new_, leaf_size);
     
   }
 
+  template<typename T, class EdgePolicy, class TTreeType>
+  MinimumSpanningTree<T, EdgePolicy, TTreeType>::MinimumSpanningTree(const TreeIndex<T>& index)
+  :
+  data_(index.Data()),
+  leaf_size_(index.leaf_size()),
+  components_(index.n_points()),
+  nearest_neighbors_(index.n_points()),
+  candidate_dists_(index.n_points(), DBL_MAX),
+  bound_cache_depth_(0)
+  {
+    
+    tree_ = new TTreeType(index);
+    index.OldFromNew(old_from_new_);
+    
+  }
+
+  template<typename T, class EdgePolicy, class TTreeType>
+  void MinimumSpanningTree<T, EdgePolicy, TTreeType>::SaveIndex(const std::string& file_name) const
+  {
+    WriteTreeIndex(*tree_, data_, old_from_new_, file_name, leaf_size_);
+  }
+
   template<typename T, class EdgePolicy, class TTreeType>
   MinimumSpanningTree<T, EdgePolicy, TTreeType>::~MinimumSpanningTree()
   {
@@ -34,42 +58,64 @@ namespace bmst {
     while (edge_list_.size() < data_.n_points() - 1)
     {
       
-      SearchTree_(tree_, tree_);
+      SearchTree_(tree_->Root(), tree_->Root());
       
       AddEdges_();
       
+      UpdateTree_(tree_->Root());
+      
+      node_candidate_dists_.clear();
+      
     }
     
   }
   
   template<typename T, class EdgePolicy, class TTreeType>
-  void MinimumSpanningTree<T, EdgePolicy, TTreeType>::SearchTree_(TTreeType* query_node,
-                                                                  TTreeType* reference_node)
+  double MinimumSpanningTree<T, EdgePolicy, TTreeType>::NodeCandidateDist_(const TNode* node) const
   {
     
-    if (query_node->Bound().Component() >= 0 && query_node->Bound().Component() == reference_node->Bound().Component()) 
+    typename std::unordered_map<const TNode*, double>::const_iterator found = 
+      node_candidate_dists_.find(node);
+    
+    return (found == node_candidate_dists_.end()) ? DBL_MAX : found->second;
+    
+  }
+  
+  template<typename T, class EdgePolicy, class TTreeType>
+  void MinimumSpanningTree<T, EdgePolicy, TTreeType>::SearchTree_(TNode* query_node,
+                                                                  TNode* reference_node)
+  {
+    
+    // Component() is -1 (a size_t) if the node is not connected
+    if (query_node->Component() != (size_t) -1 && query_node->Component() == reference_node->Component()) 
     {
       return; // they're connected, so prune
     }
-    else if (EdgePolicy::CanPrune(query_node->Bound(), reference_node->Bound()))
+    else if (EdgePolicy::CanPrune(tree_->Bound(query_node), tree_->Bound(reference_node), 
+                                  NodeCandidateDist_(query_node)))
     {
       return; // we pruned based on bounds
     }
     else if (query_node->IsLeaf() && reference_node->IsLeaf()) {
       
+      // all the weights between the two leaves at once
+      Table<double> weights;
+      EdgePolicy::EdgeWeights(data_, 
+                              query_node->Begin(), query_node->End(), 
+                              reference_node->Begin(), reference_node->End(),
+                              weights);
+      
       for (size_t q = query_node->Begin(); q < query_node->End(); q++)
       {
         
-        const Point<T>& query = data_[q];
         size_t root_q = components_.Find(q);
         
-        for (size_t r = reference_node->Begin(); reference_node->End(); r++)
+        for (size_t r = reference_node->Begin(); r < reference_node->End(); r++)
         {
 
-          const Point<T>& reference = data_[r];
           size_t root_r = components_.Find(r);
           
-          double this_weight = EdgePolicy::EdgeWeight(query, reference);
+          double this_weight = weights[q - query_node->Begin()][r - reference_node->Begin()];
           
           if (root_q != root_r and this_weight < candidate_dists_[root_q]) 
           {
@@ -81,58 +127,70 @@ namespace bmst {
           
         } // loop over r
       } // loop over q
+      
+      double max_candidate = 0;
+      for (size_t q = query_node->Begin(); q < query_node->End(); q++)
+        max_candidate = std::max(max_candidate, candidate_dists_[components_.Find(q)]);
+      node_candidate_dists_[query_node] = max_candidate;
+      
     } // base case
     else if (reference_node->IsLeaf())
     {
       
-      SearchTree_(query_node->Left(), reference_node);
-      SearchTree_(query_node->Right(), reference_node);
+      SearchTree_(tree_->Left(query_node), reference_node);
+      SearchTree_(tree_->Right(query_node), reference_node);
+      
+      node_candidate_dists_[query_node] = std::max(NodeCandidateDist_(tree_->Left(query_node)),
+                                                   NodeCandidateDist_(tree_->Right(query_node)));
       
     }
     else if (query_node->IsLeaf())
     {
      
-      double left_dist = EdgePolicy::EdgeWeight(query_node->Center(), reference_node->Left()->Center());
-      double right_dist = EdgePolicy::EdgeWeight(query_node->Center(), reference_node->Right()->Center());
+      double left_dist = EdgePolicy::EdgeWeight(tree_->RCenter(query_node), tree_->RCenter(tree_->Left(reference_node)));
+      double right_dist = EdgePolicy::EdgeWeight(tree_->RCenter(query_node), tree_->RCenter(tree_->Right(reference_node)));
       
       if (left_dist < right_dist)
       {
-        SearchTree_(query_node, reference_node->Left());
-        SearchTree_(query_node, reference_node->Right());
+        SearchTree_(query_node, tree_->Left(reference_node));
+        SearchTree_(query_node, tree_->Right(reference_node));
       }
       else {
-        SearchTree_(query_node, reference_node->Right());
-        SearchTree_(query_node, reference_node->Left());
+        SearchTree_(query_node, tree_->Right(reference_node));
+        SearchTree_(query_node, tree_->Left(reference_node));
       }
     }
     else {
      
-      double left_dist = EdgePolicy::EdgeWeight(query_node->Left()->Center(), reference_node->Left()->Center());
-      double right_dist = EdgePolicy::EdgeWeight(query_node->Left()->Center(), reference_node->Right()->Center());
+      double left_dist = EdgePolicy::EdgeWeight(tree_->RCenter(tree_->Left(query_node)), tree_->RCenter(tree_->Left(reference_node)));
+      double right_dist = EdgePolicy::EdgeWeight(tree_->RCenter(tree_->Left(query_node)), tree_->RCenter(tree_->Right(reference_node)));
       
       if (left_dist < right_dist)
       {
-        SearchTree_(query_node->Left(), reference_node->Left());
-        SearchTree_(query_node->Left(), reference_node->Right());
+        SearchTree_(tree_->Left(query_node), tree_->Left(reference_node));
+        SearchTree_(tree_->Left(query_node), tree_->Right(reference_node));
       }
       else {
-        SearchTree_(query_node->Left(), reference_node->Right());
-        SearchTree_(query_node->Left(), reference_node->Left());
+        SearchTree_(tree_->Left(query_node), tree_->Right(reference_node));
+        SearchTree_(tree_->Left(query_node), tree_->Left(reference_node));
       } 
 
-      left_dist = EdgePolicy::EdgeWeight(query_node->Right()->Center(), reference_node->Left()->Center());
-      right_dist = EdgePolicy::EdgeWeight(query_node->Right()->Center(), reference_node->Right()->Center());
+      left_dist = EdgePolicy::EdgeWeight(tree_->RCenter(tree_->Right(query_node)), tree_->RCenter(tree_->Left(reference_node)));
+      right_dist = EdgePolicy::EdgeWeight(tree_->RCenter(tree_->Right(query_node)), tree_->RCenter(tree_->Right(reference_node)));
       
       if (left_dist < right_dist)
       {
-        SearchTree_(query_node->Right(), reference_node->Left());
-        SearchTree_(query_node->Right(), reference_node->Right());
+        SearchTree_(tree_->Right(query_node), tree_->Left(reference_node));
+        SearchTree_(tree_->Right(query_node), tree_->Right(reference_node));
       }
       else {
-        SearchTree_(query_node->Right(), reference_node->Right());
-        SearchTree_(query_node->Right(), reference_node->Left());
+        SearchTree_(tree_->Right(query_node), tree_->Right(reference_node));
+        SearchTree_(tree_->Right(query_node), tree_->Left(reference_node));
       } 
 
+      node_candidate_dists_[query_node] = std::max(NodeCandidateDist_(tree_->Left(query_node)),
+                                                   NodeCandidateDist_(tree_->Right(query_node)));
+
     }
     
   }
@@ -154,30 +212,28 @@ namespace bmst {
 
       edge_weights.resize(data_.n_points());  
       
-      // allocate the memory first
-      for (size_t i = 0; i < data_.n_points(); i++)
-      {
-        
-        edge_weights[i].resize(data_.n_points());
-        
-      } // for i
-      
-      for (size_t j = 0; j < data_.n_points(); j++)
+      // the rows of the weights a block of points at a time, so that 
+      // only the block matrices are live next to edge_weights
+      const size_t kBlock = 256;
+      Table<double> weights;
+      for (size_t begin = 0; begin < data_.n_points(); begin += kBlock)
       {
         
-        edge_weights[j][j] = 0.0;
+        const size_t end = std::min(begin + kBlock, data_.n_points());
+        EdgePolicy::EdgeWeights(data_, begin, end, 
+                                0, data_.n_points(), weights);
         
-        for (size_t k = j+1; k < data_.n_points(); k++)
+        for (size_t j = begin; j < end; j++)
         {
-      
-          // this assumes that the edge weights are symmetric
-          double this_weight = EdgePolicy::EdgeWeight(data_[j], data_[k]);
           
-          edge_weights[j][k] = this_weight;
-          edge_weights[k][j] = this_weight;
+          edge_weights[j].assign(weights[j - begin].values(), 
+                                 weights[j - begin].values() + 
+                                 data_.n_points());
+          edge_weights[j][j] = 0.0;
           
-        } // for k
-      } // for j
+        } // for j
+        
+      } // for begin
       
     } // if we're precomputing all of the distances
     
@@ -199,7 +255,7 @@ namespace bmst {
       for (size_t i = 0; i < data_.n_points(); i++)
       {
         
-        const Point<T>& point_i = data_[i];
+        const ConstPointView<T> point_i = data_[i];
         size_t root_i = components_.Find(i);
         
         for (size_t j = 0; j < data_.n_points(); j++)
@@ -208,13 +264,15 @@ namespace bmst {
           // don't bother if they're already connected
           if (i == j || root_i == components_.Find(j)) continue;
         
-          const Point<T>& point_j = data_[j];
+          const ConstPointView<T> point_j = data_[j];
           
           // they aren't in the same component
           double this_weight;
           if (compute_weights) 
           {
-            this_weight = EdgePolicy::EdgeWeight(point_i, point_j);
+            // only the weights below the candidate matter
+            this_weight = EdgePolicy::EdgeWeight(point_i, point_j, 
+                                                 candidate_dists_[root_i]);
           }
           else {
             this_weight = edge_weights[i][j];
@@ -292,29 +350,40 @@ namespace bmst {
       for (size_t i = 0; i < data_.n_points(); i++)
       {
     
-        Point<T>& q = data_[i];
+        const ConstPointView<T> q = data_[i];
         size_t root_q = components_.Find(i);
+        
+        EdgePolicy::TBDiv::Gradient(q, query_prime_);
       
-        SearchTree_(q, i, root_q, tree_);
+        SearchTree_(q, query_prime_, i, root_q, tree_->Root(), 0);
       
       } // loop over queries
     
       AddEdges_();
       
-      UpdateTree_(tree_);
+      UpdateTree_(tree_->Root());
     
     }
     
   } // ComputeSTB
   
   template<typename T, class EdgePolicy, class TTreeType>
-  void MinimumSpanningTree<T, EdgePolicy, TTreeType>::UpdateTree_(TTreeType* node) 
+  void MinimumSpanningTree<T, EdgePolicy, TTreeType>::EnableBoundCache(size_t max_bytes, 
+                                                                       size_t max_depth)
+  {
+    bound_cache_.reset(new BoundCache(max_bytes));
+    bound_cache_depth_ = max_depth;
+  }
+  
+  template<typename T, class EdgePolicy, class TTreeType>
+  void MinimumSpanningTree<T, EdgePolicy, TTreeType>::UpdateTree_(TNode* node) 
   {
     
     if (node->IsLeaf()) 
     {
       
-      if (node->Bound().Component() < 0) 
+      // Component() is -1 (a size_t) if the node is not connected
+      if (node->Component() == (size_t) -1) 
       {
         
         size_t comp = components_.Find(node->Begin());
@@ -330,31 +399,31 @@ namespace bmst {
           
         } // loop over points in the leaf
         
-        node->Bound().SetComponent(comp);
+        node->SetComponent(comp);
         
       } // do we need to see if the node is connected now?
       else {
         
         // it might have changed id, so just set it to the new one
         // There is no way for the node to have stopped being connected
-        node->Bound().SetComponent(components_.Find(node->Begin()));
+        node->SetComponent(components_.Find(node->Begin()));
         
       }
       
     } // is the node a leaf?
     else {
       
-      UpdateTree_(node->Left());
-      UpdateTree_(node->Right());
+      UpdateTree_(tree_->Left(node));
+      UpdateTree_(tree_->Right(node));
       
-      size_t left_comp = node->Left()->Bound().Component();
-      size_t right_comp = node->Right()->Bound().Component();
+      size_t left_comp = tree_->Left(node)->Component();
+      size_t right_comp = tree_->Right(node)->Component();
 
       // We don't need to check if they're positive, since this is ok in the
       // case that they're both -1      
       if (left_comp == right_comp) 
       {
-        node->Bound().SetComponent(left_comp);
+        node->SetComponent(left_comp);
       }
       // we assume that it's already -1
       
@@ -363,39 +432,45 @@ namespace bmst {
   }
   
   template<typename T, class EdgePolicy, class TTreeType>
-  void MinimumSpanningTree<T, EdgePolicy, TTreeType>::ResetTree_(TTreeType* node) 
+  void MinimumSpanningTree<T, EdgePolicy, TTreeType>::ResetTree_(TNode* node) 
   {
     
     if (not node->IsLeaf())
     {
-      ResetTree_(node->Left());
-      ResetTree_(node->Right());
+      ResetTree_(tree_->Left(node));
+      ResetTree_(tree_->Right(node));
     }
     
-    node->Bound().SetComponent(-1);
+    node->SetComponent(-1);
     
   }
   
   template<typename T, class EdgePolicy, class TTreeType>
-  void MinimumSpanningTree<T, EdgePolicy, TTreeType>::SearchTree_(const Point<T>& q,
+  void MinimumSpanningTree<T, EdgePolicy, TTreeType>::SearchTree_(const ConstPointView<T>& q,
+                                                                  const ConstPointView<T>& q_prime,
                                                                   size_t q_index,
                                                                   size_t root_q,
-                                                                  TTreeType* node)
+                                                                  TNode* node,
+                                                                  size_t depth)
   {
     
     // we're all connected, so don't search any more
-    if (root_q == node->Bound().Component()) {
+    if (root_q == node->Component()) {
       return;
     }
-    else if (EdgePolicy::CanPrune(q, node->Bound(), candidate_dists_[root_q])) {
+    else if (CanPrune_(q, q_prime, q_index, root_q, node, depth)) {
       return; // we pruned based on distance
     }
     else if (node->IsLeaf())
     {
       for (size_t i = node->Begin(); i < node->End(); i++)
       {
-        const Point<T>& point_i = data_[i];
-        double this_weight = EdgePolicy::EdgeWeight(q, point_i);
+        // the query itself and its component are not candidates
+        if (components_.Find(i) == root_q) continue;
+
+        const ConstPointView<T> point_i = data_[i];
+        double this_weight = EdgePolicy::EdgeWeight(q, point_i, 
+                                                    candidate_dists_[root_q]);
         
         if (this_weight < candidate_dists_[root_q]) 
         {
@@ -409,17 +484,17 @@ namespace bmst {
     } // base case
     else {
       
-      double left_weight = EdgePolicy::EdgeWeight(q, node->Left()->RCenter());
-      double right_weight = EdgePolicy::EdgeWeight(q, node->Right()->RCenter());
+      double left_weight = EdgePolicy::EdgeWeight(q, tree_->RCenter(tree_->Left(node)));
+      double right_weight = EdgePolicy::EdgeWeight(q, tree_->RCenter(tree_->Right(node)));
       
       if (left_weight < right_weight) 
       {
-        SearchTree_(q, q_index, root_q, node->Left());
-        SearchTree_(q, q_index, root_q, node->Right());
+        SearchTree_(q, q_prime, q_index, root_q, tree_->Left(node), depth + 1);
+        SearchTree_(q, q_prime, q_index, root_q, tree_->Right(node), depth + 1);
       }
       else {
-        SearchTree_(q, q_index, root_q, node->Right());
-        SearchTree_(q, q_index, root_q, node->Left());
+        SearchTree_(q, q_prime, q_index, root_q, tree_->Right(node), depth + 1);
+        SearchTree_(q, q_prime, q_index, root_q, tree_->Left(node), depth + 1);
       }
       
       
@@ -427,6 +502,28 @@ namespace bmst {
     
   } // SearchTree_()
   
+  template<typename T, class EdgePolicy, class TTreeType>
+  bool MinimumSpanningTree<T, EdgePolicy, TTreeType>::CanPrune_(const ConstPointView<T>& q,
+                                                                const ConstPointView<T>& q_prime,
+                                                                size_t q_index,
+                                                                size_t root_q,
+                                                                TNode* node,
+                                                                size_t depth)
+  {
+    
+    if (not bound_cache_ or depth > bound_cache_depth_)
+      return EdgePolicy::CanPrune(q, q_prime, tree_->Bound(node), candidate_dists_[root_q]);
+    
+    double lower_bound;
+    if (not bound_cache_->Find(q_index, node, lower_bound))
+    {
+      lower_bound = EdgePolicy::LowerBound(q, q_prime, tree_->Bound(node));
+      bound_cache_->Insert(q_index, node, lower_bound);
+    }
+    return (lower_bound > candidate_dists_[root_q]);
+    
+  }
+  
   template<typename T, class EdgePolicy, class TTreeType>
   std::vector<Edge>& MinimumSpanningTree<T, EdgePolicy, TTreeType>::EdgeList() 
   {
@@ -451,7 +548,7 @@ namespace bmst {
     
     // don't call UpdateTree_ here, won't work because leaves already have 
     // their components set
-    ResetTree_(tree_);
+    ResetTree_(tree_->Root());
     
   }
   
@@ -7,18 +7,46 @@ namespace bmst {
 
   // A policy class which computes the length of an edge (x,y) as 
   // max(d_f(x,y), d_f(y,x)) for the given divergence f
+  // The bounds are the BregmanBall<T, TBregmanDiv> of the nodes, or 
+  // views of them (see FlatBregmanBallTree)
   template<typename T, class TBregmanDiv>
   class MstMaxEdge {
   
-    typedef BregmanBall<T, TBregmanDiv> BoundType;
-  
   public:
     
-    static double EdgeWeight(const Point<T>& x, const Point<T>&y);
+    typedef TBregmanDiv TBDiv;
+    
+    static double EdgeWeight(const ConstPointView<T>& x, const ConstPointView<T>&y);
+  
+    // EdgeWeight(x, y) if it is at most upper_bound, some value above 
+    // upper_bound otherwise (the divergences stop early)
+    static double EdgeWeight(const ConstPointView<T>& x, const ConstPointView<T>&y, 
+                             double upper_bound);
   
-    static bool CanPrune(const BoundType& query_bound, const BoundType& ref_bound);
+    // out[i][j] = EdgeWeight(data[q_begin + i], data[r_begin + j]), from 
+    // the divergence matrices of the two blocks
+    static void EdgeWeights(const Table<T>& data, 
+                            size_t q_begin, size_t q_end, 
+                            size_t r_begin, size_t r_end,
+                            Table<double>& out);
+  
+    // Whether all the edges between the points of the two balls weigh
+    // more than candidate_dist (see BregmanBall::CanPruneRight)
+    template<class BoundType>
+    static bool CanPrune(const BoundType& query_bound, const BoundType& ref_bound,
+                         double candidate_dist);
                            
-    static bool CanPrune(const Point<T>& query, const BoundType& ref_bound, double candidate_dist);                         
+    // query_prime is the gradient of the query
+    template<class BoundType>
+    static bool CanPrune(const ConstPointView<T>& query, const ConstPointView<T>& query_prime,
+                         const BoundType& ref_bound, double candidate_dist);
+  
+    // A lower bound on the weights of the edges from the query to the 
+    // points of ref_bound, which does not depend on any candidate (see
+    // BregmanBall::RightLowerBound)
+    template<class BoundType>
+    static double LowerBound(const ConstPointView<T>& query, const ConstPointView<T>& query_prime,
+                             const BoundType& ref_bound);
   
   }; // class
 
@@ -4,31 +4,86 @@
 namespace bmst {
 
   template<typename T, class TBregmanDiv>
-  double MstMaxEdge<T, TBregmanDiv>::EdgeWeight(const Point<T>& x, const Point<T>& y)
+  double MstMaxEdge<T, TBregmanDiv>::EdgeWeight(const ConstPointView<T>& x, const ConstPointView<T>& y)
   {
   
-    double xy = TBregmanDiv::Divergence(x,y);
-    double yx = TBregmanDiv::Divergence(y,x);
+    double xy = TBregmanDiv::BDivergence(x,y);
+    double yx = TBregmanDiv::BDivergence(y,x);
     
     return std::max(xy, yx);
     
   }
 
   template<typename T, class TBregmanDiv>
+  double MstMaxEdge<T, TBregmanDiv>::EdgeWeight(const ConstPointView<T>& x, 
+                                                const ConstPointView<T>& y,
+                                                double upper_bound)
+  {
+  
+    double xy = TBregmanDiv::BDivergence(x, y, upper_bound);
+    if (xy > upper_bound)
+      return xy;
+    double yx = TBregmanDiv::BDivergence(y, x, upper_bound);
+    
+    return std::max(xy, yx);
+    
+  }
+
+  template<typename T, class TBregmanDiv>
+  void MstMaxEdge<T, TBregmanDiv>::EdgeWeights(const Table<T>& data,
+                                               size_t q_begin, size_t q_end,
+                                               size_t r_begin, size_t r_end,
+                                               Table<double>& out)
+  {
+  
+    Table<double> qr;
+    Table<double> rq;
+    TBregmanDiv::BDivergenceMatrix(data, q_begin, q_end, data, r_begin, r_end, qr);
+    TBregmanDiv::BDivergenceMatrix(data, r_begin, r_end, data, q_begin, q_end, rq);
+    
+    out = Table<double>(q_end - q_begin, r_end - r_begin);
+    for (size_t i = 0; i < out.n_points(); i++)
+      for (size_t j = 0; j < out.n_dims(); j++)
+        out[i][j] = std::max(qr[i][j], rq[j][i]);
+    
+  }
+
+  template<typename T, class TBregmanDiv>
+  template<class BoundType>
   bool MstMaxEdge<T, TBregmanDiv>::CanPrune(const BoundType& query_bound,
-                                                   const BoundType& ref_bound)
+                                            const BoundType& ref_bound,
+                                            double candidate_dist)
   { 
+    // max(d(x, q), d(q, x)) is at least both d(x, q), from the right ball
+    // of the references to the left ball of the queries, and d(q, x)
+    double ref_div_query = TBregmanDiv::BDivergence(query_bound.left_centroid(),
+                                                    ref_bound.right_centroid());
+    if (ref_bound.CanPruneRight(query_bound, candidate_dist, ref_div_query))
+      return true;
+    double query_div_ref = TBregmanDiv::BDivergence(ref_bound.left_centroid(),
+                                                    query_bound.right_centroid());
+    return query_bound.CanPruneRight(ref_bound, candidate_dist, query_div_ref);
+  }
 
-    return false;
-
+  template<typename T, class TBregmanDiv>
+  template<class BoundType>
+  bool MstMaxEdge<T, TBregmanDiv>::CanPrune(const ConstPointView<T>& query,
+                                            const ConstPointView<T>& query_prime,
+                                            const BoundType& ref_bound, 
+                                            double candidate_dist)
+  {
+    // max(d(x, q), d(q, x)) >= d(x, q), which the right ball bounds
+    return ref_bound.CanPruneRight(query, query_prime, candidate_dist);
   }
 
   template<typename T, class TBregmanDiv>
-  bool MstMaxEdge<T, TBregmanDiv>::CanPrune(const Point<T>& query,
-                                                    const BoundType& ref_bound, 
-                                                    double candidate_dist)
+  template<class BoundType>
+  double MstMaxEdge<T, TBregmanDiv>::LowerBound(const ConstPointView<T>& query,
+                                                const ConstPointView<T>& query_prime,
+                                                const BoundType& ref_bound)
   {
-    return false;
+    double div_to_centroid = TBregmanDiv::BDivergence(query, ref_bound.right_centroid());
+    return ref_bound.RightLowerBound(query, query_prime, div_to_centroid);
   }
 
 
@@ -0,0 +1,97 @@
+/**
+ * @file bregman_mst/mlpack_code/parallel.hpp
+ *
+ * The threads of the parallel tree construction (see
+ * BregmanBallTree): ParallelFor splits a pass over the points into
+ * blocks for the data-parallel k-means of the large nodes, and
+ * WorkStealingPool runs the independent subtrees below them. Every
+ * thread of the pool keeps its own deque of tasks: it runs the last
+ * task it spawned (depth first), and an idle thread steals the oldest
+ * task of another one (the largest subtree left).
+ */
+
+#ifndef BMST_PARALLEL_HPP_
+#define BMST_PARALLEL_HPP_
+
+#include <stddef.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace bmst {
+
+// The threads of the machine (at least 1)
+size_t HardwareThreads();
+
+// fn(block) for every block in [0, n_blocks), on up to n_threads
+// threads (the calling thread only if n_threads <= 1). The blocks are
+// handed out in no particular order, so fn must only write to its own
+// block.
+void ParallelFor(
+    const size_t n_blocks,
+    const size_t n_threads,
+    const std::function<void (const size_t)>& fn);
+
+class WorkStealingPool
+{
+public:
+  typedef std::function<void ()> Task;
+
+private:
+  struct Worker_
+  {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+  std::vector<std::unique_ptr<Worker_> > workers_;
+
+  // the pool and the index of the worker the calling thread is
+  struct CurrentWorker_
+  {
+    const WorkStealingPool* pool;
+    size_t index;
+  };
+  static CurrentWorker_& ThreadWorker_();
+
+  // the tasks spawned and not finished yet, and the ones still in the
+  // deques
+  std::atomic<size_t> pending_;
+  std::atomic<size_t> queued_;
+
+  // the idle workers sleep on idle_ until a task is queued or they are
+  // all done
+  std::mutex idle_mutex_;
+  std::condition_variable idle_;
+  void WakeIdle_(const bool all);
+
+  // the task queued last on the worker, or the oldest task of another
+  bool Pop_(const size_t worker, Task& task);
+  bool Steal_(const size_t worker, Task& task);
+
+  void Work_(const size_t worker);
+
+public:
+  WorkStealingPool(const size_t n_threads);
+
+  // Queue the task on the deque of the calling thread if it is a worker
+  // of the pool, on the deques in turn otherwise
+  void Spawn(Task task);
+
+  // Run the tasks, and the ones they spawn, on the threads of the pool;
+  // returns once they are all done
+  void Wait();
+
+  size_t n_threads() const { return workers_.size(); }
+
+}; // class
+
+}; // namespace
+
+#include "parallel_impl.hpp"
+
+#endif
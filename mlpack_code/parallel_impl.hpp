@@ -0,0 +1,161 @@
+/**
+ * @file bregman_mst/mlpack_code/parallel_impl.hpp
+ *
+ * Implementation of the functions defined in parallel.hpp
+ */
+
+#ifndef BMST_PARALLEL_IMPL_HPP_
+#define BMST_PARALLEL_IMPL_HPP_
+
+#include <algorithm>
+#include <thread>
+
+#include "parallel.hpp"
+
+namespace bmst {
+
+inline size_t HardwareThreads()
+{
+  return std::max((size_t) 1, (size_t) std::thread::hardware_concurrency());
+}
+
+inline void ParallelFor(
+    const size_t n_blocks,
+    const size_t n_threads,
+    const std::function<void (const size_t)>& fn)
+{
+  if (n_threads <= 1 or n_blocks <= 1)
+  {
+    for (size_t block = 0; block < n_blocks; block++)
+      fn(block);
+    return;
+  }
+
+  std::atomic<size_t> next_block(0);
+  auto work = [&]()
+  {
+    for (size_t block = next_block++; block < n_blocks; block = next_block++)
+      fn(block);
+  };
+  // the calling thread is one of them
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < std::min(n_threads, n_blocks); i++)
+    threads.push_back(std::thread(work));
+  work();
+  for (size_t i = 0; i < threads.size(); i++)
+    threads[i].join();
+}
+
+inline WorkStealingPool::CurrentWorker_& WorkStealingPool::ThreadWorker_()
+{
+  static thread_local CurrentWorker_ worker = { NULL, 0 };
+  return worker;
+}
+
+inline WorkStealingPool::WorkStealingPool(const size_t n_threads) :
+  pending_(0),
+  queued_(0)
+{
+  for (size_t i = 0; i < std::max((size_t) 1, n_threads); i++)
+    workers_.push_back(std::unique_ptr<Worker_>(new Worker_()));
+}
+
+inline void WorkStealingPool::Spawn(Task task)
+{
+  static thread_local size_t next_worker = 0;
+  const CurrentWorker_& current = ThreadWorker_();
+  size_t worker;
+  if (current.pool == this)
+    worker = current.index;
+  else
+    worker = (next_worker++) % workers_.size();
+
+  // counted before it can run, so that pending_ only reaches 0 once all
+  // the tasks spawned are done
+  ++pending_;
+  {
+    std::lock_guard<std::mutex> lock(workers_[worker]->mutex);
+    ++queued_;
+    workers_[worker]->tasks.push_back(std::move(task));
+  }
+  WakeIdle_(false);
+}
+
+inline void WorkStealingPool::WakeIdle_(const bool all)
+{
+  // under the lock, so that a worker cannot miss it between checking 
+  // queued_ and going to sleep
+  std::lock_guard<std::mutex> lock(idle_mutex_);
+  if (all)
+    idle_.notify_all();
+  else
+    idle_.notify_one();
+}
+
+inline bool WorkStealingPool::Pop_(const size_t worker, Task& task)
+{
+  std::lock_guard<std::mutex> lock(workers_[worker]->mutex);
+  if (workers_[worker]->tasks.empty())
+    return false;
+  task = std::move(workers_[worker]->tasks.back());
+  workers_[worker]->tasks.pop_back();
+  --queued_;
+  return true;
+}
+
+inline bool WorkStealingPool::Steal_(const size_t worker, Task& task)
+{
+  for (size_t i = 1; i < workers_.size(); i++)
+  {
+    Worker_& victim = *workers_[(worker + i) % workers_.size()];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (victim.tasks.empty())
+      continue;
+    task = std::move(victim.tasks.front());
+    victim.tasks.pop_front();
+    --queued_;
+    return true;
+  }
+  return false;
+}
+
+inline void WorkStealingPool::Work_(const size_t worker)
+{
+  CurrentWorker_& current = ThreadWorker_();
+  const CurrentWorker_ previous = current;
+  current.pool = this;
+  current.index = worker;
+  Task task;
+  while (pending_ > 0)
+  {
+    if (Pop_(worker, task) or Steal_(worker, task))
+    {
+      task();
+      task = Task();
+      if (--pending_ == 0)
+        WakeIdle_(true);
+    }
+    else
+    {
+      // the running tasks may still spawn more
+      std::unique_lock<std::mutex> lock(idle_mutex_);
+      idle_.wait(lock, [this]() { return queued_ > 0 or pending_ == 0; });
+    }
+  }
+  current = previous;
+}
+
+inline void WorkStealingPool::Wait()
+{
+  // the calling thread is the first worker
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < workers_.size(); i++)
+    threads.push_back(std::thread(&WorkStealingPool::Work_, this, i));
+  Work_(0);
+  for (size_t i = 0; i < threads.size(); i++)
+    threads[i].join();
+}
+
+}; // namespace
+
+#endif
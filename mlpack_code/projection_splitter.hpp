@@ -0,0 +1,113 @@
+/**
+ * @file bregman_mst/mlpack_code/projection_splitter.hpp
+ *
+ * Cheap splits for constructing Bregman ball trees, which need no
+ * clustering: the points of the node are projected in gradient space,
+ * <grad phi(x), u>, on a direction u and split at the median (or at the
+ * mean) of the projections. As the bisector {x : d(x, a) = d(x, b)} of
+ * two points is the hyperplane <x, grad phi(b) - grad phi(a)> = c, this
+ * is the rule of findSplit in the C package, with the direction:
+ *  - a random (gaussian) direction: RandomProjectionSplitter;
+ *  - the top principal direction of the gradients of a sample of the
+ *    node, by power iteration: PCASplitter.
+ * The children get the means of their points as centers, as with
+ * KMeansSplitter, so the balls are looser but the split only takes a
+ * gradient per point and a divergence per point for the radii.
+ */
+
+#ifndef BMST_PROJECTION_SPLITTER_HPP_
+#define BMST_PROJECTION_SPLITTER_HPP_
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "data.hpp"
+#include "kmeans_splitter.hpp"
+
+namespace bmst {
+
+enum SplitDirection
+{
+  kRandomDirection,
+  kPrincipalDirection
+};
+
+// The defaults of ProjectionSplitter::SetSplitting
+const size_t kPCASampleSize = 1024;
+const size_t kPowerIterations = 20;
+const double kPowerTolerance = 1e-6;
+
+template <typename T, class TBregmanDiv, SplitDirection kDirection>
+class ProjectionSplitter
+{
+private:
+  unsigned seed_;
+  size_t n_threads_;
+
+  // the settings of SetSplitting
+  static size_t sample_size_;
+  static size_t max_iterations_;
+  static double tolerance_;
+  static bool median_;
+
+  // The direction of the projections
+  template <class TTable>
+  void Direction_(
+      const TTable& data,
+      const size_t begin_index,
+      const size_t end_index,
+      std::default_random_engine& gen,
+      Point<T>& direction) const;
+
+public:
+  // The splits have 2 children (k must be 2)
+  ProjectionSplitter(const size_t k = 2);
+
+  // The principal direction is the one of the gradients of sample_size
+  // points of the node (all of them in the smaller nodes), with at most
+  // max_iterations steps of the power iteration, which stops once the
+  // direction changes by less than tolerance (1 - |cos| <= tolerance).
+  // The points are split at the median of their projections (the first
+  // half of them, in the order of the projections, go to the first
+  // child), or at their mean if median is false. As with
+  // SampledKMeansSplitter::SetSampling, the settings are static.
+  static void SetSplitting(
+      const size_t sample_size,
+      const size_t max_iterations,
+      const double tolerance,
+      const bool median = true);
+
+  // The seed of the direction (and of the sample), as
+  // KMeansSplitter::SetSeed
+  void SetSeed(const unsigned seed) { seed_ = seed; }
+
+  // The threads of the passes over the points, as
+  // KMeansSplitter::SetThreads
+  void SetThreads(const size_t n_threads)
+  {
+    n_threads_ = std::max((size_t) 1, n_threads);
+  }
+
+  // TTable is Table<T> or SparseTable<T>
+  template <class TTable>
+  void PartitionData(
+      const TTable& data,
+      const size_t begin_index,
+      const size_t end_index,
+      std::vector<size_t>& membership,
+      std::vector<Point<T> >& centers,
+      std::vector<double>& radii);
+}; // class ProjectionSplitter
+
+template <typename T, class TBregmanDiv>
+using RandomProjectionSplitter =
+  ProjectionSplitter<T, TBregmanDiv, kRandomDirection>;
+
+template <typename T, class TBregmanDiv>
+using PCASplitter = ProjectionSplitter<T, TBregmanDiv, kPrincipalDirection>;
+
+} // namespace
+#include "projection_splitter_impl.hpp"
+
+#endif
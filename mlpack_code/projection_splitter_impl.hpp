@@ -0,0 +1,217 @@
+/**
+ * @file bregman_mst/mlpack_code/projection_splitter_impl.hpp
+ *
+ * Implementation of the functions defined in projection_splitter.hpp
+ */
+
+#ifndef BMST_PROJECTION_SPLITTER_IMPL_HPP_
+#define BMST_PROJECTION_SPLITTER_IMPL_HPP_
+
+#include <math.h>
+
+#include <iostream>
+#include <limits>
+#include <utility>
+
+#include "parallel.hpp"
+#include "projection_splitter.hpp"
+
+namespace bmst {
+
+template<typename T, class TBregmanDiv, SplitDirection kDirection>
+size_t ProjectionSplitter<T, TBregmanDiv, kDirection>::sample_size_ =
+  kPCASampleSize;
+
+template<typename T, class TBregmanDiv, SplitDirection kDirection>
+size_t ProjectionSplitter<T, TBregmanDiv, kDirection>::max_iterations_ =
+  kPowerIterations;
+
+template<typename T, class TBregmanDiv, SplitDirection kDirection>
+double ProjectionSplitter<T, TBregmanDiv, kDirection>::tolerance_ =
+  kPowerTolerance;
+
+template<typename T, class TBregmanDiv, SplitDirection kDirection>
+bool ProjectionSplitter<T, TBregmanDiv, kDirection>::median_ = true;
+
+template<typename T, class TBregmanDiv, SplitDirection kDirection>
+ProjectionSplitter<T, TBregmanDiv, kDirection>::ProjectionSplitter(
+    const size_t k) :
+  seed_(0),
+  n_threads_(1)
+{
+  if (k != 2)
+  {
+    std::cout << "[ERROR] The projection splitters only split in 2, not " <<
+      k << "." << std::endl;
+    exit(1);
+  }
+}
+
+template<typename T, class TBregmanDiv, SplitDirection kDirection>
+void ProjectionSplitter<T, TBregmanDiv, kDirection>::SetSplitting(
+    const size_t sample_size,
+    const size_t max_iterations,
+    const double tolerance,
+    const bool median)
+{
+  sample_size_ = std::max((size_t) 1, sample_size);
+  max_iterations_ = max_iterations;
+  tolerance_ = tolerance;
+  median_ = median;
+}
+
+template<typename T, class TBregmanDiv, SplitDirection kDirection>
+template<class TTable>
+void ProjectionSplitter<T, TBregmanDiv, kDirection>::Direction_(
+    const TTable& data,
+    const size_t begin_index,
+    const size_t end_index,
+    std::default_random_engine& gen,
+    Point<T>& direction) const
+{
+  const size_t n_dims = data[begin_index].n_dims();
+  std::normal_distribution<double> gaussian;
+  direction.zeros(n_dims);
+  for (size_t j = 0; j < n_dims; j++)
+    direction[j] = gaussian(gen);
+  if (kDirection == kRandomDirection)
+    return;
+
+  // the centered gradients of the sample, drawn without replacement
+  // (see SampleRange)
+  std::vector<size_t> sample;
+  SampleRange(begin_index, end_index, sample_size_, gen, sample);
+  Table<T> gradients(sample.size(), n_dims);
+  Point<T> mean;
+  mean.zeros(n_dims);
+  Point<T> gradient;
+  for (size_t s = 0; s < sample.size(); s++)
+  {
+    TBregmanDiv::Gradient(data[sample[s]], gradient);
+    std::copy(gradient.values(), gradient.values() + n_dims,
+        gradients[s].values());
+    mean += gradient;
+  }
+  mean /= (double) sample.size();
+  for (size_t s = 0; s < sample.size(); s++)
+    for (size_t j = 0; j < n_dims; j++)
+      gradients[s][j] -= mean[j];
+
+  // the power iteration on their covariance, from the random direction
+  Point<T> v = direction;
+  v /= sqrt(Dot(v, v));
+  Point<T> w;
+  for (size_t iter = 0; iter < max_iterations_; iter++)
+  {
+    w.zeros(n_dims);
+    for (size_t s = 0; s < sample.size(); s++)
+    {
+      const double projection =
+        Dot(ConstPointView<T>(gradients[s]), ConstPointView<T>(v));
+      for (size_t j = 0; j < n_dims; j++)
+        w[j] += projection * gradients[s][j];
+    }
+    const double norm = sqrt(Dot(w, w));
+    // the gradients are all the same (or not finite, as for the zeros of
+    // the KL divergence): keep the last direction
+    if (not (norm > 0) or isinf(norm))
+      break;
+    w /= norm;
+    const double cosine = Dot(v, w);
+    v = w;
+    if (1 - fabs(cosine) <= tolerance_)
+      break;
+  }
+  direction = v;
+}
+
+template<typename T, class TBregmanDiv, SplitDirection kDirection>
+template<class TTable>
+void ProjectionSplitter<T, TBregmanDiv, kDirection>::PartitionData(
+    const TTable& data,
+    const size_t begin_index,
+    const size_t end_index,
+    std::vector<size_t>& membership,
+    std::vector<Point<T> >& centers,
+    std::vector<double>& radii)
+{
+  if (end_index <= begin_index)
+  {
+    std::cout << "[ERROR] Requested begin index: " << begin_index << ", " <<
+      "Requested end index: " << end_index << " -- can't really split "
+      "this chunk." << std::endl;
+    return;
+  }
+  const size_t n_points = end_index - begin_index;
+  const size_t n_dims = data[begin_index].n_dims();
+  std::default_random_engine gen(
+      seed_ != 0 ? seed_ : std::random_device()());
+  Point<T> direction;
+  Direction_(data, begin_index, end_index, gen, direction);
+
+  // the projections of the gradients, block by block (see
+  // KMeansSplitter::SetThreads), with a gradient per block; the ones
+  // which are not numbers (from infinite gradients) go last
+  const size_t n_blocks =
+    (n_points + kKMeansBlockPoints - 1) / kKMeansBlockPoints;
+  std::vector<std::pair<double, size_t> > projections(n_points);
+  ParallelFor(n_blocks, n_threads_, [&](const size_t block)
+  {
+    const size_t block_begin = begin_index + block * kKMeansBlockPoints;
+    const size_t block_end =
+      std::min(end_index, block_begin + kKMeansBlockPoints);
+    Point<T> gradient;
+    for (size_t i = block_begin; i < block_end; i++)
+    {
+      TBregmanDiv::Gradient(data[i], gradient);
+      const double projection = Dot(gradient, direction);
+      projections[i - begin_index] = std::make_pair(
+          isnan(projection) ?
+          std::numeric_limits<double>::infinity() : projection,
+          i - begin_index);
+    }
+  });
+
+  // the first half of the points in the order of the projections, or
+  // the ones below the mean, go to the first child
+  membership.assign(n_points, 1);
+  if (median_)
+  {
+    std::nth_element(projections.begin(),
+        projections.begin() + n_points / 2, projections.end());
+    for (size_t i = 0; i < n_points / 2; i++)
+      membership[projections[i].second] = 0;
+  }
+  else
+  {
+    double mean = 0;
+    size_t n_finite = 0;
+    for (size_t i = 0; i < n_points; i++)
+    {
+      if (not isinf(projections[i].first))
+      {
+        mean += projections[i].first;
+        n_finite++;
+      }
+    }
+    mean /= std::max(n_finite, (size_t) 1);
+    for (size_t i = 0; i < n_points; i++)
+      if (projections[i].first < mean)
+        membership[i] = 0;
+  }
+
+  // the centers are the means of the children
+  centers.assign(2, Point<T>());
+  for (size_t j = 0; j < 2; j++)
+    centers[j].zeros(n_dims);
+  MeanCenters(data, begin_index, end_index, membership, n_threads_,
+      centers);
+
+  // compute the radii for each of the centers
+  CenterRadii<TBregmanDiv>(data, begin_index, end_index, membership,
+      centers, n_threads_, radii);
+} // PartitionData
+
+} // namespace
+
+#endif
@@ -0,0 +1,105 @@
+/**
+ * @file bregman_mst/mlpack_code/quantized_data.hpp
+ *
+ * Quantized tables for large sets of non-negative histograms. Every bin
+ * is stored as an 8 or 16-bit code, and the value of a bin is its code
+ * times the scale of its point (or of the whole table). The divergences
+ * dequantize the codes on the fly.
+ *
+ * A tree built on a quantized table computes its centroids and radii
+ * from the dequantized points with the same kernels as the search, so
+ * the pruning is exact for the quantized points without any slack. The
+ * search can re-rank its candidates with the full precision points (see
+ * LeftNNSearch::ComputeNeighbor).
+ */
+
+#ifndef BMST_QUANTIZED_DATA_HPP_
+#define BMST_QUANTIZED_DATA_HPP_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "data.hpp"
+
+namespace bmst
+{
+
+// Non-owning read-only view of a quantized point; the value of the
+// i-th bin is codes()[i] * scale()
+template <typename T, typename Q>
+class QuantizedPointView
+{
+private:
+  const Q* codes_;
+  T scale_;
+  size_t n_dims_;
+
+public:
+  QuantizedPointView();
+  QuantizedPointView(const Q* codes, const T scale, const size_t n_dims);
+
+  const size_t n_dims() const { return n_dims_; }
+  const Q* codes() const { return codes_; }
+  const T scale() const { return scale_; }
+
+  // The dequantized value of the i-th bin
+  const T operator[](const size_t i) const;
+
+  // The dequantized copy of the point
+  operator Point<T>() const;
+
+  void print() const;
+
+};
+
+// center += x
+template<typename T, typename Q>
+Point<T>& operator+=(Point<T>& center, const QuantizedPointView<T, Q>& x);
+
+// <a, b> for a quantized a and a dense b
+template<typename T, typename Q>
+double Dot(const QuantizedPointView<T, Q>& a, const ConstPointView<T>& b);
+
+// \sum_i a_i over the dequantized bins
+template<typename T, typename Q>
+double Sum(const QuantizedPointView<T, Q>& a);
+
+// Q is uint8_t or uint16_t. Every bin is rounded to the nearest code, so
+// a dequantized bin is off by at most half the scale of its point.
+template <typename T, typename Q>
+class QuantizedTable
+{
+private:
+  // row-major codes, n_dims_ per point
+  std::vector<Q> codes_;
+  std::vector<T> scales_;
+  size_t n_dims_;
+
+public:
+  QuantizedTable();
+  // Quantize a table of non-negative points, with a scale per point
+  // (the largest bin of the point gets the largest code) or one scale
+  // for the whole table.
+  QuantizedTable(const Table<T>& table, const bool per_point_scale = true);
+
+  const size_t n_points() const { return scales_.size(); }
+  const size_t n_dims() const { return n_dims_; }
+
+  QuantizedPointView<T, Q> operator[](const size_t i) const;
+
+  // The largest error of a dequantized bin of the i-th point
+  const T MaxError(const size_t i) const { return 0.5 * scales_[i]; }
+
+  // Swap the i-th and the j-th points in place
+  void Swap(const size_t i, const size_t j);
+
+  void print() const;
+
+}; // class
+
+}; // namespace
+
+#include "quantized_data_impl.hpp"
+
+#endif
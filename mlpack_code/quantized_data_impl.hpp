@@ -0,0 +1,190 @@
+/**
+ * @file bregman_mst/mlpack_code/quantized_data_impl.hpp
+ *
+ * Implementation of the functions defined in quantized_data.hpp
+ */
+
+#ifndef BMST_QUANTIZED_DATA_IMPL_HPP_
+#define BMST_QUANTIZED_DATA_IMPL_HPP_
+
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+
+#include "quantized_data.hpp"
+
+namespace bmst
+{
+
+template <typename T, typename Q>
+QuantizedPointView<T, Q>::QuantizedPointView() :
+  codes_(NULL),
+  scale_(0),
+  n_dims_(0)
+{}
+
+template <typename T, typename Q>
+QuantizedPointView<T, Q>::QuantizedPointView(
+    const Q* codes, const T scale, const size_t n_dims) :
+  codes_(codes),
+  scale_(scale),
+  n_dims_(n_dims)
+{}
+
+template <typename T, typename Q>
+const T QuantizedPointView<T, Q>::operator[](const size_t i) const
+{
+  if (i >= n_dims_)
+  {
+    std::cout << "[ERROR] Point index out of range" << std::endl;
+    exit(1);
+  }
+  return codes_[i] * scale_;
+}
+
+template <typename T, typename Q>
+QuantizedPointView<T, Q>::operator Point<T>() const
+{
+  Point<T> point;
+  point.zeros(n_dims_);
+  T* point_values = point.values();
+  for (size_t i = 0; i < n_dims_; i++)
+    point_values[i] = codes_[i] * scale_;
+  return point;
+}
+
+template <typename T, typename Q>
+void QuantizedPointView<T, Q>::print() const
+{
+  ((Point<T>) *this).print();
+}
+
+template<typename T, typename Q>
+Point<T>& operator+=(Point<T>& center, const QuantizedPointView<T, Q>& x)
+{
+  if (center.n_dims() != x.n_dims())
+  {
+    std::cout << "[ERROR] Dimensions mismatch in point addition" <<
+      std::endl;
+    exit(1);
+  }
+  T* center_values = center.values();
+  const Q* x_codes = x.codes();
+  const T x_scale = x.scale();
+  for (size_t i = 0; i < x.n_dims(); i++)
+    center_values[i] += x_codes[i] * x_scale;
+  return center;
+}
+
+template<typename T, typename Q>
+double Dot(const QuantizedPointView<T, Q>& a, const ConstPointView<T>& b)
+{
+  if (a.n_dims() != b.n_dims())
+  {
+    std::cout << "[ERROR] Dimension mismatch in dot product computation" <<
+      std::endl;
+    exit(1);
+  }
+  const Q* a_codes = a.codes();
+  const T* b_values = b.values();
+  // the scale is common to all the bins
+  double dot_product = 0;
+  for (size_t i = 0; i < a.n_dims(); i++)
+    dot_product += a_codes[i] * b_values[i];
+  return a.scale() * dot_product;
+}
+
+template<typename T, typename Q>
+double Sum(const QuantizedPointView<T, Q>& a)
+{
+  const Q* a_codes = a.codes();
+  double sum = 0;
+  for (size_t i = 0; i < a.n_dims(); i++)
+    sum += a_codes[i];
+  return a.scale() * sum;
+}
+
+template <typename T, typename Q>
+QuantizedTable<T, Q>::QuantizedTable() :
+  n_dims_(0)
+{}
+
+template <typename T, typename Q>
+QuantizedTable<T, Q>::QuantizedTable(
+    const Table<T>& table, const bool per_point_scale) :
+  codes_(table.n_points() * table.n_dims()),
+  scales_(table.n_points()),
+  n_dims_(table.n_dims())
+{
+  const double max_code = std::numeric_limits<Q>::max();
+  double table_max = 0;
+  for (size_t i = 0; i < table.n_points(); i++)
+  {
+    const T* row = table[i].values();
+    double point_max = 0;
+    for (size_t j = 0; j < n_dims_; j++)
+    {
+      if (row[j] < 0)
+      {
+        std::cout << "[ERROR] Only non-negative points can be quantized." <<
+          std::endl;
+        exit(1);
+      }
+      point_max = std::max(point_max, (double) row[j]);
+    }
+    scales_[i] = point_max / max_code;
+    table_max = std::max(table_max, point_max);
+  }
+  if (not per_point_scale)
+    std::fill(scales_.begin(), scales_.end(), table_max / max_code);
+
+  for (size_t i = 0; i < table.n_points(); i++)
+  {
+    if (scales_[i] == 0)
+      continue;
+    const T* row = table[i].values();
+    Q* point_codes = codes_.data() + i * n_dims_;
+    for (size_t j = 0; j < n_dims_; j++)
+      point_codes[j] = (Q) std::min(max_code, round(row[j] / scales_[i]));
+  }
+}
+
+template <typename T, typename Q>
+QuantizedPointView<T, Q> QuantizedTable<T, Q>::operator[](
+    const size_t i) const
+{
+  if (i >= n_points())
+  {
+    std::cout << "[ERROR] Table index out of range" << std::endl;
+    exit(1);
+  }
+  return QuantizedPointView<T, Q>(
+      codes_.data() + i * n_dims_, scales_[i], n_dims_);
+}
+
+template <typename T, typename Q>
+void QuantizedTable<T, Q>::Swap(const size_t i, const size_t j)
+{
+  if (i == j)
+    return;
+  std::swap_ranges(
+      codes_.begin() + i * n_dims_,
+      codes_.begin() + (i + 1) * n_dims_,
+      codes_.begin() + j * n_dims_);
+  std::swap(scales_[i], scales_[j]);
+}
+
+template <typename T, typename Q>
+void QuantizedTable<T, Q>::print() const
+{
+  for (size_t i = 0; i < n_points(); i++)
+    (*this)[i].print();
+}
+
+}; // namespace
+
+#endif
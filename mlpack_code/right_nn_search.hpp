@@ -0,0 +1,76 @@
+#ifndef BMST_RIGHT_NN_SEARCH_HPP_
+#define BMST_RIGHT_NN_SEARCH_HPP_
+
+#include <queue>
+#include <utility>
+
+#include "bregman_ball_tree.hpp"
+#include "divergence_cache.hpp"
+#include "kmeans_splitter.hpp"
+
+namespace bmst {
+
+// The right nearest neighbor argmin_x d(q, x) of a query, the reverse of 
+// LeftNNSearch: the nodes are pruned with their left balls 
+// {x : d(mu, x) <= R} (see BregmanBall::CanPruneLeft). The references 
+// are dense.
+template<typename T, class TBDiv, class TBBall>
+class RightNNSearch {
+public:
+  
+  RightNNSearch(const Table<T>& data, const size_t leaf_size);
+  
+  ~RightNNSearch();
+  
+  size_t ComputeNeighbor(const ConstPointView<T>& query);
+  
+  size_t ComputeNeighborNaive(const ConstPointView<T>& query);
+
+  // ComputeNeighborNaive for all the queries, from the divergence 
+  // matrices of blocks of queries to the references computed by 
+  // n_threads threads
+  void ComputeNeighborsNaive(
+      const Table<T>& queries, 
+      std::vector<size_t>& neighbors,
+      const size_t n_threads = 1);
+  
+private:
+  
+  typedef KMeansSplitter<T, TBDiv> TSplitter;
+  
+  typedef BregmanBallTree<T, TBDiv, TBBall, TSplitter> TTreeType;
+
+  Table<T> data_;
+  
+  TTreeType* tree_;
+
+  size_t leaf_size_;
+  
+  size_t neighbor_index_;
+  // an upper bound on the exact divergence to the neighbor found so far
+  // (its computed divergence plus TBDiv::BDivergenceError)
+  double neighbor_distance_;
+  double neighbor_computed_distance_;
+
+  std::vector<size_t> old_from_new_indices_;
+
+  // phi(), the gradients and offset() of the (reordered) references, so
+  // that d(q, x) = phi(q) - <q, grad phi(x)> + offset(x) costs one dot
+  // product for the references with a finite gradient
+  DivergenceCache<T, TBDiv> cache_;
+
+  // phi() and TBDiv::ClosedFormNorm() of the current query
+  double query_phi_;
+  double query_norm_;
+  
+  // functions
+  void SearchNode_(
+      const TTreeType* node,
+      const ConstPointView<T>& query);
+}; // class
+
+} // namespace
+
+#endif
+
+#include "right_nn_search_impl.hpp"
@@ -0,0 +1,177 @@
+
+#ifndef BMST_RIGHT_NN_SEARCH_IMPL_HPP_
+#define BMST_RIGHT_NN_SEARCH_IMPL_HPP_
+
+#include "right_nn_search.hpp"
+
+namespace bmst {
+
+template<typename T, class TBDiv, class TBBall>
+RightNNSearch<T, TBDiv, TBBall>::RightNNSearch(
+    const Table<T>& data, const size_t leaf_size) :
+  data_(data),
+  leaf_size_(leaf_size),
+  neighbor_index_(-1),
+  neighbor_distance_(std::numeric_limits<T>::max()),
+  neighbor_computed_distance_(std::numeric_limits<T>::max())
+{
+  tree_ = new TTreeType(data_, old_from_new_indices_, leaf_size_);
+  cache_ = DivergenceCache<T, TBDiv>(data_, true);
+}
+
+template<typename T, class TBDiv, class TBBall>
+RightNNSearch<T, TBDiv, TBBall>::~RightNNSearch()
+{
+  if (tree_)
+    delete tree_;
+}
+
+template<typename T, class TBDiv, class TBBall>
+size_t RightNNSearch<T, TBDiv, TBBall>::ComputeNeighbor(
+    const ConstPointView<T>& query)
+{
+  neighbor_index_ = -1;
+  neighbor_distance_ = std::numeric_limits<T>::max();
+  neighbor_computed_distance_ = std::numeric_limits<T>::max();
+  query_phi_ = TBDiv::Phi(query);
+  query_norm_ = TBDiv::ClosedFormNorm(query, query_phi_);
+
+  SearchNode_(tree_, query);
+  
+  if (neighbor_index_ == -1) {
+    assert(neighbor_distance_ == std::numeric_limits<T>::max());
+    return -1;
+  } else {
+    assert(neighbor_distance_ < std::numeric_limits<T>::max());
+    assert(old_from_new_indices_[neighbor_index_]  < data_.n_points());
+    return old_from_new_indices_[neighbor_index_];
+  }
+}
+
+template<typename T, class TBDiv, class TBBall>
+size_t RightNNSearch<T, TBDiv, TBBall>::ComputeNeighborNaive(
+    const ConstPointView<T>& query)
+{
+  neighbor_index_ = -1;
+  neighbor_distance_ = std::numeric_limits<T>::max();
+  
+  for (int r = 0; r < data_.n_points(); r++)
+  {
+    double this_dist = TBDiv::BDivergence(query, data_[r]);
+    
+    if (this_dist < neighbor_distance_) 
+    {
+      neighbor_index_ = r;
+      neighbor_distance_ = this_dist;
+    }
+  } // loop over references
+
+  if (neighbor_index_ == -1) {
+    assert(neighbor_distance_ == std::numeric_limits<T>::max());
+    return -1;
+  } else {
+    assert(neighbor_distance_ < std::numeric_limits<T>::max());
+    assert(old_from_new_indices_[neighbor_index_]  < data_.n_points());
+    return old_from_new_indices_[neighbor_index_];
+  }
+}
+
+template<typename T, class TBDiv, class TBBall>
+void RightNNSearch<T, TBDiv, TBBall>::ComputeNeighborsNaive(
+    const Table<T>& queries, 
+    std::vector<size_t>& neighbors,
+    const size_t n_threads)
+{
+  // the matrices of a block of queries take at most 
+  // 8 * data_.n_points() * kBlock bytes
+  const size_t kBlock = 256;
+  neighbors.assign(queries.n_points(), -1);
+  Table<double> divergences;
+  for (size_t begin = 0; begin < queries.n_points(); begin += kBlock)
+  {
+    const size_t end = std::min(queries.n_points(), begin + kBlock);
+    TBDiv::BDivergenceMatrix(queries, begin, end, 
+        data_, 0, data_.n_points(), divergences, n_threads);
+    // one row of the matrix per query
+    for (size_t q = begin; q < end; q++)
+    {
+      const double* divergences_q = divergences[q - begin].values();
+      double neighbor_distance = std::numeric_limits<T>::max();
+      for (size_t r = 0; r < data_.n_points(); r++)
+      {
+        if (divergences_q[r] < neighbor_distance)
+        {
+          neighbors[q] = old_from_new_indices_[r];
+          neighbor_distance = divergences_q[r];
+        }
+      }
+    }
+  }
+}
+
+template<typename T, class TBDiv, class TBBall>
+void RightNNSearch<T, TBDiv, TBBall>::SearchNode_(
+    const TTreeType* node, 
+    const ConstPointView<T>& query) 
+{
+  // at leaf, do exhaustive search
+  if (node->IsLeaf()) 
+  {
+    for (int i = node->Begin(); i < node->End(); i++)
+    {
+      if (cache_.closed_form(i))
+      {
+        // the closed form loses more to cancellation than the 
+        // divergence itself, so the bound is padded by its own error
+        const double dist = TBDiv::BDivergence(query_phi_, query, 
+            cache_.gradient(i), cache_.offset(i));
+        if (dist < neighbor_computed_distance_) 
+        {
+          neighbor_index_ = i;
+          neighbor_computed_distance_ = dist;
+          neighbor_distance_ = 
+            dist + cache_.ErrorTo(i, query_phi_, query_norm_);
+        }
+      }
+      else
+      {
+        const double dist = 
+          TBDiv::BDivergence(query, data_[i], neighbor_distance_);
+        if (dist < neighbor_computed_distance_) 
+        {
+          neighbor_index_ = i;
+          neighbor_computed_distance_ = dist;
+          neighbor_distance_ = 
+            dist + TBDiv::BDivergenceError(query, data_[i], dist);
+        }
+      }
+    } // for references
+    return;
+  } // base case
+
+  const double d_left = 
+    TBDiv::BDivergence(node->Left()->LCenter(), query);
+  const double d_right = 
+    TBDiv::BDivergence(node->Right()->LCenter(), query);
+  // Prioritize search by the divergence from the left centroids
+  if (d_left < d_right)
+  {
+    SearchNode_(node->Left(), query);
+    if (not node->Right()->Bound().CanPruneLeft(
+        query, neighbor_distance_, d_right))
+      SearchNode_(node->Right(), query);
+  }
+  else 
+  {
+    SearchNode_(node->Right(), query);
+    if (not node->Left()->Bound().CanPruneLeft(
+        query, neighbor_distance_, d_left))
+      SearchNode_(node->Left(), query);
+  } 
+
+  return;
+} // SearchNode_() 
+
+} // namespace
+
+#endif
@@ -0,0 +1,98 @@
+/**
+ * @file bregman_mst/mlpack_code/sampled_kmeans_splitter.hpp
+ *
+ * A cheaper 2-means clustering for constructing Bregman ball trees: the
+ * centers are fitted on a bounded random sample of the points of the
+ * node (by Lloyd iterations on the sample, or by mini-batch updates),
+ * and then every point of the node is assigned to its closest center in
+ * a single pass (which the nodes no larger than the sample skip). The
+ * centers are then the means of their points, as with KMeansSplitter. A
+ * split takes O(sample_size * max_iterations + n) divergences instead of
+ * O(n) per Lloyd iteration, so that building a tree takes close to
+ * O(n log n) divergences.
+ */
+
+#ifndef BMST_SAMPLED_KMEANS_SPLITTER_HPP_
+#define BMST_SAMPLED_KMEANS_SPLITTER_HPP_
+
+#include <algorithm>
+#include <vector>
+
+#include "data.hpp"
+#include "kmeans_splitter.hpp"
+
+namespace bmst {
+
+// The defaults of SampledKMeansSplitter::SetSampling
+const size_t kKMeansSampleSize = 256;
+const size_t kKMeansSampleIterations = 100;
+const double kKMeansSampleTolerance = 1e-4;
+
+template <typename T, class TBregmanDiv>
+class SampledKMeansSplitter
+{
+private:
+  size_t k_;
+  unsigned seed_;
+  size_t n_threads_;
+
+  // the settings of SetSampling
+  static size_t sample_size_;
+  static size_t max_iterations_;
+  static double tolerance_;
+  static size_t batch_size_;
+
+  // the index of the center closest to x, and the divergence to it
+  template <class TPoint>
+  size_t ClosestCenter_(
+      const TPoint& x,
+      const std::vector<Point<T> >& centers,
+      double& min_div) const;
+
+public:
+  SampledKMeansSplitter(const size_t k = 2);
+
+  // The centers are fitted on sample_size points of the node drawn
+  // without replacement (all of them in the smaller nodes), with Lloyd
+  // iterations until the assignment of the sample is stable, the
+  // objective on it decreases by at most tolerance (relatively) or for
+  // max_iterations iterations; if the sample is the whole node, its last
+  // assignment is the split. With batch_size > 0, they are fitted by
+  // mini-batch updates instead: every iteration draws batch_size points
+  // of the node, and the centers move toward them with a step of
+  // 1 / (the points they got so far), until the (smoothed) objective on
+  // the batches changes by at most tolerance. The settings are shared by
+  // all the splitters (which the tree builds for every node), and must
+  // not change during a build.
+  static void SetSampling(
+      const size_t sample_size,
+      const size_t max_iterations,
+      const double tolerance,
+      const size_t batch_size = 0);
+
+  // The seed of the sample and of the first center, as
+  // KMeansSplitter::SetSeed
+  void SetSeed(const unsigned seed) { seed_ = seed; }
+
+  // The threads of the pass over all the points, as
+  // KMeansSplitter::SetThreads (the fit on the sample is serial)
+  void SetThreads(const size_t n_threads)
+  {
+    n_threads_ = std::max((size_t) 1, n_threads);
+  }
+
+  // TTable is Table<T> or SparseTable<T>
+  template <class TTable>
+  void PartitionData(
+      const TTable& data,
+      const size_t begin_index,
+      const size_t end_index,
+      std::vector<size_t>& membership,
+      std::vector<Point<T> >& centers,
+      std::vector<double>& radii);
+}; // class SampledKMeansSplitter
+
+} // namespace
+#include "sampled_kmeans_splitter_impl.hpp"
+
+#endif
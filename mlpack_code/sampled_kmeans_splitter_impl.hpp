@@ -0,0 +1,263 @@
+/**
+ * @file bregman_mst/mlpack_code/sampled_kmeans_splitter_impl.hpp
+ *
+ * Implementation of the functions defined in sampled_kmeans_splitter.hpp
+ */
+
+#ifndef BMST_SAMPLED_KMEANS_SPLITTER_IMPL_HPP_
+#define BMST_SAMPLED_KMEANS_SPLITTER_IMPL_HPP_
+
+#include <math.h>
+
+#include <iostream>
+#include <limits>
+#include <random>
+
+#include "parallel.hpp"
+#include "sampled_kmeans_splitter.hpp"
+
+namespace bmst {
+
+template<typename T, class TBregmanDiv>
+size_t SampledKMeansSplitter<T, TBregmanDiv>::sample_size_ =
+  kKMeansSampleSize;
+
+template<typename T, class TBregmanDiv>
+size_t SampledKMeansSplitter<T, TBregmanDiv>::max_iterations_ =
+  kKMeansSampleIterations;
+
+template<typename T, class TBregmanDiv>
+double SampledKMeansSplitter<T, TBregmanDiv>::tolerance_ =
+  kKMeansSampleTolerance;
+
+template<typename T, class TBregmanDiv>
+size_t SampledKMeansSplitter<T, TBregmanDiv>::batch_size_ = 0;
+
+template<typename T, class TBregmanDiv>
+SampledKMeansSplitter<T, TBregmanDiv>::SampledKMeansSplitter(
+    const size_t k) :
+  k_(k),
+  seed_(0),
+  n_threads_(1)
+{}
+
+template<typename T, class TBregmanDiv>
+void SampledKMeansSplitter<T, TBregmanDiv>::SetSampling(
+    const size_t sample_size,
+    const size_t max_iterations,
+    const double tolerance,
+    const size_t batch_size)
+{
+  sample_size_ = std::max((size_t) 1, sample_size);
+  max_iterations_ = max_iterations;
+  tolerance_ = tolerance;
+  batch_size_ = batch_size;
+}
+
+template<typename T, class TBregmanDiv>
+template<class TPoint>
+size_t SampledKMeansSplitter<T, TBregmanDiv>::ClosestCenter_(
+    const TPoint& x,
+    const std::vector<Point<T> >& centers,
+    double& min_div) const
+{
+  // a point infinitely far from all the centers goes to the first one
+  // (see KMeansSplitter)
+  min_div = std::numeric_limits<double>::max();
+  size_t min_index = 0;
+  for (size_t j = 0; j < centers.size(); j++)
+  {
+    const double div_to_center = TBregmanDiv::BDivergence(x, centers[j]);
+    if (div_to_center < min_div)
+    {
+      min_div = div_to_center;
+      min_index = j;
+    }
+  }
+  return min_index;
+}
+
+template<typename T, class TBregmanDiv>
+template<class TTable>
+void SampledKMeansSplitter<T, TBregmanDiv>::PartitionData(
+    const TTable& data,
+    const size_t begin_index,
+    const size_t end_index,
+    std::vector<size_t>& membership,
+    std::vector<Point<T> >& centers,
+    std::vector<double>& radii)
+{
+  if (end_index <= begin_index)
+  {
+    std::cout << "[ERROR] Requested begin index: " << begin_index << ", " <<
+      "Requested end index: " << end_index << " -- can't really cluster "
+      "this chunk." << std::endl;
+    return;
+  }
+  const size_t n_points = end_index - begin_index;
+  const size_t n_dims = data[begin_index].n_dims();
+  std::default_random_engine gen(
+      seed_ != 0 ? seed_ : std::random_device()());
+
+  // the sample, in the order of the data
+  std::vector<size_t> sample;
+  SampleRange(begin_index, end_index, sample_size_, gen, sample);
+
+  // a random point of the sample and then the farthest ones, as in
+  // KMeansSplitter. If the sample has less than k_ distinct points, the
+  // other centers are copies of the first one, and all the points go to
+  // it.
+  centers.resize(0);
+  std::uniform_int_distribution<size_t> sample_rand(0, sample.size() - 1);
+  centers.push_back(data[sample[sample_rand(gen)]]);
+  std::vector<double> div_to_closest_mean(
+      sample.size(), std::numeric_limits<double>::max());
+  for (size_t j = 1; j < k_; j++)
+  {
+    double max_div_to_closest_center = 0;
+    size_t max_index = sample.size();
+    for (size_t s = 0; s < sample.size(); s++)
+    {
+      const double div_to_center =
+        TBregmanDiv::BDivergence(data[sample[s]], centers[j - 1]);
+      if (div_to_center < div_to_closest_mean[s])
+        div_to_closest_mean[s] = div_to_center;
+      if (div_to_closest_mean[s] > max_div_to_closest_center)
+      {
+        max_div_to_closest_center = div_to_closest_mean[s];
+        max_index = s;
+      }
+    }
+    if (max_index == sample.size())
+      centers.push_back(centers[0]);
+    else
+      centers.push_back(data[sample[max_index]]);
+  }
+
+  // fit the centers
+  std::vector<Point<T> > sums(k_);
+  std::vector<double> counts(k_);
+  // the assignment of the sample by the last Lloyd iteration, and the
+  // centers are the means of it; it is the one of the node if the sample
+  // is the whole node
+  std::vector<size_t> sample_membership;
+  if (batch_size_ == 0)
+  {
+    // Lloyd iterations on the sample, until the assignment is stable (as
+    // in KMeansSplitter) or the objective stops decreasing
+    double prev_obj = std::numeric_limits<double>::infinity();
+    for (size_t iter = 0; iter < max_iterations_; iter++)
+    {
+      for (size_t j = 0; j < k_; j++)
+        sums[j].zeros(n_dims);
+      counts.assign(k_, 0);
+      double obj = 0;
+      bool changed = sample_membership.empty();
+      sample_membership.resize(sample.size());
+      for (size_t s = 0; s < sample.size(); s++)
+      {
+        double min_div;
+        const size_t j = ClosestCenter_(data[sample[s]], centers, min_div);
+        obj += min_div;
+        sums[j] += data[sample[s]];
+        counts[j]++;
+        changed = changed or sample_membership[s] != j;
+        sample_membership[s] = j;
+      }
+      // the centers are already the means of this assignment
+      if (not changed)
+        break;
+      for (size_t j = 0; j < k_; j++)
+      {
+        if (counts[j] > 0)
+        {
+          centers[j] = sums[j];
+          centers[j] /= counts[j];
+        }
+      }
+      // the objective of the previous centers decreases at every step
+      if (obj == 0 or (not isinf(prev_obj)
+                       and prev_obj - obj <= tolerance_ * prev_obj))
+        break;
+      prev_obj = obj;
+    }
+  }
+  else
+  {
+    // mini-batch updates: the points of a batch are assigned to the
+    // centers first, and then every center moves to the mean of all the
+    // points it got so far (as if it was their running mean)
+    std::uniform_int_distribution<size_t> node_rand(
+        begin_index, end_index - 1);
+    std::vector<size_t> batch(batch_size_);
+    std::vector<size_t> batch_membership(batch_size_);
+    counts.assign(k_, 0);
+    double smoothed_obj = 0;
+    for (size_t iter = 0; iter < max_iterations_; iter++)
+    {
+      double batch_obj = 0;
+      for (size_t b = 0; b < batch_size_; b++)
+      {
+        double min_div;
+        batch[b] = node_rand(gen);
+        batch_membership[b] = ClosestCenter_(data[batch[b]], centers, min_div);
+        batch_obj += min_div;
+      }
+      batch_obj /= batch_size_;
+      for (size_t b = 0; b < batch_size_; b++)
+      {
+        // c <- c + (x - c) / count, without a temporary point
+        const size_t j = batch_membership[b];
+        counts[j]++;
+        centers[j] *= counts[j] - 1;
+        centers[j] += data[batch[b]];
+        centers[j] /= counts[j];
+      }
+      const double prev_smoothed_obj = smoothed_obj;
+      smoothed_obj = (iter == 0) ?
+        batch_obj : 0.7 * smoothed_obj + 0.3 * batch_obj;
+      if (batch_obj == 0 or (iter > 0 and not isinf(smoothed_obj)
+            and fabs(prev_smoothed_obj - smoothed_obj) <=
+              tolerance_ * prev_smoothed_obj))
+        break;
+    }
+  }
+
+  // a single pass over the node assigns the points, block by block (see
+  // KMeansSplitter::SetThreads), and the centers are the means of their
+  // points (the ones left without points keep their fitted value),
+  // unless the sample is the whole node and the Lloyd iterations already
+  // assigned it
+  if (sample_membership.size() == n_points)
+  {
+    membership.swap(sample_membership);
+  }
+  else
+  {
+    membership.resize(n_points);
+    const size_t n_blocks =
+      (n_points + kKMeansBlockPoints - 1) / kKMeansBlockPoints;
+    ParallelFor(n_blocks, n_threads_, [&](const size_t block)
+    {
+      const size_t block_begin = begin_index + block * kKMeansBlockPoints;
+      const size_t block_end =
+        std::min(end_index, block_begin + kKMeansBlockPoints);
+      for (size_t i = block_begin; i < block_end; i++)
+      {
+        double min_div;
+        membership[i - begin_index] =
+          ClosestCenter_(data[i], centers, min_div);
+      }
+    });
+    MeanCenters(data, begin_index, end_index, membership, n_threads_,
+        centers);
+  }
+
+  // compute the radii for each of the centers
+  CenterRadii<TBregmanDiv>(data, begin_index, end_index, membership,
+      centers, n_threads_, radii);
+} // PartitionData
+
+} // namespace
+
+#endif
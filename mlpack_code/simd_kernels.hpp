@@ -0,0 +1,173 @@
+/**
+ * @file bregman_mst/mlpack_code/simd_kernels.hpp
+ *
+ * Vectorized dot products, squared distance and axpby over raw arrays of
+ * floats or doubles, with SSE2, AVX2 and AVX-512 versions, and
+ * vectorized log and exp (AVX2) with the KL divergence kernels built on
+ * them. The widest instruction set supported by the CPU is selected
+ * (through CPUID) the first time a kernel runs; other types, other
+ * architectures and other compilers use the scalar loops, and so does
+ * every build with BMST_NO_SIMD defined. The kernels behind Dot,
+ * SquaredDistance and Axpby in data.hpp and behind KLDivergence.
+ */
+
+#ifndef BMST_SIMD_KERNELS_HPP_
+#define BMST_SIMD_KERNELS_HPP_
+
+#include <stddef.h>
+
+#if !defined(BMST_NO_SIMD) && defined(__GNUC__) && \
+  (defined(__x86_64__) || defined(__i386__))
+#define BMST_SIMD_X86 1
+#endif
+
+namespace bmst {
+namespace simd {
+
+// in increasing order of width
+enum Isa
+{
+  kScalar = 0,
+  kSse2,
+  kAvx2,
+  kAvx512
+};
+
+// The widest instruction set supported by the CPU and the OS
+inline Isa SupportedIsa();
+
+// The instruction set used by the kernels
+inline Isa ActiveIsa();
+
+// Use the given instruction set, or the widest supported one below it,
+// and return it. Meant for tests and benchmarks (e.g. to compare with
+// the scalar path); it must not be called while kernels are running.
+inline Isa SetIsa(const Isa isa);
+
+inline const char* IsaName(const Isa isa);
+
+// The sums are accumulated in double, also for floats. Their order
+// depends on the instruction set, so the results can differ in the last
+// bits from one set to another.
+
+// \sum_i a_i b_i
+template <typename T>
+double Dot(const T* a, const T* b, const size_t n_dims);
+inline double Dot(const float* a, const float* b, const size_t n_dims);
+inline double Dot(const double* a, const double* b, const size_t n_dims);
+
+// result_k = \sum_i a_i b_k_i for the four rows b[0], ..., b[3]. The
+// micro-kernel of the divergence matrices (see divergence_matrix.hpp):
+// every value of a is loaded once for the four products.
+template <typename T>
+void Dot4(
+    const T* a, const T* const* b, const size_t n_dims, double* result);
+inline void Dot4(
+    const float* a,
+    const float* const* b,
+    const size_t n_dims,
+    double* result);
+inline void Dot4(
+    const double* a,
+    const double* const* b,
+    const size_t n_dims,
+    double* result);
+
+// \sum_i (a_i - b_i)^2
+template <typename T>
+double SquaredDistance(const T* a, const T* b, const size_t n_dims);
+inline double SquaredDistance(
+    const float* a, const float* b, const size_t n_dims);
+inline double SquaredDistance(
+    const double* a, const double* b, const size_t n_dims);
+
+// result_i = alpha x_i + beta y_i, where result may alias x or y. It is
+// computed in double without fused multiply-adds, so it rounds exactly
+// like the scalar loop with every instruction set.
+template <typename T>
+void Axpby(
+    const double alpha,
+    const T* x,
+    const double beta,
+    const T* y,
+    T* result,
+    const size_t n_dims);
+inline void Axpby(
+    const double alpha,
+    const float* x,
+    const double beta,
+    const float* y,
+    float* result,
+    const size_t n_dims);
+inline void Axpby(
+    const double alpha,
+    const double* x,
+    const double beta,
+    const double* y,
+    double* result,
+    const size_t n_dims);
+
+// Element-wise log and exp, computed in double. The vectorized versions
+// (fdlibm's reductions and polynomials) are within kLogUlps and kExpUlps
+// units in the last place of the exact results; the scalar ones are
+// those of the C library, within one.
+const double kLogUlps = 2;
+const double kExpUlps = 2;
+
+template <typename T>
+void Log(const T* x, T* result, const size_t n_dims);
+inline void Log(const float* x, float* result, const size_t n_dims);
+inline void Log(const double* x, double* result, const size_t n_dims);
+
+template <typename T>
+void Exp(const T* x, T* result, const size_t n_dims);
+inline void Exp(const float* x, float* result, const size_t n_dims);
+inline void Exp(const double* x, double* result, const size_t n_dims);
+
+// The KL divergence \sum_i x_i log (x_i / y_i) + y_i - x_i, its gradient
+// log x_i + 1 and the gradient of its conjugate exp(x_i - 1). The
+// coordinates below epsilon are zeros, as in KLDivergence: the
+// divergence is max() if some y_i is zero but x_i is not, the gradient
+// of a zero is -max() and the conjugate gradient of -max() is zero. The
+// vectorized versions handle these cases with masks, without branches.
+template <typename T>
+double KLDivergence(const T* x, const T* y, const size_t n_dims);
+inline double KLDivergence(
+    const float* x, const float* y, const size_t n_dims);
+inline double KLDivergence(
+    const double* x, const double* y, const size_t n_dims);
+
+template <typename T>
+void KLGradient(const T* x, T* result, const size_t n_dims);
+inline void KLGradient(const float* x, float* result, const size_t n_dims);
+inline void KLGradient(
+    const double* x, double* result, const size_t n_dims);
+
+template <typename T>
+void KLGradientConjugate(const T* x, T* result, const size_t n_dims);
+inline void KLGradientConjugate(
+    const float* x, float* result, const size_t n_dims);
+inline void KLGradientConjugate(
+    const double* x, double* result, const size_t n_dims);
+
+// Early abandoning versions of SquaredDistance and KLDivergence: every
+// coordinate adds a non-negative term, so the sums go through blocks of
+// kAbandonBlock coordinates (on the kernels above) and stop after the
+// first block that takes them above upper_bound. The result is exact if
+// it is at most upper_bound; otherwise it is some value above it.
+const size_t kAbandonBlock = 32;
+
+template <typename T>
+double SquaredDistance(
+    const T* a, const T* b, const size_t n_dims, const double upper_bound);
+
+template <typename T>
+double KLDivergence(
+    const T* x, const T* y, const size_t n_dims, const double upper_bound);
+
+}; // namespace
+}; // namespace
+
+#include "simd_kernels_impl.hpp"
+
+#endif
@@ -0,0 +1,959 @@
+/**
+ * @file bregman_mst/mlpack_code/simd_kernels_impl.hpp
+ *
+ * Implementation of the functions defined in simd_kernels.hpp
+ */
+
+#ifndef BMST_SIMD_KERNELS_IMPL_HPP_
+#define BMST_SIMD_KERNELS_IMPL_HPP_
+
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+
+#ifdef BMST_SIMD_X86
+#include <immintrin.h>
+#endif
+
+#include "simd_kernels.hpp"
+
+namespace bmst {
+namespace simd {
+
+inline Isa SupportedIsa()
+{
+#ifdef BMST_SIMD_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f"))
+    return kAvx512;
+  if (__builtin_cpu_supports("avx2") and __builtin_cpu_supports("fma"))
+    return kAvx2;
+  if (__builtin_cpu_supports("sse2"))
+    return kSse2;
+#endif
+  return kScalar;
+}
+
+inline Isa& ActiveIsa_()
+{
+  static Isa isa = SupportedIsa();
+  return isa;
+}
+
+inline Isa ActiveIsa()
+{
+  return ActiveIsa_();
+}
+
+inline Isa SetIsa(const Isa isa)
+{
+  ActiveIsa_() = std::min(isa, SupportedIsa());
+  return ActiveIsa_();
+}
+
+inline const char* IsaName(const Isa isa)
+{
+  switch (isa)
+  {
+    case kSse2:
+      return "SSE2";
+    case kAvx2:
+      return "AVX2";
+    case kAvx512:
+      return "AVX-512";
+    default:
+      return "scalar";
+  }
+}
+
+// The scalar loops
+
+template <typename T>
+double Dot(const T* a, const T* b, const size_t n_dims)
+{
+  double dot_product = 0;
+  for (size_t i = 0; i < n_dims; i++)
+    dot_product += (a[i] * b[i]);
+  return dot_product;
+}
+
+template <typename T>
+double SquaredDistance(const T* a, const T* b, const size_t n_dims)
+{
+  double sq_distance = 0;
+  for (size_t i = 0; i < n_dims; i++)
+  {
+    const double diff = (double) a[i] - (double) b[i];
+    sq_distance += diff * diff;
+  }
+  return sq_distance;
+}
+
+template <typename T>
+void Axpby(
+    const double alpha,
+    const T* x,
+    const double beta,
+    const T* y,
+    T* result,
+    const size_t n_dims)
+{
+  for (size_t i = 0; i < n_dims; i++)
+    result[i] = alpha * x[i] + beta * y[i];
+}
+
+template <typename T>
+void Dot4(
+    const T* a, const T* const* b, const size_t n_dims, double* result)
+{
+  for (size_t k = 0; k < 4; k++)
+    result[k] = Dot<T>(a, b[k], n_dims);
+}
+
+template <typename T>
+void Log(const T* x, T* result, const size_t n_dims)
+{
+  for (size_t i = 0; i < n_dims; i++)
+    result[i] = log((double) x[i]);
+}
+
+template <typename T>
+void Exp(const T* x, T* result, const size_t n_dims)
+{
+  for (size_t i = 0; i < n_dims; i++)
+    result[i] = exp((double) x[i]);
+}
+
+template <typename T>
+double KLDivergence(const T* x, const T* y, const size_t n_dims)
+{
+  double result = 0.0;
+  for (size_t i = 0; i < n_dims; i++)
+  {
+    if (x[i] < 0 or y[i] < 0) 
+    {
+      std::cout << "[ERROR] KL divergence cannot be computed for negative "
+        "valued features." << std::endl;
+      exit(1);
+    }
+
+    bool x_zero = (x[i] < std::numeric_limits<T>::epsilon());
+    bool y_zero = (y[i] < std::numeric_limits<T>::epsilon());
+    if (not x_zero and y_zero)
+      // log 0 = - infty, nothing will reduce infty
+      return std::numeric_limits<T>::max();
+    else if (x_zero and not y_zero)
+      // 0 log 0 is 0 for KL divergence
+      result += y[i];
+    else if (not x_zero and not y_zero) 
+      result += x[i] * log(x[i] / y[i]) + y[i] - x[i];
+  }
+  return result;
+}
+
+template <typename T>
+void KLGradient(const T* x, T* result, const size_t n_dims)
+{
+  for (size_t i = 0; i < n_dims; i++)
+  {
+    if (x[i] < 0) 
+    {
+      std::cout << "[ERROR] Gradient corresponding to KL divergence cannot "
+        "be computed for negative valued features." << std::endl;
+      exit(1);
+    }
+    if (x[i] < std::numeric_limits<T>::epsilon())
+      result[i] = -std::numeric_limits<T>::max();
+    else
+      result[i] = log(x[i]) + 1.0;
+  }
+}
+
+template <typename T>
+void KLGradientConjugate(const T* x, T* result, const size_t n_dims)
+{
+  for (size_t i = 0; i < n_dims; i++)
+  {
+    if (x[i] > -std::numeric_limits<T>::max())
+      result[i] = exp(x[i] - 1.0);
+    else
+      result[i] = 0;
+  }
+}
+
+#ifdef BMST_SIMD_X86
+
+// Every kernel loads the values as doubles, two (SSE2), four (AVX2) or
+// eight (AVX-512) at a time, with two accumulators to hide the latency
+// of the additions. The last values are handled by the scalar loops.
+
+#define BMST_SSE2 __attribute__((target("sse2")))
+#define BMST_AVX2 __attribute__((target("avx2")))
+#define BMST_AVX2_FMA __attribute__((target("avx2,fma")))
+#define BMST_AVX512 __attribute__((target("avx512f")))
+
+BMST_SSE2 inline __m128d LoadSse2_(const double* p)
+{
+  return _mm_loadu_pd(p);
+}
+
+BMST_SSE2 inline __m128d LoadSse2_(const float* p)
+{
+  // the two floats in the low half
+  return _mm_cvtps_pd(
+      _mm_castsi128_ps(_mm_loadl_epi64((const __m128i*) p)));
+}
+
+BMST_SSE2 inline void StoreSse2_(double* p, const __m128d v)
+{
+  _mm_storeu_pd(p, v);
+}
+
+BMST_SSE2 inline void StoreSse2_(float* p, const __m128d v)
+{
+  _mm_storel_epi64((__m128i*) p, _mm_castps_si128(_mm_cvtpd_ps(v)));
+}
+
+BMST_SSE2 inline double SumSse2_(const __m128d v)
+{
+  return _mm_cvtsd_f64(_mm_add_sd(v, _mm_unpackhi_pd(v, v)));
+}
+
+template <typename T>
+BMST_SSE2 double DotSse2_(const T* a, const T* b, const size_t n_dims)
+{
+  __m128d sum_0 = _mm_setzero_pd();
+  __m128d sum_1 = _mm_setzero_pd();
+  size_t i = 0;
+  for (; i + 4 <= n_dims; i += 4)
+  {
+    sum_0 = _mm_add_pd(sum_0,
+        _mm_mul_pd(LoadSse2_(a + i), LoadSse2_(b + i)));
+    sum_1 = _mm_add_pd(sum_1,
+        _mm_mul_pd(LoadSse2_(a + i + 2), LoadSse2_(b + i + 2)));
+  }
+  return SumSse2_(_mm_add_pd(sum_0, sum_1)) +
+    Dot<T>(a + i, b + i, n_dims - i);
+}
+
+template <typename T>
+BMST_SSE2 double SquaredDistanceSse2_(
+    const T* a, const T* b, const size_t n_dims)
+{
+  __m128d sum_0 = _mm_setzero_pd();
+  __m128d sum_1 = _mm_setzero_pd();
+  size_t i = 0;
+  for (; i + 4 <= n_dims; i += 4)
+  {
+    const __m128d diff_0 = _mm_sub_pd(LoadSse2_(a + i), LoadSse2_(b + i));
+    const __m128d diff_1 =
+      _mm_sub_pd(LoadSse2_(a + i + 2), LoadSse2_(b + i + 2));
+    sum_0 = _mm_add_pd(sum_0, _mm_mul_pd(diff_0, diff_0));
+    sum_1 = _mm_add_pd(sum_1, _mm_mul_pd(diff_1, diff_1));
+  }
+  return SumSse2_(_mm_add_pd(sum_0, sum_1)) +
+    SquaredDistance<T>(a + i, b + i, n_dims - i);
+}
+
+template <typename T>
+BMST_SSE2 void AxpbySse2_(
+    const double alpha,
+    const T* x,
+    const double beta,
+    const T* y,
+    T* result,
+    const size_t n_dims)
+{
+  const __m128d v_alpha = _mm_set1_pd(alpha);
+  const __m128d v_beta = _mm_set1_pd(beta);
+  size_t i = 0;
+  for (; i + 2 <= n_dims; i += 2)
+    StoreSse2_(result + i, _mm_add_pd(
+          _mm_mul_pd(v_alpha, LoadSse2_(x + i)),
+          _mm_mul_pd(v_beta, LoadSse2_(y + i))));
+  Axpby<T>(alpha, x + i, beta, y + i, result + i, n_dims - i);
+}
+
+BMST_AVX2 inline __m256d LoadAvx2_(const double* p)
+{
+  return _mm256_loadu_pd(p);
+}
+
+BMST_AVX2 inline __m256d LoadAvx2_(const float* p)
+{
+  return _mm256_cvtps_pd(_mm_loadu_ps(p));
+}
+
+BMST_AVX2 inline void StoreAvx2_(double* p, const __m256d v)
+{
+  _mm256_storeu_pd(p, v);
+}
+
+BMST_AVX2 inline void StoreAvx2_(float* p, const __m256d v)
+{
+  _mm_storeu_ps(p, _mm256_cvtpd_ps(v));
+}
+
+BMST_AVX2 inline double SumAvx2_(const __m256d v)
+{
+  const __m128d sum = _mm_add_pd(
+      _mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+  return _mm_cvtsd_f64(_mm_add_sd(sum, _mm_unpackhi_pd(sum, sum)));
+}
+
+template <typename T>
+BMST_AVX2_FMA double DotAvx2_(const T* a, const T* b, const size_t n_dims)
+{
+  __m256d sum_0 = _mm256_setzero_pd();
+  __m256d sum_1 = _mm256_setzero_pd();
+  size_t i = 0;
+  for (; i + 8 <= n_dims; i += 8)
+  {
+    sum_0 = _mm256_fmadd_pd(LoadAvx2_(a + i), LoadAvx2_(b + i), sum_0);
+    sum_1 = _mm256_fmadd_pd(
+        LoadAvx2_(a + i + 4), LoadAvx2_(b + i + 4), sum_1);
+  }
+  return SumAvx2_(_mm256_add_pd(sum_0, sum_1)) +
+    Dot<T>(a + i, b + i, n_dims - i);
+}
+
+template <typename T>
+BMST_AVX2_FMA void Dot4Avx2_(
+    const T* a, const T* const* b, const size_t n_dims, double* result)
+{
+  __m256d sum_0 = _mm256_setzero_pd();
+  __m256d sum_1 = _mm256_setzero_pd();
+  __m256d sum_2 = _mm256_setzero_pd();
+  __m256d sum_3 = _mm256_setzero_pd();
+  size_t i = 0;
+  for (; i + 4 <= n_dims; i += 4)
+  {
+    const __m256d a_i = LoadAvx2_(a + i);
+    sum_0 = _mm256_fmadd_pd(a_i, LoadAvx2_(b[0] + i), sum_0);
+    sum_1 = _mm256_fmadd_pd(a_i, LoadAvx2_(b[1] + i), sum_1);
+    sum_2 = _mm256_fmadd_pd(a_i, LoadAvx2_(b[2] + i), sum_2);
+    sum_3 = _mm256_fmadd_pd(a_i, LoadAvx2_(b[3] + i), sum_3);
+  }
+  result[0] = SumAvx2_(sum_0) + Dot<T>(a + i, b[0] + i, n_dims - i);
+  result[1] = SumAvx2_(sum_1) + Dot<T>(a + i, b[1] + i, n_dims - i);
+  result[2] = SumAvx2_(sum_2) + Dot<T>(a + i, b[2] + i, n_dims - i);
+  result[3] = SumAvx2_(sum_3) + Dot<T>(a + i, b[3] + i, n_dims - i);
+}
+
+template <typename T>
+BMST_AVX2_FMA double SquaredDistanceAvx2_(
+    const T* a, const T* b, const size_t n_dims)
+{
+  __m256d sum_0 = _mm256_setzero_pd();
+  __m256d sum_1 = _mm256_setzero_pd();
+  size_t i = 0;
+  for (; i + 8 <= n_dims; i += 8)
+  {
+    const __m256d diff_0 =
+      _mm256_sub_pd(LoadAvx2_(a + i), LoadAvx2_(b + i));
+    const __m256d diff_1 =
+      _mm256_sub_pd(LoadAvx2_(a + i + 4), LoadAvx2_(b + i + 4));
+    sum_0 = _mm256_fmadd_pd(diff_0, diff_0, sum_0);
+    sum_1 = _mm256_fmadd_pd(diff_1, diff_1, sum_1);
+  }
+  return SumAvx2_(_mm256_add_pd(sum_0, sum_1)) +
+    SquaredDistance<T>(a + i, b + i, n_dims - i);
+}
+
+// no FMA in the target, so that the products are rounded like in the
+// scalar loop
+template <typename T>
+BMST_AVX2 void AxpbyAvx2_(
+    const double alpha,
+    const T* x,
+    const double beta,
+    const T* y,
+    T* result,
+    const size_t n_dims)
+{
+  const __m256d v_alpha = _mm256_set1_pd(alpha);
+  const __m256d v_beta = _mm256_set1_pd(beta);
+  size_t i = 0;
+  for (; i + 4 <= n_dims; i += 4)
+    StoreAvx2_(result + i, _mm256_add_pd(
+          _mm256_mul_pd(v_alpha, LoadAvx2_(x + i)),
+          _mm256_mul_pd(v_beta, LoadAvx2_(y + i))));
+  Axpby<T>(alpha, x + i, beta, y + i, result + i, n_dims - i);
+}
+
+// log and exp on four doubles (fdlibm's e_log.c and e_exp.c). The
+// arguments of LogAvx2_ are non-negative.
+BMST_AVX2_FMA inline __m256d LogAvx2_(__m256d x)
+{
+  const __m256d is_zero = _mm256_cmp_pd(x, _mm256_setzero_pd(), _CMP_EQ_OQ);
+  const __m256d is_inf = _mm256_cmp_pd(
+      x, _mm256_set1_pd(std::numeric_limits<double>::infinity()),
+      _CMP_EQ_OQ);
+  // scale the subnormals up by 2^54
+  const __m256d is_tiny = _mm256_cmp_pd(x, _mm256_set1_pd(DBL_MIN), _CMP_LT_OQ);
+  x = _mm256_blendv_pd(x, _mm256_mul_pd(x, _mm256_set1_pd(0x1p54)), is_tiny);
+
+  // x = 2^k m with m in [1, 2)
+  const __m256i bits = _mm256_castpd_si256(x);
+  __m256d m = _mm256_castsi256_pd(_mm256_or_si256(
+        _mm256_and_si256(bits, _mm256_set1_epi64x(0x000fffffffffffffLL)),
+        _mm256_set1_epi64x(0x3ff0000000000000LL)));
+  // the biased exponent, converted through 2^52 + e
+  const __m256d two_52 = _mm256_set1_pd(0x1p52);
+  __m256d k = _mm256_sub_pd(
+      _mm256_castsi256_pd(_mm256_or_si256(_mm256_srli_epi64(bits, 52),
+          _mm256_castpd_si256(two_52))),
+      two_52);
+  k = _mm256_sub_pd(k, _mm256_set1_pd(1023.0));
+  k = _mm256_sub_pd(k, _mm256_and_pd(is_tiny, _mm256_set1_pd(54.0)));
+  // m in [sqrt(2) / 2, sqrt(2))
+  const __m256d is_big = _mm256_cmp_pd(m, _mm256_set1_pd(M_SQRT2), _CMP_GT_OQ);
+  m = _mm256_blendv_pd(m, _mm256_mul_pd(m, _mm256_set1_pd(0.5)), is_big);
+  k = _mm256_add_pd(k, _mm256_and_pd(is_big, _mm256_set1_pd(1.0)));
+
+  // log m = f - hfsq + s (hfsq + R) with f = m - 1 and s = f / (2 + f)
+  const __m256d f = _mm256_sub_pd(m, _mm256_set1_pd(1.0));
+  const __m256d s = _mm256_div_pd(f, _mm256_add_pd(_mm256_set1_pd(2.0), f));
+  const __m256d z = _mm256_mul_pd(s, s);
+  const __m256d w = _mm256_mul_pd(z, z);
+  __m256d t_1 = _mm256_fmadd_pd(w, _mm256_set1_pd(1.531383769920937332e-01),
+      _mm256_set1_pd(2.222219843214978396e-01));
+  t_1 = _mm256_fmadd_pd(w, t_1, _mm256_set1_pd(3.999999999940941908e-01));
+  t_1 = _mm256_mul_pd(w, t_1);
+  __m256d t_2 = _mm256_fmadd_pd(w, _mm256_set1_pd(1.479819860511658591e-01),
+      _mm256_set1_pd(1.818357216161805012e-01));
+  t_2 = _mm256_fmadd_pd(w, t_2, _mm256_set1_pd(2.857142874366239149e-01));
+  t_2 = _mm256_fmadd_pd(w, t_2, _mm256_set1_pd(6.666666666666735130e-01));
+  t_2 = _mm256_mul_pd(z, t_2);
+  const __m256d r = _mm256_add_pd(t_1, t_2);
+  const __m256d hfsq = _mm256_mul_pd(_mm256_set1_pd(0.5), _mm256_mul_pd(f, f));
+
+  // k ln2_hi - ((hfsq - (s (hfsq + R) + k ln2_lo)) - f)
+  const __m256d ln2_hi = _mm256_set1_pd(6.93147180369123816490e-01);
+  const __m256d ln2_lo = _mm256_set1_pd(1.90821492927058770002e-10);
+  const __m256d correction = _mm256_fmadd_pd(
+      s, _mm256_add_pd(hfsq, r), _mm256_mul_pd(k, ln2_lo));
+  __m256d result = _mm256_sub_pd(_mm256_mul_pd(k, ln2_hi),
+      _mm256_sub_pd(_mm256_sub_pd(hfsq, correction), f));
+
+  result = _mm256_blendv_pd(result,
+      _mm256_set1_pd(-std::numeric_limits<double>::infinity()), is_zero);
+  return _mm256_blendv_pd(result,
+      _mm256_set1_pd(std::numeric_limits<double>::infinity()), is_inf);
+}
+
+// 2^n for integral n in [-1022, 1023]
+BMST_AVX2 inline __m256d Pow2Avx2_(const __m256d n)
+{
+  // the low bits of 1.5 2^52 + n hold n in two's complement
+  const __m256i bits = _mm256_castpd_si256(
+      _mm256_add_pd(n, _mm256_set1_pd(0x1.8p52)));
+  return _mm256_castsi256_pd(_mm256_slli_epi64(
+        _mm256_add_epi64(bits, _mm256_set1_epi64x(1023)), 52));
+}
+
+BMST_AVX2_FMA inline __m256d ExpAvx2_(__m256d x)
+{
+  // past these bounds exp(x) is infinite or zero, and x is clamped so 
+  // that 2^n stays in range
+  x = _mm256_min_pd(x, _mm256_set1_pd(710.0));
+  x = _mm256_max_pd(x, _mm256_set1_pd(-750.0));
+
+  // x = n ln2 + r with |r| <= ln2 / 2
+  const __m256d n = _mm256_round_pd(
+      _mm256_mul_pd(x, _mm256_set1_pd(1.44269504088896338700e+00)),
+      _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+  const __m256d hi = _mm256_fnmadd_pd(
+      n, _mm256_set1_pd(6.93147180369123816490e-01), x);
+  const __m256d lo = _mm256_mul_pd(
+      n, _mm256_set1_pd(1.90821492927058770002e-10));
+  const __m256d r = _mm256_sub_pd(hi, lo);
+
+  // exp(r) = 1 - ((lo - r c / (2 - c)) - hi)
+  const __m256d z = _mm256_mul_pd(r, r);
+  __m256d c = _mm256_fmadd_pd(z, _mm256_set1_pd(4.13813679705723846039e-08),
+      _mm256_set1_pd(-1.65339022054652515390e-06));
+  c = _mm256_fmadd_pd(z, c, _mm256_set1_pd(6.61375632143793436117e-05));
+  c = _mm256_fmadd_pd(z, c, _mm256_set1_pd(-2.77777777770155933842e-03));
+  c = _mm256_fmadd_pd(z, c, _mm256_set1_pd(1.66666666666666019037e-01));
+  c = _mm256_fnmadd_pd(z, c, r);
+  const __m256d y = _mm256_sub_pd(_mm256_set1_pd(1.0), _mm256_sub_pd(
+        _mm256_sub_pd(lo, _mm256_div_pd(_mm256_mul_pd(r, c),
+            _mm256_sub_pd(_mm256_set1_pd(2.0), c))), hi));
+
+  // 2^n in two steps, so that both factors are normal
+  const __m256d n_1 = _mm256_floor_pd(_mm256_mul_pd(n, _mm256_set1_pd(0.5)));
+  const __m256d n_2 = _mm256_sub_pd(n, n_1);
+  return _mm256_mul_pd(_mm256_mul_pd(y, Pow2Avx2_(n_1)), Pow2Avx2_(n_2));
+}
+
+template <typename T>
+BMST_AVX2_FMA void LogAvx2_(const T* x, T* result, const size_t n_dims)
+{
+  size_t i = 0;
+  for (; i + 4 <= n_dims; i += 4)
+    StoreAvx2_(result + i, LogAvx2_(LoadAvx2_(x + i)));
+  Log<T>(x + i, result + i, n_dims - i);
+}
+
+template <typename T>
+BMST_AVX2_FMA void ExpAvx2_(const T* x, T* result, const size_t n_dims)
+{
+  size_t i = 0;
+  for (; i + 4 <= n_dims; i += 4)
+    StoreAvx2_(result + i, ExpAvx2_(LoadAvx2_(x + i)));
+  Exp<T>(x + i, result + i, n_dims - i);
+}
+
+template <typename T>
+BMST_AVX2_FMA double KLDivergenceAvx2_(
+    const T* x, const T* y, const size_t n_dims)
+{
+  const __m256d zero = _mm256_setzero_pd();
+  const __m256d one = _mm256_set1_pd(1.0);
+  const __m256d epsilon = _mm256_set1_pd(std::numeric_limits<T>::epsilon());
+  __m256d sum = zero;
+  __m256d negative = zero;
+  __m256d infinite = zero;
+  size_t i = 0;
+  for (; i + 4 <= n_dims; i += 4)
+  {
+    const __m256d x_i = LoadAvx2_(x + i);
+    const __m256d y_i = LoadAvx2_(y + i);
+    negative = _mm256_or_pd(negative, _mm256_or_pd(
+          _mm256_cmp_pd(x_i, zero, _CMP_LT_OQ),
+          _mm256_cmp_pd(y_i, zero, _CMP_LT_OQ)));
+    const __m256d x_zero = _mm256_cmp_pd(x_i, epsilon, _CMP_LT_OQ);
+    const __m256d y_zero = _mm256_cmp_pd(y_i, epsilon, _CMP_LT_OQ);
+    // x_i > 0 and y_i == 0
+    infinite = _mm256_or_pd(infinite, _mm256_andnot_pd(x_zero, y_zero));
+
+    // x_i log (x_i / y_i) + y_i - x_i, on ones where either is zero
+    const __m256d log_ratio = LogAvx2_(_mm256_div_pd(
+          _mm256_blendv_pd(x_i, one, x_zero),
+          _mm256_blendv_pd(y_i, one, y_zero)));
+    __m256d term = _mm256_sub_pd(
+        _mm256_fmadd_pd(x_i, log_ratio, y_i), x_i);
+    // y_i where x_i == 0 (and 0 where both are)
+    term = _mm256_blendv_pd(term, _mm256_andnot_pd(y_zero, y_i), x_zero);
+    sum = _mm256_add_pd(sum, term);
+  }
+  if (_mm256_movemask_pd(negative))
+  {
+    std::cout << "[ERROR] KL divergence cannot be computed for negative "
+      "valued features." << std::endl;
+    exit(1);
+  }
+  if (_mm256_movemask_pd(infinite))
+    return std::numeric_limits<T>::max();
+  const double tail = KLDivergence<T>(x + i, y + i, n_dims - i);
+  if (tail == std::numeric_limits<T>::max())
+    return tail;
+  return SumAvx2_(sum) + tail;
+}
+
+template <typename T>
+BMST_AVX2_FMA void KLGradientAvx2_(
+    const T* x, T* result, const size_t n_dims)
+{
+  const __m256d zero = _mm256_setzero_pd();
+  const __m256d epsilon = _mm256_set1_pd(std::numeric_limits<T>::epsilon());
+  const __m256d minus_max = _mm256_set1_pd(-std::numeric_limits<T>::max());
+  __m256d negative = zero;
+  size_t i = 0;
+  for (; i + 4 <= n_dims; i += 4)
+  {
+    const __m256d x_i = LoadAvx2_(x + i);
+    negative = _mm256_or_pd(negative, _mm256_cmp_pd(x_i, zero, _CMP_LT_OQ));
+    const __m256d x_zero = _mm256_cmp_pd(x_i, epsilon, _CMP_LT_OQ);
+    const __m256d gradient = _mm256_add_pd(
+        LogAvx2_(_mm256_blendv_pd(x_i, _mm256_set1_pd(1.0), x_zero)),
+        _mm256_set1_pd(1.0));
+    StoreAvx2_(result + i, _mm256_blendv_pd(gradient, minus_max, x_zero));
+  }
+  if (_mm256_movemask_pd(negative))
+  {
+    std::cout << "[ERROR] Gradient corresponding to KL divergence cannot "
+      "be computed for negative valued features." << std::endl;
+    exit(1);
+  }
+  KLGradient<T>(x + i, result + i, n_dims - i);
+}
+
+template <typename T>
+BMST_AVX2_FMA void KLGradientConjugateAvx2_(
+    const T* x, T* result, const size_t n_dims)
+{
+  const __m256d minus_max = _mm256_set1_pd(-std::numeric_limits<T>::max());
+  size_t i = 0;
+  for (; i + 4 <= n_dims; i += 4)
+  {
+    const __m256d x_i = LoadAvx2_(x + i);
+    const __m256d finite = _mm256_cmp_pd(x_i, minus_max, _CMP_GT_OQ);
+    const __m256d conjugate =
+      ExpAvx2_(_mm256_sub_pd(x_i, _mm256_set1_pd(1.0)));
+    StoreAvx2_(result + i, _mm256_and_pd(finite, conjugate));
+  }
+  KLGradientConjugate<T>(x + i, result + i, n_dims - i);
+}
+
+BMST_AVX512 inline __m512d LoadAvx512_(const double* p)
+{
+  return _mm512_loadu_pd(p);
+}
+
+BMST_AVX512 inline __m512d LoadAvx512_(const float* p)
+{
+  return _mm512_cvtps_pd(_mm256_loadu_ps(p));
+}
+
+template <typename T>
+BMST_AVX512 double DotAvx512_(const T* a, const T* b, const size_t n_dims)
+{
+  __m512d sum_0 = _mm512_setzero_pd();
+  __m512d sum_1 = _mm512_setzero_pd();
+  size_t i = 0;
+  for (; i + 16 <= n_dims; i += 16)
+  {
+    sum_0 = _mm512_fmadd_pd(LoadAvx512_(a + i), LoadAvx512_(b + i), sum_0);
+    sum_1 = _mm512_fmadd_pd(
+        LoadAvx512_(a + i + 8), LoadAvx512_(b + i + 8), sum_1);
+  }
+  return _mm512_reduce_add_pd(_mm512_add_pd(sum_0, sum_1)) +
+    Dot<T>(a + i, b + i, n_dims - i);
+}
+
+template <typename T>
+BMST_AVX512 double SquaredDistanceAvx512_(
+    const T* a, const T* b, const size_t n_dims)
+{
+  __m512d sum_0 = _mm512_setzero_pd();
+  __m512d sum_1 = _mm512_setzero_pd();
+  size_t i = 0;
+  for (; i + 16 <= n_dims; i += 16)
+  {
+    const __m512d diff_0 =
+      _mm512_sub_pd(LoadAvx512_(a + i), LoadAvx512_(b + i));
+    const __m512d diff_1 =
+      _mm512_sub_pd(LoadAvx512_(a + i + 8), LoadAvx512_(b + i + 8));
+    sum_0 = _mm512_fmadd_pd(diff_0, diff_0, sum_0);
+    sum_1 = _mm512_fmadd_pd(diff_1, diff_1, sum_1);
+  }
+  return _mm512_reduce_add_pd(_mm512_add_pd(sum_0, sum_1)) +
+    SquaredDistance<T>(a + i, b + i, n_dims - i);
+}
+
+#undef BMST_SSE2
+#undef BMST_AVX2
+#undef BMST_AVX2_FMA
+#undef BMST_AVX512
+
+#endif // BMST_SIMD_X86
+
+// The dispatch on the active instruction set
+
+template <typename T>
+double DotDispatch_(const T* a, const T* b, const size_t n_dims)
+{
+#ifdef BMST_SIMD_X86
+  switch (ActiveIsa_())
+  {
+    case kAvx512:
+      return DotAvx512_(a, b, n_dims);
+    case kAvx2:
+      return DotAvx2_(a, b, n_dims);
+    case kSse2:
+      return DotSse2_(a, b, n_dims);
+    default:
+      break;
+  }
+#endif
+  return Dot<T>(a, b, n_dims);
+}
+
+// The four accumulators of AVX2 already hide the latency of the
+// additions, so Dot4 stops there
+template <typename T>
+void Dot4Dispatch_(
+    const T* a, const T* const* b, const size_t n_dims, double* result)
+{
+#ifdef BMST_SIMD_X86
+  if (ActiveIsa_() >= kAvx2)
+  {
+    Dot4Avx2_(a, b, n_dims, result);
+    return;
+  }
+#endif
+  Dot4<T>(a, b, n_dims, result);
+}
+
+template <typename T>
+double SquaredDistanceDispatch_(const T* a, const T* b, const size_t n_dims)
+{
+#ifdef BMST_SIMD_X86
+  switch (ActiveIsa_())
+  {
+    case kAvx512:
+      return SquaredDistanceAvx512_(a, b, n_dims);
+    case kAvx2:
+      return SquaredDistanceAvx2_(a, b, n_dims);
+    case kSse2:
+      return SquaredDistanceSse2_(a, b, n_dims);
+    default:
+      break;
+  }
+#endif
+  return SquaredDistance<T>(a, b, n_dims);
+}
+
+// Axpby is bound by the memory bandwidth, so AVX-512 brings nothing
+// over AVX2 (and would imply FMA)
+template <typename T>
+void AxpbyDispatch_(
+    const double alpha,
+    const T* x,
+    const double beta,
+    const T* y,
+    T* result,
+    const size_t n_dims)
+{
+#ifdef BMST_SIMD_X86
+  switch (ActiveIsa_())
+  {
+    case kAvx512:
+    case kAvx2:
+      AxpbyAvx2_(alpha, x, beta, y, result, n_dims);
+      return;
+    case kSse2:
+      AxpbySse2_(alpha, x, beta, y, result, n_dims);
+      return;
+    default:
+      break;
+  }
+#endif
+  Axpby<T>(alpha, x, beta, y, result, n_dims);
+}
+
+inline double Dot(const float* a, const float* b, const size_t n_dims)
+{
+  return DotDispatch_(a, b, n_dims);
+}
+
+inline void Dot4(
+    const float* a,
+    const float* const* b,
+    const size_t n_dims,
+    double* result)
+{
+  Dot4Dispatch_(a, b, n_dims, result);
+}
+
+inline void Dot4(
+    const double* a,
+    const double* const* b,
+    const size_t n_dims,
+    double* result)
+{
+  Dot4Dispatch_(a, b, n_dims, result);
+}
+
+inline double Dot(const double* a, const double* b, const size_t n_dims)
+{
+  return DotDispatch_(a, b, n_dims);
+}
+
+inline double SquaredDistance(
+    const float* a, const float* b, const size_t n_dims)
+{
+  return SquaredDistanceDispatch_(a, b, n_dims);
+}
+
+inline double SquaredDistance(
+    const double* a, const double* b, const size_t n_dims)
+{
+  return SquaredDistanceDispatch_(a, b, n_dims);
+}
+
+inline void Axpby(
+    const double alpha,
+    const float* x,
+    const double beta,
+    const float* y,
+    float* result,
+    const size_t n_dims)
+{
+  AxpbyDispatch_(alpha, x, beta, y, result, n_dims);
+}
+
+inline void Axpby(
+    const double alpha,
+    const double* x,
+    const double beta,
+    const double* y,
+    double* result,
+    const size_t n_dims)
+{
+  AxpbyDispatch_(alpha, x, beta, y, result, n_dims);
+}
+
+// The log and exp kernels stop at AVX2, and the SSE2 level uses the C
+// library
+template <typename T>
+void LogDispatch_(const T* x, T* result, const size_t n_dims)
+{
+#ifdef BMST_SIMD_X86
+  if (ActiveIsa_() >= kAvx2)
+  {
+    LogAvx2_(x, result, n_dims);
+    return;
+  }
+#endif
+  Log<T>(x, result, n_dims);
+}
+
+template <typename T>
+void ExpDispatch_(const T* x, T* result, const size_t n_dims)
+{
+#ifdef BMST_SIMD_X86
+  if (ActiveIsa_() >= kAvx2)
+  {
+    ExpAvx2_(x, result, n_dims);
+    return;
+  }
+#endif
+  Exp<T>(x, result, n_dims);
+}
+
+template <typename T>
+double KLDivergenceDispatch_(const T* x, const T* y, const size_t n_dims)
+{
+#ifdef BMST_SIMD_X86
+  if (ActiveIsa_() >= kAvx2)
+    return KLDivergenceAvx2_(x, y, n_dims);
+#endif
+  return KLDivergence<T>(x, y, n_dims);
+}
+
+template <typename T>
+void KLGradientDispatch_(const T* x, T* result, const size_t n_dims)
+{
+#ifdef BMST_SIMD_X86
+  if (ActiveIsa_() >= kAvx2)
+  {
+    KLGradientAvx2_(x, result, n_dims);
+    return;
+  }
+#endif
+  KLGradient<T>(x, result, n_dims);
+}
+
+template <typename T>
+void KLGradientConjugateDispatch_(
+    const T* x, T* result, const size_t n_dims)
+{
+#ifdef BMST_SIMD_X86
+  if (ActiveIsa_() >= kAvx2)
+  {
+    KLGradientConjugateAvx2_(x, result, n_dims);
+    return;
+  }
+#endif
+  KLGradientConjugate<T>(x, result, n_dims);
+}
+
+inline void Log(const float* x, float* result, const size_t n_dims)
+{
+  LogDispatch_(x, result, n_dims);
+}
+
+inline void Log(const double* x, double* result, const size_t n_dims)
+{
+  LogDispatch_(x, result, n_dims);
+}
+
+inline void Exp(const float* x, float* result, const size_t n_dims)
+{
+  ExpDispatch_(x, result, n_dims);
+}
+
+inline void Exp(const double* x, double* result, const size_t n_dims)
+{
+  ExpDispatch_(x, result, n_dims);
+}
+
+inline double KLDivergence(
+    const float* x, const float* y, const size_t n_dims)
+{
+  return KLDivergenceDispatch_(x, y, n_dims);
+}
+
+inline double KLDivergence(
+    const double* x, const double* y, const size_t n_dims)
+{
+  return KLDivergenceDispatch_(x, y, n_dims);
+}
+
+inline void KLGradient(const float* x, float* result, const size_t n_dims)
+{
+  KLGradientDispatch_(x, result, n_dims);
+}
+
+inline void KLGradient(
+    const double* x, double* result, const size_t n_dims)
+{
+  KLGradientDispatch_(x, result, n_dims);
+}
+
+inline void KLGradientConjugate(
+    const float* x, float* result, const size_t n_dims)
+{
+  KLGradientConjugateDispatch_(x, result, n_dims);
+}
+
+inline void KLGradientConjugate(
+    const double* x, double* result, const size_t n_dims)
+{
+  KLGradientConjugateDispatch_(x, result, n_dims);
+}
+
+template <typename T>
+double SquaredDistance(
+    const T* a, const T* b, const size_t n_dims, const double upper_bound)
+{
+  double sq_distance = 0;
+  for (size_t i = 0; i < n_dims; i += kAbandonBlock)
+  {
+    sq_distance += SquaredDistance(
+        a + i, b + i, std::min(kAbandonBlock, n_dims - i));
+    if (sq_distance > upper_bound)
+      break;
+  }
+  return sq_distance;
+}
+
+template <typename T>
+double KLDivergence(
+    const T* x, const T* y, const size_t n_dims, const double upper_bound)
+{
+  double result = 0;
+  for (size_t i = 0; i < n_dims; i += kAbandonBlock)
+  {
+    const double block = KLDivergence(
+        x + i, y + i, std::min(kAbandonBlock, n_dims - i));
+    if (block == std::numeric_limits<T>::max())
+      return block;
+    result += block;
+    if (result > upper_bound)
+      break;
+  }
+  return result;
+}
+
+}; // namespace
+}; // namespace
+
+#endif
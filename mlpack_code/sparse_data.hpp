@@ -0,0 +1,112 @@
+/**
+ * @file bregman_mst/mlpack_code/sparse_data.hpp
+ *
+ * Sparse points and tables for high dimensional data with few non-zeros
+ * (text and bag-of-words histograms). The non-zeros of every point are
+ * stored as (index, value) pairs with increasing indices, in the CSR
+ * (compressed sparse row) layout.
+ */
+
+#ifndef BMST_SPARSE_DATA_HPP_
+#define BMST_SPARSE_DATA_HPP_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "data.hpp"
+
+namespace bmst
+{
+
+// Non-owning read-only view of a sparse point stored in a SparseTable
+template <typename T>
+class SparsePointView
+{
+private:
+  const uint32_t* indices_;
+  const T* values_;
+  size_t n_nonzeros_;
+  size_t n_dims_;
+
+public:
+  SparsePointView();
+  SparsePointView(
+      const uint32_t* indices,
+      const T* values,
+      const size_t n_nonzeros,
+      const size_t n_dims);
+
+  const size_t n_dims() const { return n_dims_; }
+  const size_t n_nonzeros() const { return n_nonzeros_; }
+  // the indices (in increasing order) and the values of the non-zeros
+  const uint32_t* indices() const { return indices_; }
+  const T* values() const { return values_; }
+
+  // The dense copy of the point
+  operator Point<T>() const;
+
+  void print() const;
+
+};
+
+// center += x, touching only the non-zeros of x
+template<typename T>
+Point<T>& operator+=(Point<T>& center, const SparsePointView<T>& x);
+
+// <a, b> for a sparse a and a dense b
+template<typename T>
+double Dot(const SparsePointView<T>& a, const ConstPointView<T>& b);
+
+// \sum_i a_i over the nonzeros
+template<typename T>
+double Sum(const SparsePointView<T>& a);
+
+// The points are stored in CSR form: the indices and values of the
+// non-zeros of all the points in two arrays, and the extent of every
+// point in them. Swapping two points only swaps their extents, so the
+// trees can reorder a sparse table in place like a dense one.
+template <typename T>
+class SparseTable
+{
+private:
+  std::vector<uint32_t> indices_;
+  std::vector<T> values_;
+  // first non-zero and number of non-zeros of every point
+  std::vector<size_t> row_begin_;
+  std::vector<size_t> row_nonzeros_;
+  size_t n_dims_;
+
+  void AddRow_(std::vector<std::pair<uint32_t, T> >& nonzeros);
+
+public:
+  SparseTable();
+  // Keep the non-zero entries of a dense table
+  SparseTable(const Table<T>& table);
+  // Read a text file with one point per line, given as space separated
+  // 'index:value' pairs with 0-based indices (blank lines are skipped,
+  // so an all-zero point needs an explicit zero pair such as '0:0').
+  // The dimensionality is n_dims, or one more than the largest index if
+  // n_dims is 0. Throws a std::runtime_error with the offending line for
+  // malformed files.
+  SparseTable(const std::string& file_name, const size_t n_dims = 0);
+
+  const size_t n_points() const { return row_begin_.size(); }
+  const size_t n_dims() const { return n_dims_; }
+  const size_t n_nonzeros() const { return values_.size(); }
+
+  SparsePointView<T> operator[](const size_t i) const;
+
+  // Swap the i-th and the j-th points in place
+  void Swap(const size_t i, const size_t j);
+
+  void print() const;
+
+}; // class
+
+}; // namespace
+
+#include "sparse_data_impl.hpp"
+
+#endif
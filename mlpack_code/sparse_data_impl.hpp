@@ -0,0 +1,266 @@
+/**
+ * @file bregman_mst/mlpack_code/sparse_data_impl.hpp
+ *
+ * Implementation of the functions defined in sparse_data.hpp
+ */
+
+#ifndef BMST_SPARSE_DATA_IMPL_HPP_
+#define BMST_SPARSE_DATA_IMPL_HPP_
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+#include "sparse_data.hpp"
+
+namespace bmst
+{
+
+template <typename T>
+SparsePointView<T>::SparsePointView() :
+  indices_(NULL),
+  values_(NULL),
+  n_nonzeros_(0),
+  n_dims_(0)
+{}
+
+template <typename T>
+SparsePointView<T>::SparsePointView(
+    const uint32_t* indices,
+    const T* values,
+    const size_t n_nonzeros,
+    const size_t n_dims) :
+  indices_(indices),
+  values_(values),
+  n_nonzeros_(n_nonzeros),
+  n_dims_(n_dims)
+{}
+
+template <typename T>
+SparsePointView<T>::operator Point<T>() const
+{
+  Point<T> point;
+  point.zeros(n_dims_);
+  T* point_values = point.values();
+  for (size_t k = 0; k < n_nonzeros_; k++)
+    point_values[indices_[k]] = values_[k];
+  return point;
+}
+
+template <typename T>
+void SparsePointView<T>::print() const
+{
+  std::cout << "(";
+  for (size_t k = 0; k < n_nonzeros_; k++)
+  {
+    std::cout << indices_[k] << ":" << values_[k];
+    if (k + 1 < n_nonzeros_)
+      std::cout << ", ";
+  }
+  std::cout << ")\n";
+}
+
+template<typename T>
+Point<T>& operator+=(Point<T>& center, const SparsePointView<T>& x)
+{
+  if (center.n_dims() != x.n_dims())
+  {
+    std::cout << "[ERROR] Dimensions mismatch in point addition" <<
+      std::endl;
+    exit(1);
+  }
+  T* center_values = center.values();
+  const uint32_t* x_indices = x.indices();
+  const T* x_values = x.values();
+  for (size_t k = 0; k < x.n_nonzeros(); k++)
+    center_values[x_indices[k]] += x_values[k];
+  return center;
+}
+
+template<typename T>
+double Dot(const SparsePointView<T>& a, const ConstPointView<T>& b)
+{
+  if (a.n_dims() != b.n_dims())
+  {
+    std::cout << "[ERROR] Dimension mismatch in dot product computation" <<
+      std::endl;
+    exit(1);
+  }
+  const uint32_t* a_indices = a.indices();
+  const T* a_values = a.values();
+  const T* b_values = b.values();
+  double dot_product = 0;
+  for (size_t k = 0; k < a.n_nonzeros(); k++)
+    dot_product += a_values[k] * b_values[a_indices[k]];
+  return dot_product;
+}
+
+template<typename T>
+double Sum(const SparsePointView<T>& a)
+{
+  const T* a_values = a.values();
+  double sum = 0;
+  for (size_t k = 0; k < a.n_nonzeros(); k++)
+    sum += a_values[k];
+  return sum;
+}
+
+template <typename T>
+SparseTable<T>::SparseTable() :
+  n_dims_(0)
+{}
+
+template <typename T>
+SparseTable<T>::SparseTable(const Table<T>& table) :
+  n_dims_(table.n_dims())
+{
+  row_begin_.reserve(table.n_points());
+  row_nonzeros_.reserve(table.n_points());
+  for (size_t i = 0; i < table.n_points(); i++)
+  {
+    const T* row = table[i].values();
+    row_begin_.push_back(values_.size());
+    for (size_t j = 0; j < n_dims_; j++)
+    {
+      if (row[j] != 0)
+      {
+        indices_.push_back(j);
+        values_.push_back(row[j]);
+      }
+    }
+    row_nonzeros_.push_back(values_.size() - row_begin_.back());
+  }
+}
+
+template <typename T>
+void SparseTable<T>::AddRow_(std::vector<std::pair<uint32_t, T> >& nonzeros)
+{
+  std::sort(nonzeros.begin(), nonzeros.end());
+  row_begin_.push_back(values_.size());
+  for (size_t k = 0; k < nonzeros.size(); k++)
+  {
+    // repeated indices are added up
+    if (k > 0 and nonzeros[k].first == nonzeros[k - 1].first)
+    {
+      values_.back() += nonzeros[k].second;
+      continue;
+    }
+    indices_.push_back(nonzeros[k].first);
+    values_.push_back(nonzeros[k].second);
+  }
+  row_nonzeros_.push_back(values_.size() - row_begin_.back());
+}
+
+template <typename T>
+SparseTable<T>::SparseTable(
+    const std::string& file_name, const size_t n_dims) :
+  n_dims_(n_dims)
+{
+  std::ifstream ifs(file_name.c_str());
+  if (not ifs.good())
+    throw std::runtime_error("Could not open '" + file_name + "'");
+
+  std::string line;
+  size_t line_number = 0;
+  size_t max_index = 0;
+  std::vector<std::pair<uint32_t, T> > nonzeros;
+  while (std::getline(ifs, line))
+  {
+    ++line_number;
+    nonzeros.clear();
+    size_t n_pairs = 0;
+    const char* c = line.data();
+    const char* line_end = line.data() + line.size();
+    while (c < line_end)
+    {
+      while (c < line_end and (*c == ' ' or *c == '\t' or *c == '\r'))
+        ++c;
+      if (c == line_end)
+        break;
+
+      uint32_t index;
+      double value;
+      std::from_chars_result result = std::from_chars(c, line_end, index);
+      if (result.ec == std::errc() and result.ptr < line_end
+          and *result.ptr == ':')
+      {
+        c = result.ptr + 1;
+        if (c < line_end and *c == '+')
+          ++c;
+        result = std::from_chars(c, line_end, value);
+      }
+      else
+        result.ec = std::errc::invalid_argument;
+      if (result.ec != std::errc()
+          or (result.ptr < line_end and *result.ptr != ' '
+              and *result.ptr != '\t' and *result.ptr != '\r'))
+      {
+        std::ostringstream error;
+        error << "'" << file_name << "', line " << line_number <<
+          ": could not parse an 'index:value' pair";
+        throw std::runtime_error(error.str());
+      }
+      if (n_dims_ > 0 and index >= n_dims_)
+      {
+        std::ostringstream error;
+        error << "'" << file_name << "', line " << line_number <<
+          ": index " << index << " out of range (" << n_dims_ <<
+          " dimensions)";
+        throw std::runtime_error(error.str());
+      }
+      max_index = std::max(max_index, (size_t) index);
+      if (value != 0)
+        nonzeros.push_back(std::make_pair(index, (T) value));
+      ++n_pairs;
+      c = result.ptr;
+    }
+    // blank lines are skipped
+    if (n_pairs > 0)
+      AddRow_(nonzeros);
+  }
+  if (n_dims_ == 0 and n_points() > 0)
+    n_dims_ = max_index + 1;
+
+  std::cout << "[INFO] " << n_points() << " sparse points loaded with " <<
+    n_dims_ << " dimensions and " << n_nonzeros() << " non-zeros." <<
+    std::endl;
+}
+
+template <typename T>
+SparsePointView<T> SparseTable<T>::operator[](const size_t i) const
+{
+  if (i >= n_points())
+  {
+    std::cout << "[ERROR] Table index out of range" << std::endl;
+    exit(1);
+  }
+  const size_t begin = row_begin_[i];
+  return SparsePointView<T>(
+      indices_.data() + begin, values_.data() + begin, row_nonzeros_[i],
+      n_dims_);
+}
+
+template <typename T>
+void SparseTable<T>::Swap(const size_t i, const size_t j)
+{
+  std::swap(row_begin_[i], row_begin_[j]);
+  std::swap(row_nonzeros_[i], row_nonzeros_[j]);
+}
+
+template <typename T>
+void SparseTable<T>::print() const
+{
+  for (size_t i = 0; i < n_points(); i++)
+    (*this)[i].print();
+}
+
+}; // namespace
+
+#endif
@@ -0,0 +1,124 @@
+/**
+ * @file bregman_mst/mlpack_code/table_io.hpp
+ *
+ * A versioned binary on-disk format for Table<T>. The points are stored
+ * with exactly the same (aligned, padded) row-major layout as in memory,
+ * so that a file can be memory-mapped and used as a Table without any
+ * parsing or copying.
+ *
+ * Layout: a TableFileHeader, zero padding up to 'data_offset' and then
+ * n_points rows of 'stride' elements each.
+ */
+
+#ifndef BMST_TABLE_IO_HPP_
+#define BMST_TABLE_IO_HPP_
+
+#include <stdint.h>
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "data.hpp"
+
+namespace bmst {
+
+// The header at the start of every binary table file
+struct TableFileHeader
+{
+  // "BMSTTBL" followed by a null byte
+  char magic[8];
+  uint32_t version;
+  // kTableByteOrderMark as written by the producer
+  uint32_t byte_order;
+  // one of the TableElementType values
+  uint32_t element_type;
+  uint32_t element_size;
+  uint64_t n_points;
+  uint64_t n_dims;
+  // distance (in elements) between consecutive points
+  uint64_t stride;
+  // alignment (in bytes) of the data section and of every row
+  uint64_t alignment;
+  // offset (in bytes) of the first point from the start of the file
+  uint64_t data_offset;
+  // FNV-1a hash of the data section if kTableHasChecksum is set
+  uint64_t checksum;
+  uint32_t flags;
+  uint32_t reserved;
+};
+
+enum TableElementType
+{
+  kTableFloat32 = 1,
+  kTableFloat64 = 2
+};
+
+const uint32_t kTableFileVersion = 1;
+const uint32_t kTableByteOrderMark = 0x01020304;
+const uint32_t kTableHasChecksum = 0x1;
+
+// Writes a binary table file one point (or one block of points) at a
+// time, so that tables that do not fit in memory can be produced. The
+// header is completed when the writer is closed.
+template<typename T>
+class BinaryTableWriter
+{
+private:
+  std::ofstream ofs_;
+  std::string file_name_;
+  TableFileHeader header_;
+  // zeros used to pad every row up to the stride
+  std::vector<T> padding_;
+  bool with_checksum_;
+
+  void Write_(const char* bytes, const size_t n_bytes);
+
+public:
+  BinaryTableWriter(
+      const std::string& file_name, 
+      const size_t n_dims, 
+      const bool with_checksum = true);
+
+  ~BinaryTableWriter();
+
+  const size_t n_points() const { return header_.n_points; }
+  const size_t n_dims() const { return header_.n_dims; }
+
+  void Append(const ConstPointView<T>& point);
+  void Append(const Table<T>& table);
+
+  // Fill in the header and close the file
+  void Close();
+
+}; // class
+
+// Write the table in the binary format
+template<typename T>
+void WriteBinaryTable(
+    const Table<T>& table,
+    const std::string& file_name,
+    const bool with_checksum = true);
+
+// Memory-map a binary table file and expose it as a Table without
+// copying. The mapping is private (copy-on-write), so the pages are
+// shared with every other process mapping the same file until some
+// point is modified (for example by the tree construction).
+template<typename T>
+Table<T> MapBinaryTable(
+    const std::string& file_name,
+    const bool verify_checksum = false);
+
+// Checks if the file starts with the binary table magic
+inline bool IsBinaryTable(const std::string& file_name);
+
+// Read the file as a binary table if it is one, otherwise parse it as
+// text
+template<typename T>
+Table<T> LoadTable(const std::string& file_name);
+
+} // namespace
+
+#include "table_io_impl.hpp"
+
+#endif
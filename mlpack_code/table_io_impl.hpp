@@ -0,0 +1,262 @@
+/**
+ * @file bregman_mst/mlpack_code/table_io_impl.hpp
+ *
+ * Implementation of the functions defined in table_io.hpp
+ */
+
+#ifndef BMST_TABLE_IO_IMPL_HPP_
+#define BMST_TABLE_IO_IMPL_HPP_
+
+#include <assert.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "table_io.hpp"
+
+namespace bmst {
+
+namespace table_io {
+
+const char kMagic[8] = { 'B', 'M', 'S', 'T', 'T', 'B', 'L', '\0' };
+
+template<typename T>
+struct ElementType;
+
+template<>
+struct ElementType<float>
+{
+  static const uint32_t value = kTableFloat32;
+};
+
+template<>
+struct ElementType<double>
+{
+  static const uint32_t value = kTableFloat64;
+};
+
+const uint64_t kChecksumSeed = 14695981039346656037ULL;
+
+// 64-bit FNV-1a over a range of bytes, continuing from 'hash'
+inline uint64_t Checksum(
+    const char* bytes, 
+    const size_t n_bytes, 
+    uint64_t hash = kChecksumSeed)
+{
+  for (size_t i = 0; i < n_bytes; i++)
+  {
+    hash ^= (unsigned char) bytes[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+} // namespace table_io
+
+template<typename T>
+BinaryTableWriter<T>::BinaryTableWriter(
+    const std::string& file_name, 
+    const size_t n_dims, 
+    const bool with_checksum) :
+  file_name_(file_name),
+  padding_(Table<T>::Stride(n_dims) - n_dims, T(0)),
+  with_checksum_(with_checksum)
+{
+  memset(&header_, 0, sizeof(header_));
+  memcpy(header_.magic, table_io::kMagic, sizeof(header_.magic));
+  header_.version = kTableFileVersion;
+  header_.byte_order = kTableByteOrderMark;
+  header_.element_type = table_io::ElementType<T>::value;
+  header_.element_size = sizeof(T);
+  header_.n_points = 0;
+  header_.n_dims = n_dims;
+  header_.stride = Table<T>::Stride(n_dims);
+  header_.alignment = Table<T>::kAlignment;
+  header_.data_offset = 
+    ((sizeof(header_) + Table<T>::kAlignment - 1) / Table<T>::kAlignment) * 
+    Table<T>::kAlignment;
+  header_.checksum = table_io::kChecksumSeed;
+  if (with_checksum_)
+    header_.flags |= kTableHasChecksum;
+
+  ofs_.open(file_name_.c_str(), std::ofstream::binary);
+  if (not ofs_.good())
+  {
+    std::cout << "[ERROR] Could not open '" << file_name_ << "' for " 
+      "writing." << std::endl;
+    exit(1);
+  }
+  // the header is rewritten once the number of points is known
+  ofs_.write((const char*) &header_, sizeof(header_));
+  std::vector<char> padding(header_.data_offset - sizeof(header_), 0);
+  ofs_.write(padding.data(), padding.size());
+}
+
+template<typename T>
+BinaryTableWriter<T>::~BinaryTableWriter()
+{
+  if (ofs_.is_open())
+    Close();
+}
+
+template<typename T>
+void BinaryTableWriter<T>::Write_(const char* bytes, const size_t n_bytes)
+{
+  ofs_.write(bytes, n_bytes);
+  if (with_checksum_)
+    header_.checksum = table_io::Checksum(bytes, n_bytes, header_.checksum);
+}
+
+template<typename T>
+void BinaryTableWriter<T>::Append(const ConstPointView<T>& point)
+{
+  assert(point.n_dims() == header_.n_dims);
+  Write_((const char*) point.values(), point.n_dims() * sizeof(T));
+  Write_((const char*) padding_.data(), padding_.size() * sizeof(T));
+  ++header_.n_points;
+}
+
+template<typename T>
+void BinaryTableWriter<T>::Append(const Table<T>& table)
+{
+  assert(table.n_dims() == header_.n_dims);
+  // the padding of the table rows is already zero
+  Write_((const char*) table.values(), 
+      table.n_points() * table.stride() * sizeof(T));
+  header_.n_points += table.n_points();
+}
+
+template<typename T>
+void BinaryTableWriter<T>::Close()
+{
+  if (not with_checksum_)
+    header_.checksum = 0;
+  ofs_.seekp(0);
+  ofs_.write((const char*) &header_, sizeof(header_));
+  if (not ofs_.good())
+  {
+    std::cout << "[ERROR] Failed writing the table to '" << file_name_ << 
+      "'." << std::endl;
+    exit(1);
+  }
+  ofs_.close();
+}
+
+template<typename T>
+void WriteBinaryTable(
+    const Table<T>& table, 
+    const std::string& file_name,
+    const bool with_checksum)
+{
+  BinaryTableWriter<T> writer(file_name, table.n_dims(), with_checksum);
+  writer.Append(table);
+  writer.Close();
+}
+
+template<typename T>
+Table<T> MapBinaryTable(
+    const std::string& file_name,
+    const bool verify_checksum)
+{
+  int fd = open(file_name.c_str(), O_RDONLY);
+  if (fd < 0)
+  {
+    std::cout << "[ERROR] Could not open '" << file_name << "'." << std::endl;
+    exit(1);
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0
+      or (size_t) file_stat.st_size < sizeof(TableFileHeader))
+  {
+    std::cout << "[ERROR] '" << file_name << "' is too small to be a "
+      "binary table." << std::endl;
+    exit(1);
+  }
+  const size_t file_size = file_stat.st_size;
+
+  void* base = mmap(
+      NULL, file_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  // the mapping stays valid after closing the descriptor
+  close(fd);
+  if (base == MAP_FAILED)
+  {
+    std::cout << "[ERROR] Could not memory-map '" << file_name << "'." <<
+      std::endl;
+    exit(1);
+  }
+
+  TableFileHeader header;
+  memcpy(&header, base, sizeof(header));
+  std::string error;
+  if (memcmp(header.magic, table_io::kMagic, sizeof(header.magic)) != 0)
+    error = "not a binary table";
+  else if (header.version != kTableFileVersion)
+    error = "unsupported format version";
+  else if (header.byte_order != kTableByteOrderMark)
+    error = "written with a different byte order";
+  else if (header.element_type != table_io::ElementType<T>::value
+           or header.element_size != sizeof(T))
+    error = "element type does not match the requested table type";
+  else if (header.alignment != Table<T>::kAlignment
+           or header.stride != Table<T>::Stride(header.n_dims)
+           or header.data_offset % Table<T>::kAlignment != 0)
+    error = "row layout does not match the in-memory layout";
+  else if (header.data_offset +
+           header.n_points * header.stride * sizeof(T) > file_size)
+    error = "file is truncated";
+
+  if (error.size() > 0)
+  {
+    munmap(base, file_size);
+    std::cout << "[ERROR] '" << file_name << "': " << error << "." <<
+      std::endl;
+    exit(1);
+  }
+
+  T* values = (T*) ((char*) base + header.data_offset);
+  if (verify_checksum and (header.flags & kTableHasChecksum))
+  {
+    const uint64_t checksum = table_io::Checksum(
+        (const char*) values, header.n_points * header.stride * sizeof(T));
+    if (checksum != header.checksum)
+    {
+      munmap(base, file_size);
+      std::cout << "[ERROR] '" << file_name << "': checksum mismatch." <<
+        std::endl;
+      exit(1);
+    }
+  }
+
+  std::shared_ptr<T> storage(
+      values, [base, file_size](T*) { munmap(base, file_size); });
+  std::cout << "[INFO] " << header.n_points << " points mapped with " <<
+    header.n_dims << " dimensions each." << std::endl;
+  return Table<T>(storage, header.n_points, header.n_dims);
+}
+
+inline bool IsBinaryTable(const std::string& file_name)
+{
+  std::ifstream ifs(file_name.c_str(), std::ifstream::binary);
+  char magic[sizeof(table_io::kMagic)];
+  ifs.read(magic, sizeof(magic));
+  return ifs.good() and memcmp(magic, table_io::kMagic, sizeof(magic)) == 0;
+}
+
+template<typename T>
+Table<T> LoadTable(const std::string& file_name)
+{
+  if (IsBinaryTable(file_name))
+    return MapBinaryTable<T>(file_name);
+  return Table<T>(file_name);
+}
+
+} // namespace
+
+#endif
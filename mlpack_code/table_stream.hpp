@@ -0,0 +1,94 @@
+/**
+ * @file bregman_mst/mlpack_code/table_stream.hpp
+ *
+ * A streaming source of points that reads a data file (text or binary
+ * table) in fixed-size blocks, so that data sets that do not fit in
+ * memory can be processed one block at a time.
+ */
+
+#ifndef BMST_TABLE_STREAM_HPP_
+#define BMST_TABLE_STREAM_HPP_
+
+#include <cstddef>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+#include "data.hpp"
+#include "table_io.hpp"
+
+namespace bmst {
+
+template<typename T>
+class TableStream
+{
+private:
+  std::string file_name_;
+  std::ifstream ifs_;
+  bool binary_;
+  size_t n_dims_;
+  size_t block_size_;
+
+  // binary files: the header and the index of the next point to read
+  TableFileHeader header_;
+  size_t next_point_;
+
+  // text files: the bytes read but not parsed yet, and the line number 
+  // of the first of them
+  std::string pending_;
+  size_t next_line_;
+
+  // the block the iterators point to
+  Table<T> block_;
+
+  bool NextTextBlock_(Table<T>& block);
+  bool NextBinaryBlock_(Table<T>& block);
+
+public:
+  // An input iterator over the blocks of the stream
+  class Iterator
+  {
+  private:
+    TableStream<T>* stream_;
+
+  public:
+    typedef std::input_iterator_tag iterator_category;
+    typedef Table<T> value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const Table<T>* pointer;
+    typedef const Table<T>& reference;
+
+    Iterator(TableStream<T>* stream = NULL) : stream_(stream) {}
+    const Table<T>& operator*() const { return stream_->block_; }
+    const Table<T>* operator->() const { return &(stream_->block_); }
+    Iterator& operator++();
+    bool operator==(const Iterator& other) const 
+    { return stream_ == other.stream_; }
+    bool operator!=(const Iterator& other) const 
+    { return stream_ != other.stream_; }
+  }; // class Iterator
+
+  TableStream(const std::string& file_name, const size_t block_size = 4096);
+
+  const size_t n_dims() const { return n_dims_; }
+  const size_t block_size() const { return block_size_; }
+  const std::string& file_name() const { return file_name_; }
+
+  // Read the next (at most block_size()) points into block. Returns 
+  // false once the stream is exhausted.
+  bool NextBlock(Table<T>& block);
+
+  // Start reading again from the first point
+  void Rewind();
+
+  // Rewinds the stream and iterates over its blocks
+  Iterator begin();
+  Iterator end() { return Iterator(); }
+
+}; // class
+
+} // namespace
+
+#include "table_stream_impl.hpp"
+
+#endif
@@ -0,0 +1,186 @@
+/**
+ * @file bregman_mst/mlpack_code/table_stream_impl.hpp
+ *
+ * Implementation of the functions defined in table_stream.hpp
+ */
+
+#ifndef BMST_TABLE_STREAM_IMPL_HPP_
+#define BMST_TABLE_STREAM_IMPL_HPP_
+
+#include <string.h>
+
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+#include "table_stream.hpp"
+#include "text_parser.hpp"
+
+namespace bmst {
+
+// number of bytes read from a text file at a time
+const size_t kTextReadBytes = 1 << 20;
+
+template<typename T>
+TableStream<T>::TableStream(
+    const std::string& file_name, const size_t block_size) :
+  file_name_(file_name),
+  binary_(IsBinaryTable(file_name)),
+  n_dims_(0),
+  block_size_(block_size),
+  next_point_(0),
+  next_line_(1)
+{
+  if (block_size_ == 0)
+  {
+    std::cout << "[ERROR] The block size of a table stream has to be " 
+      "positive." << std::endl;
+    exit(1);
+  }
+
+  ifs_.open(file_name_.c_str(), std::ifstream::binary);
+  if (not ifs_.good())
+  {
+    std::cout << "[ERROR] Could not open '" << file_name_ << "'." << 
+      std::endl;
+    exit(1);
+  }
+
+  if (binary_)
+  {
+    ifs_.read((char*) &header_, sizeof(header_));
+    if (not ifs_.good()
+        or header_.version != kTableFileVersion
+        or header_.byte_order != kTableByteOrderMark
+        or header_.element_size != sizeof(T)
+        or header_.stride != Table<T>::Stride(header_.n_dims))
+    {
+      std::cout << "[ERROR] '" << file_name_ << "' cannot be streamed as "
+        "a table of this element type." << std::endl;
+      exit(1);
+    }
+    n_dims_ = header_.n_dims;
+  }
+  else
+  {
+    // find the dimensionality from the first point
+    Table<T> first_block;
+    const size_t block_size = block_size_;
+    block_size_ = 1;
+    NextTextBlock_(first_block);
+    block_size_ = block_size;
+    n_dims_ = first_block.n_dims();
+  }
+  Rewind();
+}
+
+template<typename T>
+bool TableStream<T>::NextBlock(Table<T>& block)
+{
+  return binary_ ? NextBinaryBlock_(block) : NextTextBlock_(block);
+}
+
+template<typename T>
+bool TableStream<T>::NextBinaryBlock_(Table<T>& block)
+{
+  const size_t n_points = 
+    std::min(block_size_, (size_t) header_.n_points - next_point_);
+  if (n_points == 0)
+    return false;
+
+  if (block.n_points() != n_points or block.n_dims() != n_dims_)
+    block = Table<T>(n_points, n_dims_);
+
+  // the file rows have the same stride as the table rows
+  ifs_.seekg(header_.data_offset + next_point_ * header_.stride * sizeof(T));
+  ifs_.read((char*) block.values(), n_points * header_.stride * sizeof(T));
+  if (not ifs_.good())
+  {
+    std::cout << "[ERROR] '" << file_name_ << "' is truncated." << std::endl;
+    exit(1);
+  }
+  next_point_ += n_points;
+  return true;
+}
+
+template<typename T>
+bool TableStream<T>::NextTextBlock_(Table<T>& block)
+{
+  // make sure that the pending bytes hold block_size_ points (or the 
+  // rest of the file)
+  const char* taken;
+  while (true)
+  {
+    const bool at_eof = ifs_.eof();
+    size_t n_points;
+    taken = text_parser::TakeLines(
+        pending_.data(), pending_.data() + pending_.size(), 
+        block_size_, at_eof, n_points);
+    if (at_eof or n_points == block_size_)
+      break;
+
+    const size_t old_size = pending_.size();
+    pending_.resize(old_size + kTextReadBytes);
+    ifs_.read(&pending_[old_size], kTextReadBytes);
+    pending_.resize(old_size + ifs_.gcount());
+  }
+
+  text_parser::Chunk chunk;
+  chunk.begin = pending_.data();
+  chunk.end = taken;
+  chunk.n_lines = 0;
+  chunk.n_points = 0;
+  chunk.n_dims = 0;
+  chunk.first_line = next_line_;
+  chunk.first_point = 0;
+  chunk.error_line = 0;
+  text_parser::ScanChunk(chunk);
+  if (chunk.n_points == 0)
+    return false;
+
+  // the first block fixes the dimensionality
+  const size_t n_dims = (n_dims_ > 0) ? n_dims_ : chunk.n_dims;
+  if (block.n_points() != chunk.n_points or block.n_dims() != n_dims)
+    block = Table<T>(chunk.n_points, n_dims);
+  text_parser::ParseChunk(chunk, n_dims, block);
+  if (chunk.error_line > 0)
+  {
+    std::ostringstream error;
+    error << "'" << file_name_ << "', line " << chunk.error_line << 
+      ": " << chunk.error;
+    throw std::runtime_error(error.str());
+  }
+
+  next_line_ += chunk.n_lines;
+  pending_.erase(0, taken - pending_.data());
+  return true;
+}
+
+template<typename T>
+void TableStream<T>::Rewind()
+{
+  ifs_.clear();
+  ifs_.seekg(0);
+  next_point_ = 0;
+  pending_.clear();
+  next_line_ = 1;
+}
+
+template<typename T>
+typename TableStream<T>::Iterator TableStream<T>::begin()
+{
+  Rewind();
+  return NextBlock(block_) ? Iterator(this) : Iterator();
+}
+
+template<typename T>
+typename TableStream<T>::Iterator& TableStream<T>::Iterator::operator++()
+{
+  if (not stream_->NextBlock(stream_->block_))
+    stream_ = NULL;
+  return *this;
+}
+
+} // namespace
+
+#endif
@@ -23,9 +23,22 @@
 #include "kmeans_splitter.hpp"
 #include "bregman_ball.hpp"
 #include "bregman_ball_tree.hpp"
+#include "flat_bregman_ball_tree.hpp"
+#include "projection_splitter.hpp"
+#include "sampled_kmeans_splitter.hpp"
+#include "table_io.hpp"
+#include "table_stream.hpp"
 
-template <typename T, class TNode, class TBregmanDiv>
-void TestTreeNode(const bmst::Table<T>& table, const TNode* node);
+template <typename T, class TTree, class TBregmanDiv>
+void TestTreeNode(
+    const bmst::Table<T>& table, 
+    const TTree& tree, 
+    const typename TTree::TNode* node);
+
+// Every node of a tree built with the splitter has the mean of its points
+// as center, and the leaves are small enough
+template <class TSplitter>
+void TestSplitterTree();
 
 int main(int argc, char* argv[])
 {
@@ -63,7 +76,8 @@ int main(int argc, char* argv[])
     while (not node_queue.empty())
     {
       BBTree* current_node = node_queue.front();
-      TestTreeNode<double, BBTree, TBregmanDiv>(rand_table, current_node);
+      TestTreeNode<double, BBTree, TBregmanDiv>(
+          rand_table, *test_bbtree, current_node);
       node_queue.pop();
       if (not current_node->IsLeaf())
       {
@@ -107,7 +121,8 @@ int main(int argc, char* argv[])
     while (not node_queue.empty())
     {
       BBTree* current_node = node_queue.front();
-      TestTreeNode<double, BBTree, TBregmanDiv>(rand_table, current_node);
+      TestTreeNode<double, BBTree, TBregmanDiv>(
+          rand_table, *test_bbtree, current_node);
       node_queue.pop();
       if (not current_node->IsLeaf())
       {
@@ -120,6 +135,218 @@ int main(int argc, char* argv[])
   }
   std::cout << "Testing the bbtree with KLDiv ... DONE" << std::endl;
   std::cout << "================================================" << std::endl;
+  std::cout << "Testing the out-of-core bbtree with KLDiv ... " << std::endl;
+  {
+    // make a 5000 x 20 dataset
+    bmst::Table<double> rand_table(5000, 20);
+    for (size_t i = 0; i < rand_table.n_points(); i++)
+      for (size_t j = 0; j < rand_table.n_dims(); j++)
+        rand_table[i][j] = randu(gen);
+    bmst::WriteBinaryTable(rand_table, "test_bbtree_in.bin");
+
+    typedef bmst::KLDivergence<double> TBregmanDiv;
+    typedef bmst::KMeansSplitter<double, TBregmanDiv> TSplitter;
+    typedef bmst::BregmanBall<double, TBregmanDiv> TBBall;
+    typedef bmst::BregmanBallTree<double, TBregmanDiv, TBBall, TSplitter> BBTree;
+
+    // a budget of about 600 points forces a few levels of spilling
+    const size_t memory_budget = 600 * 
+      (bmst::Table<double>::Stride(20) * sizeof(double) + 4 * sizeof(size_t));
+    bmst::TableStream<double> stream("test_bbtree_in.bin", 256);
+    std::vector<size_t> old_from_new;
+    BBTree* test_bbtree = new BBTree(
+        stream, "test_bbtree_out.bin", old_from_new, memory_budget, 5, ".");
+    const bmst::Table<double> tree_table = 
+      bmst::MapBinaryTable<double>("test_bbtree_out.bin", true);
+    std::cout << "Indexed " << tree_table.n_points() << " points in " <<
+      tree_table.n_dims() << " dimensions each .. " << std::endl;
+
+    // the output is a permutation of the input
+    assert(tree_table.n_points() == rand_table.n_points());
+    assert(old_from_new.size() == rand_table.n_points());
+    std::vector<bool> seen(rand_table.n_points(), false);
+    for (size_t i = 0; i < tree_table.n_points(); i++)
+    {
+      assert(not seen[old_from_new[i]]);
+      seen[old_from_new[i]] = true;
+      for (size_t j = 0; j < tree_table.n_dims(); j++)
+        assert(tree_table[i][j] == rand_table[old_from_new[i]][j]);
+    }
+
+    // test the stats of each node
+    std::queue<BBTree*> node_queue;
+    node_queue.push(test_bbtree);
+    while (not node_queue.empty())
+    {
+      BBTree* current_node = node_queue.front();
+      TestTreeNode<double, BBTree, TBregmanDiv>(
+          tree_table, *test_bbtree, current_node);
+      node_queue.pop();
+      if (not current_node->IsLeaf())
+      {
+        assert(current_node->Left()->Begin() == current_node->Begin());
+        assert(current_node->Left()->End() == 
+            current_node->Right()->Begin());
+        assert(current_node->Right()->End() == current_node->End());
+        node_queue.push(current_node->Left());
+        node_queue.push(current_node->Right());
+      }
+    }
+
+    delete test_bbtree;
+    remove("test_bbtree_in.bin");
+    remove("test_bbtree_out.bin");
+  }
+  std::cout << "Testing the out-of-core bbtree with KLDiv ... DONE" << std::endl;
+  std::cout << "================================================" << std::endl;
+
+  std::cout << "Testing the parallel bbtree with KLDiv ... " << std::endl;
+  {
+    // enough points for a few data-parallel levels of 4 blocks or more 
+    // (see kKMeansBlockPoints) above the tasks
+    bmst::Table<double> rand_table(20000, 10);
+    for (size_t i = 0; i < rand_table.n_points(); i++)
+      for (size_t j = 0; j < rand_table.n_dims(); j++)
+        rand_table[i][j] = randu(gen);
+    bmst::Table<double> parallel_table(rand_table);
+
+    typedef bmst::KLDivergence<double> TBregmanDiv;
+    typedef bmst::KMeansSplitter<double, TBregmanDiv> TSplitter;
+    typedef bmst::BregmanBall<double, TBregmanDiv> TBBall;
+    typedef bmst::BregmanBallTree<double, TBregmanDiv, TBBall, TSplitter> BBTree;
+
+    // the same seed gives the same tree on one thread and on four
+    std::vector<size_t> old_from_new;
+    BBTree serial_bbtree(rand_table, old_from_new, 5, 0, 
+        bmst::TreeBuildOptions(1, 4000, 42));
+    std::vector<size_t> parallel_old_from_new;
+    BBTree parallel_bbtree(parallel_table, parallel_old_from_new, 5, 0, 
+        bmst::TreeBuildOptions(4, 4000, 42));
+    std::cout << "Indexed " << parallel_table.n_points() << " points in " <<
+      parallel_table.n_dims() << " dimensions each on 4 threads .. " << 
+      std::endl;
+    assert(old_from_new == parallel_old_from_new);
+
+    std::queue<const BBTree*> serial_queue;
+    std::queue<const BBTree*> parallel_queue;
+    serial_queue.push(&serial_bbtree);
+    parallel_queue.push(&parallel_bbtree);
+    size_t n_nodes = 0;
+    while (not serial_queue.empty())
+    {
+      const BBTree* serial_node = serial_queue.front();
+      const BBTree* parallel_node = parallel_queue.front();
+      serial_queue.pop();
+      parallel_queue.pop();
+      TestTreeNode<double, BBTree, TBregmanDiv>(
+          parallel_table, parallel_bbtree, parallel_node);
+      assert(serial_node->Begin() == parallel_node->Begin());
+      assert(serial_node->Count() == parallel_node->Count());
+      assert(serial_node->IsLeaf() == parallel_node->IsLeaf());
+      assert(serial_node->RRadius() == parallel_node->RRadius());
+      for (size_t j = 0; j < parallel_table.n_dims(); j++)
+        assert(serial_node->RCenter()[j] == parallel_node->RCenter()[j]);
+      n_nodes++;
+      if (not serial_node->IsLeaf())
+      {
+        serial_queue.push(serial_node->Left());
+        serial_queue.push(serial_node->Right());
+        parallel_queue.push(parallel_node->Left());
+        parallel_queue.push(parallel_node->Right());
+      }
+    }
+    std::cout << "Compared " << n_nodes << " nodes .. " << std::endl;
+  }
+  std::cout << "Testing the parallel bbtree with KLDiv ... DONE" << std::endl;
+  std::cout << "================================================" << std::endl;
+
+  std::cout << "Testing the bbtree with the sampled splitter and KLDiv ..." <<
+    std::endl;
+  TestSplitterTree<bmst::SampledKMeansSplitter<double, 
+    bmst::KLDivergence<double> > >();
+  std::cout << "Testing the bbtree with the sampled splitter and KLDiv ... "
+    "DONE" << std::endl;
+  std::cout << "================================================" << std::endl;
+
+  std::cout << "Testing the bbtree with the random projection splitter and "
+    "KLDiv ..." << std::endl;
+  TestSplitterTree<bmst::RandomProjectionSplitter<double, 
+    bmst::KLDivergence<double> > >();
+  std::cout << "Testing the bbtree with the random projection splitter and "
+    "KLDiv ... DONE" << std::endl;
+  std::cout << "================================================" << std::endl;
+
+  std::cout << "Testing the bbtree with the PCA splitter and KLDiv ..." <<
+    std::endl;
+  TestSplitterTree<bmst::PCASplitter<double, bmst::KLDivergence<double> > >();
+  std::cout << "Testing the bbtree with the PCA splitter and KLDiv ... DONE" <<
+    std::endl;
+  std::cout << "================================================" << std::endl;
+
+  std::cout << "Testing the flat bbtree with KLDiv ..." << std::endl;
+  {
+    bmst::Table<double> rand_table(2000, 10);
+    std::mt19937 gen(7);
+    std::uniform_real_distribution<double> randu(0.01, 1.0);
+    for (size_t i = 0; i < rand_table.n_points(); i++)
+      for (size_t j = 0; j < rand_table.n_dims(); j++)
+        rand_table[i][j] = randu(gen);
+
+    typedef bmst::KLDivergence<double> TBregmanDiv;
+    typedef bmst::KMeansSplitter<double, TBregmanDiv> TSplitter;
+    typedef bmst::BregmanBall<double, TBregmanDiv> TBBall;
+    typedef bmst::BregmanBallTree<double, TBregmanDiv, TBBall, TSplitter> BBTree;
+    typedef bmst::FlatBregmanBallTree<double, TBregmanDiv, TSplitter> FlatTree;
+
+    std::vector<size_t> old_from_new;
+    BBTree bbtree(rand_table, old_from_new, 5);
+    const FlatTree flat_tree(bbtree);
+    std::cout << "Flattened " << flat_tree.n_nodes() << " nodes in " <<
+      flat_tree.Bytes() << " bytes .. " << std::endl;
+
+    // the same nodes in depth-first order, with the left child next, and
+    // the same pruning for a query
+    const bmst::ConstPointView<double> q = rand_table[0];
+    const bmst::Point<double> q_prime = TBregmanDiv::Gradient(q);
+    std::vector<const BBTree*> stack(1, &bbtree);
+    size_t index = 0;
+    while (not stack.empty())
+    {
+      const BBTree* node = stack.back();
+      stack.pop_back();
+      const FlatTree::Node* flat_node = flat_tree.Root() + index;
+      TestTreeNode<double, FlatTree, TBregmanDiv>(
+          rand_table, flat_tree, flat_node);
+      assert(node->Begin() == flat_node->Begin());
+      assert(node->Count() == flat_node->Count());
+      assert(node->IsLeaf() == flat_node->IsLeaf());
+      assert(node->RRadius() == flat_node->RRadius());
+      assert(node->LRadius() == flat_node->LRadius());
+      for (size_t j = 0; j < rand_table.n_dims(); j++)
+      {
+        assert(node->RCenter()[j] == flat_tree.RCenter(flat_node)[j]);
+        assert(node->LCenter()[j] == flat_tree.LCenter(flat_node)[j]);
+      }
+      for (double best = 1e-3; best < 10; best *= 10)
+      {
+        assert(flat_tree.CanPruneRight(flat_node, q, q_prime, best) ==
+            node->Bound().CanPruneRight(q, q_prime, best));
+        assert(flat_tree.CanPruneLeft(flat_node, q, best) ==
+            node->Bound().CanPruneLeft(q, best));
+      }
+      if (not node->IsLeaf())
+      {
+        assert(flat_tree.Left(flat_node) == flat_node + 1);
+        assert(flat_tree.Right(flat_node)->Begin() == node->Right()->Begin());
+        stack.push_back(node->Right());
+        stack.push_back(node->Left());
+      }
+      index++;
+    }
+    assert(index == flat_tree.n_nodes());
+  }
+  std::cout << "Testing the flat bbtree with KLDiv ... DONE" << std::endl;
+  std::cout << "================================================" << std::endl;
 
   std::cout << "[TESTS-TO-BE-ADDED] We need to add tests for 'CentroidPrimes' and "
     "for the left center and left radius" << std::endl;
@@ -127,8 +354,11 @@ int main(int argc, char* argv[])
   return 0;
 }
 
-template <typename T, class TNode, class TBregmanDiv>
-void TestTreeNode(const bmst::Table<T>& table, const TNode* node)
+template <typename T, class TTree, class TBregmanDiv>
+void TestTreeNode(
+    const bmst::Table<T>& table, 
+    const TTree& tree, 
+    const typename TTree::TNode* node)
 {
   // check the node center
   bmst::Point<T> center;
@@ -139,8 +369,9 @@ void TestTreeNode(const bmst::Table<T>& table, const TNode* node)
 
   center /= (T) node->Count();
 
-  assert(center.n_dims() == node->RCenter().n_dims());
-  const bmst::Point<T> center_diff = center - node->RCenter();
+  assert(center.n_dims() == tree.RCenter(node).n_dims());
+  const bmst::Point<T> center_diff = 
+    center - bmst::Point<T>(tree.RCenter(node));
   double center_diff_sq_norm = bmst::Dot(center_diff, center_diff);
   if (center_diff_sq_norm > 1e-10)
   {
@@ -167,3 +398,39 @@ void TestTreeNode(const bmst::Table<T>& table, const TNode* node)
 
   return;
 }
+
+template <class TSplitter>
+void TestSplitterTree()
+{
+  bmst::Table<double> rand_table(20000, 10);
+  std::mt19937 gen(3);
+  std::uniform_real_distribution<double> randu(0.01, 1.0);
+  for (size_t i = 0; i < rand_table.n_points(); i++)
+    for (size_t j = 0; j < rand_table.n_dims(); j++)
+      rand_table[i][j] = randu(gen);
+
+  typedef bmst::KLDivergence<double> TBregmanDiv;
+  typedef bmst::BregmanBall<double, TBregmanDiv> TBBall;
+  typedef bmst::BregmanBallTree<double, TBregmanDiv, TBBall, TSplitter> BBTree;
+
+  std::vector<size_t> old_from_new;
+  BBTree bbtree(rand_table, old_from_new, 10, 0, 
+      bmst::TreeBuildOptions(1, 1 << 16, 42));
+  std::vector<const BBTree*> stack(1, &bbtree);
+  size_t n_nodes = 0;
+  while (not stack.empty())
+  {
+    const BBTree* node = stack.back();
+    stack.pop_back();
+    TestTreeNode<double, BBTree, TBregmanDiv>(rand_table, bbtree, node);
+    n_nodes++;
+    if (not node->IsLeaf())
+    {
+      stack.push_back(node->Right());
+      stack.push_back(node->Left());
+    }
+    else
+      assert(node->Count() <= 10);
+  }
+  std::cout << "Checked " << n_nodes << " nodes .. " << std::endl;
+}
@@ -1,3 +1,5 @@
+#include <random>
+
 #include "bregman_ball.hpp"
 
 #include "KLDivergence.hpp"
@@ -30,9 +32,40 @@ int main (int argc, char* argv[])
     bool can_prune_large = kl_ball_large.CanPruneRight(q, q_prime, 0.05);
     //std::cout << "large prune: " << can_prune_large << "\n";
     assert(!can_prune_large);
+
+    // without any step the bisection cannot prune
+    typedef BregmanBall<double, KLDivergence<double> > TBall;
+    TBall::SetBisection(0, kBisectionTolerance);
+    assert(not kl_ball_small.CanPruneRight(q, q_prime, 0.05));
+    TBall::SetBisection(kMaxBisectionIterations, kBisectionTolerance);
+    assert(kl_ball_small.CanPruneRight(q, q_prime, 0.05));
   }
   std::cout << "KL Ball Passed.\n";
   
+  std::cout << "Testing KL left ball.\n";
+  {
+    typedef BregmanBall<double, KLDivergence<double> > TBall;
+    const double d_mu_q = KLDivergence<double>::BDivergence(mu, q);
+    TBall kl_ball_small(mu, 0.001, mu, 0.001);
+    TBall kl_ball_large(mu, 0.001, mu, 0.2);
+    assert(kl_ball_small.CanPruneLeft(q, 0.05));
+    assert(not kl_ball_large.CanPruneLeft(q, 0.05));
+    assert(not kl_ball_small.CanPruneLeft(q, 0.05, 0.0005));
+    assert(kl_ball_small.CanPruneLeft(q, 0.05, d_mu_q));
+
+    // a point of the ball closer to q than the candidate
+    Point<double> x;
+    Axpby<double>(0.5, mu, 0.5, q, x);
+    TBall kl_ball_x(mu, 0.001, mu, 
+        KLDivergence<double>::BDivergence(mu, x));
+    assert(not kl_ball_x.CanPruneLeft(
+          q, 1.01 * KLDivergence<double>::BDivergence(q, x)));
+
+    // a ball without a left centroid never prunes on the left
+    assert(not TBall(mu, 0.001).CanPruneLeft(q, 0.05));
+  }
+  std::cout << "KL left ball passed.\n";
+
   std::cout << "Testing L2 Ball\n";
   {
     // 0.065
@@ -49,6 +82,116 @@ int main (int argc, char* argv[])
     assert(!can_prune_large);
   }
   std::cout << "L2 Ball Passed.\n";
+
+  std::cout << "Testing closed form L2 bound\n";
+  {
+    // the nearest point of the ball to q is on the segment from mu to q,
+    // at sqrt(2 R) from mu, so the bound is tight
+    const double radius = 0.001;
+    BregmanBall<double, L2Divergence<double> > l2_ball(mu, radius);
+    Point<double> q_prime = L2Divergence<double>::Gradient(q);
+    const double q_mu = sqrt(2 * L2Divergence<double>::BDivergence(q, mu));
+    Point<double> nearest;
+    const double t = sqrt(2 * radius) / q_mu;
+    Axpby<double>(1 - t, mu, t, q, nearest);
+    const double d_nearest = L2Divergence<double>::BDivergence(nearest, q);
+    assert(fabs(BallBound<L2Divergence<double> >::LowerBound(
+            L2Divergence<double>::BDivergence(q, mu), radius) - d_nearest) <
+        1e-12);
+    assert(l2_ball.CanPruneRight(q, q_prime, 0.99 * d_nearest));
+    assert(not l2_ball.CanPruneRight(q, q_prime, 1.01 * d_nearest));
+
+    // no bound for a query in the ball
+    assert(BallBound<L2Divergence<double> >::LowerBound(radius, radius) == 0);
+    assert(not BallBound<KLDivergence<double> >::kClosedForm);
+
+    // the left ball is the same ball
+    BregmanBall<double, L2Divergence<double> > l2_left_ball(
+        mu, radius, mu, radius);
+    assert(l2_left_ball.CanPruneLeft(q, 0.99 * d_nearest));
+    assert(not l2_left_ball.CanPruneLeft(q, 1.01 * d_nearest));
+  }
+  std::cout << "Closed form L2 bound passed.\n";
+
+  std::cout << "Testing KL ball-ball bound\n";
+  {
+    // the right ball around mu and the left ball around q, with the 
+    // divergences d(x, y) from the first to the second at least 
+    // d(q, mu) - which is about 0.28 - less the radii
+    typedef KLDivergence<double> TDiv;
+    typedef BregmanBall<double, TDiv> TBall;
+    const double radius = 0.002;
+    TBall right_ball(mu, radius, mu, radius);
+    TBall left_ball(q, radius, q, radius);
+    const double d_q_mu = TDiv::BDivergence(q, mu);
+    // the O(d) bound, without bisection, and then the projections
+    const double quick_bound = 
+      right_ball.RightLowerBound(left_ball, d_q_mu, 0);
+    const double cheap_bound = right_ball.RightLowerBound(left_ball, d_q_mu, 1);
+    const double bound = right_ball.RightLowerBound(left_ball, d_q_mu);
+    assert(quick_bound > 0 and cheap_bound >= quick_bound);
+    assert(cheap_bound > 0 and bound >= cheap_bound and bound < d_q_mu);
+
+    // no point of the balls is closer
+    std::mt19937 generator(0);
+    std::uniform_real_distribution<double> noise(-0.05, 0.05);
+    double min_div = std::numeric_limits<double>::max();
+    size_t n_pairs = 0;
+    for (size_t i = 0; i < 20000 and n_pairs < 1000; i++)
+    {
+      Point<double> x(mu);
+      Point<double> y(q);
+      for (size_t d = 0; d < x.n_dims(); d++)
+      {
+        x[d] *= 1 + noise(generator);
+        y[d] *= 1 + noise(generator);
+      }
+      if (TDiv::BDivergence(x, mu) > radius or 
+          TDiv::BDivergence(q, y) > radius)
+        continue;
+      min_div = std::min(min_div, TDiv::BDivergence(x, y));
+      n_pairs++;
+    }
+    assert(n_pairs > 0 and bound <= min_div);
+    std::cout << "Bounds: " << quick_bound << " (O(d)), " << cheap_bound << 
+      " (1 alternation), " << bound << ", closest pair found " << 
+      min_div << "\n";
+
+    assert(right_ball.CanPruneRight(left_ball, 0.9 * cheap_bound, d_q_mu));
+    assert(not right_ball.CanPruneRight(left_ball, min_div, d_q_mu));
+    assert(left_ball.CanPruneLeft(right_ball, 0.9 * cheap_bound, d_q_mu));
+
+    // balls which meet, and a ball without a left centroid
+    assert(right_ball.RightLowerBound(
+          TBall(q, radius, q, d_q_mu), d_q_mu) == 0);
+    assert(right_ball.RightLowerBound(TBall(q, radius), d_q_mu) == 0);
+  }
+  std::cout << "KL ball-ball bound passed.\n";
+
+  std::cout << "Testing L2 ball-ball bound\n";
+  {
+    // the closest points of the balls are on the segment from mu to q
+    typedef L2Divergence<double> TDiv;
+    typedef BregmanBall<double, TDiv> TBall;
+    const double radius = 0.001;
+    const double q_radius = 0.002;
+    TBall right_ball(mu, radius, mu, radius);
+    TBall left_ball(q, q_radius, q, q_radius);
+    const double d_q_mu = TDiv::BDivergence(q, mu);
+    const double q_mu = sqrt(2 * d_q_mu);
+    Point<double> x;
+    Point<double> y;
+    const double t = sqrt(2 * radius) / q_mu;
+    const double s = sqrt(2 * q_radius) / q_mu;
+    Axpby<double>(1 - t, mu, t, q, x);
+    Axpby<double>(s, mu, 1 - s, q, y);
+    const double d_nearest = TDiv::BDivergence(x, y);
+    assert(fabs(right_ball.RightLowerBound(left_ball, d_q_mu) - d_nearest) <
+        1e-12);
+    assert(right_ball.CanPruneRight(left_ball, 0.99 * d_nearest, d_q_mu));
+    assert(not right_ball.CanPruneRight(left_ball, 1.01 * d_nearest, d_q_mu));
+  }
+  std::cout << "L2 ball-ball bound passed.\n";
   
   return 0;
 }
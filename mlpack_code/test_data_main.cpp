@@ -7,16 +7,80 @@
  */
 
 #include <assert.h>
+#include <math.h>
+#include <stdio.h>
 #include <time.h>
 
 #include <algorithm>
 #include <fstream>
 #include <iostream>
+#include <limits>
 #include <random>
+#include <stdexcept>
 #include <string>
 #include <vector>
 
 #include "data.hpp"
+#include "simd_kernels.hpp"
+
+// the vectorized kernels sum in a different order than the scalar loops
+bool Close(const double a, const double b)
+{
+  return fabs(a - b) <= 1e-12 * std::max(1.0, fabs(b));
+}
+
+template <typename T>
+void TestSimdKernels(std::default_random_engine& generator)
+{
+  std::uniform_real_distribution<double> randu(-10, 10);
+  const bmst::simd::Isa supported = bmst::simd::SupportedIsa();
+  for (size_t n_dims = 0; n_dims < 70; n_dims++) {
+    std::vector<T> x(n_dims), y(n_dims), result(n_dims), scalar(n_dims);
+    for (size_t i = 0; i < n_dims; i++) {
+      x[i] = randu(generator);
+      y[i] = randu(generator);
+    }
+
+    // the products of floats are rounded to floats in the scalar loop
+    // only, so the results can differ by n_dims roundings
+    double magnitude = 1;
+    for (size_t i = 0; i < n_dims; i++)
+      magnitude += fabs(x[i] * y[i]) + (x[i] - y[i]) * (x[i] - y[i]);
+    const double tolerance =
+      n_dims * std::numeric_limits<T>::epsilon() * magnitude;
+
+    bmst::simd::SetIsa(bmst::simd::kScalar);
+    const double dot = bmst::simd::Dot(x.data(), y.data(), n_dims);
+    const double sq_dist =
+      bmst::simd::SquaredDistance(x.data(), y.data(), n_dims);
+    bmst::simd::Axpby(0.3, x.data(), -1.7, y.data(), scalar.data(), n_dims);
+
+    for (int isa = bmst::simd::kSse2; isa <= supported; isa++) {
+      assert(bmst::simd::SetIsa((bmst::simd::Isa) isa) == isa);
+      assert(fabs(bmst::simd::Dot(x.data(), y.data(), n_dims) - dot) <=
+          tolerance);
+      assert(fabs(bmst::simd::SquaredDistance(x.data(), y.data(), n_dims) -
+            sq_dist) <= tolerance);
+      const T* rows[4] = { y.data(), y.data(), y.data(), y.data() };
+      double dots[4];
+      bmst::simd::Dot4(x.data(), rows, n_dims, dots);
+      for (size_t k = 0; k < 4; k++)
+        assert(fabs(dots[k] - dot) <= tolerance);
+      bmst::simd::Axpby(
+          0.3, x.data(), -1.7, y.data(), result.data(), n_dims);
+      for (size_t i = 0; i < n_dims; i++)
+        assert(result[i] == scalar[i]);
+
+      // in place
+      result = x;
+      bmst::simd::Axpby(
+          0.3, result.data(), -1.7, y.data(), result.data(), n_dims);
+      for (size_t i = 0; i < n_dims; i++)
+        assert(result[i] == scalar[i]);
+    }
+  }
+  bmst::simd::SetIsa(supported);
+}
 
 int main(int argc, char* argv[])
 {
@@ -161,17 +225,56 @@ int main(int argc, char* argv[])
   }
   std::cout << " ... PASSED" << std::endl;
   std::cout << "Testing binary dot-product";
+  // the scalar path sums in the order of the loops below
+  const bmst::simd::Isa isa = bmst::simd::ActiveIsa();
+  bmst::simd::SetIsa(bmst::simd::kScalar);
   double dp = 0;
   for (size_t i = 0; i < p.n_dims(); i++) 
     dp += (p[i] * q[i]);
 
   assert(dp == bmst::Dot(p, q));
+  bmst::simd::SetIsa(isa);
+  assert(Close(bmst::Dot(p, q), dp));
+  bmst::simd::SetIsa(bmst::simd::kScalar);
 
   dp = 0;
   for (size_t i = 0; i < r.n_dims(); i++) 
     dp += (r[i] * s[i]);
 
   assert(dp == bmst::Dot(r, s));
+  bmst::simd::SetIsa(isa);
+  assert(Close(bmst::Dot(r, s), dp));
+  std::cout << " ... PASSED" << std::endl;
+  std::cout << "Testing fused squared distance and axpby";
+  double sq_dist = 0;
+  for (size_t i = 0; i < p.n_dims(); i++) 
+    sq_dist += (p[i] - q[i]) * (p[i] - q[i]);
+
+  bmst::simd::SetIsa(bmst::simd::kScalar);
+  assert(sq_dist == bmst::SquaredDistance(p, q));
+  bmst::simd::SetIsa(isa);
+  assert(Close(bmst::SquaredDistance(p, q), sq_dist));
+
+  t = 0.3 * p + 0.7 * q;
+  u.zeros(3);
+  bmst::Axpby<double>(0.3, p, 0.7, q, u);
+  assert(u.n_dims() == p.n_dims());
+  for (size_t i = 0; i < p.n_dims(); i++) {
+    assert(u[i] == t[i]);
+  }
+
+  // in place, without reallocating
+  const double* u_values = u.values();
+  bmst::Axpby<double>(2.0, u, -1.0, p, u);
+  assert(u.values() == u_values);
+  for (size_t i = 0; i < p.n_dims(); i++) {
+    assert(u[i] == 2.0 * t[i] - p[i]);
+  }
+  std::cout << " ... PASSED" << std::endl;
+  std::cout << "Testing the " << bmst::simd::IsaName(isa) << 
+    " kernels against the scalar ones";
+  TestSimdKernels<double>(generator);
+  TestSimdKernels<float>(generator);
   std::cout << " ... PASSED" << std::endl;
 
 
@@ -320,6 +423,39 @@ int main(int argc, char* argv[])
   }
   std::cout << " ... PASSED" << std::endl;
 
+  std::cout << "Testing the aligned storage + point views";
+  {
+    bmst::Table<float> pointSetX(pointSetP);
+    assert(pointSetX.n_dims() == pointSetA[0].size());
+    assert(pointSetX.stride() >= pointSetX.n_dims());
+    assert((pointSetX.stride() * sizeof(float)) %
+      bmst::Table<float>::kAlignment == 0);
+    for (size_t i = 0; i < pointSetX.n_points(); i++) {
+      assert((size_t) pointSetX[i].values() %
+        bmst::Table<float>::kAlignment == 0);
+      // the padding is zeroed out
+      for (size_t j = pointSetX.n_dims(); j < pointSetX.stride(); j++)
+        assert(pointSetX.values()[i * pointSetX.stride() + j] == 0);
+    }
+
+    pointSetX.Swap(3, 7);
+    for (size_t j = 0; j < pointSetX.n_dims(); j++) {
+      assert(pointSetX[3][j] == pointSetA[7][j]);
+      assert(pointSetX[7][j] == pointSetA[3][j]);
+    }
+
+    bmst::PointView<float> view = pointSetX[5];
+    view[2] = -1;
+    assert(pointSetX[5][2] == -1);
+    assert(pointSetP[5][2] == pointSetA[5][2]);
+
+    const bmst::Point<float> copy = pointSetX[5];
+    assert(copy.n_dims() == pointSetX.n_dims());
+    for (size_t j = 0; j < copy.n_dims(); j++)
+      assert(copy[j] == pointSetX[5][j]);
+  }
+  std::cout << " ... PASSED" << std::endl;
+
   std::cout << "Testing the initializer(file name)" << std::endl;
   {
     std::cout << "Reading 'test_data.csv' .. " << std::endl;
@@ -354,6 +490,53 @@ int main(int argc, char* argv[])
     }
     std::cout << "DONE" << std::endl;
   }
+  std::cout << "Testing the parallel parser";
+  {
+    // mixed separators, blank lines and CRLF line endings
+    const std::string file_name = "test_data_parser.csv";
+    std::ofstream ofs(file_name.c_str());
+    for (size_t i = 0; i < 1000; i++) {
+      if (i % 97 == 0)
+        ofs << "\n  \n";
+      for (size_t j = 0; j < 100; j++) {
+        ofs << pointSetA[i][j];
+        if (j < 99)
+          ofs << ((i + j) % 3 == 0 ? ", " : (j % 2 ? "," : " "));
+      }
+      ofs << ((i % 5 == 0) ? "\r\n" : "\n");
+    }
+    ofs.close();
+
+    const bmst::Table<float> serial(file_name, 1);
+    const bmst::Table<float> parallel(file_name, 7);
+    assert(serial.n_points() == 1000);
+    assert(parallel.n_points() == 1000);
+    assert(serial.n_dims() == 100);
+    assert(parallel.n_dims() == 100);
+    for (size_t i = 0; i < 1000; i++) {
+      for (size_t j = 0; j < 100; j++) {
+        assert(serial[i][j] == parallel[i][j]);
+        assert(std::fabs(serial[i][j] - pointSetA[i][j]) < 1e-4);
+      }
+    }
+
+    // a dimension mismatch is reported with its line number
+    ofs.open(file_name.c_str());
+    ofs << "1, 2, 3\n\n4, 5, 6\n7, 8\n9, 10, 11\n";
+    ofs.close();
+    for (size_t n_threads = 1; n_threads < 4; n_threads++) {
+      bool thrown = false;
+      try {
+        const bmst::Table<float> bad(file_name, n_threads);
+      } catch (const std::runtime_error& e) {
+        thrown = true;
+        assert(std::string(e.what()).find("line 4:") != std::string::npos);
+      }
+      assert(thrown);
+    }
+    remove(file_name.c_str());
+  }
+  std::cout << " ... PASSED" << std::endl;
   std::cout << "Testing the Table class ... DONE" << std::endl;
 
   return 0;
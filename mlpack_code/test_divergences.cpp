@@ -1,6 +1,10 @@
+#include <float.h>
+#include <math.h>
+
 #include "data.hpp"
 #include "KLDivergence.hpp"
 #include "L2Divergence.hpp"
+#include "divergence_cache.hpp"
 
 using namespace bmst;
 
@@ -92,6 +96,323 @@ int main(int argc, char* argv[])
   }
   
   std::cout << "L2 Divergence passed.\n";
+
+  std::cout << "Testing fixed-dimension divergences.\n";
+
+  assert((KLDivergence<double, 5>::BDivergence(x, y) == 
+      KLDivergence<double>::BDivergence(x, y)));
+  assert((KLDivergence<double, 5>::JBDivergence(x, y) == 
+      KLDivergence<double>::JBDivergence(x, y)));
+  assert((L2Divergence<double, 5>::BDivergence(x, y) == 
+      L2Divergence<double>::BDivergence(x, y)));
+  assert((L2Divergence<double, 5>::JBDivergence(x, y) == 
+      L2Divergence<double>::JBDivergence(x, y)));
+
+  x_prime = KLDivergence<double, 5>::Gradient(x);
+  x_prime_inv = KLDivergence<double, 5>::GradientConjugate(x_prime);
+  y_prime = KLDivergence<double>::Gradient(x);
+  for (int i = 0; i < x.n_dims(); i++)
+  {
+    assert (x_prime[i] == y_prime[i]);
+    assert (fabs(x[i] - x_prime_inv[i]) < eps);
+  }
+
+  std::cout << "Fixed-dimension divergences passed.\n";
+
+  std::cout << "Testing the cached divergence terms.\n";
+
+  {
+    std::vector<Point<double> > points;
+    points.push_back(x);
+    points.push_back(y);
+    points.push_back(a);
+    points.push_back(b);
+    const Table<double> table(points);
+
+    DivergenceCache<double, KLDivergence<double> > kl_cache(table);
+    DivergenceCache<double, L2Divergence<double> > l2_cache(table);
+    assert(kl_cache.n_points() == table.n_points());
+    // a and b have zeros, so the KL divergences to them have no closed 
+    // form
+    assert(kl_cache.closed_form(0) and kl_cache.closed_form(1));
+    assert(not kl_cache.closed_form(2) and not kl_cache.closed_form(3));
+    for (size_t i = 0; i < table.n_points(); i++)
+    {
+      assert(l2_cache.closed_form(i));
+      for (size_t j = 0; j < table.n_points(); j++)
+      {
+        assert(fabs(L2Divergence<double>::BDivergence(
+            l2_cache.phi(i), table[i], l2_cache.gradient(j), 
+            l2_cache.offset(j)) - 
+            L2Divergence<double>::BDivergence(table[i], table[j])) < eps);
+        if (kl_cache.closed_form(j))
+          assert(fabs(KLDivergence<double>::BDivergence(
+              kl_cache.phi(i), table[i], kl_cache.gradient(j), 
+              kl_cache.offset(j)) - 
+              KLDivergence<double>::BDivergence(table[i], table[j])) < eps);
+      }
+    }
+
+    // the closed form is within its error bound of the divergence, in 
+    // single precision
+    Table<float> float_table(table.n_points(), table.n_dims());
+    Table<double> rounded_table(table.n_points(), table.n_dims());
+    for (size_t i = 0; i < table.n_points(); i++)
+    {
+      for (size_t j = 0; j < table.n_dims(); j++)
+      {
+        float_table[i][j] = table[i][j];
+        rounded_table[i][j] = float_table[i][j];
+      }
+    }
+    DivergenceCache<float, KLDivergence<float> > float_kl_cache(float_table);
+    DivergenceCache<float, L2Divergence<float> > float_l2_cache(float_table);
+    for (size_t i = 0; i < table.n_points(); i++)
+    {
+      for (size_t j = 0; j < table.n_points(); j++)
+      {
+        assert(fabs(L2Divergence<float>::BDivergence(
+            float_l2_cache.phi(i), float_table[i], 
+            float_l2_cache.gradient(j), float_l2_cache.offset(j)) - 
+            L2Divergence<double>::BDivergence(
+              rounded_table[i], rounded_table[j])) <= 
+            float_l2_cache.ErrorTo(j, float_l2_cache.phi(i), 
+              L2Divergence<float>::ClosedFormNorm(
+                float_table[i], float_l2_cache.phi(i))));
+        if (not float_kl_cache.closed_form(j))
+          continue;
+        double dual_norm, scale;
+        DivergenceCache<float, KLDivergence<float> >::ErrorScale(
+            float_table[j], float_kl_cache.phi(j), 
+            float_kl_cache.gradient(j), dual_norm, scale);
+        assert(fabs(KLDivergence<float>::BDivergence(
+            float_kl_cache.phi(i), float_table[i], 
+            float_kl_cache.gradient(j), float_kl_cache.offset(j)) - 
+            KLDivergence<double>::BDivergence(
+              rounded_table[i], rounded_table[j])) <= 
+            float_kl_cache.ErrorFrom(i, dual_norm, scale));
+      }
+    }
+
+    kl_cache.Swap(0, 2);
+    assert(kl_cache.phi(0) == KLDivergence<double>::Phi(a));
+    assert(not kl_cache.closed_form(0) and kl_cache.closed_form(2));
+  }
+
+  std::cout << "Cached divergence terms passed.\n";
+
+  std::cout << "Testing the vectorized log, exp and KL kernels.\n";
+  {
+    // the arguments span the whole range, subnormals included
+    std::vector<double> args;
+    for (double v = 1e-310; v < 1e300; v *= 1.0137)
+      args.push_back(v);
+    for (double v = 0.5; v < 2; v += 1e-4)
+      args.push_back(v);
+    std::vector<double> logs(args.size());
+    simd::Log(args.data(), logs.data(), args.size());
+    for (size_t i = 0; i < args.size(); i++)
+      assert(fabs(logs[i] - log(args[i])) <= 
+          simd::kLogUlps * DBL_EPSILON * fabs(log(args[i])));
+
+    std::vector<double> exp_args;
+    for (double v = -740; v < 709; v += 0.0173)
+      exp_args.push_back(v);
+    std::vector<double> exps(exp_args.size());
+    simd::Exp(exp_args.data(), exps.data(), exp_args.size());
+    for (size_t i = 0; i < exp_args.size(); i++)
+    {
+      const double exact = exp(exp_args[i]);
+      // below DBL_MIN the results lose precision in both
+      if (exact < DBL_MIN)
+        assert(fabs(exps[i] - exact) <= 2 * DBL_MIN * DBL_EPSILON);
+      else
+        assert(fabs(exps[i] - exact) <= 
+            simd::kExpUlps * DBL_EPSILON * exact);
+    }
+
+    // the zeros, infinities and large values go through the masks
+    const double special[] = { 0, INFINITY, 1e308, 5e-324 };
+    double special_logs[4];
+    simd::Log(special, special_logs, 4);
+    for (size_t i = 0; i < 4; i++)
+      assert(special_logs[i] == log(special[i]) or 
+          fabs(special_logs[i] - log(special[i])) <= 
+          simd::kLogUlps * DBL_EPSILON * fabs(log(special[i])));
+    const double special_exp_args[] = { -INFINITY, -1000, 1000, 0 };
+    double special_exps[4];
+    simd::Exp(special_exp_args, special_exps, 4);
+    assert(special_exps[0] == 0 and special_exps[1] == 0);
+    assert(special_exps[2] == INFINITY and special_exps[3] == 1);
+
+    // the vectorized KL kernels against the scalar ones, on points with
+    // zeros
+    Table<double> points(4, 13);
+    for (size_t i = 0; i < points.n_points(); i++)
+      for (size_t j = 0; j < points.n_dims(); j++)
+        points[i][j] = ((i + 2 * j) % 5 == 0) ? 0.0 : 0.1 * (i + j + 1);
+    const simd::Isa isa = simd::ActiveIsa();
+    for (size_t i = 0; i < points.n_points(); i++)
+    {
+      simd::SetIsa(simd::kScalar);
+      const Point<double> scalar_grad = KLDivergence<double>::Gradient(
+          points[i]);
+      const Point<double> scalar_conj = 
+        KLDivergence<double>::GradientConjugate(scalar_grad);
+      simd::SetIsa(isa);
+      const Point<double> grad = KLDivergence<double>::Gradient(points[i]);
+      const Point<double> conj = 
+        KLDivergence<double>::GradientConjugate(grad);
+      for (size_t j = 0; j < points.n_dims(); j++)
+      {
+        assert(fabs(grad[j] - scalar_grad[j]) <= 
+            4 * DBL_EPSILON * fabs(scalar_grad[j]));
+        assert(fabs(conj[j] - points[i][j]) <= 8 * DBL_EPSILON);
+      }
+
+      for (size_t j = 0; j < points.n_points(); j++)
+      {
+        simd::SetIsa(simd::kScalar);
+        const double scalar_div = 
+          KLDivergence<double>::BDivergence(points[i], points[j]);
+        simd::SetIsa(isa);
+        const double div = 
+          KLDivergence<double>::BDivergence(points[i], points[j]);
+        if (scalar_div == std::numeric_limits<double>::max())
+          assert(div == scalar_div);
+        else
+          assert(fabs(div - scalar_div) <= 
+              KLDivergence<double>::BDivergenceError(
+                points[i], points[j], div));
+      }
+    }
+  }
+
+  std::cout << "Vectorized kernels passed.\n";
+
+  std::cout << "Testing the divergence matrices.\n";
+  {
+    // enough points and dimensions for several tiles, and a few zeros
+    // for the points without closed form
+    Table<double> x(37, 300);
+    Table<double> y(290, 300);
+    for (size_t i = 0; i < x.n_points(); i++)
+      for (size_t j = 0; j < x.n_dims(); j++)
+        x[i][j] = ((i * 7 + j) % 31 == 0) ? 0.0 : 0.01 * ((i + 3 * j) % 17 + 1);
+    for (size_t i = 0; i < y.n_points(); i++)
+      for (size_t j = 0; j < y.n_dims(); j++)
+        y[i][j] = ((i + j) % 97 == 0 and i % 5 == 0) 
+          ? 0.0 : 0.02 * ((2 * i + j) % 13 + 1);
+
+    Table<double> kl_matrix;
+    Table<double> l2_matrix;
+    for (size_t n_threads = 1; n_threads <= 3; n_threads++)
+    {
+      KLDivergence<double>::BDivergenceMatrix(x, y, kl_matrix, n_threads);
+      L2Divergence<double>::BDivergenceMatrix(x, y, l2_matrix, n_threads);
+      assert(kl_matrix.n_points() == x.n_points());
+      assert(kl_matrix.n_dims() == y.n_points());
+      for (size_t i = 0; i < x.n_points(); i++)
+      {
+        for (size_t j = 0; j < y.n_points(); j++)
+        {
+          const double kl = KLDivergence<double>::BDivergence(x[i], y[j]);
+          if (kl == std::numeric_limits<double>::max())
+            assert(kl_matrix[i][j] == kl);
+          else
+            assert(fabs(kl_matrix[i][j] - kl) < eps);
+          assert(fabs(l2_matrix[i][j] - 
+                L2Divergence<double>::BDivergence(x[i], y[j])) < eps);
+        }
+      }
+    }
+
+    // a block of rows against a block of columns
+    L2Divergence<double>::BDivergenceMatrix(x, 5, 9, y, 100, 103, l2_matrix);
+    assert(l2_matrix.n_points() == 4 and l2_matrix.n_dims() == 3);
+    for (size_t i = 0; i < 4; i++)
+      for (size_t j = 0; j < 3; j++)
+        assert(fabs(l2_matrix[i][j] - 
+              L2Divergence<double>::BDivergence(x[5 + i], y[100 + j])) < eps);
+  }
+
+  std::cout << "Divergence matrices passed.\n";
+
+  std::cout << "Testing the early abandoning divergences.\n";
+  {
+    Table<double> points(3, 100);
+    for (size_t i = 0; i < points.n_points(); i++)
+      for (size_t j = 0; j < points.n_dims(); j++)
+        points[i][j] = 0.1 * ((i * 5 + j) % 11 + 1);
+    // a zero in the last block only
+    points[2][97] = 0;
+    for (size_t i = 0; i < points.n_points(); i++)
+    {
+      for (size_t j = 0; j < points.n_points(); j++)
+      {
+        const double kl = KLDivergence<double>::BDivergence(
+            points[i], points[j]);
+        const double l2 = L2Divergence<double>::BDivergence(
+            points[i], points[j]);
+        // the bound is not reached
+        assert(fabs(KLDivergence<double>::BDivergence(
+                points[i], points[j], 2 * kl + 1) - kl) < eps);
+        assert(fabs(L2Divergence<double>::BDivergence(
+                points[i], points[j], l2) - l2) < eps);
+        // the bound is passed before the end
+        if (kl > 0)
+          assert(KLDivergence<double>::BDivergence(
+                points[i], points[j], 0.01 * kl) > 0.01 * kl);
+        if (l2 > 0)
+          assert(L2Divergence<double>::BDivergence(
+                points[i], points[j], 0.01 * l2) > 0.01 * l2);
+      }
+    }
+    // the zero of points[2] makes the divergence infinite, but the sum 
+    // stops before it
+    assert(KLDivergence<double>::BDivergence(points[0], points[2]) == 
+        std::numeric_limits<double>::max());
+    const double abandoned = 
+      KLDivergence<double>::BDivergence(points[0], points[2], 1.0);
+    assert(abandoned > 1.0 and abandoned < std::numeric_limits<double>::max());
+  }
+
+  std::cout << "Early abandoning divergences passed.\n";
+
+  // in-place gradients
+  {
+    Table<double> points(3, 7);
+    for (size_t i = 0; i < points.n_points(); i++)
+      for (size_t j = 0; j < points.n_dims(); j++)
+        points[i][j] = 0.1 * (i + j + 1);
+    Point<double> grad;
+    Point<double> conj;
+    for (size_t i = 0; i < points.n_points(); i++)
+    {
+      KLDivergence<double>::Gradient(points[i], grad);
+      KLDivergence<double>::GradientConjugate(grad, conj);
+      const Point<double> kl_grad = KLDivergence<double>::Gradient(points[i]);
+      const double* grad_storage = grad.values();
+      for (size_t j = 0; j < points.n_dims(); j++)
+      {
+        assert(grad[j] == kl_grad[j]);
+        assert(fabs(conj[j] - points[i][j]) <= 8 * DBL_EPSILON);
+      }
+      // the storage is reused, and the result can alias the argument
+      KLDivergence<double>::GradientConjugate(grad, grad);
+      assert(grad.values() == grad_storage);
+      for (size_t j = 0; j < points.n_dims(); j++)
+        assert(grad[j] == conj[j]);
+
+      L2Divergence<double>::Gradient(points[i], grad);
+      L2Divergence<double>::GradientConjugate(grad, grad);
+      assert(grad.values() == grad_storage);
+      for (size_t j = 0; j < points.n_dims(); j++)
+        assert(grad[j] == points[i][j]);
+    }
+  }
+
+  std::cout << "In-place gradients passed.\n";
   
   return 0;
 }
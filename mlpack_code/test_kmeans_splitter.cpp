@@ -12,6 +12,7 @@
 #include <algorithm>
 #include <fstream>
 #include <iostream>
+#include <limits>
 #include <random>
 #include <string>
 #include <vector>
@@ -20,6 +21,8 @@
 #include "KLDivergence.hpp"
 #include "L2Divergence.hpp"
 #include "kmeans_splitter.hpp"
+#include "projection_splitter.hpp"
+#include "sampled_kmeans_splitter.hpp"
 
 using namespace std;
 
@@ -169,9 +172,10 @@ int main(int argc, char* argv[])
       std::cout << "], Radius: " << radii[i] << std::endl;
     }
 
-    // all radii should be 0
+    // all radii should be 0, up to the error padding
     for (size_t j = 0; j < radii.size(); j++)
-      assert(radii[j] == 0.0);
+      assert(radii[j] <= bmst::KLDivergence<double>::BDivergenceError(
+            centers[j], centers[j], 0.0));
 
     // check that the memberships are as expected
     // if 2 points have 0 divergence, they should have same membership
@@ -614,5 +618,300 @@ int main(int argc, char* argv[])
 
   std::cout << " ===============================================" << std::endl;
 
+  std::cout << "Testing sampled kmeans clustering on a chunk within a "
+    "20000 point table with KLDiv ... " << std::endl;
+  {
+    std::default_random_engine gen(5);
+    std::uniform_real_distribution<double> urand(1e-10, 1);
+    bmst::Table<double> rand_table(20000, 8);
+    for (size_t i = 0; i < rand_table.n_points(); i++)
+      for (size_t j = 0; j < rand_table.n_dims(); j++)
+        rand_table[i][j] = urand(gen);
+
+    typedef bmst::SampledKMeansSplitter<double, bmst::KLDivergence<double> >
+      TSampledSplitter;
+    const size_t range_lb = 1000;
+    const size_t range_ub = 19000;
+    // Lloyd iterations on the sample, and then mini-batches
+    for (size_t batch_size = 0; batch_size <= 256; batch_size += 256)
+    {
+      TSampledSplitter::SetSampling(512, 50, 1e-4, batch_size);
+      std::vector<size_t> membership;
+      std::vector<bmst::Point<double> > centers;
+      std::vector<double> radii;
+      TSampledSplitter sampled_test;
+      sampled_test.SetSeed(17);
+      sampled_test.PartitionData(
+          rand_table, range_lb, range_ub, membership, centers, radii);
+      assert(membership.size() == range_ub - range_lb);
+      assert(centers.size() == 2);
+      assert(radii.size() == 2);
+
+      // the centers are the means of their points, and the radii their 
+      // largest divergences
+      std::vector<bmst::Point<double> > actual_centers(2);
+      std::vector<size_t> cluster_counts(2, 0);
+      for (size_t j = 0; j < 2; j++)
+        actual_centers[j].zeros(rand_table.n_dims());
+      for (size_t i = 0; i < membership.size(); i++)
+      {
+        actual_centers[membership[i]] += rand_table[range_lb + i];
+        cluster_counts[membership[i]]++;
+      }
+      std::vector<double> actual_radii(2, 0);
+      for (size_t j = 0; j < 2; j++)
+      {
+        std::cout << "Cluster " << j + 1 << " has " << cluster_counts[j] <<
+          " points." << std::endl;
+        assert(cluster_counts[j] > 0);
+        actual_centers[j] /= (double) cluster_counts[j];
+        for (size_t d = 0; d < rand_table.n_dims(); d++)
+          assert(fabs(centers[j][d] - actual_centers[j][d]) < 1e-10);
+      }
+      for (size_t i = 0; i < membership.size(); i++)
+      {
+        const double div_to_assigned_center = 
+          bmst::KLDivergence<double>::BDivergence(
+              rand_table[range_lb + i], actual_centers[membership[i]]);
+        actual_radii[membership[i]] = 
+          std::max(actual_radii[membership[i]], div_to_assigned_center);
+      }
+      for (size_t j = 0; j < 2; j++)
+        assert(fabs(radii[j] - actual_radii[j]) < 1e-10);
+
+      // the same seed gives the same split, on any number of threads
+      std::vector<size_t> membership_again;
+      TSampledSplitter sampled_again;
+      sampled_again.SetSeed(17);
+      sampled_again.SetThreads(3);
+      sampled_again.PartitionData(
+          rand_table, range_lb, range_ub, membership_again, centers, radii);
+      assert(membership_again == membership);
+    }
+    TSampledSplitter::SetSampling(bmst::kKMeansSampleSize, 
+        bmst::kKMeansSampleIterations, bmst::kKMeansSampleTolerance);
+  }
+  std::cout << "Testing sampled kmeans clustering on a chunk within a "
+    "20000 point table with KLDiv ... " << "DONE" << std::endl;
+
+  std::cout << " ===============================================" << std::endl;
+
+  // the update of the k-means centers (see KMeansSplitter): a center 
+  // without points keeps its position instead of going to the origin
+  std::cout << "Testing the k-means update of an empty cluster ..." << 
+    std::endl;
+  {
+    bmst::Table<double> points(6, 2);
+    for (size_t i = 0; i < points.n_points(); i++)
+    {
+      points[i][0] = 1.0 + i;
+      points[i][1] = 2.0 * i;
+    }
+    // the points 1-4 go to the centers 0 and 2, none to the center 1
+    std::vector<size_t> membership {0, 2, 0, 2};
+    std::vector<bmst::Point<double> > centers(3);
+    for (size_t j = 0; j < 3; j++)
+    {
+      centers[j].zeros(2);
+      centers[j][0] = 7.0 + j;
+      centers[j][1] = -1.0;
+    }
+    for (size_t n_threads = 1; n_threads <= 2; n_threads++)
+    {
+      std::vector<bmst::Point<double> > updated = centers;
+      bmst::MeanCenters(points, 1, 5, membership, n_threads, updated);
+      assert(updated[0][0] == 3.0 and updated[0][1] == 4.0);
+      assert(updated[2][0] == 4.0 and updated[2][1] == 6.0);
+      assert(updated[1][0] == 8.0 and updated[1][1] == -1.0);
+    }
+  }
+  std::cout << "Testing the k-means update of an empty cluster ... DONE" << 
+    std::endl;
+
+  std::cout << " ===============================================" << std::endl;
+
+  std::cout << "Testing the projection splits on a chunk within a 5000 point "
+    "table with KLDiv ... " << std::endl;
+  {
+    std::default_random_engine gen(9);
+    std::uniform_real_distribution<double> urand(1e-10, 1);
+    bmst::Table<double> rand_table(5000, 6);
+    for (size_t i = 0; i < rand_table.n_points(); i++)
+      for (size_t j = 0; j < rand_table.n_dims(); j++)
+        rand_table[i][j] = urand(gen);
+
+    typedef bmst::KLDivergence<double> TBDiv;
+    const size_t range_lb = 100;
+    const size_t range_ub = 4901;
+    for (size_t rule = 0; rule < 2; rule++)
+    {
+      std::vector<size_t> membership;
+      std::vector<bmst::Point<double> > centers;
+      std::vector<double> radii;
+      std::vector<size_t> membership_again;
+      if (rule == 0)
+      {
+        bmst::RandomProjectionSplitter<double, TBDiv> splitter;
+        splitter.SetSeed(23);
+        splitter.PartitionData(
+            rand_table, range_lb, range_ub, membership, centers, radii);
+        splitter.SetThreads(3);
+        splitter.PartitionData(
+            rand_table, range_lb, range_ub, membership_again, centers, radii);
+      }
+      else
+      {
+        bmst::PCASplitter<double, TBDiv> splitter;
+        splitter.SetSeed(23);
+        splitter.PartitionData(
+            rand_table, range_lb, range_ub, membership, centers, radii);
+        splitter.SetThreads(3);
+        splitter.PartitionData(
+            rand_table, range_lb, range_ub, membership_again, centers, radii);
+      }
+      // the same seed gives the same split, on any number of threads
+      assert(membership_again == membership);
+
+      // the median splits the chunk in half
+      std::vector<size_t> cluster_counts(2, 0);
+      std::vector<bmst::Point<double> > actual_centers(2);
+      for (size_t j = 0; j < 2; j++)
+        actual_centers[j].zeros(rand_table.n_dims());
+      for (size_t i = 0; i < membership.size(); i++)
+      {
+        actual_centers[membership[i]] += rand_table[range_lb + i];
+        cluster_counts[membership[i]]++;
+      }
+      std::cout << "Split " << cluster_counts[0] << " : " << 
+        cluster_counts[1] << std::endl;
+      assert(cluster_counts[0] == (range_ub - range_lb) / 2);
+      assert(cluster_counts[0] + cluster_counts[1] == range_ub - range_lb);
+
+      // the centers are the means of their points, and the radii their 
+      // largest divergences
+      std::vector<double> actual_radii(2, 0);
+      for (size_t j = 0; j < 2; j++)
+      {
+        actual_centers[j] /= (double) cluster_counts[j];
+        for (size_t d = 0; d < rand_table.n_dims(); d++)
+          assert(fabs(centers[j][d] - actual_centers[j][d]) < 1e-10);
+      }
+      for (size_t i = 0; i < membership.size(); i++)
+        actual_radii[membership[i]] = std::max(actual_radii[membership[i]],
+            TBDiv::BDivergence(
+              rand_table[range_lb + i], actual_centers[membership[i]]));
+      for (size_t j = 0; j < 2; j++)
+        assert(fabs(radii[j] - actual_radii[j]) < 1e-10);
+    }
+  }
+  std::cout << "Testing the projection splits on a chunk within a 5000 point "
+    "table with KLDiv ... " << "DONE" << std::endl;
+
+  std::cout << " ===============================================" << std::endl;
+
+  std::cout << "Testing the principal direction and the mean threshold of "
+    "the projection splits with L2Div ... " << std::endl;
+  {
+    typedef bmst::L2Divergence<double> TBDiv;
+    std::default_random_engine gen(13);
+    std::uniform_real_distribution<double> urand(-1, 1);
+
+    // stretched along the axis 2, so that the principal direction of 
+    // the gradients (the points for L2) is that axis, and the median 
+    // split separates the points along it
+    bmst::Table<double> stretched(2000, 5);
+    for (size_t i = 0; i < stretched.n_points(); i++)
+      for (size_t j = 0; j < stretched.n_dims(); j++)
+        stretched[i][j] = (j == 2 ? 100 : 1) * urand(gen);
+    {
+      std::vector<size_t> membership;
+      std::vector<bmst::Point<double> > centers;
+      std::vector<double> radii;
+      bmst::PCASplitter<double, TBDiv> splitter;
+      splitter.SetSeed(29);
+      splitter.PartitionData(
+          stretched, 0, stretched.n_points(), membership, centers, radii);
+      std::vector<double> min_along(2, std::numeric_limits<double>::max());
+      std::vector<double> max_along(2, -std::numeric_limits<double>::max());
+      for (size_t i = 0; i < membership.size(); i++)
+      {
+        min_along[membership[i]] = 
+          std::min(min_along[membership[i]], stretched[i][2]);
+        max_along[membership[i]] = 
+          std::max(max_along[membership[i]], stretched[i][2]);
+      }
+      std::cout << "Along the axis: [" << min_along[0] << ", " << 
+        max_along[0] << "] and [" << min_along[1] << ", " << max_along[1] <<
+        "]" << std::endl;
+      // the children overlap along the axis by at most the spread of the
+      // other axes
+      assert(max_along[0] < min_along[1] + 5 or 
+          max_along[1] < min_along[0] + 5);
+      assert(fabs(centers[0][2] - centers[1][2]) > 80);
+    }
+
+    // with the mean threshold, the first child gets the points whose 
+    // projections are below their mean: on a line, the direction is 
+    // +-1, and the skewed points are not split at the median
+    bmst::Table<double> line(1000, 1);
+    for (size_t i = 0; i < line.n_points(); i++)
+      line[i][0] = 0.001 * i * i;
+    double mean = 0;
+    for (size_t i = 0; i < line.n_points(); i++)
+      mean += line[i][0];
+    mean /= line.n_points();
+    for (size_t rule = 0; rule < 2; rule++)
+    {
+      std::vector<size_t> membership;
+      std::vector<bmst::Point<double> > centers;
+      std::vector<double> radii;
+      if (rule == 0)
+      {
+        bmst::RandomProjectionSplitter<double, TBDiv>::SetSplitting(
+            bmst::kPCASampleSize, bmst::kPowerIterations, 
+            bmst::kPowerTolerance, false);
+        bmst::RandomProjectionSplitter<double, TBDiv> splitter;
+        splitter.SetSeed(31);
+        splitter.PartitionData(
+            line, 0, line.n_points(), membership, centers, radii);
+      }
+      else
+      {
+        bmst::PCASplitter<double, TBDiv>::SetSplitting(
+            bmst::kPCASampleSize, bmst::kPowerIterations, 
+            bmst::kPowerTolerance, false);
+        bmst::PCASplitter<double, TBDiv> splitter;
+        splitter.SetSeed(31);
+        splitter.PartitionData(
+            line, 0, line.n_points(), membership, centers, radii);
+      }
+      // the sign of the direction: the first child holds the smaller 
+      // projections
+      const double sign = (membership[0] == 0) ? 1.0 : -1.0;
+      size_t first_count = 0;
+      for (size_t i = 0; i < line.n_points(); i++)
+      {
+        if (membership[i] == 0)
+        {
+          assert(sign * line[i][0] < sign * mean);
+          first_count++;
+        }
+        else
+          assert(sign * line[i][0] >= sign * mean);
+      }
+      std::cout << "Mean split " << first_count << " : " << 
+        line.n_points() - first_count << std::endl;
+      assert(first_count > 0 and first_count != line.n_points() / 2);
+    }
+    bmst::RandomProjectionSplitter<double, TBDiv>::SetSplitting(
+        bmst::kPCASampleSize, bmst::kPowerIterations, bmst::kPowerTolerance);
+    bmst::PCASplitter<double, TBDiv>::SetSplitting(
+        bmst::kPCASampleSize, bmst::kPowerIterations, bmst::kPowerTolerance);
+  }
+  std::cout << "Testing the principal direction and the mean threshold of "
+    "the projection splits with L2Div ... " << "DONE" << std::endl;
+
+  std::cout << " ===============================================" << std::endl;
+
   return 0;
 }
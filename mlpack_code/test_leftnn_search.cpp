@@ -1,4 +1,5 @@
 #include "bregman_ball.hpp"
+#include "flat_bregman_ball_tree.hpp"
 #include "left_nn_search.hpp"
 #include "KLDivergence.hpp"
 #include "L2Divergence.hpp"
@@ -78,6 +79,24 @@ int main(int argc, char* argv[])
     }
   }
   std::cout << "L2 Divergence tests PASSED.\n";
+
+  std::cout << "Testing KL Divergence Search on the flat tree.\n";
+  {
+    typedef KLDivergence<double> TBDiv;
+    typedef BregmanBall<double, TBDiv> TBBall;
+    typedef FlatBregmanBallTree<double, TBDiv, 
+            KMeansSplitter<double, TBDiv> > TFlatTree;
+    LeftNNSearch<double, TBDiv, TBBall, Table<double>, TFlatTree> 
+      searcher_flat(references, leaf_size);
+  
+    for (int q = 0; q < queries.n_points(); q++)
+    {
+      naive_neighbors[q] = searcher_flat.ComputeNeighborNaive(queries[q]);
+      neighbors[q] = searcher_flat.ComputeNeighbor(queries[q]);
+      assert(neighbors[q] == naive_neighbors[q]);
+    }
+  }
+  std::cout << "KL Divergence flat tree tests PASSED.\n";
     
   return 0;
 }
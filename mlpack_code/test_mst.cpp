@@ -4,6 +4,7 @@
 #include "KLDivergence.hpp"
 #include "L2Divergence.hpp"
 #include "bregman_ball_tree.hpp"
+#include "flat_bregman_ball_tree.hpp"
 #include "kmeans_splitter.hpp"
 
 using namespace bmst;
@@ -34,7 +35,8 @@ int main(int argc, char* argv[])
   //////////////////////////////////
   
   typedef L2Divergence<double> DivType;
-  typedef BregmanBallTree<double, DivType, KMeansSplitter<double, DivType> > TreeType;
+  typedef BregmanBallTree<double, DivType, BregmanBall<double, DivType>, 
+          KMeansSplitter<double, DivType> > TreeType;
   
   MinimumSpanningTree<double, MstMaxEdge<double, DivType>, TreeType> naive_false_mst(data, 1000);
   MinimumSpanningTree<double, MstMaxEdge<double, DivType>, TreeType> naive_true_mst(data, 1000);
@@ -81,7 +83,141 @@ int main(int argc, char* argv[])
     
   }
   
-  std::cout << "Single-Tree Boruvka passes.\n";
+  std::cout << "Single-Tree Boruvka passes.\n\n";
+  
+  std::cout << "Testing the bound cache\n";
+  
+  {
+    
+    BoundCache cache(3 * BoundCache::kEntryBytes);
+    assert(cache.max_entries() == 3);
+    int nodes[4];
+    for (size_t i = 0; i < 3; i++)
+      cache.Insert(i, &nodes[i], i);
+    double bound;
+    // 0 becomes the most recently used, 1 is evicted
+    assert(cache.Find(0, &nodes[0], bound) and bound == 0);
+    cache.Insert(3, &nodes[3], 3);
+    assert(cache.size() == 3);
+    assert(not cache.Find(1, &nodes[1], bound));
+    assert(cache.Find(2, &nodes[2], bound) and bound == 2);
+    assert(not cache.Find(2, &nodes[0], bound));
+    assert(cache.hits() == 2 and cache.misses() == 2);
+    
+  }
+  
+  // the trees with and without the cache (large enough for all the 
+  // bounds, and too small) give the same tree as the naive algorithm
+  {
+    
+    std::vector<std::vector<double> > cache_points;
+    for (size_t i = 0; i < 200; i++) {
+      std::vector<double> point;
+      for (size_t j = 0; j < 3; j++) {
+        point.push_back(randu(generator));
+      }
+      cache_points.push_back(point);
+    }
+    Table<double> cache_data(cache_points);
+    
+    typedef KLDivergence<double> KLType;
+    typedef BregmanBallTree<double, KLType, BregmanBall<double, KLType>, 
+            KMeansSplitter<double, KLType> > KLTreeType;
+    typedef MinimumSpanningTree<double, MstMaxEdge<double, KLType>, KLTreeType> KLMst;
+    
+    KLMst naive_mst(cache_data, 1000);
+    naive_mst.ComputeNaive(true);
+    double naive_weight = 0;
+    for (const Edge& edge : naive_mst.EdgeList())
+      naive_weight += edge.weight;
+    
+    const size_t max_bytes[] = { 0, 1 << 10, 1 << 24 };
+    for (size_t b = 0; b < 3; b++)
+    {
+      
+      KLMst mst(cache_data, 5);
+      if (max_bytes[b] > 0)
+        mst.EnableBoundCache(max_bytes[b], 1000);
+      mst.ComputeSTB();
+      std::vector<Edge> edges = mst.EdgeList();
+      assert(edges.size() == cache_data.n_points() - 1);
+      double weight = 0;
+      for (size_t i = 0; i < edges.size(); i++)
+        weight += edges[i].weight;
+      assert(fabs(weight - naive_weight) < 1e-9 * naive_weight);
+      if (max_bytes[b] > 0)
+      {
+        const BoundCache* cache = mst.GetBoundCache();
+        assert(cache->size() <= cache->max_entries());
+        // the later rounds find the bounds of the first one
+        if (max_bytes[b] == (1 << 24))
+          assert(cache->hits() > 0);
+      }
+      
+    }
+    
+  }
+  
+  std::cout << "Bound cache passes.\n\n";
+  
+  std::cout << "Testing Dual-Tree Boruvka algorithm\n";
+  
+  // the dual-tree trees prune with the bounds between balls, and weigh 
+  // the same as the naive ones
+  {
+    
+    std::vector<std::vector<double> > dual_points;
+    for (size_t i = 0; i < 300; i++) {
+      std::vector<double> point;
+      for (size_t j = 0; j < 3; j++) {
+        point.push_back(randu(generator));
+      }
+      dual_points.push_back(point);
+    }
+    Table<double> dual_data(dual_points);
+    
+    typedef KLDivergence<double> KLType;
+    typedef BregmanBallTree<double, KLType, BregmanBall<double, KLType>, 
+            KMeansSplitter<double, KLType> > KLTreeType;
+    typedef MinimumSpanningTree<double, MstMaxEdge<double, KLType>, KLTreeType> KLMst;
+    typedef MinimumSpanningTree<double, MstMaxEdge<double, DivType>, TreeType> L2Mst;
+    
+    KLMst kl_naive(dual_data, 1000);
+    kl_naive.ComputeNaive(true);
+    KLMst kl_dual(dual_data, 5);
+    kl_dual.ComputeDTB();
+    L2Mst l2_naive(dual_data, 1000);
+    l2_naive.ComputeNaive(true);
+    L2Mst l2_dual(dual_data, 5);
+    l2_dual.ComputeDTB();
+    
+    // and on the flat layout of the tree
+    typedef FlatBregmanBallTree<double, KLType, KMeansSplitter<double, KLType> > KLFlatType;
+    typedef MinimumSpanningTree<double, MstMaxEdge<double, KLType>, KLFlatType> KLFlatMst;
+    KLFlatMst kl_flat_dual(dual_data, 5);
+    kl_flat_dual.ComputeDTB();
+    KLFlatMst kl_flat_single(dual_data, 5);
+    kl_flat_single.ComputeSTB();
+    
+    double weights[6] = { 0, 0, 0, 0, 0, 0 };
+    std::vector<Edge>* edge_lists[6] = { &kl_naive.EdgeList(), &kl_dual.EdgeList(), 
+                                         &l2_naive.EdgeList(), &l2_dual.EdgeList(),
+                                         &kl_flat_dual.EdgeList(), 
+                                         &kl_flat_single.EdgeList() };
+    for (size_t m = 0; m < 6; m++)
+    {
+      assert(edge_lists[m]->size() == dual_data.n_points() - 1);
+      for (const Edge& edge : *edge_lists[m])
+        weights[m] += edge.weight;
+    }
+    assert(fabs(weights[1] - weights[0]) < 1e-9 * weights[0]);
+    assert(fabs(weights[3] - weights[2]) < 1e-9 * weights[2]);
+    assert(fabs(weights[4] - weights[0]) < 1e-9 * weights[0]);
+    assert(fabs(weights[5] - weights[0]) < 1e-9 * weights[0]);
+    
+  }
+  
+  std::cout << "Dual-Tree Boruvka passes.\n";
   
   return 0;
   
@@ -0,0 +1,165 @@
+/**
+ * @file bmst/mlpack_code/test_quantized_data.cpp
+ *
+ * This file tests the quantized tables, the quantized divergence kernels
+ * and the search on quantized tables with full precision re-ranking.
+ */
+
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <iostream>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "data.hpp"
+#include "quantized_data.hpp"
+#include "KLDivergence.hpp"
+#include "L2Divergence.hpp"
+#include "bregman_ball.hpp"
+#include "left_nn_search.hpp"
+
+using namespace bmst;
+
+// the quantized kernels sum in a different order than the dense ones
+bool Close(const double a, const double b)
+{
+  if (a == std::numeric_limits<double>::max()
+      or b == std::numeric_limits<double>::max())
+    return a == b;
+  return fabs(a - b) <= 1e-9 * std::max(1.0, fabs(b));
+}
+
+template <typename Q>
+void TestTable(const Table<double>& dense)
+{
+  const QuantizedTable<double, Q> quantized(dense);
+  assert(quantized.n_points() == dense.n_points());
+  assert(quantized.n_dims() == dense.n_dims());
+  for (size_t i = 0; i < dense.n_points(); i++)
+  {
+    const Point<double> point = quantized[i];
+    for (size_t j = 0; j < dense.n_dims(); j++)
+    {
+      assert(fabs(point[j] - dense[i][j]) <=
+          quantized.MaxError(i) * (1 + 1e-9));
+      assert(point[j] == quantized[i][j]);
+    }
+  }
+
+  // one scale for the whole table
+  const QuantizedTable<double, Q> per_table(dense, false);
+  for (size_t i = 0; i < dense.n_points(); i++)
+  {
+    assert(per_table[i].scale() == per_table[0].scale());
+    for (size_t j = 0; j < dense.n_dims(); j++)
+      assert(fabs(per_table[i][j] - dense[i][j]) <=
+          per_table.MaxError(i) * (1 + 1e-9));
+  }
+
+  QuantizedTable<double, Q> swapped(quantized);
+  swapped.Swap(0, 5);
+  for (size_t j = 0; j < dense.n_dims(); j++)
+  {
+    assert(swapped[0][j] == quantized[5][j]);
+    assert(swapped[5][j] == quantized[0][j]);
+  }
+}
+
+template <class TBDiv, typename Q>
+void TestKernels(const Table<double>& dense)
+{
+  const QuantizedTable<double, Q> quantized(dense);
+  Point<double> grad;
+  for (size_t i = 0; i < dense.n_points(); i++)
+  {
+    const size_t j = (i * 7 + 3) % dense.n_points();
+    const Point<double> x = quantized[i];
+    assert(Close(TBDiv::BDivergence(quantized[i], dense[j]),
+          TBDiv::BDivergence(x, dense[j])));
+    assert(Close(TBDiv::JBDivergence(quantized[i], dense[j]),
+          TBDiv::JBDivergence(x, dense[j])));
+    assert(Close(TBDiv::Phi(quantized[i]), TBDiv::Phi(x)));
+    assert(Close(Dot(quantized[i], dense[j]),
+          Dot((ConstPointView<double>) x, dense[j])));
+    TBDiv::Gradient(quantized[i], grad);
+    const Point<double> x_grad = TBDiv::Gradient(x);
+    for (size_t d = 0; d < dense.n_dims(); d++)
+      assert(grad[d] == x_grad[d]);
+  }
+}
+
+template <class TBDiv, typename Q>
+void TestSearch(const Table<double>& dense, const Table<double>& queries)
+{
+  typedef BregmanBall<double, TBDiv> TBBall;
+  typedef QuantizedTable<double, Q> TQTable;
+  const TQTable quantized(dense);
+  LeftNNSearch<double, TBDiv, TBBall, TQTable> searcher(quantized, 5);
+
+  // the naive search on the dequantized points
+  Table<double> dequantized(dense.n_points(), dense.n_dims());
+  for (size_t i = 0; i < dense.n_points(); i++)
+    for (size_t j = 0; j < dense.n_dims(); j++)
+      dequantized[i][j] = quantized[i][j];
+  LeftNNSearch<double, TBDiv, TBBall> dequantized_searcher(dequantized, 5);
+  LeftNNSearch<double, TBDiv, TBBall> dense_searcher(dense, 5);
+
+  for (size_t q = 0; q < queries.n_points(); q++)
+  {
+    // the pruning is exact for the quantized points
+    const size_t neighbor = searcher.ComputeNeighbor(queries[q]);
+    assert(neighbor ==
+        dequantized_searcher.ComputeNeighborNaive(queries[q]));
+
+    // re-ranking all the points gives the full precision neighbor
+    const size_t exact = dense_searcher.ComputeNeighborNaive(queries[q]);
+    assert(searcher.ComputeNeighbor(
+          queries[q], dense.n_points(), dense) == exact);
+
+    // re-ranking a few candidates can only improve on the quantized
+    // neighbor
+    const size_t reranked = searcher.ComputeNeighbor(queries[q], 10, dense);
+    assert(TBDiv::BDivergence(dense[reranked], queries[q]) <=
+        TBDiv::BDivergence(dense[neighbor], queries[q]));
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  std::default_random_engine generator(time(NULL));
+  std::uniform_real_distribution<double> randu(0.1, 10);
+  std::bernoulli_distribution is_zero(0.05);
+
+  // 500 x 32 histograms with a few zeros
+  Table<double> dense(500, 32);
+  for (size_t i = 0; i < dense.n_points(); i++)
+    for (size_t j = 0; j < dense.n_dims(); j++)
+      dense[i][j] = is_zero(generator) ? 0.0 : randu(generator);
+  Table<double> queries(20, 32);
+  for (size_t i = 0; i < queries.n_points(); i++)
+    for (size_t j = 0; j < queries.n_dims(); j++)
+      queries[i][j] = randu(generator);
+
+  std::cout << "Testing the quantized table";
+  TestTable<uint8_t>(dense);
+  TestTable<uint16_t>(dense);
+  std::cout << " ... PASSED" << std::endl;
+
+  std::cout << "Testing the quantized KL and L2 kernels";
+  TestKernels<KLDivergence<double>, uint8_t>(dense);
+  TestKernels<L2Divergence<double>, uint8_t>(dense);
+  TestKernels<KLDivergence<double, 32>, uint16_t>(dense);
+  std::cout << " ... PASSED" << std::endl;
+
+  std::cout << "Testing the search on quantized tables";
+  TestSearch<KLDivergence<double>, uint8_t>(dense, queries);
+  TestSearch<L2Divergence<double>, uint8_t>(dense, queries);
+  TestSearch<KLDivergence<double>, uint16_t>(dense, queries);
+  std::cout << " ... PASSED" << std::endl;
+
+  return 0;
+}
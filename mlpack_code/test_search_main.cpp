@@ -5,12 +5,14 @@
  */
 
 #include <assert.h>
+#include <stdlib.h>
 #include <time.h>
 
 #include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <memory>
+#include <new>
 #include <random>
 #include <string>
 #include <vector>
@@ -18,6 +20,7 @@
 #include <boost/program_options.hpp>
 
 #include "data.hpp"
+#include "table_io.hpp"
 #include "util.hpp"
 
 #include "L2Divergence.hpp"
@@ -25,12 +28,56 @@
 #include "bregman_ball.hpp"
 #include "enhanced_bregman_ball.hpp"
 #include "left_nn_search.hpp"
+#include "right_nn_search.hpp"
 
 using namespace std;
 
+// The heap allocations of this thread, counted by the replacement of the
+// global operator new below
+static thread_local size_t n_allocations = 0;
+
+void* operator new(size_t size)
+{
+  ++n_allocations;
+  void* pointer = malloc(size == 0 ? 1 : size);
+  if (pointer == NULL)
+    throw std::bad_alloc();
+  return pointer;
+}
+
+void operator delete(void* pointer) noexcept
+{
+  free(pointer);
+}
+
+void operator delete(void* pointer, size_t size) noexcept
+{
+  free(pointer);
+}
+
+template <typename T, class Divergence, class TSearcher>
+void DoSearchAndCompareToNaive(
+    bmst::Table<T>& rset, 
+    bmst::Table<T>& qset, 
+    const size_t leaf_size, 
+    const bool right);
+
 template <typename T, class Divergence, class TBBall>
 void DoSearchAndCompareToNaive(
-    bmst::Table<T>& rset, bmst::Table<T>& qset, const size_t leaf_size);
+    bmst::Table<T>& rset, 
+    bmst::Table<T>& qset, 
+    const size_t leaf_size, 
+    const string& direction)
+{
+  if (direction == "right")
+    DoSearchAndCompareToNaive<T, Divergence, 
+      bmst::RightNNSearch<T, Divergence, TBBall> >(
+          rset, qset, leaf_size, true);
+  else
+    DoSearchAndCompareToNaive<T, Divergence, 
+      bmst::LeftNNSearch<T, Divergence, TBBall> >(
+          rset, qset, leaf_size, false);
+}
 
 int main(int argc, char* argv[])
 {
@@ -42,13 +89,19 @@ int main(int argc, char* argv[])
   opt_desc.add_options()
     ("help", "Produce help message")
     ("rfile", bpo::value<string>(), 
-     "The file containing the set of points (required)")
+     "The file containing the set of points (required). Text files and "
+     "binary tables (see convert_table_main) are both accepted")
     ("qfile", bpo::value<string>(), 
      "A file containing a separate set of queries (optional)")
     ("divergence", bpo::value<string>(), 
      "The divergence to be used for the search (optional). Options are: \n"
      " L2 (default)\n"
      " KL\n")
+    ("direction", bpo::value<string>(), 
+     "The side of the divergence on which the neighbors are searched "
+     "(optional). Options are: \n"
+     " left (default), argmin_x d(x, q)\n"
+     " right, argmin_x d(q, x)\n")
     ("results", bpo::value<string>(), "The file in which to write the results")
     ("k", bpo::value<string>(),
      "The number of neighbors required for each query "
@@ -58,7 +111,13 @@ int main(int argc, char* argv[])
      "(optional, 'leaf_size' defaults to 10)")
     ("split_ratio", bpo::value<string>(), "The ratio with which the dataset "
      "is split into query and reference sets (optional, defaults to 0.1 "
-     "if the query set is not provided)");
+     "if the query set is not provided)")
+    ("max_bisection_iterations", bpo::value<string>(),
+     "The maximum number of steps of the bisections of the pruning "
+     "(optional, defaults to 64)")
+    ("bisection_tolerance", bpo::value<string>(),
+     "The relative distance to the surface of a ball at which the "
+     "bisections of the pruning stop (optional, defaults to 1e-3)");
 
   // read command line arguments
   bpo::variables_map vm;
@@ -91,12 +150,20 @@ int main(int argc, char* argv[])
   string qfile = vm.count("qfile") ? vm["qfile"].as<string>() : "";
   string chosen_divergence = 
     vm.count("divergence") ? vm["divergence"].as<string>() : "L2";
+  string direction = 
+    vm.count("direction") ? vm["direction"].as<string>() : "left";
   string results_file = vm.count("results") ? vm["results"].as<string>() : "";
   size_t k = vm.count("k") ? atoi(vm["k"].as<string>().c_str()) : 1;
   double query_ref_split_ratio = vm.count("split_ratio") ? 
     atof(vm["split_ratio"].as<string>().c_str()) : 0.1;
   size_t leaf_size = vm.count("leaf_size") ? 
     atoi(vm["leaf_size"].as<string>().c_str()) : 10;
+  size_t max_bisection_iterations = vm.count("max_bisection_iterations") ?
+    atoi(vm["max_bisection_iterations"].as<string>().c_str()) : 
+    bmst::kMaxBisectionIterations;
+  double bisection_tolerance = vm.count("bisection_tolerance") ?
+    atof(vm["bisection_tolerance"].as<string>().c_str()) : 
+    bmst::kBisectionTolerance;
 
   if (divergences.find(chosen_divergence) == divergences.end())
   {
@@ -106,15 +173,21 @@ int main(int argc, char* argv[])
     exit(1);
   }
 
+  if (direction != "left" and direction != "right")
+  {
+    cout << "[ERROR] The --direction should be 'left' or 'right'" << endl;
+    exit(1);
+  }
+
   cout << "Reading in '" << rfile << "'" << endl;
-  bmst::Table<float> data(rfile);
+  bmst::Table<float> data = bmst::LoadTable<float>(rfile);
   std::unique_ptr<bmst::Table<float> > qset;
   std::unique_ptr<bmst::Table<float> > rset;
 
   if (qfile != "")
   {
     cout << "Reading in '" << qfile << "'" << endl;
-    qset.reset(new bmst::Table<float>(qfile));
+    qset.reset(new bmst::Table<float>(bmst::LoadTable<float>(qfile)));
     rset.reset(new bmst::Table<float>(data));
   }
   else
@@ -136,20 +209,22 @@ int main(int argc, char* argv[])
   cout << "Finding " << k << " neighbor(s) for " << qset->n_points() << 
     " queries from a set of " << rset->n_points() << 
     " points with respect to the " << chosen_divergence << "-divergence" << 
-    endl;
+    " (" << direction << " neighbors)" << endl;
 
   if (chosen_divergence == "KL") 
   {
     typedef bmst::EnhancedBregmanBall<float, bmst::KLDivergence<float> > TBBall;
+    TBBall::SetBisection(max_bisection_iterations, bisection_tolerance);
     DoSearchAndCompareToNaive<float, bmst::KLDivergence<float>, TBBall>(
-        *rset, *qset, leaf_size);
+        *rset, *qset, leaf_size, direction);
   }  
   else
   {  
     assert(chosen_divergence == "L2");
     typedef bmst::EnhancedBregmanBall<float, bmst::L2Divergence<float> > TBBall;
+    TBBall::SetBisection(max_bisection_iterations, bisection_tolerance);
     DoSearchAndCompareToNaive<float, bmst::L2Divergence<float>, TBBall >(
-        *rset, *qset, leaf_size);
+        *rset, *qset, leaf_size, direction);
   }
 
   if (results_file != "")
@@ -161,16 +236,19 @@ int main(int argc, char* argv[])
   return 0;
 } // main
 
-template <typename T, class TDivergence, class TBBall>
+template <typename T, class TDivergence, class TSearcher>
 void DoSearchAndCompareToNaive(
-    bmst::Table<T>& rset, bmst::Table<T>& qset, const size_t leaf_size)
+    bmst::Table<T>& rset, 
+    bmst::Table<T>& qset, 
+    const size_t leaf_size, 
+    const bool right)
 {
   //qset.make_non_zero(0.01);
   //rset.make_non_zero(0.02);
 
   cout << "[INFO] Indexing the reference set with leaves of maximum size " << 
     leaf_size << " ..." << endl;  
-  bmst::LeftNNSearch<T, TDivergence, TBBall> searcher(rset, leaf_size);
+  TSearcher searcher(rset, leaf_size);
   cout << "[INFO] Reference set indexed" << endl;
 
   std::vector<size_t> neighbors(qset.n_points());
@@ -179,36 +257,40 @@ void DoSearchAndCompareToNaive(
   cout << "[INFO] Testing search correctness ... ";
   size_t errors = 0;
   size_t num_queries_with_zero = 0;
-  size_t total_bdiv_counter = 0;
-  size_t total_grad_counter = 0;
-  size_t total_grad_con_counter = 0;
+  // the counts of this thread (test_search_main is built with BMST_STATS)
+  bmst::DivergenceStats& stats = TDivergence::Stats();
+  bmst::DivergenceStats total_stats;
+  // the first search allocates the scratch space of the searcher, the 
+  // later ones should not allocate at all
+  size_t total_allocations = 0;
+  size_t max_allocations = 0;
+
+  // the brute force baseline, on the divergence matrices
+  stats.Reset();
+  searcher.ComputeNeighborsNaive(qset, naive_neighbors);
+  assert(stats.bdiv == rset.n_points() * qset.n_points());
 
   for (size_t i = 0; i < qset.n_points(); i++) 
   {
-    TDivergence::bdiv_counter = 0;
-    TDivergence::grad_counter = 0;
-    TDivergence::grad_con_counter = 0;
-    naive_neighbors[i] = searcher.ComputeNeighborNaive(qset[i]);
+    // the left divergences to a query with a zero can all be infinite
     if (naive_neighbors[i] == -1) {
-      assert(bmst::util::PointHasZero(qset[i]));
+      assert(right or bmst::util::PointHasZero(qset[i]));
       ++num_queries_with_zero;
     } else {
       assert(naive_neighbors[i] < rset.n_points());
-      assert(TDivergence::bdiv_counter == rset.n_points());
-      assert(TDivergence::grad_counter == 0);
-      assert(TDivergence::grad_con_counter == 0);
     }
-    TDivergence::bdiv_counter = 0;
-    TDivergence::grad_counter = 0;
-    TDivergence::grad_con_counter = 0;
+    stats.Reset();
+    const size_t n_allocations_before = n_allocations;
     neighbors[i] = searcher.ComputeNeighbor(qset[i]);
+    const size_t query_allocations = n_allocations - n_allocations_before;
+    total_allocations += query_allocations;
+    if (i > 0)
+      max_allocations = std::max(max_allocations, query_allocations);
     if (neighbors[i] == -1) {
-      assert(bmst::util::PointHasZero(qset[i]));
+      assert(right or bmst::util::PointHasZero(qset[i]));
     } else {
       assert(neighbors[i] < rset.n_points());
-      total_bdiv_counter += TDivergence::bdiv_counter;
-      total_grad_counter += TDivergence::grad_counter;
-      total_grad_con_counter += TDivergence::grad_con_counter;
+      total_stats += stats;
     }
 
     if (neighbors[i] != naive_neighbors[i]) 
@@ -216,8 +298,15 @@ void DoSearchAndCompareToNaive(
       if (neighbors[i] == -1 or naive_neighbors[i] == -1) {
         ++errors;
       } else {
-        T naive_div = TDivergence::BDivergence(qset[i], rset[naive_neighbors[i]]);
-        T div = TDivergence::BDivergence(qset[i], rset[neighbors[i]]);
+        const bmst::ConstPointView<T> naive_neighbor = 
+          rset[naive_neighbors[i]];
+        const bmst::ConstPointView<T> neighbor = rset[neighbors[i]];
+        T naive_div = right 
+          ? TDivergence::BDivergence(qset[i], naive_neighbor)
+          : TDivergence::BDivergence(naive_neighbor, qset[i]);
+        T div = right 
+          ? TDivergence::BDivergence(qset[i], neighbor)
+          : TDivergence::BDivergence(neighbor, qset[i]);
         if (naive_div < div) ++errors;
       }
       // qset[i].print();
@@ -233,7 +322,15 @@ void DoSearchAndCompareToNaive(
     " queries with zero" << endl;
   cout << "[INFO] Naive comp: " << "D " << rset.n_points() * 
     (qset.n_points() - num_queries_with_zero) << endl;
-  cout << "[INFO] Tree comp:  " << "D " << total_bdiv_counter << " G " << 
-    total_grad_counter << " C " << total_grad_con_counter << endl;
+  cout << "[INFO] Tree comp:  " << "D " << total_stats.bdiv << " G " << 
+    total_stats.grad << " C " << total_stats.grad_con << endl;
+  cout << "[INFO] Bisections: " << total_stats.bisections << " with " << 
+    total_stats.bisection_steps << " steps (" << 
+    (double) total_stats.bisection_steps / 
+    std::max(total_stats.bisections, (size_t) 1) << " per bisection)" << 
+    endl;
+  cout << "[INFO] Heap allocations: " << total_allocations << 
+    " in all the searches, at most " << max_allocations << 
+    " per search after the first" << endl;
   return;
 }
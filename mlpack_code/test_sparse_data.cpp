@@ -0,0 +1,230 @@
+/**
+ * @file bmst/mlpack_code/test_sparse_data.cpp
+ *
+ * This file tests the sparse tables, the sparse divergence kernels and
+ * the tree construction and search on sparse tables.
+ */
+
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <queue>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "data.hpp"
+#include "sparse_data.hpp"
+#include "KLDivergence.hpp"
+#include "L2Divergence.hpp"
+#include "bregman_ball.hpp"
+#include "enhanced_bregman_ball.hpp"
+#include "kmeans_splitter.hpp"
+#include "bregman_ball_tree.hpp"
+#include "left_nn_search.hpp"
+
+using namespace bmst;
+
+// the sparse kernels sum in a different order than the dense ones
+bool Close(const double a, const double b)
+{
+  if (a == std::numeric_limits<double>::max()
+      or b == std::numeric_limits<double>::max())
+    return a == b;
+  return fabs(a - b) <= 1e-9 * std::max(1.0, fabs(b));
+}
+
+template <class TBDiv>
+void TestKernels(const Table<double>& dense, const SparseTable<double>& sparse)
+{
+  Point<double> grad;
+  for (size_t i = 0; i < dense.n_points(); i++)
+  {
+    const size_t j = (i * 7 + 3) % dense.n_points();
+    assert(Close(TBDiv::BDivergence(sparse[i], dense[j]),
+          TBDiv::BDivergence(dense[i], dense[j])));
+    assert(Close(TBDiv::BDivergence(dense[i], sparse[j]),
+          TBDiv::BDivergence(dense[i], dense[j])));
+    assert(Close(TBDiv::BDivergence(sparse[i], sparse[j]),
+          TBDiv::BDivergence(dense[i], dense[j])));
+    assert(Close(TBDiv::JBDivergence(sparse[i], dense[j]),
+          TBDiv::JBDivergence(dense[i], dense[j])));
+    assert(Close(TBDiv::JBDivergence(dense[i], sparse[j]),
+          TBDiv::JBDivergence(dense[i], dense[j])));
+    assert(Close(TBDiv::JBDivergence(sparse[i], sparse[j]),
+          TBDiv::JBDivergence(dense[i], dense[j])));
+
+    const Point<double> sparse_grad = TBDiv::Gradient(sparse[i]);
+    const Point<double> dense_grad = TBDiv::Gradient(dense[i]);
+    // the dense gradient may use the vectorized logarithm
+    for (size_t d = 0; d < dense.n_dims(); d++)
+      assert(Close(sparse_grad[d], dense_grad[d]));
+    // and in place, into the storage of the last one
+    TBDiv::Gradient(sparse[j], grad);
+    const Point<double> sparse_grad_j = TBDiv::Gradient(sparse[j]);
+    for (size_t d = 0; d < dense.n_dims(); d++)
+      assert(grad[d] == sparse_grad_j[d]);
+  }
+}
+
+template <class TBDiv>
+void TestTree(const Table<double>& dense, const SparseTable<double>& sparse)
+{
+  typedef KMeansSplitter<double, TBDiv> TSplitter;
+  typedef EnhancedBregmanBall<double, TBDiv> TBBall;
+  typedef BregmanBallTree<double, TBDiv, TBBall, TSplitter> TTree;
+
+  SparseTable<double> table(sparse);
+  std::vector<size_t> old_from_new;
+  TTree tree(table, old_from_new, 5);
+
+  // the points were permuted, not changed
+  std::vector<bool> seen(dense.n_points(), false);
+  for (size_t i = 0; i < table.n_points(); i++)
+  {
+    assert(not seen[old_from_new[i]]);
+    seen[old_from_new[i]] = true;
+    const Point<double> point = table[i];
+    for (size_t d = 0; d < dense.n_dims(); d++)
+      assert(point[d] == dense[old_from_new[i]][d]);
+  }
+
+  // every node is centered at the mean of its points
+  std::queue<const TTree*> node_queue;
+  node_queue.push(&tree);
+  while (not node_queue.empty())
+  {
+    const TTree* node = node_queue.front();
+    node_queue.pop();
+    Point<double> center;
+    center.zeros(dense.n_dims());
+    for (size_t i = node->Begin(); i < node->End(); i++)
+      center += table[i];
+    center /= (double) node->Count();
+    assert(SquaredDistance(center, node->RCenter()) < 1e-10);
+    if (not node->IsLeaf())
+    {
+      node_queue.push(node->Left());
+      node_queue.push(node->Right());
+    }
+  }
+}
+
+template <class TBDiv>
+void TestSearch(
+    const Table<double>& dense,
+    const SparseTable<double>& sparse,
+    const Table<double>& queries)
+{
+  typedef BregmanBall<double, TBDiv> TBBall;
+  LeftNNSearch<double, TBDiv, TBBall> dense_searcher(dense, 5);
+  LeftNNSearch<double, TBDiv, TBBall, SparseTable<double> >
+    sparse_searcher(sparse, 5);
+
+  for (size_t q = 0; q < queries.n_points(); q++)
+  {
+    const size_t naive = dense_searcher.ComputeNeighborNaive(queries[q]);
+    assert(sparse_searcher.ComputeNeighborNaive(queries[q]) == naive);
+    assert(sparse_searcher.ComputeNeighbor(queries[q]) == naive);
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  std::default_random_engine generator(time(NULL));
+  std::uniform_real_distribution<double> randu(0.1, 10);
+  std::bernoulli_distribution is_nonzero(0.1);
+
+  // 600 x 200 histograms with about 10% non-zeros
+  Table<double> dense(600, 200);
+  for (size_t i = 0; i < dense.n_points(); i++)
+  {
+    for (size_t j = 0; j < dense.n_dims(); j++)
+      dense[i][j] = is_nonzero(generator) ? randu(generator) : 0.0;
+    // no empty points
+    dense[i][i % dense.n_dims()] = randu(generator);
+  }
+  Table<double> queries(20, 200);
+  for (size_t i = 0; i < queries.n_points(); i++)
+    for (size_t j = 0; j < queries.n_dims(); j++)
+      queries[i][j] = randu(generator);
+
+  std::cout << "Testing the sparse table";
+  const SparseTable<double> sparse(dense);
+  {
+    assert(sparse.n_points() == dense.n_points());
+    assert(sparse.n_dims() == dense.n_dims());
+    size_t n_nonzeros = 0;
+    for (size_t i = 0; i < dense.n_points(); i++)
+    {
+      const Point<double> point = sparse[i];
+      for (size_t j = 0; j < dense.n_dims(); j++)
+      {
+        assert(point[j] == dense[i][j]);
+        if (dense[i][j] != 0)
+          ++n_nonzeros;
+      }
+    }
+    assert(sparse.n_nonzeros() == n_nonzeros);
+
+    SparseTable<double> swapped(sparse);
+    swapped.Swap(0, 5);
+    const Point<double> point = swapped[0];
+    for (size_t j = 0; j < dense.n_dims(); j++)
+      assert(point[j] == dense[5][j]);
+  }
+  std::cout << " ... PASSED" << std::endl;
+
+  std::cout << "Testing the sparse text reader";
+  {
+    std::ofstream ofs("test_sparse_data.txt");
+    ofs << "0:1.5 3:2\n\n4:0.25 1:1e-1 \n0:0\n";
+    ofs.close();
+    const SparseTable<double> table("test_sparse_data.txt");
+    assert(table.n_points() == 3);
+    assert(table.n_dims() == 5);
+    assert(table.n_nonzeros() == 4);
+    assert(table[1].indices()[0] == 1 and table[1].values()[0] == 0.1);
+    assert(table[1].indices()[1] == 4 and table[1].values()[1] == 0.25);
+    assert(table[2].n_nonzeros() == 0);
+
+    ofs.open("test_sparse_data.txt");
+    ofs << "0:1.5 3:2\n4-0.25\n";
+    ofs.close();
+    bool thrown = false;
+    try
+    {
+      SparseTable<double> bad_table("test_sparse_data.txt");
+    }
+    catch (const std::runtime_error& e)
+    {
+      thrown = (std::string(e.what()).find("line 2") != std::string::npos);
+    }
+    assert(thrown);
+    remove("test_sparse_data.txt");
+  }
+  std::cout << " ... PASSED" << std::endl;
+
+  std::cout << "Testing the sparse KL and L2 kernels";
+  TestKernels<KLDivergence<double> >(dense, sparse);
+  TestKernels<L2Divergence<double> >(dense, sparse);
+  TestKernels<KLDivergence<double, 200> >(dense, sparse);
+  std::cout << " ... PASSED" << std::endl;
+
+  std::cout << "Testing the bbtree on sparse tables";
+  TestTree<KLDivergence<double> >(dense, sparse);
+  TestTree<L2Divergence<double> >(dense, sparse);
+  std::cout << " ... PASSED" << std::endl;
+
+  std::cout << "Testing the search on sparse tables";
+  TestSearch<KLDivergence<double> >(dense, sparse, queries);
+  TestSearch<L2Divergence<double> >(dense, sparse, queries);
+  std::cout << " ... PASSED" << std::endl;
+
+  return 0;
+}
@@ -0,0 +1,160 @@
+/**
+ * @file bmst/mlpack_code/test_table_io.cpp
+ *
+ * This file tests writing tables in the binary format, memory-mapping
+ * them back and streaming them in blocks.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "data.hpp"
+#include "table_io.hpp"
+#include "table_stream.hpp"
+
+template <typename T>
+void TestRoundTrip(const size_t n_points, const size_t n_dims);
+
+template <typename T>
+void TestStream(
+    const std::string& file_name, 
+    const bmst::Table<T>& table, 
+    const size_t block_size);
+
+int main(int argc, char* argv[])
+{
+  std::cout << "Testing the binary table round trip (float)";
+  TestRoundTrip<float>(1000, 100);
+  TestRoundTrip<float>(10, 16);
+  std::cout << " ... PASSED" << std::endl;
+
+  std::cout << "Testing the binary table round trip (double)";
+  TestRoundTrip<double>(500, 37);
+  TestRoundTrip<double>(0, 5);
+  std::cout << " ... PASSED" << std::endl;
+
+  std::cout << "Testing LoadTable on text and binary files";
+  {
+    const bmst::Table<double> text_table("../test_data.csv");
+    assert(not bmst::IsBinaryTable("../test_data.csv"));
+    bmst::WriteBinaryTable(text_table, "test_data.bin");
+    assert(bmst::IsBinaryTable("test_data.bin"));
+    const bmst::Table<double> bin_table =
+      bmst::LoadTable<double>("test_data.bin");
+    const bmst::Table<double> loaded_text_table =
+      bmst::LoadTable<double>("../test_data.csv");
+    assert(bin_table.n_points() == text_table.n_points());
+    assert(loaded_text_table.n_points() == text_table.n_points());
+    for (size_t i = 0; i < text_table.n_points(); i++)
+      for (size_t j = 0; j < text_table.n_dims(); j++)
+      {
+        assert(bin_table[i][j] == text_table[i][j]);
+        assert(loaded_text_table[i][j] == text_table[i][j]);
+      }
+    remove("test_data.bin");
+  }
+  std::cout << " ... PASSED" << std::endl;
+
+  std::cout << "Testing the table stream on text and binary files";
+  {
+    const bmst::Table<double> text_table("../test_data.csv");
+    bmst::WriteBinaryTable(text_table, "test_data.bin");
+    const size_t block_sizes[] = { 1, 7, text_table.n_points(), 100000 };
+    for (size_t i = 0; i < 4; i++)
+    {
+      TestStream("../test_data.csv", text_table, block_sizes[i]);
+      TestStream("test_data.bin", text_table, block_sizes[i]);
+    }
+    remove("test_data.bin");
+  }
+  std::cout << " ... PASSED" << std::endl;
+
+  return 0;
+}
+
+template <typename T>
+void TestRoundTrip(const size_t n_points, const size_t n_dims)
+{
+  std::default_random_engine generator(time(NULL));
+  std::uniform_real_distribution<double> randu(0, 10);
+
+  std::vector<std::vector<T> > points;
+  for (size_t i = 0; i < n_points; i++) {
+    std::vector<T> point;
+    for (size_t j = 0; j < n_dims; j++)
+      point.push_back(randu(generator));
+    points.push_back(point);
+  }
+  bmst::Table<T> table(n_points, n_dims);
+  for (size_t i = 0; i < n_points; i++)
+    for (size_t j = 0; j < n_dims; j++)
+      table[i][j] = points[i][j];
+
+  const std::string file_name = "test_table_io.bin";
+  bmst::WriteBinaryTable(table, file_name);
+  {
+    bmst::Table<T> mapped = bmst::MapBinaryTable<T>(file_name, true);
+    assert(mapped.n_points() == n_points);
+    assert(mapped.n_dims() == n_dims);
+    assert(mapped.stride() == table.stride());
+    for (size_t i = 0; i < n_points; i++) {
+      assert((size_t) mapped[i].values() %
+        bmst::Table<T>::kAlignment == 0);
+      for (size_t j = 0; j < n_dims; j++)
+        assert(mapped[i][j] == points[i][j]);
+    }
+
+    // the mapping is private, so modifying it does not touch the file
+    if (n_points > 1) {
+      mapped.Swap(0, n_points - 1);
+      for (size_t j = 0; j < n_dims; j++)
+        assert(mapped[0][j] == points[n_points - 1][j]);
+    }
+
+    // copies own their data
+    const bmst::Table<T> copy(mapped);
+    assert(copy.n_points() == mapped.n_points());
+    assert(copy.values() != mapped.values() or n_points == 0);
+  }
+
+  // the file is still intact
+  const bmst::Table<T> remapped = bmst::MapBinaryTable<T>(file_name, true);
+  for (size_t i = 0; i < n_points; i++)
+    for (size_t j = 0; j < n_dims; j++)
+      assert(remapped[i][j] == points[i][j]);
+
+  remove(file_name.c_str());
+  return;
+}
+
+template <typename T>
+void TestStream(
+    const std::string& file_name, 
+    const bmst::Table<T>& table, 
+    const size_t block_size)
+{
+  bmst::TableStream<T> stream(file_name, block_size);
+  assert(stream.n_dims() == table.n_dims());
+
+  // iterate twice to check that the stream rewinds
+  for (size_t pass = 0; pass < 2; pass++) {
+    size_t n_points = 0;
+    for (typename bmst::TableStream<T>::Iterator it = stream.begin(); 
+         it != stream.end(); ++it) {
+      assert(it->n_points() > 0);
+      assert(it->n_points() <= block_size);
+      assert(it->n_dims() == table.n_dims());
+      for (size_t i = 0; i < it->n_points(); i++, n_points++)
+        for (size_t j = 0; j < table.n_dims(); j++)
+          assert((*it)[i][j] == table[n_points][j]);
+    }
+    assert(n_points == table.n_points());
+  }
+  return;
+}
@@ -0,0 +1,271 @@
+/**
+ * @file bmst/mlpack_code/test_tree_io.cpp
+ *
+ * This file tests saving trees as tree indices and loading them back,
+ * in both layouts and in the searches.
+ */
+
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stddef.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "KLDivergence.hpp"
+#include "L2Divergence.hpp"
+#include "bregman_ball.hpp"
+#include "bregman_ball_tree.hpp"
+#include "enhanced_bregman_ball.hpp"
+#include "flat_bregman_ball_tree.hpp"
+#include "kmeans_splitter.hpp"
+#include "left_nn_search.hpp"
+#include "minimum_spanning_tree.hpp"
+#include "mst_edge_max.hpp"
+#include "tree_io.hpp"
+
+template <typename T>
+bmst::Table<T> RandomTable(const size_t n_points, const size_t n_dims);
+
+// The nodes of both trees in depth-first order must be the same
+template <typename T, class TTree, class TOtherTree>
+void CompareTrees(const TTree& tree, const TOtherTree& other_tree);
+
+// Whether loading a copy of the index, with the value at offset
+// overwritten (or cut at offset if truncate), fails with the exit status
+// of the error path
+bool LoadFails(
+    const std::string& file_name,
+    const size_t offset,
+    const uint64_t value,
+    const bool truncate = false);
+
+int main(int argc, char* argv[])
+{
+  typedef bmst::KLDivergence<double> TBDiv;
+  typedef bmst::KMeansSplitter<double, TBDiv> TSplitter;
+  typedef bmst::BregmanBall<double, TBDiv> TBBall;
+  typedef bmst::BregmanBallTree<double, TBDiv, TBBall, TSplitter> BBTree;
+  typedef bmst::FlatBregmanBallTree<double, TBDiv, TSplitter> FlatTree;
+
+  std::cout << "Testing the tree index round trip";
+  {
+    bmst::Table<double> data = RandomTable<double>(3000, 12);
+    std::vector<size_t> old_from_new;
+    const BBTree tree(data, old_from_new, 8);
+    bmst::WriteTreeIndex(tree, data, old_from_new, "test_tree.idx", 8);
+    assert(bmst::IsTreeIndex("test_tree.idx"));
+    assert(not bmst::IsTreeIndex("../test_data.csv"));
+
+    const bmst::TreeIndex<double> index("test_tree.idx", true);
+    assert(index.n_points() == data.n_points());
+    assert(index.n_dims() == data.n_dims());
+    assert(index.leaf_size() == 8);
+    assert(index.n_extra_stats() == 0);
+
+    const bmst::Table<double> index_data = index.Data();
+    for (size_t i = 0; i < data.n_points(); i++)
+      for (size_t j = 0; j < data.n_dims(); j++)
+        assert(index_data[i][j] == data[i][j]);
+    std::vector<size_t> index_old_from_new;
+    index.OldFromNew(index_old_from_new);
+    assert(index_old_from_new == old_from_new);
+
+    const BBTree loaded_tree(index);
+    CompareTrees<double>(tree, loaded_tree);
+    const FlatTree flat_tree(index);
+    assert(flat_tree.n_nodes() == index.n_nodes());
+    CompareTrees<double>(tree, flat_tree);
+
+    // and from the flat layout
+    const FlatTree tree_flat(tree);
+    bmst::WriteTreeIndex(tree_flat, data, old_from_new, "test_flat.idx");
+    const bmst::TreeIndex<double> flat_index("test_flat.idx", true);
+    CompareTrees<double>(tree, BBTree(flat_index));
+
+    // corrupted and truncated indices are rejected
+    bmst::TreeFileHeader header;
+    std::ifstream header_file("test_tree.idx", std::ios::binary);
+    header_file.read((char*) &header, sizeof(header));
+    header_file.close();
+    std::cout.flush();
+    assert(LoadFails("test_tree.idx", header.file_size - 8, 0, true));
+    assert(LoadFails("test_tree.idx",
+          offsetof(bmst::TreeFileHeader, data_offset), header.file_size));
+    assert(LoadFails("test_tree.idx",
+          offsetof(bmst::TreeFileHeader, centroids_offset),
+          header.nodes_offset));
+    assert(LoadFails("test_tree.idx",
+          offsetof(bmst::TreeFileHeader, n_nodes), (uint64_t) -1));
+    // the right child of the root and the count of its left child
+    assert(LoadFails("test_tree.idx",
+          header.nodes_offset + offsetof(bmst::TreeFileNode, right),
+          header.n_nodes));
+    assert(LoadFails("test_tree.idx",
+          header.nodes_offset + offsetof(bmst::TreeFileNode, right), 1));
+    assert(LoadFails("test_tree.idx", header.nodes_offset +
+          sizeof(bmst::TreeFileNode) + offsetof(bmst::TreeFileNode, count),
+          data.n_points() + 1));
+    // an old_from_new entry past the points
+    assert(LoadFails("test_tree.idx", header.permutation_offset +
+          5 * sizeof(uint64_t), data.n_points()));
+    remove("test_tree.idx");
+    remove("test_flat.idx");
+  }
+  std::cout << " ... PASSED" << std::endl;
+
+  std::cout << "Testing the extra stats of the tree index";
+  {
+    typedef bmst::EnhancedBregmanBall<float, bmst::KLDivergence<float> >
+      TEnhancedBall;
+    typedef bmst::BregmanBallTree<float, bmst::KLDivergence<float>,
+            TEnhancedBall,
+            bmst::KMeansSplitter<float, bmst::KLDivergence<float> > >
+              EnhancedTree;
+    bmst::Table<float> data = RandomTable<float>(1000, 7);
+    std::vector<size_t> old_from_new;
+    const EnhancedTree tree(data, old_from_new, 10);
+    bmst::WriteTreeIndex(tree, data, old_from_new, "test_enhanced.idx");
+    const bmst::TreeIndex<float> index("test_enhanced.idx", true);
+    assert(index.n_extra_stats() == TEnhancedBall::kNumExtraStats);
+    const EnhancedTree loaded_tree(index);
+    CompareTrees<float>(tree, loaded_tree);
+    double stats[2];
+    double loaded_stats[2];
+    tree.Bound().GetExtraStats(stats);
+    loaded_tree.Bound().GetExtraStats(loaded_stats);
+    assert(stats[0] > 0 and stats[1] > 0);
+    assert(stats[0] == loaded_stats[0] and stats[1] == loaded_stats[1]);
+    remove("test_enhanced.idx");
+  }
+  std::cout << " ... PASSED" << std::endl;
+
+  std::cout << "Testing the searches from a tree index";
+  {
+    const bmst::Table<double> references = RandomTable<double>(2000, 10);
+    const bmst::Table<double> queries = RandomTable<double>(100, 10);
+    bmst::LeftNNSearch<double, TBDiv, TBBall> searcher(references, 5);
+    searcher.SaveIndex("test_search.idx");
+
+    const bmst::TreeIndex<double> index("test_search.idx");
+    bmst::LeftNNSearch<double, TBDiv, TBBall> loaded_searcher(index);
+    bmst::LeftNNSearch<double, TBDiv, TBBall, bmst::Table<double>, FlatTree>
+      flat_searcher(index);
+    for (size_t q = 0; q < queries.n_points(); q++)
+    {
+      const size_t neighbor = searcher.ComputeNeighbor(queries[q]);
+      assert(loaded_searcher.ComputeNeighbor(queries[q]) == neighbor);
+      assert(flat_searcher.ComputeNeighbor(queries[q]) == neighbor);
+    }
+    remove("test_search.idx");
+
+    typedef bmst::MinimumSpanningTree<double,
+            bmst::MstMaxEdge<double, TBDiv>, FlatTree> FlatMst;
+    bmst::Table<double> mst_data = RandomTable<double>(500, 5);
+    FlatMst mst(mst_data, 5);
+    mst.SaveIndex("test_mst.idx");
+    mst.ComputeDTB();
+    FlatMst loaded_mst(bmst::TreeIndex<double>("test_mst.idx"));
+    loaded_mst.ComputeDTB();
+    double weight = 0;
+    double loaded_weight = 0;
+    for (const bmst::Edge& edge : mst.EdgeList())
+      weight += edge.weight;
+    for (const bmst::Edge& edge : loaded_mst.EdgeList())
+      loaded_weight += edge.weight;
+    assert(fabs(weight - loaded_weight) < 1e-9 * weight);
+    remove("test_mst.idx");
+  }
+  std::cout << " ... PASSED" << std::endl;
+
+  return 0;
+}
+
+template <typename T>
+bmst::Table<T> RandomTable(const size_t n_points, const size_t n_dims)
+{
+  static std::mt19937 gen(11);
+  std::uniform_real_distribution<T> randu(0.01, 1.0);
+  bmst::Table<T> table(n_points, n_dims);
+  for (size_t i = 0; i < n_points; i++)
+    for (size_t j = 0; j < n_dims; j++)
+      table[i][j] = randu(gen);
+  return table;
+}
+
+bool LoadFails(
+    const std::string& file_name,
+    const size_t offset,
+    const uint64_t value,
+    const bool truncate)
+{
+  std::ifstream in(file_name.c_str(), std::ios::binary);
+  std::string bytes((std::istreambuf_iterator<char>(in)),
+      std::istreambuf_iterator<char>());
+  if (truncate)
+    bytes.resize(offset);
+  else
+    bytes.replace(offset, sizeof(value), (const char*) &value, sizeof(value));
+  std::ofstream out("test_corrupted.idx", std::ios::binary);
+  out.write(bytes.data(), bytes.size());
+  out.close();
+
+  // the error path exits, so load in a child process
+  const pid_t pid = fork();
+  if (pid == 0)
+  {
+    freopen("/dev/null", "w", stdout);
+    const bmst::TreeIndex<double> index("test_corrupted.idx", true);
+    exit(0);
+  }
+  int status = 0;
+  waitpid(pid, &status, 0);
+  remove("test_corrupted.idx");
+  return WIFEXITED(status) and WEXITSTATUS(status) == 1;
+}
+
+template <typename T, class TTree, class TOtherTree>
+void CompareTrees(const TTree& tree, const TOtherTree& other_tree)
+{
+  typedef typename TTree::TNode TNode;
+  typedef typename TOtherTree::TNode TOtherNode;
+  std::vector<const TNode*> stack(1, tree.Root());
+  std::vector<const TOtherNode*> other_stack(1, other_tree.Root());
+  while (not stack.empty())
+  {
+    const TNode* node = stack.back();
+    const TOtherNode* other_node = other_stack.back();
+    stack.pop_back();
+    other_stack.pop_back();
+    assert(node->Begin() == other_node->Begin());
+    assert(node->Count() == other_node->Count());
+    assert(node->IsLeaf() == other_node->IsLeaf());
+    assert(node->RRadius() == other_node->RRadius());
+    assert(node->LRadius() == other_node->LRadius());
+    const auto& ball = tree.Bound(node);
+    const auto& other_ball = other_tree.Bound(other_node);
+    for (size_t j = 0; j < tree.RCenter(node).n_dims(); j++)
+    {
+      assert(ball.right_centroid()[j] == other_ball.right_centroid()[j]);
+      assert(ball.right_centroid_prime()[j] ==
+          other_ball.right_centroid_prime()[j]);
+      assert(ball.left_centroid()[j] == other_ball.left_centroid()[j]);
+      assert(ball.left_centroid_prime()[j] ==
+          other_ball.left_centroid_prime()[j]);
+    }
+    if (not node->IsLeaf())
+    {
+      stack.push_back(tree.Right(node));
+      stack.push_back(tree.Left(node));
+      other_stack.push_back(other_tree.Right(other_node));
+      other_stack.push_back(other_tree.Left(other_node));
+    }
+  }
+  assert(other_stack.empty());
+}
@@ -0,0 +1,84 @@
+/**
+ * @file bregman_mst/mlpack_code/text_parser.hpp
+ *
+ * A parallel parser for the comma/space separated text data files. The
+ * file is memory-mapped and split into byte ranges on line boundaries;
+ * the ranges are first scanned in parallel to count the points in each
+ * of them, and then parsed in parallel with std::from_chars straight
+ * into the preallocated Table buffer.
+ */
+
+#ifndef BMST_TEXT_PARSER_HPP_
+#define BMST_TEXT_PARSER_HPP_
+
+#include <string>
+#include <vector>
+
+#include "data.hpp"
+
+namespace bmst {
+namespace text_parser {
+
+// A byte range of the file that starts at the beginning of a line and
+// ends just after a newline (or at the end of the file)
+struct Chunk
+{
+  const char* begin;
+  const char* end;
+  // number of lines and of non-empty lines (points) in the chunk
+  size_t n_lines;
+  size_t n_points;
+  // number of values on the first non-empty line of the chunk
+  size_t n_dims;
+  // (1-based) line number of the first line of the chunk
+  size_t first_line;
+  // index of the first point of the chunk in the table
+  size_t first_point;
+  // the first error found while parsing the chunk (if any)
+  size_t error_line;
+  std::string error;
+};
+
+// Split [begin, end) into at most n_chunks ranges on line boundaries
+inline void SplitChunks(
+    const char* begin,
+    const char* end,
+    const size_t n_chunks,
+    std::vector<Chunk>& chunks);
+
+// Count the lines and the points in the chunk
+inline void ScanChunk(Chunk& chunk);
+
+// Returns the end of the longest run of complete lines of [begin, end)
+// holding at most max_points points, and the number of points in it. 
+// The last line only counts as complete without a trailing newline if 
+// at_eof is set.
+inline const char* TakeLines(
+    const char* begin, 
+    const char* end, 
+    const size_t max_points, 
+    const bool at_eof,
+    size_t& n_points);
+
+// Parse the points of the chunk into the rows of the table starting at
+// chunk.first_point. Lines with a number of values different from
+// n_dims are recorded as the chunk error.
+template<typename T>
+void ParseChunk(Chunk& chunk, const size_t n_dims, Table<T>& table);
+
+// Read a text data file into the table using n_threads threads (0
+// means one per hardware thread, as long as each gets a reasonably
+// sized part of the file). Throws a std::runtime_error
+// reporting the line number for malformed files.
+template<typename T>
+void ReadTable(
+    const std::string& file_name,
+    const size_t n_threads,
+    Table<T>& table);
+
+} // namespace
+} // namespace
+
+#include "text_parser_impl.hpp"
+
+#endif
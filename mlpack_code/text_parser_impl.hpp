@@ -0,0 +1,274 @@
+/**
+ * @file bregman_mst/mlpack_code/text_parser_impl.hpp
+ *
+ * Implementation of the functions defined in text_parser.hpp
+ */
+
+#ifndef BMST_TEXT_PARSER_IMPL_HPP_
+#define BMST_TEXT_PARSER_IMPL_HPP_
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <charconv>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#include "text_parser.hpp"
+
+namespace bmst {
+namespace text_parser {
+
+// do not bother spawning threads for less than this many bytes each
+const size_t kMinChunkBytes = 1 << 20;
+
+inline bool IsSeparator(const char c)
+{
+  return c == ' ' or c == ',' or c == '\t' or c == '\r';
+}
+
+inline const char* LineEnd(const char* begin, const char* end)
+{
+  const char* newline = (const char*) memchr(begin, '\n', end - begin);
+  return newline ? newline : end;
+}
+
+inline void SplitChunks(
+    const char* begin,
+    const char* end,
+    const size_t n_chunks,
+    std::vector<Chunk>& chunks)
+{
+  chunks.clear();
+  const size_t n_bytes = end - begin;
+  const char* chunk_begin = begin;
+  for (size_t i = 1; i <= n_chunks and chunk_begin < end; i++)
+  {
+    const char* chunk_end = end;
+    if (i < n_chunks)
+    {
+      chunk_end = LineEnd(begin + (n_bytes / n_chunks) * i, end);
+      if (chunk_end < end)
+        ++chunk_end;
+      if (chunk_end <= chunk_begin)
+        continue;
+    }
+    Chunk chunk;
+    chunk.begin = chunk_begin;
+    chunk.end = chunk_end;
+    chunk.n_lines = 0;
+    chunk.n_points = 0;
+    chunk.n_dims = 0;
+    chunk.first_line = 0;
+    chunk.first_point = 0;
+    chunk.error_line = 0;
+    chunks.push_back(chunk);
+    chunk_begin = chunk_end;
+  }
+}
+
+inline void ScanChunk(Chunk& chunk)
+{
+  for (const char* line = chunk.begin; line < chunk.end; )
+  {
+    const char* line_end = LineEnd(line, chunk.end);
+    ++chunk.n_lines;
+
+    const char* c = line;
+    while (c < line_end and IsSeparator(*c))
+      ++c;
+    if (c < line_end)
+    {
+      if (chunk.n_points == 0)
+      {
+        // count the values on the first point of the chunk
+        while (c < line_end)
+        {
+          ++chunk.n_dims;
+          while (c < line_end and not IsSeparator(*c))
+            ++c;
+          while (c < line_end and IsSeparator(*c))
+            ++c;
+        }
+      }
+      ++chunk.n_points;
+    }
+    line = line_end + 1;
+  }
+}
+
+inline const char* TakeLines(
+    const char* begin, 
+    const char* end, 
+    const size_t max_points, 
+    const bool at_eof,
+    size_t& n_points)
+{
+  n_points = 0;
+  const char* line = begin;
+  while (line < end)
+  {
+    const char* line_end = LineEnd(line, end);
+    if (line_end == end and not at_eof)
+      break;
+
+    const char* c = line;
+    while (c < line_end and IsSeparator(*c))
+      ++c;
+    if (c < line_end)
+    {
+      if (n_points == max_points)
+        break;
+      ++n_points;
+    }
+    line = (line_end < end) ? line_end + 1 : end;
+  }
+  return line;
+}
+
+template<typename T>
+void ParseChunk(Chunk& chunk, const size_t n_dims, Table<T>& table)
+{
+  size_t line_number = chunk.first_line;
+  size_t point = chunk.first_point;
+  for (const char* line = chunk.begin; line < chunk.end; ++line_number)
+  {
+    const char* line_end = LineEnd(line, chunk.end);
+    T* row = table.values() + point * table.stride();
+    size_t n_values = 0;
+
+    const char* c = line;
+    while (c < line_end)
+    {
+      while (c < line_end and IsSeparator(*c))
+        ++c;
+      if (c == line_end)
+        break;
+
+      // from_chars does not accept an explicit plus sign
+      if (*c == '+')
+        ++c;
+      double value;
+      std::from_chars_result result = std::from_chars(c, line_end, value);
+      if (result.ec != std::errc()
+          or (result.ptr < line_end and not IsSeparator(*result.ptr)))
+      {
+        chunk.error_line = line_number;
+        chunk.error = "could not parse a number";
+        return;
+      }
+      if (n_values < n_dims)
+        row[n_values] = (T) value;
+      ++n_values;
+      c = result.ptr;
+    }
+
+    if (n_values > 0)
+    {
+      if (n_values != n_dims)
+      {
+        std::ostringstream error;
+        error << "Dimensionality of the points do not match (expected " <<
+          n_dims << ", found " << n_values << ")";
+        chunk.error_line = line_number;
+        chunk.error = error.str();
+        return;
+      }
+      ++point;
+    }
+    line = line_end + 1;
+  }
+}
+
+template<typename T>
+void ReadTable(
+    const std::string& file_name,
+    const size_t n_threads,
+    Table<T>& table)
+{
+  int fd = open(file_name.c_str(), O_RDONLY);
+  if (fd < 0)
+    throw std::runtime_error("Could not open '" + file_name + "'");
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0)
+  {
+    close(fd);
+    throw std::runtime_error("Could not stat '" + file_name + "'");
+  }
+  const size_t file_size = file_stat.st_size;
+  if (file_size == 0)
+  {
+    close(fd);
+    table = Table<T>();
+    return;
+  }
+  void* base = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED)
+    throw std::runtime_error("Could not memory-map '" + file_name + "'");
+  madvise(base, file_size, MADV_SEQUENTIAL);
+
+  size_t n_chunks = n_threads;
+  if (n_chunks == 0)
+    n_chunks = std::max((size_t) 1, std::min(
+        (size_t) std::thread::hardware_concurrency(),
+        file_size / kMinChunkBytes));
+
+  std::vector<Chunk> chunks;
+  const char* begin = (const char*) base;
+  SplitChunks(begin, begin + file_size, n_chunks, chunks);
+
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < chunks.size(); i++)
+    threads.push_back(std::thread(ScanChunk, std::ref(chunks[i])));
+  ScanChunk(chunks[0]);
+  for (size_t i = 0; i < threads.size(); i++)
+    threads[i].join();
+  threads.clear();
+
+  // assign the line numbers and the table rows to the chunks
+  size_t n_points = 0;
+  size_t n_lines = 0;
+  size_t n_dims = 0;
+  for (size_t i = 0; i < chunks.size(); i++)
+  {
+    chunks[i].first_line = n_lines + 1;
+    chunks[i].first_point = n_points;
+    n_lines += chunks[i].n_lines;
+    n_points += chunks[i].n_points;
+    if (n_dims == 0)
+      n_dims = chunks[i].n_dims;
+  }
+
+  table = Table<T>(n_points, n_dims);
+  for (size_t i = 1; i < chunks.size(); i++)
+    threads.push_back(std::thread(
+        ParseChunk<T>, std::ref(chunks[i]), n_dims, std::ref(table)));
+  ParseChunk<T>(chunks[0], n_dims, table);
+  for (size_t i = 0; i < threads.size(); i++)
+    threads[i].join();
+
+  munmap(base, file_size);
+
+  // report the first error in the file
+  for (size_t i = 0; i < chunks.size(); i++)
+  {
+    if (chunks[i].error_line > 0)
+    {
+      std::ostringstream error;
+      error << "'" << file_name << "', line " << chunks[i].error_line <<
+        ": " << chunks[i].error;
+      table = Table<T>();
+      throw std::runtime_error(error.str());
+    }
+  }
+}
+
+} // namespace
+} // namespace
+
+#endif
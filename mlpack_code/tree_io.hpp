@@ -0,0 +1,155 @@
+/**
+ * @file bregman_mst/mlpack_code/tree_io.hpp
+ *
+ * A versioned binary on-disk format for a built BregmanBallTree: the
+ * nodes, the centroids of their balls and the gradients of the
+ * centroids, the extra stats of the balls (see
+ * BregmanBall::kNumExtraStats), the old_from_new permutation and the
+ * reordered data, so that a search can start from a prebuilt index
+ * instead of building the tree again.
+ *
+ * Layout: a TreeFileHeader and then the sections, each one starting at
+ * a multiple of Table<T>::kAlignment:
+ *  - n_nodes TreeFileNode, in depth-first (pre-)order from the root (the
+ *    layout of FlatBregmanBallTree);
+ *  - the right centroids, their gradients, the left centroids and their
+ *    gradients: four tables of n_nodes rows laid out as Table<T> rows;
+ *  - n_nodes * n_extra_stats doubles;
+ *  - n_points uint64_t, old_from_new;
+ *  - n_points rows of the data, laid out as Table<T> rows.
+ * The tables are laid out as in memory (as in table_io.hpp), so that
+ * they are memory-mapped without parsing or copying. The divergence is
+ * not recorded: an index must be loaded with the divergence it was built
+ * with.
+ */
+
+#ifndef BMST_TREE_IO_HPP_
+#define BMST_TREE_IO_HPP_
+
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "data.hpp"
+#include "table_io.hpp"
+
+namespace bmst {
+
+// The header at the start of every tree index file
+struct TreeFileHeader
+{
+  // "BMSTIDX" followed by a null byte
+  char magic[8];
+  uint32_t version;
+  // kTableByteOrderMark as written by the producer
+  uint32_t byte_order;
+  // one of the TableElementType values
+  uint32_t element_type;
+  uint32_t element_size;
+  uint64_t n_points;
+  uint64_t n_dims;
+  uint64_t n_nodes;
+  // the doubles of extra stats of every node
+  uint64_t n_extra_stats;
+  // the leaf size the tree was built with (0 if unknown)
+  uint64_t leaf_size;
+  // distance (in elements) between consecutive rows of the tables
+  uint64_t stride;
+  // alignment (in bytes) of the sections and of every row
+  uint64_t alignment;
+  // offsets (in bytes) of the sections from the start of the file
+  uint64_t nodes_offset;
+  uint64_t centroids_offset;
+  uint64_t extra_stats_offset;
+  uint64_t permutation_offset;
+  uint64_t data_offset;
+  uint64_t file_size;
+  // FNV-1a hash of everything after the header if kTableHasChecksum is
+  // set
+  uint64_t checksum;
+  uint32_t flags;
+  uint32_t reserved;
+};
+
+// A node of the tree index file
+struct TreeFileNode
+{
+  // the range of the node in the reordered data
+  uint64_t begin;
+  uint64_t count;
+  // the index of the right child (the left one is the next node), 0 for
+  // a leaf
+  uint64_t right;
+  double right_radius;
+  double left_radius;
+};
+
+const uint32_t kTreeFileVersion = 1;
+
+// Write the tree (a BregmanBallTree or a FlatBregmanBallTree), the data
+// it was built on (reordered by the construction) and its old_from_new
+// permutation in the binary format
+template<class TTree, typename T>
+void WriteTreeIndex(
+    const TTree& tree,
+    const Table<T>& data,
+    const std::vector<size_t>& old_from_new,
+    const std::string& file_name,
+    const size_t leaf_size = 0,
+    const bool with_checksum = true);
+
+// A tree index file memory-mapped read-only (copy-on-write, as in
+// MapBinaryTable). The tables it returns share the mapping, which stays
+// alive as long as one of them does.
+template<typename T>
+class TreeIndex
+{
+private:
+  std::shared_ptr<char> mapping_;
+  TreeFileHeader header_;
+  const TreeFileNode* nodes_;
+  const double* extra_stats_;
+  const uint64_t* permutation_;
+
+  // the table of n_points rows at offset in the mapping
+  Table<T> MappedTable_(const uint64_t offset, const size_t n_points) const;
+
+public:
+  TreeIndex(const std::string& file_name, const bool verify_checksum = false);
+
+  const size_t n_points() const { return header_.n_points; }
+  const size_t n_dims() const { return header_.n_dims; }
+  const size_t n_nodes() const { return header_.n_nodes; }
+  const size_t n_extra_stats() const { return header_.n_extra_stats; }
+  const size_t leaf_size() const { return header_.leaf_size; }
+
+  const TreeFileNode& Node(const size_t node) const { return nodes_[node]; }
+  // the n_extra_stats() stats of the node
+  const double* ExtraStats(const size_t node) const
+  {
+    return extra_stats_ + node * header_.n_extra_stats;
+  }
+
+  // one row per node, without copying
+  Table<T> RightCentroids() const;
+  Table<T> RightCentroidPrimes() const;
+  Table<T> LeftCentroids() const;
+  Table<T> LeftCentroidPrimes() const;
+
+  // the reordered data, without copying
+  Table<T> Data() const;
+
+  void OldFromNew(std::vector<size_t>& old_from_new) const;
+
+}; // class
+
+// Checks if the file starts with the tree index magic
+inline bool IsTreeIndex(const std::string& file_name);
+
+} // namespace
+
+#include "tree_io_impl.hpp"
+
+#endif
@@ -0,0 +1,424 @@
+/**
+ * @file bregman_mst/mlpack_code/tree_io_impl.hpp
+ *
+ * Implementation of the functions defined in tree_io.hpp
+ */
+
+#ifndef BMST_TREE_IO_IMPL_HPP_
+#define BMST_TREE_IO_IMPL_HPP_
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "tree_io.hpp"
+
+namespace bmst {
+
+namespace tree_io {
+
+const char kMagic[8] = { 'B', 'M', 'S', 'T', 'I', 'D', 'X', '\0' };
+
+inline uint64_t Aligned(const uint64_t offset, const uint64_t alignment)
+{
+  return ((offset + alignment - 1) / alignment) * alignment;
+}
+
+// Whether n_items items of item_size bytes from offset end by end, 
+// without overflowing on the counts of a corrupted header
+inline bool SectionFits(
+    const uint64_t offset, 
+    const uint64_t n_items, 
+    const uint64_t item_size, 
+    const uint64_t end)
+{
+  return offset <= end and 
+    (item_size == 0 or n_items <= (end - offset) / item_size);
+}
+
+// Writes the sections after the header, keeping track of the offset and
+// of the checksum
+class SectionWriter
+{
+private:
+  std::ofstream& ofs_;
+  uint64_t offset_;
+  uint64_t checksum_;
+  bool with_checksum_;
+
+public:
+  SectionWriter(
+      std::ofstream& ofs, const uint64_t offset, const bool with_checksum) :
+    ofs_(ofs),
+    offset_(offset),
+    checksum_(table_io::kChecksumSeed),
+    with_checksum_(with_checksum)
+  {}
+
+  void Write(const char* bytes, const size_t n_bytes)
+  {
+    ofs_.write(bytes, n_bytes);
+    offset_ += n_bytes;
+    if (with_checksum_)
+      checksum_ = table_io::Checksum(bytes, n_bytes, checksum_);
+  }
+
+  // zeros up to the next multiple of alignment
+  void Align(const uint64_t alignment)
+  {
+    const std::vector<char> padding(Aligned(offset_, alignment) - offset_, 0);
+    Write(padding.data(), padding.size());
+  }
+
+  const uint64_t offset() const { return offset_; }
+  const uint64_t checksum() const { return with_checksum_ ? checksum_ : 0; }
+};
+
+} // namespace tree_io
+
+template<class TTree, typename T>
+void WriteTreeIndex(
+    const TTree& tree,
+    const Table<T>& data,
+    const std::vector<size_t>& old_from_new,
+    const std::string& file_name,
+    const size_t leaf_size,
+    const bool with_checksum)
+{
+  typedef typename TTree::TNode TNode;
+  typedef typename std::decay<
+    decltype(tree.Bound(tree.Root()))>::type TBall;
+  assert(old_from_new.size() == data.n_points());
+
+  // the nodes in depth-first order, and the index of their right child
+  std::vector<const TNode*> nodes;
+  std::vector<uint64_t> rights;
+  std::vector<std::pair<const TNode*, size_t> > stack(
+      1, std::make_pair(tree.Root(), (size_t) 0));
+  while (not stack.empty())
+  {
+    const TNode* node = stack.back().first;
+    const size_t parent = stack.back().second;
+    stack.pop_back();
+    const size_t index = nodes.size();
+    // every right child comes after the subtree of its left sibling
+    if (index > 0 and parent != index - 1)
+      rights[parent] = index;
+    nodes.push_back(node);
+    rights.push_back(0);
+    if (not node->IsLeaf())
+    {
+      stack.push_back(std::make_pair(tree.Right(node), index));
+      stack.push_back(std::make_pair(tree.Left(node), index));
+    }
+  }
+
+  const size_t n_nodes = nodes.size();
+  const size_t n_dims = data.n_dims();
+  const uint64_t alignment = Table<T>::kAlignment;
+  const uint64_t stride = Table<T>::Stride(n_dims);
+  const uint64_t rows_bytes = n_nodes * stride * sizeof(T);
+
+  TreeFileHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, tree_io::kMagic, sizeof(header.magic));
+  header.version = kTreeFileVersion;
+  header.byte_order = kTableByteOrderMark;
+  header.element_type = table_io::ElementType<T>::value;
+  header.element_size = sizeof(T);
+  header.n_points = data.n_points();
+  header.n_dims = n_dims;
+  header.n_nodes = n_nodes;
+  header.n_extra_stats = TBall::kNumExtraStats;
+  header.leaf_size = leaf_size;
+  header.stride = stride;
+  header.alignment = alignment;
+  header.nodes_offset = tree_io::Aligned(sizeof(header), alignment);
+  header.centroids_offset = tree_io::Aligned(
+      header.nodes_offset + n_nodes * sizeof(TreeFileNode), alignment);
+  header.extra_stats_offset = tree_io::Aligned(
+      header.centroids_offset + 4 * rows_bytes, alignment);
+  header.permutation_offset = tree_io::Aligned(
+      header.extra_stats_offset +
+      n_nodes * header.n_extra_stats * sizeof(double), alignment);
+  header.data_offset = tree_io::Aligned(
+      header.permutation_offset + data.n_points() * sizeof(uint64_t),
+      alignment);
+  header.file_size =
+    header.data_offset + data.n_points() * stride * sizeof(T);
+  if (with_checksum)
+    header.flags |= kTableHasChecksum;
+
+  std::ofstream ofs(file_name.c_str(), std::ofstream::binary);
+  if (not ofs.good())
+  {
+    std::cout << "[ERROR] Could not open '" << file_name << "' for "
+      "writing." << std::endl;
+    exit(1);
+  }
+  // the header is rewritten with the checksum at the end
+  ofs.write((const char*) &header, sizeof(header));
+  tree_io::SectionWriter writer(ofs, sizeof(header), with_checksum);
+
+  writer.Align(alignment);
+  assert(writer.offset() == header.nodes_offset);
+  for (size_t i = 0; i < n_nodes; i++)
+  {
+    TreeFileNode file_node;
+    memset(&file_node, 0, sizeof(file_node));
+    file_node.begin = nodes[i]->Begin();
+    file_node.count = nodes[i]->Count();
+    file_node.right = rights[i];
+    file_node.right_radius = nodes[i]->RRadius();
+    file_node.left_radius = nodes[i]->LRadius();
+    writer.Write((const char*) &file_node, sizeof(file_node));
+  }
+
+  writer.Align(alignment);
+  assert(writer.offset() == header.centroids_offset);
+  const std::vector<T> padding(stride - n_dims, T(0));
+  for (size_t table = 0; table < 4; table++)
+    for (size_t i = 0; i < n_nodes; i++)
+    {
+      const auto& ball = tree.Bound(nodes[i]);
+      const T* values =
+        (table == 0) ? ball.right_centroid().values() :
+        (table == 1) ? ball.right_centroid_prime().values() :
+        (table == 2) ? ball.left_centroid().values() :
+        ball.left_centroid_prime().values();
+      writer.Write((const char*) values, n_dims * sizeof(T));
+      writer.Write((const char*) padding.data(), padding.size() * sizeof(T));
+    }
+
+  writer.Align(alignment);
+  assert(writer.offset() == header.extra_stats_offset);
+  std::vector<double> stats(header.n_extra_stats);
+  for (size_t i = 0; i < n_nodes; i++)
+  {
+    tree.Bound(nodes[i]).GetExtraStats(stats.data());
+    writer.Write((const char*) stats.data(), stats.size() * sizeof(double));
+  }
+
+  writer.Align(alignment);
+  assert(writer.offset() == header.permutation_offset);
+  const std::vector<uint64_t> permutation(
+      old_from_new.begin(), old_from_new.end());
+  writer.Write((const char*) permutation.data(),
+      permutation.size() * sizeof(uint64_t));
+
+  writer.Align(alignment);
+  assert(writer.offset() == header.data_offset);
+  // the padding of the table rows is already zero
+  writer.Write((const char*) data.values(),
+      data.n_points() * data.stride() * sizeof(T));
+
+  header.checksum = writer.checksum();
+  ofs.seekp(0);
+  ofs.write((const char*) &header, sizeof(header));
+  if (not ofs.good())
+  {
+    std::cout << "[ERROR] Failed writing the tree index to '" << file_name <<
+      "'." << std::endl;
+    exit(1);
+  }
+  ofs.close();
+}
+
+template<typename T>
+TreeIndex<T>::TreeIndex(
+    const std::string& file_name,
+    const bool verify_checksum)
+{
+  int fd = open(file_name.c_str(), O_RDONLY);
+  if (fd < 0)
+  {
+    std::cout << "[ERROR] Could not open '" << file_name << "'." << std::endl;
+    exit(1);
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0
+      or (size_t) file_stat.st_size < sizeof(TreeFileHeader))
+  {
+    std::cout << "[ERROR] '" << file_name << "' is too small to be a "
+      "tree index." << std::endl;
+    exit(1);
+  }
+  const size_t file_size = file_stat.st_size;
+
+  void* base = mmap(
+      NULL, file_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  // the mapping stays valid after closing the descriptor
+  close(fd);
+  if (base == MAP_FAILED)
+  {
+    std::cout << "[ERROR] Could not memory-map '" << file_name << "'." <<
+      std::endl;
+    exit(1);
+  }
+  mapping_ = std::shared_ptr<char>(
+      (char*) base, [file_size](char* base) { munmap(base, file_size); });
+
+  memcpy(&header_, base, sizeof(header_));
+  std::string error;
+  if (memcmp(header_.magic, tree_io::kMagic, sizeof(header_.magic)) != 0)
+    error = "not a tree index";
+  else if (header_.version != kTreeFileVersion)
+    error = "unsupported format version";
+  else if (header_.byte_order != kTableByteOrderMark)
+    error = "written with a different byte order";
+  else if (header_.element_type != table_io::ElementType<T>::value
+           or header_.element_size != sizeof(T))
+    error = "element type does not match the requested table type";
+  else if (header_.alignment != Table<T>::kAlignment
+           or header_.stride != Table<T>::Stride(header_.n_dims)
+           or header_.nodes_offset % Table<T>::kAlignment != 0
+           or header_.centroids_offset % Table<T>::kAlignment != 0
+           or header_.extra_stats_offset % Table<T>::kAlignment != 0
+           or header_.permutation_offset % Table<T>::kAlignment != 0
+           or header_.data_offset % Table<T>::kAlignment != 0)
+    error = "row layout does not match the in-memory layout";
+  else if (header_.n_nodes == 0)
+    error = "no nodes";
+  else if (header_.file_size > file_size)
+    error = "file is truncated";
+  else if (header_.stride > file_size or header_.n_extra_stats > file_size)
+    error = "row sizes do not fit in the file";
+  else if (header_.nodes_offset < sizeof(header_)
+           or not tree_io::SectionFits(header_.nodes_offset, 
+               header_.n_nodes, sizeof(TreeFileNode), 
+               header_.centroids_offset)
+           or not tree_io::SectionFits(header_.centroids_offset, 
+               header_.n_nodes, 4 * header_.stride * sizeof(T), 
+               header_.extra_stats_offset)
+           or not tree_io::SectionFits(header_.extra_stats_offset, 
+               header_.n_nodes, header_.n_extra_stats * sizeof(double), 
+               header_.permutation_offset)
+           or not tree_io::SectionFits(header_.permutation_offset, 
+               header_.n_points, sizeof(uint64_t), header_.data_offset)
+           or not tree_io::SectionFits(header_.data_offset, 
+               header_.n_points, header_.stride * sizeof(T), 
+               header_.file_size))
+    error = "sections overlap or are truncated";
+
+  // the nodes are in depth-first order, with their right child after 
+  // their left one (the next node), and their ranges within the points
+  const TreeFileNode* nodes =
+    (const TreeFileNode*) (mapping_.get() + header_.nodes_offset);
+  for (size_t i = 0; error.size() == 0 and i < header_.n_nodes; i++)
+  {
+    if (nodes[i].begin > header_.n_points
+        or nodes[i].count > header_.n_points - nodes[i].begin)
+      error = "node " + std::to_string(i) + " is out of the points";
+    else if (nodes[i].right != 0
+             and (nodes[i].right <= i + 1 
+                  or nodes[i].right >= header_.n_nodes))
+      error = "node " + std::to_string(i) + " has an invalid right child";
+  }
+
+  // the permutation maps the points to their original indices
+  const uint64_t* old_from_new =
+    (const uint64_t*) (mapping_.get() + header_.permutation_offset);
+  for (size_t i = 0; error.size() == 0 and i < header_.n_points; i++)
+    if (old_from_new[i] >= header_.n_points)
+      error = "old_from_new entry " + std::to_string(i) + 
+        " is out of the points";
+
+  if (error.size() == 0 and verify_checksum
+      and (header_.flags & kTableHasChecksum))
+  {
+    const uint64_t checksum = table_io::Checksum(
+        mapping_.get() + sizeof(header_),
+        header_.file_size - sizeof(header_));
+    if (checksum != header_.checksum)
+      error = "checksum mismatch";
+  }
+
+  if (error.size() > 0)
+  {
+    std::cout << "[ERROR] '" << file_name << "': " << error << "." <<
+      std::endl;
+    exit(1);
+  }
+
+  nodes_ = (const TreeFileNode*) (mapping_.get() + header_.nodes_offset);
+  extra_stats_ =
+    (const double*) (mapping_.get() + header_.extra_stats_offset);
+  permutation_ =
+    (const uint64_t*) (mapping_.get() + header_.permutation_offset);
+  std::cout << "[INFO] " << header_.n_nodes << " nodes over " <<
+    header_.n_points << " points mapped with " << header_.n_dims <<
+    " dimensions each." << std::endl;
+}
+
+template<typename T>
+Table<T> TreeIndex<T>::MappedTable_(
+    const uint64_t offset, const size_t n_points) const
+{
+  // shares the ownership of the mapping
+  const std::shared_ptr<T> storage(
+      mapping_, (T*) (mapping_.get() + offset));
+  return Table<T>(storage, n_points, header_.n_dims);
+}
+
+template<typename T>
+Table<T> TreeIndex<T>::RightCentroids() const
+{
+  return MappedTable_(header_.centroids_offset, header_.n_nodes);
+}
+
+template<typename T>
+Table<T> TreeIndex<T>::RightCentroidPrimes() const
+{
+  return MappedTable_(
+      header_.centroids_offset +
+      header_.n_nodes * header_.stride * sizeof(T), header_.n_nodes);
+}
+
+template<typename T>
+Table<T> TreeIndex<T>::LeftCentroids() const
+{
+  return MappedTable_(
+      header_.centroids_offset +
+      2 * header_.n_nodes * header_.stride * sizeof(T), header_.n_nodes);
+}
+
+template<typename T>
+Table<T> TreeIndex<T>::LeftCentroidPrimes() const
+{
+  return MappedTable_(
+      header_.centroids_offset +
+      3 * header_.n_nodes * header_.stride * sizeof(T), header_.n_nodes);
+}
+
+template<typename T>
+Table<T> TreeIndex<T>::Data() const
+{
+  return MappedTable_(header_.data_offset, header_.n_points);
+}
+
+template<typename T>
+void TreeIndex<T>::OldFromNew(std::vector<size_t>& old_from_new) const
+{
+  old_from_new.assign(permutation_, permutation_ + header_.n_points);
+}
+
+inline bool IsTreeIndex(const std::string& file_name)
+{
+  std::ifstream ifs(file_name.c_str(), std::ifstream::binary);
+  char magic[sizeof(tree_io::kMagic)];
+  ifs.read(magic, sizeof(magic));
+  return ifs.good() and memcmp(magic, tree_io::kMagic, sizeof(magic)) == 0;
+}
+
+} // namespace
+
+#endif
@@ -50,26 +50,20 @@ void SplitSet(
   std::shuffle(
       full_list.begin(), full_list.end(), std::default_random_engine(rd()));
 
-  std::vector<Point<T> > point_set;
-
-  // Doing queries and references one by one to save memory
-  // pick the queries
-  for (size_t i = 0; i < table.n_points(); i++) 
-  {
-    if (full_list[i] == 0) 
-      point_set.push_back(table[i]);
-  }
-  qset.reset(new Table<T>(point_set));
-  point_set.clear();
-
-  // pick the references
+  // Copy the rows straight into the preallocated query and reference tables
+  qset.reset(new Table<T>(num_queries, table.n_dims()));
+  rset.reset(new Table<T>(table.n_points() - num_queries, table.n_dims()));
+  size_t q_ind = 0;
+  size_t r_ind = 0;
   for (size_t i = 0; i < table.n_points(); i++) 
   {
-    if (full_list[i] == 1)
-      point_set.push_back(table[i]);
+    const ConstPointView<T> point = table[i];
+    PointView<T> target =
+      (full_list[i] == 0) ? (*qset)[q_ind++] : (*rset)[r_ind++];
+    std::copy(point.values(), point.values() + point.n_dims(), target.values());
   }
-  rset.reset(new Table<T>(point_set));
-  point_set.clear();
+  assert(q_ind == qset->n_points());
+  assert(r_ind == rset->n_points());
 
   return;
 }